@@ -10,7 +10,12 @@
 #include <gutil.h>
 #include <glist.h>
 
+#include <pthread.h>
+
+#include "bindx_batch.h"
+#include "bindx_bench.h"
 #include "bindx_c.h"
+#include "bindx_cache.h"
 #include "bindx_cpp.h"
 #include "bindx_f90.h"
 #include "bindx_f77.h"
@@ -31,6 +36,34 @@
 #define MAX_IN_FILES	16
 #define MAX_OUT_FILES	16
 
+#define MAX_WRITE_JOBS	8
+
+#define MAX_DEPS_FILES	(MAX_OUT_FILES * (MAX_WRITE_JOBS + 1))
+
+
+/* The sections of the IR each back-end consumes, used to decide with -cache
+   whether a back-end's output can have changed since the last run. */
+#define BINDX_CACHE_SECTIONS_COMMON (BINDX_CACHE_SECTION_MASK_HEADER | \
+                                     BINDX_CACHE_SECTION_MASK_SUBPROGRAMS)
+
+#define BINDX_CACHE_SECTIONS_C   (BINDX_CACHE_SECTIONS_COMMON)
+#define BINDX_CACHE_SECTIONS_CPP (BINDX_CACHE_SECTIONS_COMMON | \
+                                  BINDX_CACHE_SECTION_MASK_ENUMS | \
+                                  BINDX_CACHE_SECTION_MASK_CONSTS)
+#define BINDX_CACHE_SECTIONS_F77 (BINDX_CACHE_SECTIONS_COMMON | \
+                                  BINDX_CACHE_SECTION_MASK_ENUMS | \
+                                  BINDX_CACHE_SECTION_MASK_STRUCTS)
+#define BINDX_CACHE_SECTIONS_F90 (BINDX_CACHE_SECTIONS_COMMON | \
+                                  BINDX_CACHE_SECTION_MASK_ENUMS | \
+                                  BINDX_CACHE_SECTION_MASK_STRUCTS)
+#define BINDX_CACHE_SECTIONS_IDL (BINDX_CACHE_SECTIONS_COMMON)
+#define BINDX_CACHE_SECTIONS_JL  (BINDX_CACHE_SECTIONS_COMMON | \
+                                  BINDX_CACHE_SECTION_MASK_CONSTS)
+#define BINDX_CACHE_SECTIONS_PY  (BINDX_CACHE_SECTIONS_COMMON | \
+                                  BINDX_CACHE_SECTION_MASK_STRUCTS)
+#define BINDX_CACHE_SECTIONS_BENCH (BINDX_CACHE_SECTIONS_COMMON | \
+                                    BINDX_CACHE_SECTION_MASK_ENUMS)
+
 
 typedef struct {
      int def;
@@ -41,57 +74,130 @@ typedef struct {
      int idl;
      int jl;
      int py;
+     int bench;
+     int jobs;
+     int cache;
+     int stats;
+     int free_threaded;
+     int limited_api;
+     int async;
+     int deps;
      int help;
      int version;
 } options_data;
 
 
+typedef struct {
+     const char *name;
+     int n_out_files;
+     char **out_files;
+     int (*write)(bindx_buffer_data **, const bindx_data *, const char *);
+     int result;
+} write_job_data;
+
+
+typedef struct {
+     const bindx_data *bindx_int;
+     int n_jobs;
+     write_job_data *jobs;
+     int i_next;
+     pthread_mutex_t mutex;
+} write_pool_data;
+
+
 int bindx_write_x(const bindx_data *bindx_int, const char *name, int n_out_files,
-                  char **out_files, int (*write)(FILE **, const bindx_data *,
-                  const char *));
+                  char **out_files,
+                  int (*write)(bindx_buffer_data **, const bindx_data *, const char *));
+int bindx_write_jobs(const bindx_data *bindx_int, int n_jobs, write_job_data *jobs,
+                     int n_threads);
+int bindx_write_deps(const char *file, int n_in_files, char **in_files,
+                     int n_out_files, char **out_files);
 void usage();
 
 
+static void write_job_add(write_job_data *jobs, int *n_jobs,
+                          bindx_cache_data *cache, const bindx_data *bindx_int,
+                          const char *tag, int sections, const char *name,
+                          int n_out_files, char **out_files,
+                          int (*write)(bindx_buffer_data **, const bindx_data *, const char *))
+{
+     if (cache && ! bindx_cache_back_end(cache, bindx_int, tag, sections, name,
+                                         n_out_files, out_files))
+          return;
+
+     jobs[*n_jobs].name        = name;
+     jobs[*n_jobs].n_out_files = n_out_files;
+     jobs[*n_jobs].out_files   = out_files;
+     jobs[*n_jobs].write       = write;
+     jobs[*n_jobs].result      = 0;
+
+     (*n_jobs)++;
+}
+
+
 int main(int argc, char *argv[]) {
 
+     char *name_c;
      char *name_cpp;
      char *name_f77;
      char *name_f90;
      char *name_idl;
      char *name_jl;
      char *name_py;
+     char *name_bench;
+
+     char *cache_name;
+
+     char *deps_name;
 
      char *in_files_def[MAX_IN_FILES];
 
      char *out_files_def[MAX_OUT_FILES];
 
+     char *out_files_c[MAX_OUT_FILES];
      char *out_files_cpp[MAX_OUT_FILES];
      char *out_files_f77[MAX_OUT_FILES];
      char *out_files_f90[MAX_OUT_FILES];
      char *out_files_idl[MAX_OUT_FILES];
      char *out_files_jl[MAX_OUT_FILES];
      char *out_files_py[MAX_OUT_FILES];
+     char *out_files_bench[MAX_OUT_FILES];
+
+     char *out_files_deps[MAX_DEPS_FILES];
 
      int i;
      int n;
 
      int n_in_files_def;
 
+     int n_out_files_c;
      int n_out_files_cpp;
      int n_out_files_f77;
      int n_out_files_f90;
      int n_out_files_idl;
      int n_out_files_jl;
      int n_out_files_py;
+     int n_out_files_bench;
+
+     int n_out_files_deps;
+
+     int n_write_jobs;
 
-     FILE *fp;
+     uint64_t hash;
+
+     bindx_buffer_data buffer;
+
+     bindx_cache_data cache;
 
      bindx_data bindx_int;
+     bindx_data *fragment;
 
      locus_data locus;
 
      options_data options;
 
+     write_job_data write_jobs[MAX_WRITE_JOBS];
+
 
      /*-------------------------------------------------------------------------
       *
@@ -104,6 +210,14 @@ int main(int argc, char *argv[]) {
      options.idl     = 0;
      options.jl      = 0;
      options.py      = 0;
+     options.bench   = 0;
+     options.jobs    = 1;
+     options.cache   = 0;
+     options.stats   = 0;
+     options.free_threaded = 0;
+     options.limited_api   = 0;
+     options.async         = 0;
+     options.deps    = 0;
      options.help    = 0;
      options.version = 0;
 
@@ -121,6 +235,14 @@ int main(int argc, char *argv[]) {
                     options.def = 1;
                     out_files_def [0] = argv[++i];
                }
+               else if (strcmp(argv[i], "-c") == 0) {
+                    check_arg_count(i, argc, 3, argv[i]);
+                    options.c = 1;
+                    name_c = argv[++i];
+                    n_out_files_c = 2;
+                    out_files_c[0] = argv[++i];
+                    out_files_c[1] = argv[++i];
+               }
                else if (strcmp(argv[i], "-cpp") == 0) {
                     check_arg_count(i, argc, 3, argv[i]);
                     options.cpp = 1;
@@ -169,6 +291,41 @@ int main(int argc, char *argv[]) {
                     n_out_files_py = 1;
                     out_files_py[0] = argv[++i];
                }
+               else if (strcmp(argv[i], "-bench") == 0) {
+                    check_arg_count(i, argc, 3, argv[i]);
+                    options.bench = 1;
+                    name_bench = argv[++i];
+                    n_out_files_bench = 2;
+                    out_files_bench[0] = argv[++i];
+                    out_files_bench[1] = argv[++i];
+               }
+               else if (strcmp(argv[i], "-jobs") == 0) {
+                    check_arg_count(i, argc, 1, argv[i]);
+                    options.jobs = strtoi_errmsg_exit(argv[i + 1], argv[i]);
+                    ++i;
+                    if (options.jobs < 1) {
+                         printf("Invalid value for -jobs: %d, must be >= 1\n", options.jobs);
+                         exit(1);
+                    }
+               }
+               else if (strcmp(argv[i], "-cache") == 0) {
+                    check_arg_count(i, argc, 1, argv[i]);
+                    options.cache = 1;
+                    cache_name = argv[++i];
+               }
+               else if (strcmp(argv[i], "-stats") == 0)
+                    options.stats = 1;
+               else if (strcmp(argv[i], "-free_threaded") == 0)
+                    options.free_threaded = 1;
+               else if (strcmp(argv[i], "-limited_api") == 0)
+                    options.limited_api = 1;
+               else if (strcmp(argv[i], "-async") == 0)
+                    options.async = 1;
+               else if (strcmp(argv[i], "-MF") == 0) {
+                    check_arg_count(i, argc, 1, argv[i]);
+                    options.deps = 1;
+                    deps_name = argv[++i];
+               }
                else if (strcmp(argv[i], "-help") == 0) {
                     usage();
                     exit(0);
@@ -203,97 +360,188 @@ int main(int argc, char *argv[]) {
      /*-------------------------------------------------------------------------
       *
       *-----------------------------------------------------------------------*/
+     if (options.cache)
+          bindx_cache_open(&cache, cache_name);
+
      bindx_init(&bindx_int);
 
      for (i = 0; i < n_in_files_def; ++i) {
-          if (strcmp(in_files_def[i], "-") == 0) {
-               yy_in = stdin;
+          fragment = NULL;
 
-               locus.file = "stdin";
-          }
-          else {
-               if ((yy_in = fopen(in_files_def[i], "r")) == NULL) {
-                    fprintf(stderr, "ERROR: Problem opening file for reading: %s ... %s\n",
-                            in_files_def[i], strerror(errno));
+          /* With a cache each input file is parsed (or loaded) on its own and
+             then merged so that its IR can be cached separately. */
+          if (options.cache && strcmp(in_files_def[i], "-") != 0) {
+               if (bindx_cache_hash_file(in_files_def[i], &hash))
                     exit(1);
-               }
 
                locus.file = in_files_def[i];
+               locus.line      = 0;
+               locus.character = 0;
+
+               fragment = bindx_cache_load_file(&cache, in_files_def[i], hash, &locus);
+          }
+
+          if (! fragment) {
+               if (strcmp(in_files_def[i], "-") == 0) {
+                    yy_in = stdin;
+
+                    locus.file = "stdin";
+               }
+               else {
+                    if ((yy_in = fopen(in_files_def[i], "r")) == NULL) {
+                         fprintf(stderr, "ERROR: Problem opening file for reading: %s ... %s\n",
+                                 in_files_def[i], strerror(errno));
+                         exit(1);
+                    }
+
+                    locus.file = in_files_def[i];
+               }
+
+               locus.line = 1;
+
+               if (! options.cache)
+                    bindx_parse(&bindx_int, &locus);
+               else {
+                    fragment = malloc(sizeof(bindx_data));
+                    bindx_init(fragment);
+                    bindx_parse(fragment, &locus);
+               }
+
+               if (yy_in != stdin)
+                    fclose(yy_in);
           }
 
-          locus.line = 1;
+          if (fragment) {
+               if (strcmp(in_files_def[i], "-") != 0)
+                    bindx_cache_add_file(&cache, in_files_def[i], hash, fragment);
+
+               locus.line      = 0;
+               locus.character = 0;
 
-          bindx_parse(&bindx_int, &locus);
+               bindx_merge(&bindx_int, fragment, &locus);
 
-          if (yy_in != stdin)
-               fclose(yy_in);
+               bindx_free(fragment);
+               free(fragment);
+          }
      }
 
 
      bindx_finialize(&bindx_int);
 
+     bindx_int.stats         = options.stats;
+     bindx_int.free_threaded = options.free_threaded;
+     bindx_int.limited_api   = options.limited_api;
+     bindx_int.async         = options.async;
+
 
      if (options.def) {
-          if ((fp = fopen(out_files_def[0], "w")) == NULL) {
-               fprintf(stderr, "ERROR: Problem opening file for writing: %s ... %s\n",
-                       out_files_def[i], strerror(errno));
-               exit(1);
-          }
+          bindx_buffer_init(&buffer);
 
-          bindx_write(fp, &bindx_int);
+          bindx_write(&buffer, &bindx_int);
 
-          fclose(fp);
+          if (bindx_buffer_flush(&buffer, out_files_def[0]))
+               exit(1);
+
+          bindx_buffer_free(&buffer);
      }
 
 
      /*-------------------------------------------------------------------------
       *
       *-----------------------------------------------------------------------*/
-     if (options.cpp) {
-          if (bindx_write_x(&bindx_int, name_cpp, n_out_files_cpp, out_files_cpp,
-                            bindx_write_cpp)) {
-              fprintf(stderr, "ERROR: bindx_write_x()\n");
-              return -1;
-          }
+     n_write_jobs = 0;
+
+     if (options.c)
+          write_job_add(write_jobs, &n_write_jobs, options.cache ? &cache : NULL,
+                        &bindx_int, "c", BINDX_CACHE_SECTIONS_C, name_c,
+                        n_out_files_c, out_files_c, bindx_write_batch);
+
+     if (options.cpp)
+          write_job_add(write_jobs, &n_write_jobs, options.cache ? &cache : NULL,
+                        &bindx_int, "cpp", BINDX_CACHE_SECTIONS_CPP, name_cpp,
+                        n_out_files_cpp, out_files_cpp, bindx_write_cpp);
+
+     if (options.f77)
+          write_job_add(write_jobs, &n_write_jobs, options.cache ? &cache : NULL,
+                        &bindx_int, "f77", BINDX_CACHE_SECTIONS_F77, name_f77,
+                        n_out_files_f77, out_files_f77, bindx_write_f77);
+
+     if (options.f90)
+          write_job_add(write_jobs, &n_write_jobs, options.cache ? &cache : NULL,
+                        &bindx_int, "f90", BINDX_CACHE_SECTIONS_F90, name_f90,
+                        n_out_files_f90, out_files_f90, bindx_write_f90);
+
+     if (options.idl)
+          write_job_add(write_jobs, &n_write_jobs, options.cache ? &cache : NULL,
+                        &bindx_int, "idl", BINDX_CACHE_SECTIONS_IDL, name_idl,
+                        n_out_files_idl, out_files_idl, bindx_write_idl);
+
+     if (options.jl)
+          write_job_add(write_jobs, &n_write_jobs, options.cache ? &cache : NULL,
+                        &bindx_int, "jl", BINDX_CACHE_SECTIONS_JL, name_jl,
+                        n_out_files_jl, out_files_jl, bindx_write_jl);
+
+     if (options.py)
+          write_job_add(write_jobs, &n_write_jobs, options.cache ? &cache : NULL,
+                        &bindx_int, "py", BINDX_CACHE_SECTIONS_PY, name_py,
+                        n_out_files_py, out_files_py, bindx_write_py);
+
+     if (options.bench)
+          write_job_add(write_jobs, &n_write_jobs, options.cache ? &cache : NULL,
+                        &bindx_int, "bench", BINDX_CACHE_SECTIONS_BENCH, name_bench,
+                        n_out_files_bench, out_files_bench, bindx_write_bench);
+
+     if (bindx_write_jobs(&bindx_int, n_write_jobs, write_jobs, options.jobs)) {
+          fprintf(stderr, "ERROR: bindx_write_jobs()\n");
+          return -1;
      }
 
-     if (options.f77) {
-          if (bindx_write_x(&bindx_int, name_f77, n_out_files_f77, out_files_f77,
-                            bindx_write_f77)) {
-              fprintf(stderr, "ERROR: bindx_write_x()\n");
-              return -1;
-          }
-     }
-
-     if (options.f90) {
-          if (bindx_write_x(&bindx_int, name_f90, n_out_files_f90, out_files_f90,
-                             bindx_write_f90)) {
-              fprintf(stderr, "ERROR: bindx_write_x()\n");
-              return -1;
-          }
-     }
-
-     if (options.idl) {
-          if (bindx_write_x(&bindx_int, name_idl, n_out_files_idl, out_files_idl,
-                            bindx_write_idl)) {
-              fprintf(stderr, "ERROR: bindx_write_x()\n");
-              return -1;
+     if (options.cache) {
+          if (bindx_cache_close(&cache)) {
+               fprintf(stderr, "ERROR: bindx_cache_close()\n");
+               return -1;
           }
      }
 
-     if (options.jl) {
-          if (bindx_write_x(&bindx_int, name_jl, n_out_files_jl, out_files_jl,
-                            bindx_write_jl)) {
-              fprintf(stderr, "ERROR: bindx_write_x()\n");
-              return -1;
-          }
-     }
 
-     if (options.py) {
-          if (bindx_write_x(&bindx_int, name_py, n_out_files_py, out_files_py,
-                            bindx_write_py)) {
-              fprintf(stderr, "ERROR: bindx_write_x()\n");
-              return -1;
+     /*-------------------------------------------------------------------------
+      *
+      *-----------------------------------------------------------------------*/
+     if (options.deps) {
+          n_out_files_deps = 0;
+
+          if (options.def)
+               out_files_deps[n_out_files_deps++] = out_files_def[0];
+
+          if (options.c)
+               for (i = 0; i < n_out_files_c; ++i)
+                    out_files_deps[n_out_files_deps++] = out_files_c[i];
+          if (options.cpp)
+               for (i = 0; i < n_out_files_cpp; ++i)
+                    out_files_deps[n_out_files_deps++] = out_files_cpp[i];
+          if (options.f77)
+               for (i = 0; i < n_out_files_f77; ++i)
+                    out_files_deps[n_out_files_deps++] = out_files_f77[i];
+          if (options.f90)
+               for (i = 0; i < n_out_files_f90; ++i)
+                    out_files_deps[n_out_files_deps++] = out_files_f90[i];
+          if (options.idl)
+               for (i = 0; i < n_out_files_idl; ++i)
+                    out_files_deps[n_out_files_deps++] = out_files_idl[i];
+          if (options.jl)
+               for (i = 0; i < n_out_files_jl; ++i)
+                    out_files_deps[n_out_files_deps++] = out_files_jl[i];
+          if (options.py)
+               for (i = 0; i < n_out_files_py; ++i)
+                    out_files_deps[n_out_files_deps++] = out_files_py[i];
+          if (options.bench)
+               for (i = 0; i < n_out_files_bench; ++i)
+                    out_files_deps[n_out_files_deps++] = out_files_bench[i];
+
+          if (bindx_write_deps(deps_name, n_in_files_def, in_files_def,
+                               n_out_files_deps, out_files_deps)) {
+               fprintf(stderr, "ERROR: bindx_write_deps()\n");
+               return -1;
           }
      }
 
@@ -310,32 +558,176 @@ int main(int argc, char *argv[]) {
 
 
 int bindx_write_x(const bindx_data *bindx_int, const char *name, int n_out_files,
-                  char **out_files, int (*write)(FILE **, const bindx_data *,
-                  const char *))
+                  char **out_files,
+                  int (*write)(bindx_buffer_data **, const bindx_data *, const char *))
 {
      int i;
+     int r = 0;
 
-     FILE *fp[MAX_IN_FILES];
+     bindx_buffer_data buffers[MAX_IN_FILES];
+
+     bindx_buffer_data *fp[MAX_IN_FILES];
 
      for (i = 0; i < n_out_files; ++i) {
-          if ((fp[i] = fopen(out_files[i], "w")) == NULL) {
-               fprintf(stderr, "ERROR: Problem opening file for writing: %s\n",
-                       out_files[i]);
-               fprintf(stderr, "  ... %s\n", strerror(errno));
-               return -1;
-          }
+          bindx_buffer_init(&buffers[i]);
+          fp[i] = &buffers[i];
      }
 
      write(fp, bindx_int, name);
 
-     for (i = 0; i < n_out_files; ++i)
-          fclose(fp[i]);
+     for (i = 0; i < n_out_files; ++i) {
+          if (bindx_buffer_flush(fp[i], out_files[i]))
+               r = -1;
+          bindx_buffer_free(fp[i]);
+     }
+
+     return r;
+}
+
+
+
+/*******************************************************************************
+ * Each back-end only reads the parsed interface and writes its own files so
+ * they are independent and may be run concurrently, one job per language.
+ ******************************************************************************/
+static void *write_pool_worker(void *arg)
+{
+     int i;
+
+     write_job_data *job;
+
+     write_pool_data *pool = arg;
+
+     while (1) {
+          pthread_mutex_lock(&pool->mutex);
+          i = pool->i_next++;
+          pthread_mutex_unlock(&pool->mutex);
+
+          if (i >= pool->n_jobs)
+               break;
+
+          job = &pool->jobs[i];
+
+          job->result = bindx_write_x(pool->bindx_int, job->name, job->n_out_files,
+                                      job->out_files, job->write);
+     }
+
+     return NULL;
+}
+
+
+
+int bindx_write_jobs(const bindx_data *bindx_int, int n_jobs, write_job_data *jobs,
+                     int n_threads)
+{
+     int i;
+
+     pthread_t threads[MAX_WRITE_JOBS];
+
+     write_pool_data pool;
+
+     if (n_threads > n_jobs)
+          n_threads = n_jobs;
+
+     pool.bindx_int = bindx_int;
+     pool.n_jobs    = n_jobs;
+     pool.jobs      = jobs;
+     pool.i_next    = 0;
+
+     pthread_mutex_init(&pool.mutex, NULL);
+
+     if (n_threads <= 1)
+          write_pool_worker(&pool);
+     else {
+          for (i = 0; i < n_threads; ++i) {
+               if (pthread_create(&threads[i], NULL, write_pool_worker, &pool)) {
+                    fprintf(stderr, "ERROR: pthread_create()\n");
+                    exit(1);
+               }
+          }
+
+          for (i = 0; i < n_threads; ++i)
+               pthread_join(threads[i], NULL);
+     }
+
+     pthread_mutex_destroy(&pool.mutex);
+
+     for (i = 0; i < n_jobs; ++i) {
+          if (jobs[i].result) {
+               fprintf(stderr, "ERROR: bindx_write_x()\n");
+               return -1;
+          }
+     }
 
      return 0;
 }
 
 
 
+/*******************************************************************************
+ * Write a Make/Ninja style dependency file in which every output depends on
+ * every interface definition file read.  Each input is also given an empty
+ * rule so that removing one does not break the build.
+ ******************************************************************************/
+static void write_deps_name(bindx_buffer_data *fp, const char *name)
+{
+     for ( ; *name; ++name) {
+          if (*name == ' ' || *name == '#')
+               bindx_buffer_append(fp, "\\", 1);
+          else
+          if (*name == '$')
+               bindx_buffer_append(fp, "$", 1);
+
+          bindx_buffer_append(fp, name, 1);
+     }
+}
+
+
+
+int bindx_write_deps(const char *file, int n_in_files, char **in_files,
+                     int n_out_files, char **out_files)
+{
+     int i;
+     int r;
+
+     bindx_buffer_data buffer;
+
+     bindx_buffer_data *fp = &buffer;
+
+     bindx_buffer_init(fp);
+
+     for (i = 0; i < n_out_files; ++i) {
+          if (i > 0)
+               bxprintf(fp, " \\\n ");
+          write_deps_name(fp, out_files[i]);
+     }
+     bxprintf(fp, ":");
+
+     for (i = 0; i < n_in_files; ++i) {
+          if (strcmp(in_files[i], "-") == 0)
+               continue;
+          bxprintf(fp, " \\\n ");
+          write_deps_name(fp, in_files[i]);
+     }
+     bxprintf(fp, "\n");
+
+     for (i = 0; i < n_in_files; ++i) {
+          if (strcmp(in_files[i], "-") == 0)
+               continue;
+          bxprintf(fp, "\n");
+          write_deps_name(fp, in_files[i]);
+          bxprintf(fp, ":\n");
+     }
+
+     r = bindx_buffer_flush(fp, file);
+
+     bindx_buffer_free(fp);
+
+     return r;
+}
+
+
+
 void usage()
 {
 
@@ -0,0 +1,253 @@
+/*******************************************************************************
+**
+**    Copyright (C) 2011-2018 Greg McGarragh <greg.mcgarragh@colostate.edu>
+**
+**    This source code is licensed under the GNU General Public License (GPL),
+**    Version 3.  See the file COPYING for more details.
+**
+*******************************************************************************/
+
+#include <gutil.h>
+
+#include "bindx_batch.h"
+#include "bindx_c.h"
+#include "bindx_parse.h"
+#include "bindx_parse_int.h"
+#include "bindx_util.h"
+
+
+/*******************************************************************************
+ * A general subprogram gets a batched version when it has at least one in
+ * scalar that can vary per sample.  Arguments the plan option would bind
+ * (arrays, enums, masks and the scalars that shape arrays) are shared by all
+ * samples, out scalars and the return value become arrays of samples and
+ * subprograms with out arrays or arguments that need more than a pointer to
+ * pass are left out.
+ ******************************************************************************/
+static int argument_is_per_sample(const subprogram_data *subprogram,
+                                  const argument_data *argument)
+{
+     return argument->usage == LEX_SUBPROGRAM_ARGUMENT_USAGE_IN &&
+            ! bindx_plan_argument_is_bound(subprogram, argument);
+}
+
+
+
+static int subprogram_is_supported(const subprogram_data *subprogram)
+{
+     int n_per_sample = 0;
+
+     argument_data *argument;
+
+     if (subprogram->type.rank > 0 ||
+         subprogram->type.type == LEX_BINDX_TYPE_STRUCTURE)
+          return 0;
+
+     if (subprogram->options.flags & (SUBPROGRAM_ARGUMENT_OPTION_MASK_BUFFER   |
+                                      SUBPROGRAM_ARGUMENT_OPTION_MASK_SNAPSHOT |
+                                      SUBPROGRAM_ARGUMENT_OPTION_MASK_RESTORE))
+          return 0;
+
+     list_for_each(subprogram->args, argument) {
+          if (argument->type.type == LEX_BINDX_TYPE_STRUCTURE)
+               return 0;
+          if (argument->usage == LEX_SUBPROGRAM_ARGUMENT_USAGE_IN_OUT)
+               return 0;
+          if (argument->usage == LEX_SUBPROGRAM_ARGUMENT_USAGE_OUT &&
+              argument->type.rank > 0)
+               return 0;
+          if (argument->options.flags & (SUBPROGRAM_ARGUMENT_OPTION_MASK_ENUM_ARRAY |
+                                         SUBPROGRAM_ARGUMENT_OPTION_MASK_LIST_SIZE  |
+                                         SUBPROGRAM_ARGUMENT_OPTION_MASK_STRIDED))
+               return 0;
+          if (argument_is_per_sample(subprogram, argument))
+               n_per_sample++;
+     }
+
+     return n_per_sample > 0;
+}
+
+
+
+/*******************************************************************************
+ *
+ ******************************************************************************/
+static int write_c_prototype(bindx_buffer_data *fp, const bindx_data *d,
+                             const subprogram_data *subprogram)
+{
+     argument_data *argument;
+
+     bxprintf(fp, "int %s_%s_batch(%s_data **d, size_t batch_n_d, size_t batch_n",
+              d->prefix, subprogram->name, d->prefix);
+
+     list_for_each(subprogram->args, argument) {
+          bxprintf(fp, ", ");
+          if (argument_is_per_sample(subprogram, argument)) {
+               bxprintf(fp, "const ");
+               bindx_write_c_type(fp, d, &argument->type, NULL);
+               bxprintf(fp, " *");
+          }
+          else
+          if (argument->usage == LEX_SUBPROGRAM_ARGUMENT_USAGE_OUT) {
+               bindx_write_c_type(fp, d, &argument->type, NULL);
+               bxprintf(fp, " *");
+          }
+          else
+               bindx_write_c_argument_declaration(fp, d, argument);
+          bxprintf(fp, "%s", argument->name);
+     }
+
+     if (subprogram->has_return_value) {
+          bxprintf(fp, ", ");
+          bindx_write_c_type(fp, d, &subprogram->type, NULL);
+          bxprintf(fp, " *batch_r");
+     }
+
+     bxprintf(fp, ")");
+
+     return 0;
+}
+
+
+
+static int write_c_prototypes(bindx_buffer_data *fp, const bindx_data *d,
+                              const subprogram_data *subs)
+{
+     subprogram_data *subprogram;
+
+     list_for_each(subs, subprogram) {
+          if (! subprogram_is_supported(subprogram))
+               continue;
+
+          write_c_prototype(fp, d, subprogram);
+          bxprintf(fp, ";\n");
+     }
+
+     return 0;
+}
+
+
+
+/*******************************************************************************
+ * Samples are run in parallel under OpenMP when each has its own instance, or
+ * with a shared instance when the subprogram is threadsafe or pure.  Otherwise
+ * samples on a shared instance are run in order.  Errors are or'ed over the
+ * samples so that the whole batch runs, leaving the outputs of the samples
+ * that failed undefined.
+ ******************************************************************************/
+static int write_c_subprograms(bindx_buffer_data *fp, const bindx_data *d,
+                               const subprogram_data *subs)
+{
+     argument_data *argument;
+     subprogram_data *subprogram;
+
+     list_for_each(subs, subprogram) {
+          if (! subprogram_is_supported(subprogram))
+               continue;
+
+          write_c_prototype(fp, d, subprogram);
+          bxprintf(fp, "\n");
+          bxprintf(fp, "{\n");
+          bxprintf(fp, "     long batch_i;\n");
+          bxprintf(fp, "\n");
+          bxprintf(fp, "     int batch_error = 0;\n");
+          if (! subprogram->has_return_value) {
+               bxprintf(fp, "     ");
+               bindx_write_c_declaration(fp, d, &subprogram->type, NULL);
+               bxprintf(fp, "batch_r;\n");
+          }
+          bxprintf(fp, "\n");
+
+          bxprintf(fp, "     if (batch_n_d != 1 && batch_n_d != batch_n) {\n");
+          bxprintf(fp, "          fprintf(stderr, \"ERROR: number of instances must be 1 or n\\n\");\n");
+          bxprintf(fp, "          return %s;\n", bindx_c_error_conditional(d, LEX_BINDX_TYPE_INT));
+          bxprintf(fp, "     }\n");
+          bxprintf(fp, "\n");
+
+          bxprintf(fp, "#ifdef _OPENMP\n");
+          if (subprogram->options.flags & (SUBPROGRAM_ARGUMENT_OPTION_MASK_THREADSAFE |
+                                           SUBPROGRAM_ARGUMENT_OPTION_MASK_PURE))
+               bxprintf(fp, "#pragma omp parallel for %sreduction(|:batch_error)\n",
+                        subprogram->has_return_value ? "" : "private(batch_r) ");
+          else
+               bxprintf(fp, "#pragma omp parallel for if (batch_n_d > 1) %sreduction(|:batch_error)\n",
+                        subprogram->has_return_value ? "" : "private(batch_r) ");
+          bxprintf(fp, "#endif\n");
+          bxprintf(fp, "     for (batch_i = 0; batch_i < (long) batch_n; ++batch_i) {\n");
+
+          if (subprogram->has_return_value)
+               bxprintf(fp, "          batch_r[batch_i] = ");
+          else
+               bxprintf(fp, "          batch_r = ");
+          bxprintf(fp, "%s_%s(d[batch_n_d > 1 ? batch_i : 0]", d->prefix, subprogram->name);
+          list_for_each(subprogram->args, argument) {
+               bxprintf(fp, ", ");
+               if (argument_is_per_sample(subprogram, argument))
+                    bxprintf(fp, "%s[batch_i]", argument->name);
+               else
+               if (argument->usage == LEX_SUBPROGRAM_ARGUMENT_USAGE_OUT)
+                    bxprintf(fp, "&%s[batch_i]", argument->name);
+               else
+                    bxprintf(fp, "%s", argument->name);
+          }
+          bxprintf(fp, ");\n");
+
+          bxprintf(fp, "          if (batch_r%s == %s)\n", subprogram->has_return_value ? "[batch_i]" : "",
+                   bindx_c_error_conditional(d, subprogram->type.type));
+          bxprintf(fp, "               batch_error = 1;\n");
+          bxprintf(fp, "     }\n");
+          bxprintf(fp, "\n");
+
+          bxprintf(fp, "     if (batch_error) {\n");
+          bxprintf(fp, "          fprintf(stderr, \"ERROR: %s_%s()\\n\");\n", d->prefix, subprogram->name);
+          bxprintf(fp, "          return %s;\n", bindx_c_error_conditional(d, LEX_BINDX_TYPE_INT));
+          bxprintf(fp, "     }\n");
+          bxprintf(fp, "\n");
+          bxprintf(fp, "     return 0;\n");
+          bxprintf(fp, "}\n");
+          bxprintf(fp, "\n");
+          bxprintf(fp, "\n");
+     }
+
+     return 0;
+}
+
+
+
+/*******************************************************************************
+ *
+ ******************************************************************************/
+int bindx_write_batch(bindx_buffer_data **fp, const bindx_data *d, const char *name)
+{
+     bindx_write_c_header_top(fp[0]);
+     bxprintf(fp[0], "\n");
+     bxprintf(fp[0], "#ifndef %s_INT_C_H\n", d->PREFIX);
+     bxprintf(fp[0], "#define %s_INT_C_H\n", d->PREFIX);
+     bxprintf(fp[0], "\n");
+     bindx_write_c_util_header(fp[0], d);
+
+     write_c_prototypes(fp[0], d, &d->subs_general);
+     bxprintf(fp[0], "\n");
+     bxprintf(fp[0], "\n");
+
+     bindx_write_c_util_trailer(fp[0], d);
+     bxprintf(fp[0], "\n");
+     bxprintf(fp[0], "#endif /* %s_INT_C_H */\n", d->PREFIX);
+
+
+     bindx_write_c_header_top(fp[1]);
+     bxprintf(fp[1], "\n");
+     bxprintf(fp[1], "#include <gutil.h>\n");
+     bxprintf(fp[1], "\n");
+     bxprintf(fp[1], "#include <%s_interface.h>\n", d->prefix);
+     bxprintf(fp[1], "\n");
+     if (d->include) {
+          bxprintf(fp[1], "#include \"%s_int_c.h\"\n", d->include);
+          bxprintf(fp[1], "\n");
+     }
+     bxprintf(fp[1], "\n");
+
+     write_c_subprograms(fp[1], d, &d->subs_general);
+
+     return 0;
+}
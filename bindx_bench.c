@@ -0,0 +1,779 @@
+/*******************************************************************************
+**
+**    Copyright (C) 2011-2018 Greg McGarragh <greg.mcgarragh@colostate.edu>
+**
+**    This source code is licensed under the GNU General Public License (GPL),
+**    Version 3.  See the file COPYING for more details.
+**
+*******************************************************************************/
+
+#include <gutil.h>
+
+#include "bindx_bench.h"
+#include "bindx_c.h"
+#include "bindx_parse.h"
+#include "bindx_parse_int.h"
+#include "bindx_util.h"
+
+
+/*******************************************************************************
+ * Subprograms whose arguments cannot be synthesized without knowing more than
+ * the interface (structures, enum lists, external enums and in/out arguments)
+ * are listed in the output but not timed.
+ ******************************************************************************/
+static int subprogram_is_supported(const subprogram_data *subprogram)
+{
+     argument_data *argument;
+
+     if (subprogram->type.type == LEX_BINDX_TYPE_STRUCTURE)
+          return 0;
+
+     list_for_each(subprogram->args, argument) {
+          if (argument->type.type == LEX_BINDX_TYPE_STRUCTURE)
+               return 0;
+          if (argument->type.type == LEX_BINDX_TYPE_ENUM && argument->type.rank > 0)
+               return 0;
+          if (argument->options.flags & (SUBPROGRAM_ARGUMENT_OPTION_MASK_ENUM_EXTERNAL |
+                                         SUBPROGRAM_ARGUMENT_OPTION_MASK_ENUM_ARRAY    |
+                                         SUBPROGRAM_ARGUMENT_OPTION_MASK_LIST_SIZE))
+               return 0;
+          if (argument->usage == LEX_SUBPROGRAM_ARGUMENT_USAGE_IN_OUT)
+               return 0;
+     }
+
+     return 1;
+}
+
+
+
+static int subprogram_has_array_args(const subprogram_data *subprogram)
+{
+     argument_data *argument;
+
+     list_for_each(subprogram->args, argument) {
+          if (argument->type.rank > 0)
+               return 1;
+     }
+
+     return 0;
+}
+
+
+
+static const char *first_enum_member(const bindx_data *d, const type_data *type)
+{
+     enum_member_data *enum_member;
+     enumeration_data *enumeration;
+
+     list_for_each(&d->enums, enumeration) {
+          if (strcmp(enumeration->name, type->name) == 0) {
+               list_for_each(enumeration->members, enum_member)
+                    return enum_member->name;
+          }
+     }
+
+     INTERNAL_ERROR("Enumeration not found: %s", type->name);
+
+     return NULL;
+}
+
+
+
+/*******************************************************************************
+ *
+ ******************************************************************************/
+static int write_c_default_value(bindx_buffer_data *fp, const bindx_data *d,
+                                 const argument_data *argument)
+{
+     if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_ENUM_MASK)
+          bxprintf(fp, "0");
+     else
+     if (argument->type.type == LEX_BINDX_TYPE_ENUM)
+          bxprintf(fp, "%s_%s", d->PREFIX, first_enum_member(d, &argument->type));
+     else
+     if (argument->type.type == LEX_BINDX_TYPE_FLOAT  ||
+         argument->type.type == LEX_BINDX_TYPE_DOUBLE ||
+         argument->type.type == LEX_BINDX_TYPE_COMPLEX)
+          bxprintf(fp, "1.");
+     else
+          bxprintf(fp, "%s_BENCH_N", d->PREFIX);
+
+     return 0;
+}
+
+
+
+static int write_c_argument_macro_name(bindx_buffer_data *fp, const bindx_data *d,
+                                       const subprogram_data *subprogram,
+                                       const argument_data *argument)
+{
+     char temp1[NM];
+     char temp2[NM];
+
+     strtoupper(subprogram->name, temp1);
+     strtoupper(argument->name,   temp2);
+
+     bxprintf(fp, "%s_BENCH_%s_%s", d->PREFIX, temp1, temp2);
+
+     return 0;
+}
+
+
+
+static int write_c_argument_macros(bindx_buffer_data *fp, const bindx_data *d,
+                                   const subprogram_data *subs)
+{
+     argument_data *argument;
+     subprogram_data *subprogram;
+
+     list_for_each(subs, subprogram) {
+          if (! subprogram_is_supported(subprogram))
+               continue;
+
+          list_for_each(subprogram->args, argument) {
+               if (argument->usage != LEX_SUBPROGRAM_ARGUMENT_USAGE_IN ||
+                   argument->type.rank > 0)
+                    continue;
+
+               bxprintf(fp, "#ifndef ");
+               write_c_argument_macro_name(fp, d, subprogram, argument);
+               bxprintf(fp, "\n");
+               bxprintf(fp, "#define ");
+               write_c_argument_macro_name(fp, d, subprogram, argument);
+               bxprintf(fp, " ");
+               write_c_default_value(fp, d, argument);
+               bxprintf(fp, "\n");
+               bxprintf(fp, "#endif\n");
+          }
+     }
+
+     return 0;
+}
+
+
+
+static int write_c_n_elems(bindx_buffer_data *fp, const argument_data *argument)
+{
+     int i;
+
+     for (i = 0; i < argument->type.rank; ++i) {
+          bxprintf(fp, "(size_t) (%s)", argument->type.dimens[i]);
+          if (i + 1 < argument->type.rank)
+               bxprintf(fp, " * ");
+     }
+
+     return 0;
+}
+
+
+
+static int write_c_utilities(bindx_buffer_data *fp, const bindx_data *d)
+{
+     bxprintf(fp, "static size_t n_allocs = 0;\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+     bxprintf(fp, "/* Count heap allocations made by the library by interposing on the glibc\n");
+     bxprintf(fp, "   allocator.  Define %s_BENCH_NO_ALLOC_COUNT to turn this off. */\n", d->PREFIX);
+     bxprintf(fp, "#if defined(__GLIBC__) && ! defined(%s_BENCH_NO_ALLOC_COUNT)\n", d->PREFIX);
+     bxprintf(fp, "#define %s_BENCH_ALLOC_COUNT 1\n", d->PREFIX);
+     bxprintf(fp, "\n");
+     bxprintf(fp, "void *__libc_malloc(size_t size);\n");
+     bxprintf(fp, "void *__libc_calloc(size_t n, size_t size);\n");
+     bxprintf(fp, "void *__libc_realloc(void *p, size_t size);\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "void *malloc(size_t size)\n");
+     bxprintf(fp, "{\n");
+     bxprintf(fp, "     n_allocs++;\n");
+     bxprintf(fp, "     return __libc_malloc(size);\n");
+     bxprintf(fp, "}\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "void *calloc(size_t n, size_t size)\n");
+     bxprintf(fp, "{\n");
+     bxprintf(fp, "     n_allocs++;\n");
+     bxprintf(fp, "     return __libc_calloc(n, size);\n");
+     bxprintf(fp, "}\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "void *realloc(void *p, size_t size)\n");
+     bxprintf(fp, "{\n");
+     bxprintf(fp, "     n_allocs++;\n");
+     bxprintf(fp, "     return __libc_realloc(p, size);\n");
+     bxprintf(fp, "}\n");
+     bxprintf(fp, "#else\n");
+     bxprintf(fp, "#define %s_BENCH_ALLOC_COUNT 0\n", d->PREFIX);
+     bxprintf(fp, "#endif\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+     bxprintf(fp, "static uint64_t bench_now(void)\n");
+     bxprintf(fp, "{\n");
+     bxprintf(fp, "     struct timespec t;\n");
+     bxprintf(fp, "     clock_gettime(CLOCK_MONOTONIC, &t);\n");
+     bxprintf(fp, "     return (uint64_t) t.tv_sec * 1000000000 + t.tv_nsec;\n");
+     bxprintf(fp, "}\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+     bxprintf(fp, "static void *bench_alloc(size_t size, size_t alignment)\n");
+     bxprintf(fp, "{\n");
+     bxprintf(fp, "     void *p;\n");
+     bxprintf(fp, "     if (posix_memalign(&p, alignment, size > 0 ? size : 1) != 0) {\n");
+     bxprintf(fp, "          fprintf(stderr, \"ERROR: posix_memalign()\\n\");\n");
+     bxprintf(fp, "          exit(1);\n");
+     bxprintf(fp, "     }\n");
+     bxprintf(fp, "     return p;\n");
+     bxprintf(fp, "}\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+     bxprintf(fp, "static void bench_report(const char *name, long n_calls, uint64_t ns, size_t n_allocs, long n_errors, size_t n_bytes)\n");
+     bxprintf(fp, "{\n");
+     bxprintf(fp, "     double ns_call = (double) ns / n_calls;\n");
+     bxprintf(fp, "     printf(\"%%-32s %%12ld %%12.1f %%12.1f \", name, n_calls, ns_call, n_bytes / ns_call * 1.e3);\n");
+     bxprintf(fp, "     if (%s_BENCH_ALLOC_COUNT)\n", d->PREFIX);
+     bxprintf(fp, "          printf(\"%%12.2f\", (double) n_allocs / n_calls);\n");
+     bxprintf(fp, "     else\n");
+     bxprintf(fp, "          printf(\"%%12s\", \"-\");\n");
+     bxprintf(fp, "     printf(\" %%12ld\\n\", n_errors);\n");
+     bxprintf(fp, "}\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+     return 0;
+}
+
+
+
+/*******************************************************************************
+ * Each subprogram gets a function that synthesizes its arguments, sizing array
+ * arguments from their dimension expressions, and then either calls it once
+ * (init and free) or times it in batches until <PREFIX>_BENCH_MIN_NS has
+ * elapsed.
+ ******************************************************************************/
+static int write_c_subprograms(bindx_buffer_data *fp, const bindx_data *d,
+                               enum subprogram_type sub_type,
+                               const subprogram_data *subs)
+{
+     int i;
+
+     int indent = 0;
+
+     int alignment;
+
+     argument_data *argument;
+     subprogram_data *subprogram;
+
+     list_for_each(subs, subprogram) {
+          if (! subprogram_is_supported(subprogram))
+               continue;
+
+          bxprintf(fp, "static int bench_%s(%s_data *d)\n", subprogram->name, d->prefix);
+          bxprintf(fp, "{\n");
+
+          indent++;
+
+          bxprintf(fp, "%s", bxis(indent));
+          bindx_write_c_declaration(fp, d, &subprogram->type, NULL);
+          bxprintf(fp, "r;\n");
+
+          list_for_each(subprogram->args, argument) {
+               bxprintf(fp, "%s", bxis(indent));
+               bindx_write_c_type(fp, d, &argument->type, NULL);
+               bxprintf(fp, " ");
+               if (argument->type.rank > 0)
+                    bxprintf(fp, "*");
+               bxprintf(fp, "%s;\n", argument->name);
+
+               if (argument_is_pointer_array(argument)) {
+                    bxprintf(fp, "%s", bxis(indent));
+                    bindx_write_c_type(fp, d, &argument->type, NULL);
+                    bxprintf(fp, " ");
+                    for (i = 0; i < argument->type.rank; ++i)
+                         bxprintf(fp, "*");
+                    bxprintf(fp, "%s2;\n", argument->name);
+               }
+
+               if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_STRIDED)
+                    bxprintf(fp, "%sptrdiff_t %s_strides[%d];\n", bxis(indent), argument->name, argument->type.rank);
+          }
+
+          if (sub_type == SUBPROGRAM_TYPE_GENERAL || subprogram_has_array_args(subprogram))
+               bxprintf(fp, "%ssize_t bench_i;\n", bxis(indent));
+          if (subprogram_has_array_args(subprogram))
+               bxprintf(fp, "%ssize_t bench_n;\n", bxis(indent));
+          if (sub_type == SUBPROGRAM_TYPE_GENERAL) {
+               bxprintf(fp, "%ssize_t bench_n_allocs0;\n", bxis(indent));
+               bxprintf(fp, "%ssize_t bench_n_bytes = 0;\n", bxis(indent));
+               bxprintf(fp, "%slong bench_n_calls = 0;\n", bxis(indent));
+               bxprintf(fp, "%slong bench_n_errors = 0;\n", bxis(indent));
+               bxprintf(fp, "%suint64_t bench_t0;\n", bxis(indent));
+               bxprintf(fp, "%suint64_t bench_t;\n", bxis(indent));
+          }
+
+          list_for_each(subprogram->args, argument) {
+               if (argument->usage == LEX_SUBPROGRAM_ARGUMENT_USAGE_IN &&
+                   argument->type.rank == 0) {
+                    bxprintf(fp, "%s%s = ", bxis(indent), argument->name);
+                    write_c_argument_macro_name(fp, d, subprogram, argument);
+                    bxprintf(fp, ";\n");
+               }
+          }
+
+          list_for_each(subprogram->args, argument) {
+               if (argument->type.rank == 0)
+                    continue;
+
+               alignment = 64;
+               if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_ALIGN &&
+                   argument->options.align > alignment)
+                    alignment = argument->options.align;
+
+               bxprintf(fp, "%sbench_n = ", bxis(indent));
+               write_c_n_elems(fp, argument);
+               bxprintf(fp, ";\n");
+               bxprintf(fp, "%s%s = bench_alloc(bench_n * sizeof(*%s), %d);\n",
+                        bxis(indent), argument->name, argument->name, alignment);
+               bxprintf(fp, "%sfor (bench_i = 0; bench_i < bench_n; ++bench_i)\n", bxis(indent));
+               bxprintf(fp, "%s%s[bench_i] = 1;\n", bxis(indent + 1), argument->name);
+               if (sub_type == SUBPROGRAM_TYPE_GENERAL)
+                    bxprintf(fp, "%sbench_n_bytes += bench_n * sizeof(*%s);\n", bxis(indent), argument->name);
+
+               if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_STRIDED)
+                    bindx_write_c_row_major_strides(fp, argument, bxis(indent));
+               else
+               if (argument_is_pointer_array(argument)) {
+                    bxprintf(fp, "%s%s2 = array_from_mem%d_%s(%s, ", bxis(indent),
+                             argument->name, argument->type.rank,
+                             bindx_c_type_postfix(&argument->type), argument->name);
+                    for (i = 0; i < argument->type.rank; ++i) {
+                         bxprintf(fp, "%s", argument->type.dimens[i]);
+                         if (i + 1 < argument->type.rank)
+                              bxprintf(fp, ", ");
+                    }
+                    bxprintf(fp, ");\n");
+               }
+          }
+
+          if (sub_type == SUBPROGRAM_TYPE_GENERAL) {
+               bxprintf(fp, "%sbench_n_allocs0 = n_allocs;\n", bxis(indent));
+               bxprintf(fp, "%sbench_t0 = bench_now();\n", bxis(indent));
+               bxprintf(fp, "%sdo {\n", bxis(indent));
+               indent++;
+               bxprintf(fp, "%sfor (bench_i = 0; bench_i < %s_BENCH_BATCH; ++bench_i) {\n", bxis(indent), d->PREFIX);
+               indent++;
+          }
+
+          bxprintf(fp, "%sr = %s_%s(d", bxis(indent), d->prefix, subprogram->name);
+          list_for_each(subprogram->args, argument) {
+               bxprintf(fp, ", ");
+               if (argument->type.rank == 0 &&
+                   argument->usage == LEX_SUBPROGRAM_ARGUMENT_USAGE_OUT)
+                    bxprintf(fp, "&");
+               bxprintf(fp, "%s", argument->name);
+               if (argument_is_pointer_array(argument))
+                    bxprintf(fp, "2");
+               if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_STRIDED)
+                    bxprintf(fp, ", %s_strides", argument->name);
+          }
+          bxprintf(fp, ");\n");
+
+          if (subprogram->type.rank > 0)
+               bxprintf(fp, "%sif (r == NULL)\n", bxis(indent));
+          else
+               bxprintf(fp, "%sif (r == %s)\n", bxis(indent),
+                        bindx_c_error_conditional(d, subprogram->type.type));
+          if (sub_type == SUBPROGRAM_TYPE_GENERAL) {
+               bxprintf(fp, "%sbench_n_errors++;\n", bxis(indent + 1));
+               if (subprogram->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_OWNED) {
+                    bxprintf(fp, "%selse\n", bxis(indent));
+                    bxprintf(fp, "%sfree_array((void *) r, %d);\n", bxis(indent + 1), subprogram->type.rank);
+               }
+               indent--;
+               bxprintf(fp, "%s}\n", bxis(indent));
+               bxprintf(fp, "%sbench_n_calls += %s_BENCH_BATCH;\n", bxis(indent), d->PREFIX);
+               indent--;
+               bxprintf(fp, "%s} while ((bench_t = bench_now() - bench_t0) < %s_BENCH_MIN_NS);\n", bxis(indent), d->PREFIX);
+               bxprintf(fp, "%sbench_report(\"%s\", bench_n_calls, bench_t, n_allocs - bench_n_allocs0, bench_n_errors, bench_n_bytes);\n",
+                        bxis(indent), subprogram->name);
+          }
+          else {
+               bxprintf(fp, "%sreturn -1;\n", bxis(indent + 1));
+          }
+
+          list_for_each(subprogram->args, argument) {
+               if (argument_is_pointer_array(argument))
+                    bxprintf(fp, "%sfree_array%d_%s(%s2);\n", bxis(indent),
+                             argument->type.rank, bindx_c_type_postfix(&argument->type),
+                             argument->name);
+               if (argument->type.rank > 0)
+                    bxprintf(fp, "%sfree(%s);\n", bxis(indent), argument->name);
+          }
+
+          bxprintf(fp, "%sreturn 0;\n", bxis(indent));
+
+          indent--;
+
+          bxprintf(fp, "}\n");
+          bxprintf(fp, "\n");
+          bxprintf(fp, "\n");
+     }
+
+     return 0;
+}
+
+
+
+static int write_c_main(bindx_buffer_data *fp, const bindx_data *d, const char *name)
+{
+     subprogram_data *subprogram;
+
+     bxprintf(fp, "int main(int argc, char *argv[])\n");
+     bxprintf(fp, "{\n");
+     bxprintf(fp, "     %s_data data;\n", d->prefix);
+     bxprintf(fp, "     %s_data *d = &data;\n", d->prefix);
+     bxprintf(fp, "\n");
+
+     bxprintf(fp, "     memset(d, 0, sizeof(%s_data));\n", d->prefix);
+
+     /* Only the first init and free subprograms are used. */
+     list_for_each(&d->subs_init, subprogram) {
+          if (! subprogram_is_supported(subprogram)) {
+               bxprintf(fp, "     fprintf(stderr, \"ERROR: %s_%s() arguments cannot be synthesized\\n\");\n",
+                        d->prefix, subprogram->name);
+               bxprintf(fp, "     exit(1);\n");
+          }
+          else {
+               bxprintf(fp, "     if (bench_%s(d)) {\n", subprogram->name);
+               bxprintf(fp, "          fprintf(stderr, \"ERROR: %s_%s()\\n\");\n", d->prefix, subprogram->name);
+               bxprintf(fp, "          exit(1);\n");
+               bxprintf(fp, "     }\n");
+          }
+          break;
+     }
+     bxprintf(fp, "\n");
+
+     bxprintf(fp, "     printf(\"%s\\n\\n\");\n", name);
+     bxprintf(fp, "     printf(\"%%-32s %%12s %%12s %%12s %%12s %%12s\\n\", \"subprogram\", \"calls\", \"ns/call\", \"MB/s\", \"allocs/call\", \"errors\");\n");
+
+     list_for_each(&d->subs_general, subprogram) {
+          if (! subprogram_is_supported(subprogram))
+               bxprintf(fp, "     printf(\"%%-32s not benchmarked\\n\", \"%s\");\n", subprogram->name);
+          else
+               bxprintf(fp, "     bench_%s(d);\n", subprogram->name);
+     }
+     bxprintf(fp, "\n");
+
+     list_for_each(&d->subs_free, subprogram) {
+          if (subprogram_is_supported(subprogram))
+               bxprintf(fp, "     bench_%s(d);\n", subprogram->name);
+          break;
+     }
+     bxprintf(fp, "\n");
+
+     bxprintf(fp, "     return 0;\n");
+     bxprintf(fp, "}\n");
+
+     return 0;
+}
+
+
+
+/*******************************************************************************
+ * The Python script sizes array arguments by evaluating the same dimension
+ * expressions.  Instance fields (d->x) are taken to be the init argument of
+ * the same name, which holds for the common case of sizes given at creation.
+ ******************************************************************************/
+static const char *type_to_numpy_dtype(const type_data *type)
+{
+     switch(type->type) {
+          case LEX_BINDX_TYPE_CHAR:
+               return "np.int8";
+          case LEX_BINDX_TYPE_INT:
+               return "np.int32";
+          case LEX_BINDX_TYPE_INT64:
+               return "np.int64";
+          case LEX_BINDX_TYPE_SIZE_T:
+               return "np.uintp";
+          case LEX_BINDX_TYPE_FLOAT:
+               return "np.float32";
+          case LEX_BINDX_TYPE_DOUBLE:
+               return "np.float64";
+          case LEX_BINDX_TYPE_COMPLEX:
+               return "np.complex128";
+          default:
+               INTERNAL_ERROR("Invalid lex_bindx_type value: %d", type->type);
+               break;
+     }
+
+     return NULL;
+}
+
+
+
+static int write_py_expression(bindx_buffer_data *fp, const char *s)
+{
+     for ( ; *s != '\0'; ++s) {
+          if (s[0] == '-' && s[1] == '>') {
+               bxprintf(fp, ".");
+               ++s;
+          }
+          else
+          if (s[0] == '/')
+               bxprintf(fp, "//");
+          else
+               bxprintf(fp, "%c", *s);
+     }
+
+     return 0;
+}
+
+
+
+static int write_py_default_value(bindx_buffer_data *fp, const bindx_data *d,
+                                  const argument_data *argument)
+{
+     if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_ENUM_MASK)
+          bxprintf(fp, "[]");
+     else
+     if (argument->type.type == LEX_BINDX_TYPE_ENUM)
+          bxprintf(fp, "\"%s\"", first_enum_member(d, &argument->type));
+     else
+     if (argument->type.type == LEX_BINDX_TYPE_COMPLEX)
+          bxprintf(fp, "1. + 0.j");
+     else
+     if (argument->type.type == LEX_BINDX_TYPE_FLOAT ||
+         argument->type.type == LEX_BINDX_TYPE_DOUBLE)
+          bxprintf(fp, "1.");
+     else
+          bxprintf(fp, "N");
+
+     return 0;
+}
+
+
+
+static int write_py_arguments(bindx_buffer_data *fp, const bindx_data *d,
+                              const subprogram_data *subprogram, int indent)
+{
+     int i;
+
+     argument_data *argument;
+
+     list_for_each(subprogram->args, argument) {
+          if (argument->usage != LEX_SUBPROGRAM_ARGUMENT_USAGE_IN)
+               continue;
+
+          bxprintf(fp, "%s%s = value(\"%s.%s\", ", bxis4(indent), argument->name,
+                   subprogram->name, argument->name);
+          if (argument->type.rank == 0)
+               write_py_default_value(fp, d, argument);
+          else {
+               bxprintf(fp, "np.ones((");
+               for (i = 0; i < argument->type.rank; ++i) {
+                    write_py_expression(fp, argument->type.dimens[i]);
+                    bxprintf(fp, ", ");
+               }
+               bxprintf(fp, "), %s", type_to_numpy_dtype(&argument->type));
+               if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_COL_MAJOR)
+                    bxprintf(fp, ", order = \"F\"");
+               bxprintf(fp, ")");
+          }
+          bxprintf(fp, ")\n");
+     }
+
+     return 0;
+}
+
+
+
+static int write_py_call_args(bindx_buffer_data *fp, const subprogram_data *subprogram)
+{
+     int flag = 0;
+
+     argument_data *argument;
+
+     list_for_each(subprogram->args, argument) {
+          if (argument->usage != LEX_SUBPROGRAM_ARGUMENT_USAGE_IN)
+               continue;
+          if (flag)
+               bxprintf(fp, ", ");
+          bxprintf(fp, "%s", argument->name);
+          flag = 1;
+     }
+
+     return 0;
+}
+
+
+
+static int write_py(bindx_buffer_data *fp, const bindx_data *d, const char *name)
+{
+     int i;
+
+     int flag;
+
+     argument_data *argument;
+     subprogram_data *subprogram;
+
+     bxprintf(fp, "#*******************************************************************************\n");
+     bxprintf(fp, "# This file was generated by bindx version %s.  Edit at your own risk.\n", bindx_version());
+     bxprintf(fp, "#*******************************************************************************\n");
+     bxprintf(fp, "#\n");
+     bxprintf(fp, "# usage: python %s_bench.py [N=n] [subprogram.argument=value] ...\n", d->prefix);
+     bxprintf(fp, "#\n");
+     bxprintf(fp, "import sys\n");
+     bxprintf(fp, "import timeit\n");
+     bxprintf(fp, "import types\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "import numpy as np\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "import %s\n", d->prefix);
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+     bxprintf(fp, "MIN_TIME = 0.1\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "overrides = dict(arg.split(\"=\", 1) for arg in sys.argv[1:])\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+     bxprintf(fp, "def value(name, default):\n");
+     bxprintf(fp, "    if name in overrides:\n");
+     bxprintf(fp, "        return eval(overrides[name])\n");
+     bxprintf(fp, "    return default\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+     bxprintf(fp, "def bench(name, setup):\n");
+     bxprintf(fp, "    try:\n");
+     bxprintf(fp, "        f, n_bytes = setup()\n");
+     bxprintf(fp, "        f()\n");
+     bxprintf(fp, "    except Exception as e:\n");
+     bxprintf(fp, "        print(\"%%-32s not benchmarked: %%s\" %% (name, e))\n");
+     bxprintf(fp, "        return\n");
+     bxprintf(fp, "    n_calls = 1\n");
+     bxprintf(fp, "    while True:\n");
+     bxprintf(fp, "        t = timeit.timeit(f, number = n_calls)\n");
+     bxprintf(fp, "        if t >= MIN_TIME:\n");
+     bxprintf(fp, "            break\n");
+     bxprintf(fp, "        n_calls *= 2\n");
+     bxprintf(fp, "    ns_call = t / n_calls * 1.e9\n");
+     bxprintf(fp, "    print(\"%%-32s %%12d %%12.1f %%12.1f\" %% (name, n_calls, ns_call, n_bytes / ns_call * 1.e3))\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+     bxprintf(fp, "N = value(\"N\", 8)\n");
+     bxprintf(fp, "\n");
+
+     list_for_each(&d->subs_init, subprogram) {
+          write_py_arguments(fp, d, subprogram, 0);
+          bxprintf(fp, "d = types.SimpleNamespace(");
+          flag = 0;
+          list_for_each(subprogram->args, argument) {
+               if (argument->usage != LEX_SUBPROGRAM_ARGUMENT_USAGE_IN)
+                    continue;
+               if (flag)
+                    bxprintf(fp, ", ");
+               bxprintf(fp, "%s = %s", argument->name, argument->name);
+               flag = 1;
+          }
+          bxprintf(fp, ")\n");
+          bxprintf(fp, "obj = %s.%s(", d->prefix, d->prefix);
+          write_py_call_args(fp, subprogram);
+          bxprintf(fp, ")\n");
+          break;
+     }
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+     list_for_each(&d->subs_general, subprogram) {
+          if (! subprogram_is_supported(subprogram))
+               continue;
+
+          bxprintf(fp, "def setup_%s():\n", subprogram->name);
+          write_py_arguments(fp, d, subprogram, 1);
+          bxprintf(fp, "    n_bytes = 0\n");
+          list_for_each(subprogram->args, argument) {
+               if (argument->type.rank == 0)
+                    continue;
+               if (argument->usage == LEX_SUBPROGRAM_ARGUMENT_USAGE_IN)
+                    bxprintf(fp, "    n_bytes += %s.nbytes\n", argument->name);
+               else {
+                    bxprintf(fp, "    n_bytes += np.dtype(%s).itemsize",
+                             type_to_numpy_dtype(&argument->type));
+                    for (i = 0; i < argument->type.rank; ++i) {
+                         bxprintf(fp, " * (");
+                         write_py_expression(fp, argument->type.dimens[i]);
+                         bxprintf(fp, ")");
+                    }
+                    bxprintf(fp, "\n");
+               }
+          }
+          bxprintf(fp, "    return (lambda: obj.%s(", subprogram->name);
+          write_py_call_args(fp, subprogram);
+          bxprintf(fp, ")), n_bytes\n");
+          bxprintf(fp, "\n");
+          bxprintf(fp, "\n");
+     }
+
+     bxprintf(fp, "print(\"%s\\n\")\n", name);
+     bxprintf(fp, "print(\"%%-32s %%12s %%12s %%12s\" %% (\"subprogram\", \"calls\", \"ns/call\", \"MB/s\"))\n");
+     list_for_each(&d->subs_general, subprogram) {
+          if (! subprogram_is_supported(subprogram))
+               bxprintf(fp, "print(\"%%-32s not benchmarked\" %% \"%s\")\n", subprogram->name);
+          else
+               bxprintf(fp, "bench(\"%s\", setup_%s)\n", subprogram->name, subprogram->name);
+     }
+
+     return 0;
+}
+
+
+
+/*******************************************************************************
+ *
+ ******************************************************************************/
+int bindx_write_bench(bindx_buffer_data **fp, const bindx_data *d, const char *name)
+{
+     bindx_write_c_header_top(fp[0]);
+     bxprintf(fp[0], "\n");
+
+     bxprintf(fp[0], "#include <gutil.h>\n");
+     bxprintf(fp[0], "\n");
+     bxprintf(fp[0], "#include <stdint.h>\n");
+     bxprintf(fp[0], "#include <time.h>\n");
+     bxprintf(fp[0], "\n");
+     bxprintf(fp[0], "#include <%s_interface.h>\n", d->prefix);
+     bxprintf(fp[0], "\n");
+     bxprintf(fp[0], "\n");
+
+     bxprintf(fp[0], "#ifndef %s_BENCH_N\n", d->PREFIX);
+     bxprintf(fp[0], "#define %s_BENCH_N 8\n", d->PREFIX);
+     bxprintf(fp[0], "#endif\n");
+     bxprintf(fp[0], "#ifndef %s_BENCH_BATCH\n", d->PREFIX);
+     bxprintf(fp[0], "#define %s_BENCH_BATCH 16\n", d->PREFIX);
+     bxprintf(fp[0], "#endif\n");
+     bxprintf(fp[0], "#ifndef %s_BENCH_MIN_NS\n", d->PREFIX);
+     bxprintf(fp[0], "#define %s_BENCH_MIN_NS 100000000\n", d->PREFIX);
+     bxprintf(fp[0], "#endif\n");
+     bxprintf(fp[0], "\n");
+
+     write_c_argument_macros(fp[0], d, &d->subs_init);
+     write_c_argument_macros(fp[0], d, &d->subs_free);
+     write_c_argument_macros(fp[0], d, &d->subs_general);
+     bxprintf(fp[0], "\n");
+     bxprintf(fp[0], "\n");
+
+     write_c_utilities(fp[0], d);
+
+     write_c_subprograms(fp[0], d, SUBPROGRAM_TYPE_INIT,    &d->subs_init);
+     write_c_subprograms(fp[0], d, SUBPROGRAM_TYPE_FREE,    &d->subs_free);
+     write_c_subprograms(fp[0], d, SUBPROGRAM_TYPE_GENERAL, &d->subs_general);
+
+     write_c_main(fp[0], d, name);
+
+
+     write_py(fp[1], d, name);
+
+     return 0;
+}
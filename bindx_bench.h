@@ -0,0 +1,27 @@
+/*******************************************************************************
+**
+**    Copyright (C) 2011-2018 Greg McGarragh <greg.mcgarragh@colostate.edu>
+**
+**    This source code is licensed under the GNU General Public License (GPL),
+**    Version 3.  See the file COPYING for more details.
+**
+*******************************************************************************/
+
+#ifndef BINDX_BENCH_H
+#define BINDX_BENCH_H
+
+#include "bindx_parse_int.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include "prototypes/bindx_bench_p.h"
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BINDX_BENCH_H */
@@ -12,6 +12,7 @@
 #include "bindx_c.h"
 #include "bindx_parse.h"
 #include "bindx_parse_int.h"
+#include "bindx_util.h"
 
 
 size_t bindx_c_type_size(const type_data *type)
@@ -23,9 +24,21 @@ size_t bindx_c_type_size(const type_data *type)
           case LEX_BINDX_TYPE_INT:
                return sizeof(int);
                break;
+          case LEX_BINDX_TYPE_INT64:
+               return sizeof(int64_t);
+               break;
+          case LEX_BINDX_TYPE_SIZE_T:
+               return sizeof(size_t);
+               break;
+          case LEX_BINDX_TYPE_FLOAT:
+               return sizeof(float);
+               break;
           case LEX_BINDX_TYPE_DOUBLE:
                return sizeof(double);
                break;
+          case LEX_BINDX_TYPE_COMPLEX:
+               return sizeof(dcomplex);
+               break;
           default:
                INTERNAL_ERROR("Invalid lex_bindx_type value: %d", type->type);
                break;
@@ -36,6 +49,38 @@ size_t bindx_c_type_size(const type_data *type)
 
 
 
+/*
+ * Postfix of the gutil array allocation routines (array_from_mem2_d(), etc.)
+ * for a type.  size_t uses the unsigned long variants which match it on LP64
+ * platforms.
+ */
+const char *bindx_c_type_postfix(const type_data *type)
+{
+     switch(type->type) {
+          case LEX_BINDX_TYPE_ENUM:
+               return "i";
+          case LEX_BINDX_TYPE_CHAR:
+               return "c";
+          case LEX_BINDX_TYPE_INT:
+               return "i";
+          case LEX_BINDX_TYPE_INT64:
+               return "ll";
+          case LEX_BINDX_TYPE_SIZE_T:
+               return "ul";
+          case LEX_BINDX_TYPE_FLOAT:
+               return "f";
+          case LEX_BINDX_TYPE_DOUBLE:
+               return "d";
+          case LEX_BINDX_TYPE_COMPLEX:
+               return "dc";
+          default:
+               INTERNAL_ERROR("Invalid lex_bindx_type value: %d", type->type);
+               return NULL;
+     }
+}
+
+
+
 const char *bindx_c_error_conditional(const bindx_data *d, int lex_bindx_type)
 {
      switch(lex_bindx_type) {
@@ -43,8 +88,16 @@ const char *bindx_c_error_conditional(const bindx_data *d, int lex_bindx_type)
                return d->errors.err_ret_int;
           case LEX_BINDX_TYPE_INT:
                return d->errors.err_ret_int;
+          case LEX_BINDX_TYPE_INT64:
+               return d->errors.err_ret_int;
+          case LEX_BINDX_TYPE_SIZE_T:
+               return d->errors.err_ret_int;
+          case LEX_BINDX_TYPE_FLOAT:
+               return d->errors.err_ret_dbl;
           case LEX_BINDX_TYPE_DOUBLE:
                return d->errors.err_ret_dbl;
+          case LEX_BINDX_TYPE_COMPLEX:
+               return d->errors.err_ret_dbl;
           default:
                INTERNAL_ERROR("Invalid lex_bindx_type value: %d", lex_bindx_type);
                return NULL;
@@ -53,78 +106,90 @@ const char *bindx_c_error_conditional(const bindx_data *d, int lex_bindx_type)
 
 
 
-int bindx_write_c_header(FILE *fp)
+int bindx_write_c_header(bindx_buffer_data *fp)
 {
-     fprintf(fp, "/*******************************************************************************\n");
-     fprintf(fp, " *\n");
-     fprintf(fp, " ******************************************************************************/\n");
+     bxprintf(fp, "/*******************************************************************************\n");
+     bxprintf(fp, " *\n");
+     bxprintf(fp, " ******************************************************************************/\n");
 
      return 0;
 }
 
 
 
-int bindx_write_c_header_top(FILE *fp)
+int bindx_write_c_header_top(bindx_buffer_data *fp)
 {
-     fprintf(fp, "/*******************************************************************************\n");
-     fprintf(fp, " * This file was generated by bindx version %s.  Edit at your own risk.\n",
-             bindx_version());
-     fprintf(fp, " ******************************************************************************/\n");
+     bxprintf(fp, "/*******************************************************************************\n");
+     bxprintf(fp, " * This file was generated by bindx version %s.  Edit at your own risk.\n",
+              bindx_version());
+     bxprintf(fp, " ******************************************************************************/\n");
 
      return 0;
 }
 
 
 
-int bindx_write_c_util_header(FILE *fp, const bindx_data *d)
+int bindx_write_c_util_header(bindx_buffer_data *fp, const bindx_data *d)
 {
-     fprintf(fp, "#include <gutil.h>\n");
-     fprintf(fp, "\n");
-     fprintf(fp, "#include <%s_interface.h>\n", d->prefix);
-     fprintf(fp, "\n");
-     fprintf(fp, "#ifdef __cplusplus\n");
-     fprintf(fp, "extern \"C\" {\n");
-     fprintf(fp, "#endif\n");
-     fprintf(fp, "\n");
-     fprintf(fp, "\n");
+     bxprintf(fp, "#include <gutil.h>\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "#include <%s_interface.h>\n", d->prefix);
+     bxprintf(fp, "\n");
+     bxprintf(fp, "#ifdef __cplusplus\n");
+     bxprintf(fp, "extern \"C\" {\n");
+     bxprintf(fp, "#endif\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
 
      return 0;
 }
 
 
 
-int bindx_write_c_util_trailer(FILE *fp, const bindx_data *d)
+int bindx_write_c_util_trailer(bindx_buffer_data *fp, const bindx_data *d)
 {
-     fprintf(fp, "#ifdef __cplusplus\n");
-     fprintf(fp, "}\n");
-     fprintf(fp, "#endif\n");
+     bxprintf(fp, "#ifdef __cplusplus\n");
+     bxprintf(fp, "}\n");
+     bxprintf(fp, "#endif\n");
 
      return 0;
 }
 
 
 
-int bindx_write_c_type(FILE *fp, const bindx_data *d, const type_data *type,
+int bindx_write_c_type(bindx_buffer_data *fp, const bindx_data *d, const type_data *type,
                        const char *prefix)
 {
      switch(type->type) {
           case LEX_BINDX_TYPE_ENUM:
                if (prefix)
-                    fprintf(fp, "enum %s_%s", prefix, type->name);
+                    bxprintf(fp, "enum %s_%s", prefix, type->name);
                else
-                    fprintf(fp, "enum %s_%s", d->prefix, type->name);
+                    bxprintf(fp, "enum %s_%s", d->prefix, type->name);
                break;
           case LEX_BINDX_TYPE_CHAR:
-               fprintf(fp, "char");
+               bxprintf(fp, "char");
                break;
           case LEX_BINDX_TYPE_INT:
-               fprintf(fp, "int");
+               bxprintf(fp, "int");
+               break;
+          case LEX_BINDX_TYPE_INT64:
+               bxprintf(fp, "int64_t");
+               break;
+          case LEX_BINDX_TYPE_SIZE_T:
+               bxprintf(fp, "size_t");
+               break;
+          case LEX_BINDX_TYPE_FLOAT:
+               bxprintf(fp, "float");
                break;
           case LEX_BINDX_TYPE_DOUBLE:
-               fprintf(fp, "double");
+               bxprintf(fp, "double");
+               break;
+          case LEX_BINDX_TYPE_COMPLEX:
+               bxprintf(fp, "dcomplex");
                break;
           case LEX_BINDX_TYPE_STRUCTURE:
-               fprintf(fp, "%s", type->name);
+               bxprintf(fp, "%s", type->name);
                break;
           default:
                INTERNAL_ERROR("Invalid lex_bindx_type value: %d", type->type);
@@ -136,26 +201,26 @@ int bindx_write_c_type(FILE *fp, const bindx_data *d, const type_data *type,
 
 
 
-int bindx_write_c_dimens(FILE *fp, const bindx_data *d, const type_data *type)
+int bindx_write_c_dimens(bindx_buffer_data *fp, const bindx_data *d, const type_data *type)
 {
      int i;
 
      for (i = 0; i < type->rank; ++i)
-          fprintf(fp, "*");
+          bxprintf(fp, "*");
 
      return 0;
 }
 
 
 
-int bindx_write_c_dimens_args(FILE *fp, const bindx_data *d, const type_data *type,
+int bindx_write_c_dimens_args(bindx_buffer_data *fp, const bindx_data *d, const type_data *type,
                               enum lex_subprogram_argument_usage usage)
 {
      if (type->type == LEX_BINDX_TYPE_STRUCTURE)
-          fprintf(fp, "*");
+          bxprintf(fp, "*");
      else
      if (type->rank == 0 && usage == LEX_SUBPROGRAM_ARGUMENT_USAGE_OUT)
-          fprintf(fp, "*");
+          bxprintf(fp, "*");
      else
           return bindx_write_c_dimens(fp, d, type);
 
@@ -164,18 +229,18 @@ int bindx_write_c_dimens_args(FILE *fp, const bindx_data *d, const type_data *ty
 
 
 
-int bindx_write_c_dimens_return(FILE *fp, const bindx_data *d, const type_data *type)
+int bindx_write_c_dimens_return(bindx_buffer_data *fp, const bindx_data *d, const type_data *type)
 {
      return bindx_write_c_dimens(fp, d, type);
 }
 
 
 
-int bindx_write_c_declaration(FILE *fp, const bindx_data *d, const type_data *type,
+int bindx_write_c_declaration(bindx_buffer_data *fp, const bindx_data *d, const type_data *type,
                               const char *prefix)
 {
      bindx_write_c_type(fp, d, type, prefix);
-     fprintf(fp, " ");
+     bxprintf(fp, " ");
      bindx_write_c_dimens(fp, d, type);
 
      return 0;
@@ -183,20 +248,102 @@ int bindx_write_c_declaration(FILE *fp, const bindx_data *d, const type_data *ty
 
 
 
-int bindx_write_c_enum_mask_init(FILE *fp, struct list_data *list, const char *name,
+int bindx_write_c_argument_dimens(bindx_buffer_data *fp, const bindx_data *d,
+                                  const argument_data *argument)
+{
+     if (argument_is_flat_array(argument))
+          bxprintf(fp, "*");
+     else
+          return bindx_write_c_dimens(fp, d, &argument->type);
+
+     return 0;
+}
+
+
+
+int bindx_write_c_argument_dimens_args(bindx_buffer_data *fp, const bindx_data *d,
+                                       const argument_data *argument)
+{
+     if (argument_is_flat_array(argument))
+          bxprintf(fp, "*");
+     else
+          return bindx_write_c_dimens_args(fp, d, &argument->type, argument->usage);
+
+     return 0;
+}
+
+
+
+int bindx_write_c_argument_declaration(bindx_buffer_data *fp, const bindx_data *d,
+                                       const argument_data *argument)
+{
+     bindx_write_c_type(fp, d, &argument->type, NULL);
+     bxprintf(fp, " ");
+     bindx_write_c_argument_dimens(fp, d, argument);
+
+     return 0;
+}
+
+
+
+/*******************************************************************************
+ * Write the entries of the dimension table that are first used by argument,
+ * given that the first *n_dimens have been written.  Entries are numbered in
+ * order of first use, so writing them as each argument is reached evaluates
+ * each one after the arguments before it have been converted.
+ ******************************************************************************/
+int bindx_write_c_subprogram_dimens(bindx_buffer_data *fp, const subprogram_data *subprogram,
+                                    const argument_data *argument, int *n_dimens,
+                                    const char *indent)
+{
+     int i;
+     int n;
+
+     n = *n_dimens;
+     for (i = 0; i < argument->type.rank; ++i) {
+          if (argument->i_dimens[i] >= n)
+               n = argument->i_dimens[i] + 1;
+     }
+
+     for (i = *n_dimens; i < n; ++i)
+          bxprintf(fp, "%sdimens[%d] = %s;\n", indent, i, subprogram->dimens[i]);
+
+     *n_dimens = n;
+
+     return 0;
+}
+
+
+
+int bindx_write_c_row_major_strides(bindx_buffer_data *fp, const argument_data *argument,
+                                    const char *indent)
+{
+     int i;
+
+     bxprintf(fp, "%s%s_strides[%d] = 1;\n", indent, argument->name, argument->type.rank - 1);
+     for (i = argument->type.rank - 2; i >= 0; --i)
+          bxprintf(fp, "%s%s_strides[%d] = %s_strides[%d] * (%s);\n", indent, argument->name, i,
+                   argument->name, i + 1, argument->type.dimens[i + 1]);
+
+     return 0;
+}
+
+
+
+int bindx_write_c_enum_mask_init(bindx_buffer_data *fp, struct list_data *list, const char *name,
                                  const char *prefix, int indent)
 {
      char temp[NM];
 
      struct list_data *item;
 
-     fprintf(fp, "%s%s = 0;\n", bxis(indent), name);
+     bxprintf(fp, "%s%s = 0;\n", bxis(indent), name);
 
      list_for_each(list, item) {
           if (strcmp(item->name, "null") == 0)
                break;
           strtoupper(item->name, temp);
-          fprintf(fp, "%s%s |= %s%s;\n", bxis(indent), name, prefix, temp);
+          bxprintf(fp, "%s%s |= %s%s;\n", bxis(indent), name, prefix, temp);
      }
 
      return 0;
@@ -204,21 +351,128 @@ int bindx_write_c_enum_mask_init(FILE *fp, struct list_data *list, const char *n
 
 
 
-int bindx_write_c_enum_array_init(FILE *fp, struct list_data *list, const char *name,
+int bindx_write_c_enum_array_init(bindx_buffer_data *fp, struct list_data *list, const char *name,
                                   const char *prefix, int indent)
 {
      char temp[NM];
 
      struct list_data *item;
 
-     fprintf(fp, "%si = 0;\n", bxis(indent));
+     bxprintf(fp, "%si = 0;\n", bxis(indent));
 
      list_for_each(list, item) {
           if (strcmp(item->name, "null") == 0)
                break;
           strtoupper(item->name, temp);
-          fprintf(fp, "%s%s[i++] = %s%s;\n", bxis(indent), name, prefix, temp);
+          bxprintf(fp, "%s%s[i++] = %s%s;\n", bxis(indent), name, prefix, temp);
      }
 
      return 0;
 }
+
+
+
+/*
+ * Per-call statistics compiled in with -stats.  Each general subprogram has a
+ * slot in a static table with a call count, the total time in ns and a log2 ns
+ * histogram for each of three phases: argument conversion, the call itself and
+ * result building.  Updates are relaxed atomic adds so that wrappers called
+ * from several threads need no lock.
+ */
+int bindx_write_c_stats_header(bindx_buffer_data *fp, const bindx_data *d)
+{
+     bxprintf(fp, "#include <stdint.h>\n");
+     bxprintf(fp, "#include <time.h>\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "#define %s_STATS_N_SUBPROGRAMS %d\n", d->PREFIX, list_count(&d->subs_general));
+     bxprintf(fp, "#define %s_STATS_N_PHASES      %d\n", d->PREFIX, BINDX_STATS_N_PHASES);
+     bxprintf(fp, "#define %s_STATS_N_BUCKETS     %d\n", d->PREFIX, BINDX_STATS_N_BUCKETS);
+     bxprintf(fp, "\n");
+     bxprintf(fp, "typedef struct {\n");
+     bxprintf(fp, "     const char *name;\n");
+     bxprintf(fp, "     uint64_t n_calls;\n");
+     bxprintf(fp, "     uint64_t ns[%s_STATS_N_PHASES];\n", d->PREFIX);
+     bxprintf(fp, "     uint64_t hist[%s_STATS_N_PHASES][%s_STATS_N_BUCKETS];\n", d->PREFIX, d->PREFIX);
+     bxprintf(fp, "} %s_stats_data;\n", d->prefix);
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+     return 0;
+}
+
+
+
+int bindx_write_c_stats_utilities(bindx_buffer_data *fp, const bindx_data *d)
+{
+     subprogram_data *subprogram;
+
+     bxprintf(fp, "static %s_stats_data %s_stats[%s_STATS_N_SUBPROGRAMS + 1] = {\n",
+              d->prefix, d->prefix, d->PREFIX);
+     list_for_each(&d->subs_general, subprogram)
+          bxprintf(fp, "     {\"%s\"},\n", subprogram->name);
+     bxprintf(fp, "     {NULL}\n");
+     bxprintf(fp, "};\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+
+     bxprintf(fp, "static uint64_t stats_now(void)\n");
+     bxprintf(fp, "{\n");
+     bxprintf(fp, "     struct timespec t;\n");
+
+     bxprintf(fp, "     clock_gettime(CLOCK_MONOTONIC, &t);\n");
+
+     bxprintf(fp, "     return (uint64_t) t.tv_sec * 1000000000 + t.tv_nsec;\n");
+     bxprintf(fp, "}\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+
+     bxprintf(fp, "static void stats_record(int i, const uint64_t *t)\n");
+     bxprintf(fp, "{\n");
+     bxprintf(fp, "     int j;\n");
+     bxprintf(fp, "     int k;\n");
+     bxprintf(fp, "     uint64_t dt;\n");
+
+     bxprintf(fp, "     __atomic_fetch_add(&%s_stats[i].n_calls, 1, __ATOMIC_RELAXED);\n", d->prefix);
+     bxprintf(fp, "     for (j = 0; j < %s_STATS_N_PHASES; ++j) {\n", d->PREFIX);
+     bxprintf(fp, "          dt = t[j + 1] - t[j];\n");
+     bxprintf(fp, "          for (k = 0; k < %s_STATS_N_BUCKETS - 1 && dt >> (k + 1) != 0; ++k) ;\n", d->PREFIX);
+     bxprintf(fp, "          __atomic_fetch_add(&%s_stats[i].ns[j], dt, __ATOMIC_RELAXED);\n", d->prefix);
+     bxprintf(fp, "          __atomic_fetch_add(&%s_stats[i].hist[j][k], 1, __ATOMIC_RELAXED);\n", d->prefix);
+     bxprintf(fp, "     }\n");
+     bxprintf(fp, "}\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+     return 0;
+}
+
+
+
+int bindx_write_c_stats_declaration(bindx_buffer_data *fp, const bindx_data *d, int indent)
+{
+     if (d->stats)
+          bxprintf(fp, "%suint64_t stats_t[%d];\n", bxis(indent), BINDX_STATS_N_PHASES + 1);
+
+     return 0;
+}
+
+
+
+/*
+ * Take the time stamp that ends phase i - 1 and, for the last one, record the
+ * call in slot i_stats.
+ */
+int bindx_write_c_stats_time(bindx_buffer_data *fp, const bindx_data *d, int i, int i_stats,
+                             int indent)
+{
+     if (! d->stats)
+          return 0;
+
+     bxprintf(fp, "%sstats_t[%d] = stats_now();\n", bxis(indent), i);
+     if (i == BINDX_STATS_N_PHASES)
+          bxprintf(fp, "%sstats_record(%d, stats_t);\n", bxis(indent), i_stats);
+
+     return 0;
+}
@@ -18,6 +18,10 @@ extern "C" {
 #endif
 
 
+#define BINDX_STATS_N_PHASES  3
+#define BINDX_STATS_N_BUCKETS 40
+
+
 #include "prototypes/bindx_c_p.h"
 
 
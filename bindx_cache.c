@@ -0,0 +1,879 @@
+/*******************************************************************************
+**
+**    Copyright (C) 2011-2018 Greg McGarragh <greg.mcgarragh@colostate.edu>
+**
+**    This source code is licensed under the GNU General Public License (GPL),
+**    Version 3.  See the file COPYING for more details.
+**
+*******************************************************************************/
+
+#include <gutil.h>
+
+#include "bindx_cache.h"
+#include "bindx_parse.h"
+#include "bindx_parse_int.h"
+#include "bindx_util.h"
+
+
+/*******************************************************************************
+ * The cache file holds the IR parsed from each -int_def_in file, keyed on a
+ * hash of the file's contents, and a fingerprint of the IR sections, names and
+ * output files consumed by each back-end on the last run.  All values are
+ * stored as 64 bit little endian integers and strings are stored as their
+ * length plus one (zero for NULL) followed by their characters:
+ *
+ *   magic "BINDXIR\0", format, bindx version
+ *   n_files,     {file, hash, length, IR[length]} ...
+ *   n_back_ends, {tag, fingerprint} ...
+ ******************************************************************************/
+#define FNV_OFFSET_BASIS ((uint64_t) 0xcbf29ce484222325ULL)
+#define FNV_PRIME        ((uint64_t) 0x00000100000001b3ULL)
+
+
+static const char cache_magic[8] = "BINDXIR";
+
+
+typedef struct {
+     const unsigned char *p;
+     const unsigned char *end;
+     int error;
+} cache_reader_data;
+
+
+
+/*******************************************************************************
+ *
+ ******************************************************************************/
+static uint64_t hash_bytes(uint64_t hash, const void *p, size_t n)
+{
+     size_t i;
+
+     const unsigned char *p2 = p;
+
+     for (i = 0; i < n; ++i) {
+          hash ^= p2[i];
+          hash *= FNV_PRIME;
+     }
+
+     return hash;
+}
+
+
+
+/*******************************************************************************
+ *
+ ******************************************************************************/
+static void buffer_init(cache_buffer_data *b, int hash_only)
+{
+     b->hash_only = hash_only;
+     b->data      = NULL;
+     b->size      = 0;
+     b->capacity  = 0;
+     b->hash      = FNV_OFFSET_BASIS;
+}
+
+
+
+static void buffer_free(cache_buffer_data *b)
+{
+     free(b->data);
+}
+
+
+
+static void put_bytes(cache_buffer_data *b, const void *p, size_t n)
+{
+     b->hash = hash_bytes(b->hash, p, n);
+
+     if (b->hash_only || n == 0)
+          return;
+
+     if (b->size + n > b->capacity) {
+          b->capacity = 2 * (b->size + n) + 256;
+          b->data = bindx_realloc(b->data, b->capacity);
+     }
+
+     memcpy(b->data + b->size, p, n);
+
+     b->size += n;
+}
+
+
+
+static void put_u64(cache_buffer_data *b, uint64_t value)
+{
+     int i;
+
+     unsigned char bytes[8];
+
+     for (i = 0; i < 8; ++i)
+          bytes[i] = (unsigned char) (value >> (8 * i));
+
+     put_bytes(b, bytes, 8);
+}
+
+
+
+static void put_int(cache_buffer_data *b, long value)
+{
+     put_u64(b, (uint64_t) value);
+}
+
+
+
+static void put_double(cache_buffer_data *b, double value)
+{
+     uint64_t bits;
+
+     memcpy(&bits, &value, sizeof(bits));
+
+     put_u64(b, bits);
+}
+
+
+
+static void put_string(cache_buffer_data *b, const char *s)
+{
+     size_t n;
+
+     if (s == NULL) {
+          put_u64(b, 0);
+          return;
+     }
+
+     n = strlen(s);
+
+     put_u64(b, n + 1);
+     put_bytes(b, s, n);
+}
+
+
+
+/*******************************************************************************
+ *
+ ******************************************************************************/
+static void get_bytes(cache_reader_data *r, void *p, size_t n)
+{
+     if (r->error || (size_t) (r->end - r->p) < n) {
+          r->error = 1;
+          memset(p, 0, n);
+          return;
+     }
+
+     memcpy(p, r->p, n);
+
+     r->p += n;
+}
+
+
+
+static uint64_t get_u64(cache_reader_data *r)
+{
+     int i;
+
+     unsigned char bytes[8];
+
+     uint64_t value = 0;
+
+     get_bytes(r, bytes, 8);
+
+     for (i = 0; i < 8; ++i)
+          value |= (uint64_t) bytes[i] << (8 * i);
+
+     return value;
+}
+
+
+
+static long get_int(cache_reader_data *r)
+{
+     return (long) (int64_t) get_u64(r);
+}
+
+
+
+static double get_double(cache_reader_data *r)
+{
+     double value;
+
+     uint64_t bits;
+
+     bits = get_u64(r);
+
+     memcpy(&value, &bits, sizeof(value));
+
+     return value;
+}
+
+
+
+static char *get_string(cache_reader_data *r)
+{
+     char *s;
+
+     uint64_t n;
+
+     n = get_u64(r);
+
+     if (n == 0 || r->error)
+          return NULL;
+
+     if ((uint64_t) (r->end - r->p) < n - 1) {
+          r->error = 1;
+          return NULL;
+     }
+
+     s = malloc(n);
+
+     get_bytes(r, s, n - 1);
+
+     s[n - 1] = '\0';
+
+     return s;
+}
+
+
+
+/*******************************************************************************
+ *
+ ******************************************************************************/
+static void put_type(cache_buffer_data *b, const type_data *d)
+{
+     int i;
+
+     put_int(b, d->type);
+     put_string(b, d->name);
+     put_int(b, d->rank);
+
+     for (i = 0; i < d->rank; ++i)
+          put_string(b, d->dimens[i]);
+}
+
+
+
+static void put_options(cache_buffer_data *b, const option_data *d)
+{
+     put_int(b, d->flags);
+     put_string(b, d->enum_external_type);
+     put_string(b, d->enum_external_class);
+     put_string(b, d->enum_name_to_value);
+     put_string(b, d->enum_index_to_mask);
+     put_string(b, d->enum_index_to_name);
+     put_string(b, d->enum_value_to_name);
+     put_int(b, d->align);
+}
+
+
+
+static void put_subprogram(cache_buffer_data *b, const bindx_data *d,
+                           const subprogram_data *subprogram)
+{
+     argument_data *argument;
+
+     put_int(b, bindx_subprogram_type(d, subprogram));
+     put_type(b, &subprogram->type);
+     put_string(b, subprogram->name);
+     put_int(b, subprogram->has_return_value);
+     put_int(b, subprogram->has_multi_dimen_args);
+     put_options(b, &subprogram->options);
+     put_int(b, list_count(subprogram->args));
+     list_for_each(subprogram->args, argument) {
+          put_type(b, &argument->type);
+          put_string(b, argument->name);
+          put_int(b, argument->usage);
+          put_options(b, &argument->options);
+     }
+}
+
+
+
+static void put_sections(cache_buffer_data *b, const bindx_data *d, int sections)
+{
+     enumeration_data *enumeration;
+     enum_member_data *enum_member;
+     global_const_data *global_const;
+     field_data *field;
+     structure_data *structure;
+     subprogram_data *subprogram;
+
+     if (sections & BINDX_CACHE_SECTION_MASK_HEADER) {
+          put_string(b, d->prefix);
+          put_string(b, d->include);
+          put_string(b, d->errors.err_ret_int);
+          put_string(b, d->errors.err_ret_dbl);
+          put_int(b, d->stats);
+          put_int(b, d->free_threaded);
+          put_int(b, d->limited_api);
+          put_int(b, d->async);
+     }
+
+     if (sections & BINDX_CACHE_SECTION_MASK_ENUMS) {
+          put_int(b, list_count(&d->enums));
+          list_for_each(&d->enums, enumeration) {
+               put_string(b, enumeration->name);
+               put_int(b, list_count(enumeration->members));
+               list_for_each(enumeration->members, enum_member) {
+                    put_string(b, enum_member->name);
+                    put_int(b, enum_member->value);
+               }
+          }
+     }
+
+     if (sections & BINDX_CACHE_SECTION_MASK_CONSTS) {
+          put_int(b, list_count(&d->consts));
+          list_for_each(&d->consts, global_const) {
+               put_type(b, &global_const->type);
+               put_string(b, global_const->name);
+               if (global_const->type.type == LEX_BINDX_TYPE_DOUBLE)
+                    put_double(b, global_const->lex_type.d);
+               else
+                    put_int(b, global_const->lex_type.l);
+          }
+     }
+
+     if (sections & BINDX_CACHE_SECTION_MASK_STRUCTS) {
+          put_int(b, list_count(&d->structs));
+          list_for_each(&d->structs, structure) {
+               put_string(b, structure->name);
+               put_int(b, structure->size);
+               put_int(b, list_count(structure->fields));
+               list_for_each(structure->fields, field) {
+                    put_type(b, &field->type);
+                    put_string(b, field->name);
+                    put_int(b, field->offset);
+               }
+          }
+     }
+
+     if (sections & BINDX_CACHE_SECTION_MASK_SUBPROGRAMS) {
+          put_int(b, list_count(&d->subs_all) + list_count(&d->subs_state) +
+                     list_count(&d->subs_clone));
+          list_for_each(&d->subs_all, subprogram)
+               put_subprogram(b, d, subprogram);
+          list_for_each(&d->subs_state, subprogram)
+               put_subprogram(b, d, subprogram);
+          list_for_each(&d->subs_clone, subprogram)
+               put_subprogram(b, d, subprogram);
+     }
+}
+
+
+
+/*******************************************************************************
+ *
+ ******************************************************************************/
+static type_data get_type(cache_reader_data *r)
+{
+     int i;
+
+     type_data type;
+
+     type.type = get_int(r);
+     type.name = get_string(r);
+     type.rank = get_int(r);
+
+     if (type.rank < 0 || type.rank > MAX_DIMENS) {
+          r->error = 1;
+          type.rank = 0;
+     }
+
+     for (i = 0; i < type.rank; ++i)
+          type.dimens[i] = get_string(r);
+
+     /* Built in type names are static strings, as set by parse_type(). */
+     switch(type.type) {
+          case LEX_BINDX_TYPE_VOID:
+               free(type.name);
+               type.name = "void";
+               break;
+          case LEX_BINDX_TYPE_CHAR:
+               free(type.name);
+               type.name = "char";
+               break;
+          case LEX_BINDX_TYPE_INT:
+               free(type.name);
+               type.name = "int";
+               break;
+          case LEX_BINDX_TYPE_INT64:
+               free(type.name);
+               type.name = "int64";
+               break;
+          case LEX_BINDX_TYPE_SIZE_T:
+               free(type.name);
+               type.name = "size_t";
+               break;
+          case LEX_BINDX_TYPE_FLOAT:
+               free(type.name);
+               type.name = "float";
+               break;
+          case LEX_BINDX_TYPE_DOUBLE:
+               free(type.name);
+               type.name = "double";
+               break;
+          case LEX_BINDX_TYPE_COMPLEX:
+               free(type.name);
+               type.name = "complex double";
+               break;
+          case LEX_BINDX_TYPE_ENUM:
+          case LEX_BINDX_TYPE_STRUCTURE:
+               break;
+          default:
+               r->error = 1;
+               type.type = LEX_BINDX_TYPE_VOID;
+               free(type.name);
+               type.name = "void";
+               break;
+     }
+
+     return type;
+}
+
+
+
+static option_data get_options(cache_reader_data *r)
+{
+     option_data options;
+
+     options.flags               = get_int(r);
+     options.enum_external_type  = get_string(r);
+     options.enum_external_class = get_string(r);
+     options.enum_name_to_value  = get_string(r);
+     options.enum_index_to_mask  = get_string(r);
+     options.enum_index_to_name  = get_string(r);
+     options.enum_value_to_name  = get_string(r);
+     options.align               = get_int(r);
+
+     return options;
+}
+
+
+
+static bindx_data *get_sections(cache_reader_data *r, locus_data *locus)
+{
+     int i;
+     int j;
+     int n;
+     int n2;
+     int sub_type;
+
+     bindx_data *d;
+
+     enumeration_data *enumeration;
+     enum_member_data *enum_member;
+     global_const_data *global_const;
+     field_data *field;
+     structure_data *structure;
+     subprogram_data *subprogram;
+     argument_data *argument;
+
+     d = malloc(sizeof(bindx_data));
+
+     bindx_init(d);
+
+     d->prefix = get_string(r);
+     if (d->prefix) {
+          d->PREFIX = strdup(d->prefix);
+          strtoupper(d->PREFIX, d->PREFIX);
+     }
+
+     d->include            = get_string(r);
+     d->errors.err_ret_int = get_string(r);
+     d->errors.err_ret_dbl = get_string(r);
+     d->stats              = get_int(r);
+     d->free_threaded      = get_int(r);
+     d->limited_api        = get_int(r);
+     d->async              = get_int(r);
+
+     n = get_int(r);
+     for (i = 0; i < n && ! r->error; ++i) {
+          enumeration = malloc(sizeof(enumeration_data));
+          enumeration->name = get_string(r);
+          enumeration->members = malloc(sizeof(enum_member_data));
+          list_init(enumeration->members);
+          n2 = get_int(r);
+          for (j = 0; j < n2 && ! r->error; ++j) {
+               enum_member = malloc(sizeof(enum_member_data));
+               enum_member->name  = get_string(r);
+               enum_member->value = get_int(r);
+               list_append(enumeration->members, enum_member, 0);
+          }
+          list_append(&d->enums, enumeration, 0);
+     }
+
+     n = get_int(r);
+     for (i = 0; i < n && ! r->error; ++i) {
+          global_const = malloc(sizeof(global_const_data));
+          global_const->type = get_type(r);
+          global_const->name = get_string(r);
+          if (global_const->type.type == LEX_BINDX_TYPE_DOUBLE)
+               global_const->lex_type.d = get_double(r);
+          else
+               global_const->lex_type.l = get_int(r);
+          list_append(&d->consts, global_const, 0);
+     }
+
+     n = get_int(r);
+     for (i = 0; i < n && ! r->error; ++i) {
+          structure = malloc(sizeof(structure_data));
+          structure->name = get_string(r);
+          structure->size = get_int(r);
+          structure->fields = malloc(sizeof(field_data));
+          list_init(structure->fields);
+          n2 = get_int(r);
+          for (j = 0; j < n2 && ! r->error; ++j) {
+               field = malloc(sizeof(field_data));
+               field->type   = get_type(r);
+               field->name   = get_string(r);
+               field->offset = get_int(r);
+               list_append(structure->fields, field, 0);
+          }
+          list_append(&d->structs, structure, 0);
+     }
+
+     n = get_int(r);
+     for (i = 0; i < n && ! r->error; ++i) {
+          subprogram = malloc(sizeof(subprogram_data));
+          sub_type                         = get_int(r);
+          subprogram->type                 = get_type(r);
+          subprogram->name                 = get_string(r);
+          subprogram->has_return_value     = get_int(r);
+          subprogram->has_multi_dimen_args = get_int(r);
+          subprogram->options              = get_options(r);
+          subprogram->n_dimens             = 0;
+          subprogram->dimens               = NULL;
+          subprogram->args = malloc(sizeof(argument_data));
+          list_init(subprogram->args);
+          n2 = get_int(r);
+          for (j = 0; j < n2 && ! r->error; ++j) {
+               argument = malloc(sizeof(argument_data));
+               argument->type    = get_type(r);
+               argument->name    = get_string(r);
+               argument->usage   = get_int(r);
+               argument->options = get_options(r);
+               list_append(subprogram->args, argument, 0);
+          }
+          if (r->error || subprogram->name == NULL ||
+              sub_type < SUBPROGRAM_TYPE_GENERAL || sub_type > SUBPROGRAM_TYPE_CLONE) {
+               r->error = 1;
+               bindx_free_subprogram(subprogram);
+               free(subprogram);
+               break;
+          }
+          bindx_add_subprogram(d, sub_type, subprogram, locus);
+     }
+
+     return d;
+}
+
+
+
+/*******************************************************************************
+ *
+ ******************************************************************************/
+int bindx_cache_hash_file(const char *file, uint64_t *hash)
+{
+     unsigned char buffer[4096];
+
+     size_t n;
+
+     FILE *fp;
+
+     if ((fp = fopen(file, "rb")) == NULL) {
+          fprintf(stderr, "ERROR: Problem opening file for reading: %s ... %s\n",
+                  file, strerror(errno));
+          return -1;
+     }
+
+     *hash = FNV_OFFSET_BASIS;
+
+     while ((n = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+          *hash = hash_bytes(*hash, buffer, n);
+
+     fclose(fp);
+
+     return 0;
+}
+
+
+
+/*******************************************************************************
+ *
+ ******************************************************************************/
+static void cache_discard(bindx_cache_data *c)
+{
+     int i;
+
+     for (i = 0; i < c->n_files; ++i)
+          free(c->files[i].file);
+
+     for (i = 0; i < c->n_back_ends; ++i)
+          free(c->back_ends[i].tag);
+
+     free(c->data);
+
+     c->data        = NULL;
+     c->size        = 0;
+     c->n_files     = 0;
+     c->n_back_ends = 0;
+}
+
+
+
+static int cache_read(bindx_cache_data *c)
+{
+     char magic[8];
+     char *version;
+
+     size_t length;
+
+     uint64_t n;
+
+     cache_reader_data r;
+
+     r.p     = c->data;
+     r.end   = c->data + c->size;
+     r.error = 0;
+
+     get_bytes(&r, magic, 8);
+     if (r.error || memcmp(magic, cache_magic, 8) != 0)
+          return -1;
+
+     if (get_u64(&r) != BINDX_CACHE_FORMAT)
+          return -1;
+
+     version = get_string(&r);
+     if (r.error || version == NULL || strcmp(version, bindx_version()) != 0) {
+          free(version);
+          return -1;
+     }
+     free(version);
+
+     n = get_u64(&r);
+     if (n > BINDX_CACHE_MAX_FILES)
+          return -1;
+
+     for ( ; c->n_files < (int) n && ! r.error; c->n_files++) {
+          c->files[c->n_files].file   = get_string(&r);
+          c->files[c->n_files].hash   = get_u64(&r);
+          length                      = get_u64(&r);
+          c->files[c->n_files].offset = r.p - c->data;
+          c->files[c->n_files].length = length;
+          if ((size_t) (r.end - r.p) < length)
+               r.error = 1;
+          else
+               r.p += length;
+     }
+
+     n = get_u64(&r);
+     if (n > BINDX_CACHE_MAX_BACK_ENDS)
+          return -1;
+
+     for ( ; c->n_back_ends < (int) n && ! r.error; c->n_back_ends++) {
+          c->back_ends[c->n_back_ends].tag         = get_string(&r);
+          c->back_ends[c->n_back_ends].fingerprint = get_u64(&r);
+     }
+
+     if (r.error || r.p != r.end)
+          return -1;
+
+     return 0;
+}
+
+
+
+/*******************************************************************************
+ * Load the cache file, if there is one.  A missing, corrupt or out of date
+ * cache is not an error, it is simply ignored and rewritten on close.
+ ******************************************************************************/
+int bindx_cache_open(bindx_cache_data *c, const char *name)
+{
+     long size;
+
+     FILE *fp;
+
+     c->name        = name;
+     c->data        = NULL;
+     c->size        = 0;
+     c->n_files     = 0;
+     c->n_back_ends = 0;
+
+     c->n_files_out = 0;
+     buffer_init(&c->files_out, 0);
+
+     c->n_back_ends_out = 0;
+     buffer_init(&c->back_ends_out, 0);
+
+     if ((fp = fopen(name, "rb")) == NULL)
+          return 0;
+
+     if (fseek(fp, 0, SEEK_END) != 0 || (size = ftell(fp)) < 0 ||
+         fseek(fp, 0, SEEK_SET) != 0) {
+          fclose(fp);
+          return 0;
+     }
+
+     c->size = size;
+     c->data = malloc(c->size + 1);
+
+     if (fread(c->data, 1, c->size, fp) != c->size) {
+          fclose(fp);
+          cache_discard(c);
+          return 0;
+     }
+
+     fclose(fp);
+
+     if (cache_read(c))
+          cache_discard(c);
+
+     return 0;
+}
+
+
+
+/*******************************************************************************
+ * Return the IR for the given input file from the cache if the file's contents
+ * are unchanged, otherwise NULL.
+ ******************************************************************************/
+bindx_data *bindx_cache_load_file(bindx_cache_data *c, const char *file,
+                                  uint64_t hash, locus_data *locus)
+{
+     int i;
+
+     bindx_data *d;
+
+     cache_reader_data r;
+
+     for (i = 0; i < c->n_files; ++i) {
+          if (c->files[i].hash == hash && c->files[i].file &&
+              strcmp(c->files[i].file, file) == 0)
+               break;
+     }
+
+     if (i == c->n_files)
+          return NULL;
+
+     r.p     = c->data + c->files[i].offset;
+     r.end   = r.p + c->files[i].length;
+     r.error = 0;
+
+     d = get_sections(&r, locus);
+
+     if (r.error || r.p != r.end) {
+          bindx_free(d);
+          free(d);
+          return NULL;
+     }
+
+     return d;
+}
+
+
+
+/*******************************************************************************
+ * Record the IR parsed from the given input file in the new cache.
+ ******************************************************************************/
+void bindx_cache_add_file(bindx_cache_data *c, const char *file, uint64_t hash,
+                          const bindx_data *d)
+{
+     cache_buffer_data b;
+
+     if (c->n_files_out == BINDX_CACHE_MAX_FILES)
+          return;
+
+     buffer_init(&b, 0);
+
+     put_sections(&b, d, BINDX_CACHE_SECTION_MASK_ALL);
+
+     put_string(&c->files_out, file);
+     put_u64   (&c->files_out, hash);
+     put_u64   (&c->files_out, b.size);
+     put_bytes (&c->files_out, b.data, b.size);
+
+     buffer_free(&b);
+
+     c->n_files_out++;
+}
+
+
+
+/*******************************************************************************
+ * Fingerprint the IR sections, name and output files used by a back-end and
+ * record it in the new cache.  Returns 1 if the back-end needs to be run, that
+ * is if the fingerprint differs from the last run or an output is missing,
+ * otherwise 0.
+ ******************************************************************************/
+int bindx_cache_back_end(bindx_cache_data *c, const bindx_data *d, const char *tag,
+                         int sections, const char *name, int n_out_files,
+                         char **out_files)
+{
+     int i;
+
+     cache_buffer_data b;
+
+     FILE *fp;
+
+     buffer_init(&b, 1);
+
+     put_string(&b, tag);
+     put_string(&b, name);
+     put_int(&b, n_out_files);
+     for (i = 0; i < n_out_files; ++i)
+          put_string(&b, out_files[i]);
+     put_sections(&b, d, sections);
+
+     if (c->n_back_ends_out < BINDX_CACHE_MAX_BACK_ENDS) {
+          put_string(&c->back_ends_out, tag);
+          put_u64   (&c->back_ends_out, b.hash);
+          c->n_back_ends_out++;
+     }
+
+     for (i = 0; i < c->n_back_ends; ++i) {
+          if (c->back_ends[i].tag && strcmp(c->back_ends[i].tag, tag) == 0)
+               break;
+     }
+
+     if (i == c->n_back_ends || c->back_ends[i].fingerprint != b.hash)
+          return 1;
+
+     for (i = 0; i < n_out_files; ++i) {
+          if ((fp = fopen(out_files[i], "r")) == NULL)
+               return 1;
+          fclose(fp);
+     }
+
+     return 0;
+}
+
+
+
+/*******************************************************************************
+ * Write the new cache, replacing the old one only if it changed, and free the
+ * cache.
+ ******************************************************************************/
+int bindx_cache_close(bindx_cache_data *c)
+{
+     int r;
+
+     cache_buffer_data b;
+
+     buffer_init(&b, 0);
+
+     put_bytes (&b, cache_magic, 8);
+     put_u64   (&b, BINDX_CACHE_FORMAT);
+     put_string(&b, bindx_version());
+     put_u64   (&b, c->n_files_out);
+     put_bytes (&b, c->files_out.data, c->files_out.size);
+     put_u64   (&b, c->n_back_ends_out);
+     put_bytes (&b, c->back_ends_out.data, c->back_ends_out.size);
+
+     r = bindx_file_update(c->name, (const char *) b.data, b.size, 1);
+
+     buffer_free(&b);
+     buffer_free(&c->files_out);
+     buffer_free(&c->back_ends_out);
+
+     cache_discard(c);
+
+     return r;
+}
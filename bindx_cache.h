@@ -0,0 +1,86 @@
+/*******************************************************************************
+**
+**    Copyright (C) 2011-2018 Greg McGarragh <greg.mcgarragh@colostate.edu>
+**
+**    This source code is licensed under the GNU General Public License (GPL),
+**    Version 3.  See the file COPYING for more details.
+**
+*******************************************************************************/
+
+#ifndef BINDX_CACHE_H
+#define BINDX_CACHE_H
+
+#include "bindx_parse_int.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#define BINDX_CACHE_FORMAT 8
+
+#define BINDX_CACHE_MAX_FILES     64
+#define BINDX_CACHE_MAX_BACK_ENDS 16
+
+
+enum bindx_cache_section_mask {
+     BINDX_CACHE_SECTION_MASK_HEADER      = (1<<0),
+     BINDX_CACHE_SECTION_MASK_ENUMS       = (1<<1),
+     BINDX_CACHE_SECTION_MASK_CONSTS      = (1<<2),
+     BINDX_CACHE_SECTION_MASK_STRUCTS     = (1<<3),
+     BINDX_CACHE_SECTION_MASK_SUBPROGRAMS = (1<<4),
+     BINDX_CACHE_SECTION_MASK_ALL         = (1<<5) - 1
+};
+
+
+typedef struct {
+     int hash_only;
+     unsigned char *data;
+     size_t size;
+     size_t capacity;
+     uint64_t hash;
+} cache_buffer_data;
+
+
+typedef struct {
+     char *file;
+     uint64_t hash;
+     size_t offset;
+     size_t length;
+} cache_file_data;
+
+
+typedef struct {
+     char *tag;
+     uint64_t fingerprint;
+} cache_back_end_data;
+
+
+typedef struct {
+     const char *name;
+
+     unsigned char *data;
+     size_t size;
+
+     int n_files;
+     cache_file_data files[BINDX_CACHE_MAX_FILES];
+
+     int n_back_ends;
+     cache_back_end_data back_ends[BINDX_CACHE_MAX_BACK_ENDS];
+
+     int n_files_out;
+     cache_buffer_data files_out;
+
+     int n_back_ends_out;
+     cache_buffer_data back_ends_out;
+} bindx_cache_data;
+
+
+#include "prototypes/bindx_cache_p.h"
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BINDX_CACHE_H */
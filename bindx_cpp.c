@@ -16,26 +16,38 @@
 #include "bindx_util.h"
 
 
-static int write_type(FILE *fp, const type_data *d, const char *name)
+static int write_type(bindx_buffer_data *fp, const type_data *d, const char *name)
 {
      switch(d->type) {
           case LEX_BINDX_TYPE_ENUM:
                if (! name)
-                    fprintf(fp, "%s", d->name);
+                    bxprintf(fp, "%s", d->name);
                else
-                    fprintf(fp, "%s::%s", name, d->name);
+                    bxprintf(fp, "%s::%s", name, d->name);
                break;
           case LEX_BINDX_TYPE_CHAR:
-               fprintf(fp, "char");
+               bxprintf(fp, "char");
                break;
           case LEX_BINDX_TYPE_INT:
-               fprintf(fp, "int");
+               bxprintf(fp, "int");
+               break;
+          case LEX_BINDX_TYPE_INT64:
+               bxprintf(fp, "int64_t");
+               break;
+          case LEX_BINDX_TYPE_SIZE_T:
+               bxprintf(fp, "size_t");
+               break;
+          case LEX_BINDX_TYPE_FLOAT:
+               bxprintf(fp, "float");
                break;
           case LEX_BINDX_TYPE_DOUBLE:
-               fprintf(fp, "double");
+               bxprintf(fp, "double");
+               break;
+          case LEX_BINDX_TYPE_COMPLEX:
+               bxprintf(fp, "dcomplex");
                break;
           case LEX_BINDX_TYPE_STRUCTURE:
-               fprintf(fp, "%s", d->name);
+               bxprintf(fp, "%s", d->name);
                break;
           default:
                INTERNAL_ERROR("Invalid lex_bindx_type value: %d", d->type);
@@ -47,42 +59,42 @@ static int write_type(FILE *fp, const type_data *d, const char *name)
 
 
 
-static int write_dimens_args(FILE *fp, const bindx_data *d, const type_data *type,
-                             enum lex_subprogram_argument_usage usage)
+static int write_dimens_args(bindx_buffer_data *fp, const bindx_data *d,
+                             const argument_data *argument)
 {
-     return bindx_write_c_dimens_args(fp, d, type, usage);
+     return bindx_write_c_argument_dimens_args(fp, d, argument);
 }
 
 
 
-static int write_dimens_return(FILE *fp, const bindx_data *d, const type_data *type)
+static int write_dimens_return(bindx_buffer_data *fp, const bindx_data *d, const type_data *type)
 {
      return bindx_write_c_dimens_return(fp, d, type);
 }
 
 
 
-static int write_enumerations(FILE *fp, const bindx_data *d,
+static int write_enumerations(bindx_buffer_data *fp, const bindx_data *d,
                               const enumeration_data *enums, int indent)
 {
      enum_member_data *enum_member;
      enumeration_data *enumeration;
 
      list_for_each(enums, enumeration) {
-          fprintf(fp, "%senum %s {\n", bxis(indent), enumeration->name);
+          bxprintf(fp, "%senum %s {\n", bxis(indent), enumeration->name);
 
           list_for_each(enumeration->members, enum_member) {
-               fprintf(fp, "%s%s = %s_%s", bxis(indent + 1), enum_member->name,
-                       d->PREFIX, enum_member->name);
+               bxprintf(fp, "%s%s = %s_%s", bxis(indent + 1), enum_member->name,
+                        d->PREFIX, enum_member->name);
 
                if (! list_is_last_elem(enumeration->members, enum_member))
-                    fprintf(fp, ",");
-               fprintf(fp, "\n");
+                    bxprintf(fp, ",");
+               bxprintf(fp, "\n");
           }
 
-          fprintf(fp, "%s};\n", bxis(indent));
+          bxprintf(fp, "%s};\n", bxis(indent));
 
-          fprintf(fp, "\n");
+          bxprintf(fp, "\n");
      }
 
      return 0;
@@ -90,7 +102,115 @@ static int write_enumerations(FILE *fp, const bindx_data *d,
 
 
 
-static int write_prototypes(FILE *fp, const bindx_data *d,
+/*
+ * Compile time name/value tables for each enumeration.  Names are the member
+ * names as given in the interface definition and are compared without regard
+ * to case.  With C++20 the consteval forms reject an unknown name at compile
+ * time.
+ */
+static int write_enumeration_tables(bindx_buffer_data *fp, const bindx_data *d,
+                                    const enumeration_data *enums, int indent)
+{
+     enum_member_data *enum_member;
+     enumeration_data *enumeration;
+
+     if (list_is_empty(enums))
+          return 0;
+
+     bxprintf(fp, "#if __cplusplus >= 201703L\n");
+     bxprintf(fp, "%sstatic constexpr bool enum_name_equal(const char *a, const char *b)\n", bxis(indent));
+     bxprintf(fp, "%s{\n", bxis(indent));
+     bxprintf(fp, "%sfor ( ; *a != '\\0' && *b != '\\0'; ++a, ++b) {\n", bxis(indent + 1));
+     bxprintf(fp, "%sif ((*a >= 'a' && *a <= 'z' ? *a - 'a' + 'A' : *a) !=\n", bxis(indent + 2));
+     bxprintf(fp, "%s    (*b >= 'a' && *b <= 'z' ? *b - 'a' + 'A' : *b))\n", bxis(indent + 2));
+     bxprintf(fp, "%sreturn false;\n", bxis(indent + 3));
+     bxprintf(fp, "%s}\n", bxis(indent + 1));
+     bxprintf(fp, "%sreturn *a == *b;\n", bxis(indent + 1));
+     bxprintf(fp, "%s}\n", bxis(indent));
+     bxprintf(fp, "\n");
+
+     list_for_each(enums, enumeration) {
+          bxprintf(fp, "%sstatic constexpr int %s_n = %d;\n", bxis(indent),
+                   enumeration->name, list_count(enumeration->members));
+
+          bxprintf(fp, "%sstatic constexpr const char *%s_names[] = {", bxis(indent), enumeration->name);
+          list_for_each(enumeration->members, enum_member) {
+               bxprintf(fp, "\"%s\"", enum_member->name);
+               if (! list_is_last_elem(enumeration->members, enum_member))
+                    bxprintf(fp, ", ");
+          }
+          bxprintf(fp, "};\n");
+
+          bxprintf(fp, "%sstatic constexpr %s %s_values[] = {", bxis(indent),
+                   enumeration->name, enumeration->name);
+          list_for_each(enumeration->members, enum_member) {
+               bxprintf(fp, "%s", enum_member->name);
+               if (! list_is_last_elem(enumeration->members, enum_member))
+                    bxprintf(fp, ", ");
+          }
+          bxprintf(fp, "};\n");
+
+          bxprintf(fp, "%sstatic constexpr int %s_name_to_value(const char *name)\n", bxis(indent), enumeration->name);
+          bxprintf(fp, "%s{\n", bxis(indent));
+          bxprintf(fp, "%sfor (int i = 0; i < %s_n; ++i) {\n", bxis(indent + 1), enumeration->name);
+          bxprintf(fp, "%sif (enum_name_equal(name, %s_names[i]))\n", bxis(indent + 2), enumeration->name);
+          bxprintf(fp, "%sreturn %s_values[i];\n", bxis(indent + 3), enumeration->name);
+          bxprintf(fp, "%s}\n", bxis(indent + 1));
+          bxprintf(fp, "%sreturn -1;\n", bxis(indent + 1));
+          bxprintf(fp, "%s}\n", bxis(indent));
+
+          bxprintf(fp, "%sstatic constexpr const char *%s_value_to_name(%s value)\n", bxis(indent),
+                   enumeration->name, enumeration->name);
+          bxprintf(fp, "%s{\n", bxis(indent));
+          bxprintf(fp, "%sfor (int i = 0; i < %s_n; ++i) {\n", bxis(indent + 1), enumeration->name);
+          bxprintf(fp, "%sif (%s_values[i] == value)\n", bxis(indent + 2), enumeration->name);
+          bxprintf(fp, "%sreturn %s_names[i];\n", bxis(indent + 3), enumeration->name);
+          bxprintf(fp, "%s}\n", bxis(indent + 1));
+          bxprintf(fp, "%sreturn nullptr;\n", bxis(indent + 1));
+          bxprintf(fp, "%s}\n", bxis(indent));
+
+          bxprintf(fp, "%sstatic constexpr int %s_names_to_mask(std::initializer_list<const char *> names)\n",
+                   bxis(indent), enumeration->name);
+          bxprintf(fp, "%s{\n", bxis(indent));
+          bxprintf(fp, "%sint mask = 0;\n", bxis(indent + 1));
+          bxprintf(fp, "%sfor (const char *name : names) {\n", bxis(indent + 1));
+          bxprintf(fp, "%sint value = %s_name_to_value(name);\n", bxis(indent + 2), enumeration->name);
+          bxprintf(fp, "%sif (value < 0)\n", bxis(indent + 2));
+          bxprintf(fp, "%sreturn -1;\n", bxis(indent + 3));
+          bxprintf(fp, "%smask |= value;\n", bxis(indent + 2));
+          bxprintf(fp, "%s}\n", bxis(indent + 1));
+          bxprintf(fp, "%sreturn mask;\n", bxis(indent + 1));
+          bxprintf(fp, "%s}\n", bxis(indent));
+
+          bxprintf(fp, "#if __cplusplus >= 202002L\n");
+          bxprintf(fp, "%sstatic consteval %s %s_parse(const char *name)\n", bxis(indent),
+                   enumeration->name, enumeration->name);
+          bxprintf(fp, "%s{\n", bxis(indent));
+          bxprintf(fp, "%sif (%s_name_to_value(name) < 0)\n", bxis(indent + 1), enumeration->name);
+          bxprintf(fp, "%sthrow \"invalid %s name\";\n", bxis(indent + 2), enumeration->name);
+          bxprintf(fp, "%sreturn (%s) %s_name_to_value(name);\n", bxis(indent + 1),
+                   enumeration->name, enumeration->name);
+          bxprintf(fp, "%s}\n", bxis(indent));
+          bxprintf(fp, "%sstatic consteval int %s_mask(std::initializer_list<const char *> names)\n",
+                   bxis(indent), enumeration->name);
+          bxprintf(fp, "%s{\n", bxis(indent));
+          bxprintf(fp, "%sif (%s_names_to_mask(names) < 0)\n", bxis(indent + 1), enumeration->name);
+          bxprintf(fp, "%sthrow \"invalid %s name\";\n", bxis(indent + 2), enumeration->name);
+          bxprintf(fp, "%sreturn %s_names_to_mask(names);\n", bxis(indent + 1), enumeration->name);
+          bxprintf(fp, "%s}\n", bxis(indent));
+          bxprintf(fp, "#endif\n");
+
+          bxprintf(fp, "\n");
+     }
+
+     bxprintf(fp, "#endif\n");
+
+     return 0;
+}
+
+
+
+static int write_prototypes(bindx_buffer_data *fp, const bindx_data *d,
                             enum subprogram_type sub_type,
                             const subprogram_data *subs,
                             const char *name, int indent)
@@ -99,13 +219,16 @@ static int write_prototypes(FILE *fp, const bindx_data *d,
      subprogram_data *subprogram;
 
      list_for_each(subs, subprogram) {
-          fprintf(fp, "%s", bxis(indent));
+          bxprintf(fp, "%s", bxis(indent));
 
           if (sub_type == SUBPROGRAM_TYPE_INIT)
-               fprintf(fp, "%s(", name);
+               bxprintf(fp, "%s(", name);
           else
           if (sub_type == SUBPROGRAM_TYPE_FREE)
-               fprintf(fp, "~%s(", name);
+               bxprintf(fp, "~%s(", name);
+          else
+          if (sub_type == SUBPROGRAM_TYPE_CLONE)
+               bxprintf(fp, "%s(const %s &src", name, name);
           else {
                if (subprogram->has_return_value ||
                    subprogram_n_scaler_out_args(subprogram) == 1) {
@@ -113,8 +236,8 @@ static int write_prototypes(FILE *fp, const bindx_data *d,
                     write_dimens_return(fp, d, &subprogram->type);
                }
                else
-                    fprintf(fp, "void");
-               fprintf(fp, " %s(", subprogram->name);
+                    bxprintf(fp, "void");
+               bxprintf(fp, " %s(", subprogram->name);
           }
 
           list_for_each(subprogram->args, argument) {
@@ -122,14 +245,16 @@ static int write_prototypes(FILE *fp, const bindx_data *d,
                     write_type(fp, &argument->type, argument->options.enum_external_class);
                else
                     write_type(fp, &argument->type, NULL);
-               fprintf(fp, " ");
-               write_dimens_args(fp, d, &argument->type, argument->usage);
-               fprintf(fp, "%s", argument->name);
+               bxprintf(fp, " ");
+               write_dimens_args(fp, d, argument);
+               bxprintf(fp, "%s", argument->name);
+               if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_STRIDED)
+                    bxprintf(fp, ", const ptrdiff_t *%s_strides", argument->name);
                if (! list_is_last_elem(subprogram->args, argument))
-                    fprintf(fp, ", ");
+                    bxprintf(fp, ", ");
           }
 
-          fprintf(fp, ");\n");
+          bxprintf(fp, ");\n");
      }
 
      return 0;
@@ -137,22 +262,30 @@ static int write_prototypes(FILE *fp, const bindx_data *d,
 
 
 
-static int write_subprograms(FILE *fp, const bindx_data *d,
+static int write_subprograms(bindx_buffer_data *fp, const bindx_data *d,
                              enum subprogram_type sub_type,
                              const subprogram_data *subs,
                              const char *name, int indent)
 {
+     int stats;
+     int i_stats = 0;
+
      argument_data *argument;
      subprogram_data *subprogram;
 
+     stats = d->stats && sub_type == SUBPROGRAM_TYPE_GENERAL;
+
      list_for_each(subs, subprogram) {
-          fprintf(fp, "%s", bxis(indent));
+          bxprintf(fp, "%s", bxis(indent));
 
           if (sub_type == SUBPROGRAM_TYPE_INIT)
-               fprintf(fp, "%s::%s(", name, name);
+               bxprintf(fp, "%s::%s(", name, name);
           else
           if (sub_type == SUBPROGRAM_TYPE_FREE)
-               fprintf(fp, "%s::~%s(", name, name);
+               bxprintf(fp, "%s::~%s(", name, name);
+          else
+          if (sub_type == SUBPROGRAM_TYPE_CLONE)
+               bxprintf(fp, "%s::%s(const %s &src", name, name, name);
           else {
                if (subprogram->has_return_value ||
                    subprogram_n_scaler_out_args(subprogram) == 1) {
@@ -160,8 +293,8 @@ static int write_subprograms(FILE *fp, const bindx_data *d,
                     write_dimens_return(fp, d, &subprogram->type);
                }
                else
-                    fprintf(fp, "void");
-               fprintf(fp, " %s::%s(", name, subprogram->name);
+                    bxprintf(fp, "void");
+               bxprintf(fp, " %s::%s(", name, subprogram->name);
           }
 
           list_for_each(subprogram->args, argument) {
@@ -169,65 +302,90 @@ static int write_subprograms(FILE *fp, const bindx_data *d,
                     write_type(fp, &argument->type, argument->options.enum_external_class);
                else
                     write_type(fp, &argument->type, name);
-               fprintf(fp, " ");
-               write_dimens_args(fp, d, &argument->type, argument->usage);
-               fprintf(fp, "%s", argument->name);
+               bxprintf(fp, " ");
+               write_dimens_args(fp, d, argument);
+               bxprintf(fp, "%s", argument->name);
+               if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_STRIDED)
+                    bxprintf(fp, ", const ptrdiff_t *%s_strides", argument->name);
                if (! list_is_last_elem(subprogram->args, argument))
-                    fprintf(fp, ", ");
+                    bxprintf(fp, ", ");
           }
 
-          fprintf(fp, ")\n");
-          fprintf(fp, "{\n");
+          bxprintf(fp, ")\n");
+          bxprintf(fp, "{\n");
 
           indent++;
 
-          fprintf(fp, "%s", bxis(indent));
-          bindx_write_c_type(fp, d, &subprogram->type, NULL);
-          fprintf(fp, " r;\n");
+          bxprintf(fp, "%s", bxis(indent));
+          bindx_write_c_declaration(fp, d, &subprogram->type, NULL);
+          bxprintf(fp, "r;\n");
+
+          if (stats) {
+               bindx_write_c_stats_declaration(fp, d, indent);
+               bindx_write_c_stats_time(fp, d, 0, i_stats, indent);
+               bindx_write_c_stats_time(fp, d, 1, i_stats, indent);
+          }
+
+          if (sub_type == SUBPROGRAM_TYPE_CLONE)
+               bxprintf(fp, "%smemset(&d, 0, sizeof(d));\n", bxis(indent));
+
+          bxprintf(fp, "%sr = %s_%s(&d", bxis(indent), d->prefix, subprogram->name);
 
-          fprintf(fp, "%sr = %s_%s(&d", bxis(indent), d->prefix, subprogram->name);
+          if (sub_type == SUBPROGRAM_TYPE_CLONE)
+               bxprintf(fp, ", (%s_data *) &src.d", d->prefix);
 
           list_for_each(subprogram->args, argument) {
-               fprintf(fp, ", ");
+               bxprintf(fp, ", ");
                if (argument->type.type == LEX_BINDX_TYPE_ENUM) {
                     if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_ENUM_EXTERNAL)
-                         fprintf(fp, "(enum %s_%s", argument->options.enum_external_type,
-                                                    argument->type.name);
+                         bxprintf(fp, "(enum %s_%s", argument->options.enum_external_type,
+                                                     argument->type.name);
                     else
-                         fprintf(fp, "(enum %s_%s", d->prefix, argument->type.name);
+                         bxprintf(fp, "(enum %s_%s", d->prefix, argument->type.name);
                     if (argument->type.rank > 0)
-                         fprintf(fp, " ");
-                    write_dimens_args(fp, d, &argument->type, argument->usage);
-                    fprintf(fp, ") ");
+                         bxprintf(fp, " ");
+                    write_dimens_args(fp, d, argument);
+                    bxprintf(fp, ") ");
                }
-               fprintf(fp, "%s", argument->name);
+               bxprintf(fp, "%s", argument->name);
+               if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_STRIDED)
+                    bxprintf(fp, ", %s_strides", argument->name);
           }
 
-          fprintf(fp, ");\n");
+          bxprintf(fp, ");\n");
 
-          fprintf(fp, "%sif (r == %s)\n", bxis(indent),
-                  bindx_c_error_conditional(d, subprogram->type.type));
+          if (stats)
+               bindx_write_c_stats_time(fp, d, 2, i_stats, indent);
+
+          if (subprogram->type.rank > 0)
+               bxprintf(fp, "%sif (r == NULL)\n", bxis(indent));
+          else
+               bxprintf(fp, "%sif (r == %s)\n", bxis(indent),
+                        bindx_c_error_conditional(d, subprogram->type.type));
           indent++;
-          fprintf(fp, "%sthrow %s::ERROR;\n", bxis(indent), name);
+          bxprintf(fp, "%sthrow %s::ERROR;\n", bxis(indent), name);
           indent--;
 
+          if (stats)
+               bindx_write_c_stats_time(fp, d, 3, i_stats++, indent);
+
           if (subprogram->has_return_value ||
               subprogram_n_scaler_out_args(subprogram) == 1) {
-               fprintf(fp, "%sreturn ", bxis(indent));
+               bxprintf(fp, "%sreturn ", bxis(indent));
                if (subprogram->type.type == LEX_BINDX_TYPE_ENUM) {
-                    fprintf(fp, "(");
+                    bxprintf(fp, "(");
                     write_type(fp, &subprogram->type, name);
-                    fprintf(fp, ") ");
+                    bxprintf(fp, ") ");
                }
-               fprintf(fp, "r;\n");
+               bxprintf(fp, "r;\n");
           }
 
           indent--;
 
-          fprintf(fp, "}\n");
+          bxprintf(fp, "}\n");
 
-          fprintf(fp, "\n");
-          fprintf(fp, "\n");
+          bxprintf(fp, "\n");
+          bxprintf(fp, "\n");
      }
 
      return 0;
@@ -235,61 +393,699 @@ static int write_subprograms(FILE *fp, const bindx_data *d,
 
 
 
-int bindx_write_cpp(FILE **fp, const bindx_data *d, const char *name)
+/*
+ * With a clone subprogram, assignment clones the source into a new instance
+ * before freeing the old one.  Without one, the implicit member-wise copy and
+ * assignment would leave two objects freeing the same instance, so both are
+ * disabled.
+ */
+static int write_assignment_prototype(bindx_buffer_data *fp, const bindx_data *d,
+                                      const char *name)
+{
+     if (bindx_clone_subprogram(d)) {
+          bxprintf(fp, "     %s &operator=(const %s &src);\n", name, name);
+          return 0;
+     }
+
+     bxprintf(fp, "#if __cplusplus >= 201103L\n");
+     bxprintf(fp, "     %s(const %s &src) = delete;\n", name, name);
+     bxprintf(fp, "     %s &operator=(const %s &src) = delete;\n", name, name);
+     bxprintf(fp, "#else\n");
+     bxprintf(fp, "private:\n");
+     bxprintf(fp, "     %s(const %s &src);\n", name, name);
+     bxprintf(fp, "     %s &operator=(const %s &src);\n", name, name);
+     bxprintf(fp, "public:\n");
+     bxprintf(fp, "#endif\n");
+
+     return 0;
+}
+
+
+
+static int write_assignment_subprogram(bindx_buffer_data *fp, const bindx_data *d,
+                                       const char *name)
+{
+     const subprogram_data *clone;
+     const subprogram_data *free_sub;
+
+     clone = bindx_clone_subprogram(d);
+     if (clone == NULL)
+          return 0;
+
+     free_sub = (subprogram_data *) d->subs_free.next;
+
+     bxprintf(fp, "%s &%s::operator=(const %s &src)\n", name, name, name);
+     bxprintf(fp, "{\n");
+     bxprintf(fp, "     int r;\n");
+     bxprintf(fp, "     %s_data d2;\n", d->prefix);
+     bxprintf(fp, "\n");
+     bxprintf(fp, "     if (this == &src)\n");
+     bxprintf(fp, "          return *this;\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "     memset(&d2, 0, sizeof(d2));\n");
+     bxprintf(fp, "     r = %s_%s(&d2, (%s_data *) &src.d);\n", d->prefix, clone->name, d->prefix);
+     bxprintf(fp, "     if (r == %s)\n", bindx_c_error_conditional(d, clone->type.type));
+     bxprintf(fp, "          throw %s::ERROR;\n", name);
+     bxprintf(fp, "\n");
+     bxprintf(fp, "     %s_%s(&d);\n", d->prefix, free_sub->name);
+     bxprintf(fp, "     d = d2;\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "     return *this;\n");
+     bxprintf(fp, "}\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+     return 0;
+}
+
+
+
+/*
+ * The snapshot and restore subprograms become a member returning the state as a
+ * std::vector<char> and a constructor that rebuilds an instance from one.
+ */
+static int write_state_prototypes(bindx_buffer_data *fp, const bindx_data *d,
+                                  const char *name)
+{
+     const subprogram_data *snapshot;
+
+     snapshot = bindx_snapshot_subprogram(d);
+     if (snapshot == NULL)
+          return 0;
+
+     bxprintf(fp, "\n");
+     bxprintf(fp, "     explicit %s(const std::vector<char> &state);\n", name);
+     bxprintf(fp, "     std::vector<char> %s();\n", snapshot->name);
+
+     return 0;
+}
+
+
+
+static int write_state_subprograms(bindx_buffer_data *fp, const bindx_data *d,
+                                   const char *name)
+{
+     const argument_data *argument;
+     const subprogram_data *snapshot;
+     const subprogram_data *restore;
+
+     snapshot = bindx_snapshot_subprogram(d);
+     restore  = bindx_restore_subprogram(d);
+     if (snapshot == NULL)
+          return 0;
+
+     bxprintf(fp, "%s::%s(const std::vector<char> &state)\n", name, name);
+     bxprintf(fp, "{\n");
+     bxprintf(fp, "     int r;\n");
+     bxprintf(fp, "     memset(&d, 0, sizeof(d));\n");
+     bxprintf(fp, "     r = %s_%s(&d, state.size(), (char *) state.data());\n", d->prefix, restore->name);
+     bxprintf(fp, "     if (r == %s)\n", bindx_c_error_conditional(d, restore->type.type));
+     bxprintf(fp, "          throw %s::ERROR;\n", name);
+     bxprintf(fp, "}\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+     argument = (argument_data *) snapshot->args->next;
+
+     bxprintf(fp, "std::vector<char> %s::%s()\n", name, snapshot->name);
+     bxprintf(fp, "{\n");
+     bxprintf(fp, "     char *r;\n");
+     bxprintf(fp, "     size_t %s;\n", argument->name);
+     bxprintf(fp, "     r = %s_%s(&d, &%s);\n", d->prefix, snapshot->name, argument->name);
+     bxprintf(fp, "     if (r == NULL)\n");
+     bxprintf(fp, "          throw %s::ERROR;\n", name);
+     bxprintf(fp, "     std::vector<char> state(r, r + %s);\n", argument->name);
+     bxprintf(fp, "     free(r);\n");
+     bxprintf(fp, "     return state;\n");
+     bxprintf(fp, "}\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+     return 0;
+}
+
+
+
+/*
+ * For subprograms with the plan option <name>_prepare() binds the in arguments
+ * that are arrays, enums, masks or sizes to a nested <name>_plan and
+ * <name>_plan::execute() takes the rest.
+ */
+static void write_plan_argument(bindx_buffer_data *fp, const bindx_data *d,
+                                const argument_data *argument, const char *name)
+{
+     if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_ENUM_EXTERNAL)
+          write_type(fp, &argument->type, argument->options.enum_external_class);
+     else
+          write_type(fp, &argument->type, name);
+     bxprintf(fp, " ");
+     write_dimens_args(fp, d, argument);
+     bxprintf(fp, "%s", argument->name);
+}
+
+
+
+static void write_plan_arguments(bindx_buffer_data *fp, const bindx_data *d,
+                                 const subprogram_data *subprogram, int bound,
+                                 const char *name)
+{
+     int flag = 0;
+
+     argument_data *argument;
+
+     list_for_each(subprogram->args, argument) {
+          if (bindx_plan_argument_is_bound(subprogram, argument) != bound)
+               continue;
+          if (flag)
+               bxprintf(fp, ", ");
+          flag = 1;
+          write_plan_argument(fp, d, argument, name);
+     }
+}
+
+
+
+static void write_return_type(bindx_buffer_data *fp, const bindx_data *d,
+                                   subprogram_data *subprogram, const char *name)
+{
+     if (subprogram->has_return_value ||
+         subprogram_n_scaler_out_args(subprogram) == 1) {
+          write_type(fp, &subprogram->type, name);
+          write_dimens_return(fp, d, &subprogram->type);
+     }
+     else
+          bxprintf(fp, "void");
+}
+
+
+
+static int write_plan_prototypes(bindx_buffer_data *fp, const bindx_data *d,
+                                 const char *name)
+{
+     argument_data *argument;
+     subprogram_data *subprogram;
+
+     list_for_each(&d->subs_general, subprogram) {
+          if (! (subprogram->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_PLAN))
+               continue;
+
+          bxprintf(fp, "\n");
+          bxprintf(fp, "     class %s_plan\n", subprogram->name);
+          bxprintf(fp, "     {\n");
+          bxprintf(fp, "     private:\n");
+          bxprintf(fp, "          %s *self;\n", name);
+          list_for_each(subprogram->args, argument) {
+               if (! bindx_plan_argument_is_bound(subprogram, argument))
+                    continue;
+               bxprintf(fp, "          ");
+               write_plan_argument(fp, d, argument, NULL);
+               bxprintf(fp, ";\n");
+          }
+          bxprintf(fp, "          friend class %s;\n", name);
+          bxprintf(fp, "\n");
+          bxprintf(fp, "     public:\n");
+          bxprintf(fp, "          ");
+          write_return_type(fp, d, subprogram, NULL);
+          bxprintf(fp, " execute(");
+          write_plan_arguments(fp, d, subprogram, 0, NULL);
+          bxprintf(fp, ");\n");
+          bxprintf(fp, "     };\n");
+          bxprintf(fp, "\n");
+          bxprintf(fp, "     %s_plan %s_prepare(", subprogram->name, subprogram->name);
+          write_plan_arguments(fp, d, subprogram, 1, NULL);
+          bxprintf(fp, ");\n");
+     }
+
+     return 0;
+}
+
+
+
+static int write_plan_subprograms(bindx_buffer_data *fp, const bindx_data *d,
+                                  const char *name)
+{
+     argument_data *argument;
+     subprogram_data *subprogram;
+
+     list_for_each(&d->subs_general, subprogram) {
+          if (! (subprogram->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_PLAN))
+               continue;
+
+          bxprintf(fp, "%s::%s_plan %s::%s_prepare(", name, subprogram->name, name, subprogram->name);
+          write_plan_arguments(fp, d, subprogram, 1, name);
+          bxprintf(fp, ")\n");
+          bxprintf(fp, "{\n");
+          bxprintf(fp, "     %s_plan plan;\n", subprogram->name);
+          bxprintf(fp, "     plan.self = this;\n");
+          list_for_each(subprogram->args, argument) {
+               if (bindx_plan_argument_is_bound(subprogram, argument))
+                    bxprintf(fp, "     plan.%s = %s;\n", argument->name, argument->name);
+          }
+          bxprintf(fp, "     return plan;\n");
+          bxprintf(fp, "}\n");
+          bxprintf(fp, "\n");
+          bxprintf(fp, "\n");
+
+          write_return_type(fp, d, subprogram, name);
+          bxprintf(fp, " %s::%s_plan::execute(", name, subprogram->name);
+          write_plan_arguments(fp, d, subprogram, 0, name);
+          bxprintf(fp, ")\n");
+          bxprintf(fp, "{\n");
+          bxprintf(fp, "     ");
+          bindx_write_c_declaration(fp, d, &subprogram->type, NULL);
+          bxprintf(fp, "r;\n");
+          bxprintf(fp, "     r = %s_%s(&self->d", d->prefix, subprogram->name);
+          list_for_each(subprogram->args, argument) {
+               bxprintf(fp, ", ");
+               if (argument->type.type == LEX_BINDX_TYPE_ENUM) {
+                    if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_ENUM_EXTERNAL)
+                         bxprintf(fp, "(enum %s_%s", argument->options.enum_external_type,
+                                                     argument->type.name);
+                    else
+                         bxprintf(fp, "(enum %s_%s", d->prefix, argument->type.name);
+                    if (argument->type.rank > 0)
+                         bxprintf(fp, " ");
+                    write_dimens_args(fp, d, argument);
+                    bxprintf(fp, ") ");
+               }
+               bxprintf(fp, "%s", argument->name);
+          }
+          bxprintf(fp, ");\n");
+          bxprintf(fp, "     if (r == %s)\n", bindx_c_error_conditional(d, subprogram->type.type));
+          bxprintf(fp, "          throw %s::ERROR;\n", name);
+          if (subprogram->has_return_value ||
+              subprogram_n_scaler_out_args(subprogram) == 1) {
+               bxprintf(fp, "     return ");
+               if (subprogram->type.type == LEX_BINDX_TYPE_ENUM) {
+                    bxprintf(fp, "(");
+                    write_type(fp, &subprogram->type, name);
+                    bxprintf(fp, ") ");
+               }
+               bxprintf(fp, "r;\n");
+          }
+          bxprintf(fp, "}\n");
+          bxprintf(fp, "\n");
+          bxprintf(fp, "\n");
+     }
+
+     return 0;
+}
+
+
+
+/*
+ * Global constants are emitted in lower case and without the interface prefix
+ * so that they do not collide with the C macros of the same name.  The name is
+ * written into temp, which must hold NM characters.
+ */
+static const char *const_name(const bindx_data *d, const char *name, char *temp)
+{
+     size_t i;
+     size_t n;
+
+     n = strlen(d->PREFIX);
+     if (strncmp(name, d->PREFIX, n) == 0 && name[n] == '_' && name[n + 1] != '\0')
+          name += n + 1;
+
+     for (i = 0; name[i] != '\0' && i < NM - 1; ++i)
+          temp[i] = tolower((int) name[i]);
+     temp[i] = '\0';
+
+     return temp;
+}
+
+
+
+static const global_const_data *find_int_const(const bindx_data *d, const char *s, size_t n)
+{
+     global_const_data *global_const;
+
+     list_for_each(&d->consts, global_const) {
+          if (global_const->type.type != LEX_BINDX_TYPE_INT   &&
+              global_const->type.type != LEX_BINDX_TYPE_INT64 &&
+              global_const->type.type != LEX_BINDX_TYPE_SIZE_T)
+               continue;
+          if (strlen(global_const->name) == n && strncmp(global_const->name, s, n) == 0)
+               return global_const;
+     }
+
+     return NULL;
+}
+
+
+
+/*
+ * Write a dimension expression that uses only integer literals, integer global
+ * constants and arithmetic, or return -1 if it uses anything else.  With fp
+ * NULL only the check is made.
+ */
+static int write_const_dimen(bindx_buffer_data *fp, const bindx_data *d,
+                             const char *dimen, const char *scope)
+{
+     char temp[NM];
+
+     const char *t;
+
+     const global_const_data *global_const;
+
+     while (*dimen != '\0') {
+          if (isalpha((int) *dimen) || *dimen == '_') {
+               for (t = dimen; isalnum((int) *t) || *t == '_'; ++t) ;
+               global_const = find_int_const(d, dimen, t - dimen);
+               if (global_const == NULL)
+                    return -1;
+               if (fp)
+                    bxprintf(fp, "%s%s", scope, const_name(d, global_const->name, temp));
+               dimen = t;
+          }
+          else
+          if (isdigit((int) *dimen) || strchr(" +*/()", *dimen) ||
+              (*dimen == '-' && dimen[1] != '>')) {
+               if (fp)
+                    bxprintf(fp, "%c", *dimen);
+               dimen++;
+          }
+          else
+               return -1;
+     }
+
+     return 0;
+}
+
+
+
+static int argument_has_const_shape(const bindx_data *d, const argument_data *argument)
+{
+     int i;
+
+     if (argument->type.rank == 0 || argument->type.type == LEX_BINDX_TYPE_ENUM ||
+         argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_STRIDED)
+          return 0;
+
+     for (i = 0; i < argument->type.rank; ++i) {
+          if (write_const_dimen(NULL, d, argument->type.dimens[i], "") < 0)
+               return 0;
+     }
+
+     return 1;
+}
+
+
+
+static int subprogram_has_array_overload(const bindx_data *d, const subprogram_data *subprogram)
+{
+     int n = 0;
+
+     argument_data *argument;
+
+     list_for_each(subprogram->args, argument) {
+          if (argument->type.rank == 0)
+               continue;
+          if (! argument_has_const_shape(d, argument) || argument_is_pointer_array(argument))
+               return 0;
+          n++;
+     }
+
+     return n > 0;
+}
+
+
+
+static void write_array_type(bindx_buffer_data *fp, const bindx_data *d,
+                             const argument_data *argument, const char *scope)
+{
+     int i;
+
+     bxprintf(fp, "std::array<");
+     write_type(fp, &argument->type, NULL);
+     bxprintf(fp, ", ");
+     for (i = 0; i < argument->type.rank; ++i) {
+          if (i > 0)
+               bxprintf(fp, " * ");
+          bxprintf(fp, "(");
+          write_const_dimen(fp, d, argument->type.dimens[i], scope);
+          bxprintf(fp, ")");
+     }
+     bxprintf(fp, ">");
+}
+
+
+
+/*
+ * Global constants and the extents of arguments with a constant shape as
+ * compile time constants in <name>_consts.
+ */
+static int write_global_consts(bindx_buffer_data *fp, const bindx_data *d,
+                               const char *name)
+{
+     int i;
+
+     char temp[NM];
+
+     global_const_data *global_const;
+     argument_data *argument;
+     subprogram_data *subprogram;
+
+     if (list_is_empty(&d->consts))
+          return 0;
+
+     bxprintf(fp, "#if __cplusplus >= 201703L\n");
+     bxprintf(fp, "namespace %s_consts {\n", name);
+
+     list_for_each(&d->consts, global_const) {
+          bxprintf(fp, "     inline constexpr ");
+          write_type(fp, &global_const->type, NULL);
+          bxprintf(fp, " %s = ", const_name(d, global_const->name, temp));
+          switch(global_const->type.type) {
+          case LEX_BINDX_TYPE_INT:
+          case LEX_BINDX_TYPE_INT64:
+          case LEX_BINDX_TYPE_SIZE_T:
+               bxprintf(fp, "%ld", global_const->lex_type.l);
+               break;
+          case LEX_BINDX_TYPE_FLOAT:
+          case LEX_BINDX_TYPE_DOUBLE:
+               bxprintf(fp, "%.17g", global_const->lex_type.d);
+               break;
+          default:
+               INTERNAL_ERROR("Invalid lex_bindx_type value: %d", global_const->type.type);
+               break;
+          }
+          bxprintf(fp, ";\n");
+     }
+
+     list_for_each(&d->subs_general, subprogram) {
+          list_for_each(subprogram->args, argument) {
+               if (! argument_has_const_shape(d, argument))
+                    continue;
+
+               bxprintf(fp, "\n");
+               bxprintf(fp, "     inline constexpr std::array<std::size_t, %d> %s_%s_extents = {",
+                        argument->type.rank, subprogram->name, argument->name);
+               for (i = 0; i < argument->type.rank; ++i) {
+                    if (i > 0)
+                         bxprintf(fp, ", ");
+                    write_const_dimen(fp, d, argument->type.dimens[i], "");
+               }
+               bxprintf(fp, "};\n");
+               bxprintf(fp, "     using %s_%s_array = ", subprogram->name, argument->name);
+               write_array_type(fp, d, argument, "");
+               bxprintf(fp, ";\n");
+          }
+     }
+
+     bxprintf(fp, "}\n");
+     bxprintf(fp, "#endif\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+     return 0;
+}
+
+
+
+/*
+ * Inline overloads taking std::array for subprograms whose array arguments
+ * all have a constant shape so the sizes are known to the compiler.
+ */
+static int write_array_overloads(bindx_buffer_data *fp, const bindx_data *d,
+                                 const char *name)
+{
+     char scope[NM];
+
+     int flag = 0;
+
+     argument_data *argument;
+     subprogram_data *subprogram;
+
+     snprintf(scope, NM, "%s_consts::", name);
+
+     list_for_each(&d->subs_general, subprogram) {
+          if (! subprogram_has_array_overload(d, subprogram))
+               continue;
+
+          if (! flag) {
+               flag = 1;
+               bxprintf(fp, "\n");
+               bxprintf(fp, "#if __cplusplus >= 201703L\n");
+          }
+
+          bxprintf(fp, "     ");
+          write_return_type(fp, d, subprogram, NULL);
+          bxprintf(fp, " %s(", subprogram->name);
+          list_for_each(subprogram->args, argument) {
+               if (argument->type.rank == 0)
+                    write_plan_argument(fp, d, argument, NULL);
+               else {
+                    if (argument->usage == LEX_SUBPROGRAM_ARGUMENT_USAGE_IN)
+                         bxprintf(fp, "const ");
+                    write_array_type(fp, d, argument, scope);
+                    bxprintf(fp, " &%s", argument->name);
+               }
+               if (! list_is_last_elem(subprogram->args, argument))
+                    bxprintf(fp, ", ");
+          }
+          bxprintf(fp, ")\n");
+          bxprintf(fp, "     {\n");
+          bxprintf(fp, "          return %s(", subprogram->name);
+          list_for_each(subprogram->args, argument) {
+               if (argument->type.rank > 0 &&
+                   argument->usage == LEX_SUBPROGRAM_ARGUMENT_USAGE_IN) {
+                    bxprintf(fp, "const_cast<");
+                    write_type(fp, &argument->type, NULL);
+                    bxprintf(fp, " *>(%s.data())", argument->name);
+               }
+               else
+               if (argument->type.rank > 0)
+                    bxprintf(fp, "%s.data()", argument->name);
+               else
+                    bxprintf(fp, "%s", argument->name);
+               if (! list_is_last_elem(subprogram->args, argument))
+                    bxprintf(fp, ", ");
+          }
+          bxprintf(fp, ");\n");
+          bxprintf(fp, "     }\n");
+     }
+
+     if (flag)
+          bxprintf(fp, "#endif\n");
+
+     return 0;
+}
+
+
+
+int bindx_write_cpp(bindx_buffer_data **fp, const bindx_data *d, const char *name)
 {
      bindx_write_c_header_top(fp[0]);
-     fprintf(fp[0], "\n");
-     fprintf(fp[0], "#ifndef %s_INT_CPP_H\n", d->PREFIX);
-     fprintf(fp[0], "#define %s_INT_CPP_H\n", d->PREFIX);
-     fprintf(fp[0], "\n");
-
-     fprintf(fp[0], "#include <gutil.h>\n");
-     fprintf(fp[0], "\n");
-     fprintf(fp[0], "#include <%s_interface.h>\n", d->prefix);
-     fprintf(fp[0], "\n");
+     bxprintf(fp[0], "\n");
+     bxprintf(fp[0], "#ifndef %s_INT_CPP_H\n", d->PREFIX);
+     bxprintf(fp[0], "#define %s_INT_CPP_H\n", d->PREFIX);
+     bxprintf(fp[0], "\n");
+
+     if (bindx_snapshot_subprogram(d)) {
+          bxprintf(fp[0], "#include <vector>\n");
+          bxprintf(fp[0], "\n");
+     }
+
+     if (! list_is_empty(&d->enums) || ! list_is_empty(&d->consts)) {
+          bxprintf(fp[0], "#if __cplusplus >= 201703L\n");
+          if (! list_is_empty(&d->consts))
+               bxprintf(fp[0], "#include <array>\n");
+          if (! list_is_empty(&d->enums))
+               bxprintf(fp[0], "#include <initializer_list>\n");
+          bxprintf(fp[0], "#endif\n");
+          bxprintf(fp[0], "\n");
+     }
+
+     bxprintf(fp[0], "#include <gutil.h>\n");
+     bxprintf(fp[0], "\n");
+     bxprintf(fp[0], "#include <%s_interface.h>\n", d->prefix);
+     bxprintf(fp[0], "\n");
      if (d->include) {
-          fprintf(fp[0], "#include \"%s_int_cpp.h\"\n", d->include);
-          fprintf(fp[0], "\n");
+          bxprintf(fp[0], "#include \"%s_int_cpp.h\"\n", d->include);
+          bxprintf(fp[0], "\n");
      }
-     fprintf(fp[0], "\n");
+     bxprintf(fp[0], "\n");
+
+     if (d->stats)
+          bindx_write_c_stats_header(fp[0], d);
 
-     fprintf(fp[0], "class %s\n", name);
-     fprintf(fp[0], "{\n");
-     fprintf(fp[0], "private:\n");
-     fprintf(fp[0], "     %s_data d;\n", d->prefix);
-     fprintf(fp[0], "\n");
-     fprintf(fp[0], "\n");
+     write_global_consts(fp[0], d, name);
 
-     fprintf(fp[0], "public:\n");
-     fprintf(fp[0], "     enum %s_errors { ERROR };\n", d->prefix);
-     fprintf(fp[0], "\n");
+     bxprintf(fp[0], "class %s\n", name);
+     bxprintf(fp[0], "{\n");
+     bxprintf(fp[0], "private:\n");
+     bxprintf(fp[0], "     %s_data d;\n", d->prefix);
+     bxprintf(fp[0], "\n");
+     bxprintf(fp[0], "\n");
+
+     bxprintf(fp[0], "public:\n");
+     bxprintf(fp[0], "     enum %s_errors { ERROR };\n", d->prefix);
+     bxprintf(fp[0], "\n");
 
      write_enumerations(fp[0], d, &d->enums, 1);
-     fprintf(fp[0], "\n");
+     write_enumeration_tables(fp[0], d, &d->enums, 1);
+     bxprintf(fp[0], "\n");
 
      write_prototypes(fp[0], d, SUBPROGRAM_TYPE_INIT,    &d->subs_init,    name, 1);
      write_prototypes(fp[0], d, SUBPROGRAM_TYPE_FREE,    &d->subs_free,    name, 1);
+     write_prototypes(fp[0], d, SUBPROGRAM_TYPE_CLONE,   &d->subs_clone,   name, 1);
+     write_assignment_prototype(fp[0], d, name);
      write_prototypes(fp[0], d, SUBPROGRAM_TYPE_GENERAL, &d->subs_general, name, 1);
-     fprintf(fp[0], "};\n");
-     fprintf(fp[0], "\n");
+     write_array_overloads(fp[0], d, name);
+     write_plan_prototypes(fp[0], d, name);
+     write_state_prototypes(fp[0], d, name);
+     if (d->stats) {
+          bxprintf(fp[0], "\n");
+          bxprintf(fp[0], "     static const %s_stats_data *stats(int *n_stats);\n", d->prefix);
+     }
+     bxprintf(fp[0], "};\n");
+     bxprintf(fp[0], "\n");
 
-     fprintf(fp[0], "#endif /* %s_INT_CPP_H */\n", d->PREFIX);
+     bxprintf(fp[0], "#endif /* %s_INT_CPP_H */\n", d->PREFIX);
 
 
      bindx_write_c_header_top(fp[1]);
-     fprintf(fp[1], "\n");
+     bxprintf(fp[1], "\n");
+
+     if (bindx_snapshot_subprogram(d)) {
+          bxprintf(fp[1], "#include <cstdlib>\n");
+          bxprintf(fp[1], "#include <cstring>\n");
+          bxprintf(fp[1], "\n");
+     }
+     else
+     if (bindx_clone_subprogram(d)) {
+          bxprintf(fp[1], "#include <cstring>\n");
+          bxprintf(fp[1], "\n");
+     }
+
+     bxprintf(fp[1], "#include <gutil.h>\n");
+     bxprintf(fp[1], "\n");
+     bxprintf(fp[1], "#include <%s_interface.h>\n", d->prefix);
+     bxprintf(fp[1], "\n");
+     bxprintf(fp[1], "#include \"%s_int_cpp.h\"\n", d->prefix);
+     bxprintf(fp[1], "\n");
+     bxprintf(fp[1], "\n");
 
-     fprintf(fp[1], "#include <gutil.h>\n");
-     fprintf(fp[1], "\n");
-     fprintf(fp[1], "#include <%s_interface.h>\n", d->prefix);
-     fprintf(fp[1], "\n");
-     fprintf(fp[1], "#include \"%s_int_cpp.h\"\n", d->prefix);
-     fprintf(fp[1], "\n");
-     fprintf(fp[1], "\n");
+     if (d->stats) {
+          bindx_write_c_stats_utilities(fp[1], d);
+
+          bxprintf(fp[1], "const %s_stats_data *%s::stats(int *n_stats)\n", d->prefix, name);
+          bxprintf(fp[1], "{\n");
+          bxprintf(fp[1], "     *n_stats = %s_STATS_N_SUBPROGRAMS;\n", d->PREFIX);
+          bxprintf(fp[1], "     return %s_stats;\n", d->prefix);
+          bxprintf(fp[1], "}\n");
+          bxprintf(fp[1], "\n");
+          bxprintf(fp[1], "\n");
+     }
 
      write_subprograms(fp[1], d, SUBPROGRAM_TYPE_INIT,    &d->subs_init,    name, 0);
      write_subprograms(fp[1], d, SUBPROGRAM_TYPE_FREE,    &d->subs_free,    name, 0);
+     write_subprograms(fp[1], d, SUBPROGRAM_TYPE_CLONE,   &d->subs_clone,   name, 0);
+     write_assignment_subprogram(fp[1], d, name);
      write_subprograms(fp[1], d, SUBPROGRAM_TYPE_GENERAL, &d->subs_general, name, 0);
+     write_plan_subprograms(fp[1], d, name);
+     write_state_subprograms(fp[1], d, name);
 
      return 0;
 }
@@ -15,30 +15,30 @@
 #include "bindx_parse_int.h"
 
 
-static int write_header(FILE *fp)
+static int write_header(bindx_buffer_data *fp)
 {
-     fprintf(fp, "c***********************************************************************\n");
-     fprintf(fp, "c\n");
-     fprintf(fp, "c***********************************************************************\n");
+     bxprintf(fp, "c***********************************************************************\n");
+     bxprintf(fp, "c\n");
+     bxprintf(fp, "c***********************************************************************\n");
 
      return 0;
 }
 
 
 
-static int write_header_top(FILE *fp)
+static int write_header_top(bindx_buffer_data *fp)
 {
-     fprintf(fp, "c***********************************************************************\n");
-     fprintf(fp, "c This file was generated by bindx version %s.  Edit at your own risk.\n",
-             bindx_version());
-     fprintf(fp, "c***********************************************************************\n");
+     bxprintf(fp, "c***********************************************************************\n");
+     bxprintf(fp, "c This file was generated by bindx version %s.  Edit at your own risk.\n",
+              bindx_version());
+     bxprintf(fp, "c***********************************************************************\n");
 
      return 0;
 }
 
 
 
-static int bindx_write_c_util_functions(FILE *fp, const bindx_data *d,
+static int bindx_write_c_util_functions(bindx_buffer_data *fp, const bindx_data *d,
                                         const subprogram_data *subs)
 {
      int i;
@@ -56,108 +56,118 @@ static int bindx_write_c_util_functions(FILE *fp, const bindx_data *d,
           for (i = 0; name[i] != '\0'; ++i)
                name[i] = tolower(name[i]);
 
-          fprintf(fp, " %s_%s_bindx_f77_(%s_data *d", d->prefix, name, d->prefix);
+          bxprintf(fp, " %s_%s_bindx_f77_(%s_data *d", d->prefix, name, d->prefix);
 
           free(name);
 
           list_for_each(subprogram->args, argument) {
-               fprintf(fp, ", ");
+               bxprintf(fp, ", ");
                if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_ENUM_EXTERNAL)
                     bindx_write_c_type(fp, d, &argument->type, argument->options.enum_external_type);
                else
                     bindx_write_c_type(fp, d, &argument->type, NULL);
-               fprintf(fp, " ");
-               fprintf(fp, "*");
-               fprintf(fp, "%s", argument->name);
+               bxprintf(fp, " ");
+               bxprintf(fp, "*");
+               bxprintf(fp, "%s", argument->name);
                if (argument->usage == LEX_SUBPROGRAM_ARGUMENT_USAGE_IN &&
                    argument->type.rank == 0)
-                    fprintf(fp, "_");
+                    bxprintf(fp, "_");
           }
 
-          fprintf(fp, ")\n");
-          fprintf(fp, "{\n");
+          bxprintf(fp, ")\n");
+          bxprintf(fp, "{\n");
 
           list_for_each(subprogram->args, argument) {
                if ((argument->usage == LEX_SUBPROGRAM_ARGUMENT_USAGE_IN &&
-                    argument->type.rank == 0) || argument->type.rank  > 1) {
-                    fprintf(fp, "%s", indent);
+                    argument->type.rank == 0) || argument_is_pointer_array(argument)) {
+                    bxprintf(fp, "%s", indent);
                     if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_ENUM_EXTERNAL)
                          bindx_write_c_type(fp, d, &argument->type,
                                             argument->options.enum_external_type);
                     else
                          bindx_write_c_type(fp, d, &argument->type, NULL);
-                    fprintf(fp, " ");
+                    bxprintf(fp, " ");
                     for (i = 0; i < argument->type.rank; ++i)
-                         fprintf(fp, "*");
-                    fprintf(fp, "%s", argument->name);
+                         bxprintf(fp, "*");
+                    bxprintf(fp, "%s", argument->name);
                     if (argument->type.rank > 1)
-                         fprintf(fp, "2");
-                    fprintf(fp, ";\n");
+                         bxprintf(fp, "2");
+                    bxprintf(fp, ";\n");
                }
+
+               if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_STRIDED)
+                    bxprintf(fp, "%sptrdiff_t %s_strides[%d];\n", indent, argument->name,
+                             argument->type.rank);
           }
 
           list_for_each(subprogram->args, argument) {
                if (argument->usage == LEX_SUBPROGRAM_ARGUMENT_USAGE_IN &&
                    argument->type.rank == 0) {
-                    fprintf(fp, "%s", indent);
-                    fprintf(fp, "%s = *%s_", argument->name, argument->name);
-                    fprintf(fp, ";\n");
+                    bxprintf(fp, "%s", indent);
+                    bxprintf(fp, "%s = *%s_", argument->name, argument->name);
+                    bxprintf(fp, ";\n");
                }
           }
 
           list_for_each(subprogram->args, argument) {
-               if (argument->type.rank > 1) {
-                    fprintf(fp, "%s%s2 = array_from_mem%d_d(%s, ", indent,
-                            argument->name, argument->type.rank, argument->name);
+               if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_STRIDED)
+                    bindx_write_c_row_major_strides(fp, argument, indent);
+               else
+               if (argument_is_pointer_array(argument)) {
+                    bxprintf(fp, "%s%s2 = array_from_mem%d_%s(%s, ", indent,
+                             argument->name, argument->type.rank,
+                             bindx_c_type_postfix(&argument->type), argument->name);
 
                     for (i = 0; i < argument->type.rank; ++i) {
-                         fprintf(fp, "%s", argument->type.dimens[i]);
+                         bxprintf(fp, "%s", argument->type.dimens[i]);
                          if (i + 1 < argument->type.rank)
-                              fprintf(fp, ", ");
+                              bxprintf(fp, ", ");
                     }
 
-                    fprintf(fp, ");\n");
+                    bxprintf(fp, ");\n");
                }
           }
 
-          fprintf(fp, "%sif (%s_%s(d", indent, d->prefix, subprogram->name);
+          bxprintf(fp, "%sif (%s_%s(d", indent, d->prefix, subprogram->name);
 
           list_for_each(subprogram->args, argument) {
-               fprintf(fp, ", ");
+               bxprintf(fp, ", ");
                if (argument->type.type == LEX_BINDX_TYPE_ENUM) {
                     if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_ENUM_EXTERNAL)
-                         fprintf(fp, "(enum %s_%s", argument->options.enum_external_type,
-                                 argument->type.name);
+                         bxprintf(fp, "(enum %s_%s", argument->options.enum_external_type,
+                                  argument->type.name);
                     else
-                         fprintf(fp, "(enum %s_%s", d->prefix, argument->type.name);
-                    for (i = 0; i < argument->type.rank; ++i)
-                          fprintf(fp, "*");
-                    fprintf(fp, ") ");
+                         bxprintf(fp, "(enum %s_%s", d->prefix, argument->type.name);
+                    bindx_write_c_argument_dimens(fp, d, argument);
+                    bxprintf(fp, ") ");
                }
-               fprintf(fp, "%s", argument->name);
-               if (argument->type.rank > 1)
-                    fprintf(fp, "2");
+               bxprintf(fp, "%s", argument->name);
+               if (argument_is_pointer_array(argument))
+                    bxprintf(fp, "2");
+               if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_STRIDED)
+                    bxprintf(fp, ", %s_strides", argument->name);
           }
 
-          fprintf(fp, ")) {\n");
+          bxprintf(fp, ")) {\n");
 
-          fprintf(fp, "%s%sfprintf(stderr, \"ERROR: %s_%s()\\n\");\n", indent, indent,
-                  d->prefix, subprogram->name);
-          fprintf(fp, "%s%sreturn -1;\n", indent, indent);
+          bxprintf(fp, "%s%sfprintf(stderr, \"ERROR: %s_%s()\\n\");\n", indent, indent,
+                   d->prefix, subprogram->name);
+          bxprintf(fp, "%s%sreturn -1;\n", indent, indent);
 
-          fprintf(fp, "%s}\n", indent);
+          bxprintf(fp, "%s}\n", indent);
 
           list_for_each(subprogram->args, argument) {
-               if (argument->type.rank > 1)
-                    fprintf(fp, "%sfree_array%d_d(%s2);\n", indent,
-                            argument->type.rank, argument->name);
+               if (argument_is_pointer_array(argument))
+                    bxprintf(fp, "%sfree_array%d_%s(%s2);\n", indent,
+                             argument->type.rank, bindx_c_type_postfix(&argument->type),
+                             argument->name);
           }
 
-          fprintf(fp, "%sreturn 0;\n", indent);
+          bxprintf(fp, "%sreturn 0;\n", indent);
 
-          fprintf(fp, "}\n");
-          fprintf(fp, "\n");
-          fprintf(fp, "\n");
+          bxprintf(fp, "}\n");
+          bxprintf(fp, "\n");
+          bxprintf(fp, "\n");
      }
 
      return 0;
@@ -165,20 +175,59 @@ static int bindx_write_c_util_functions(FILE *fp, const bindx_data *d,
 
 
 
-static void fprintf_f77(FILE *fp, const char *fmt, ...)
+static int write_c_clone_function(bindx_buffer_data *fp, const bindx_data *d)
+{
+     int i;
+
+     char *name;
+
+     char *indent = "     ";
+
+     const subprogram_data *subprogram;
+
+     subprogram = bindx_clone_subprogram(d);
+     if (subprogram == NULL)
+          return 0;
+
+     name = strdup(subprogram->name);
+     for (i = 0; name[i] != '\0'; ++i)
+          name[i] = tolower(name[i]);
+
+     bxprintf(fp, "int %s_%s_bindx_f77_(%s_data *d, %s_data *src)\n", d->prefix, name,
+              d->prefix, d->prefix);
+
+     free(name);
+
+     bxprintf(fp, "{\n");
+     bxprintf(fp, "%sif (%s_%s(d, src)) {\n", indent, d->prefix, subprogram->name);
+     bxprintf(fp, "%s%sfprintf(stderr, \"ERROR: %s_%s()\\n\");\n", indent, indent,
+              d->prefix, subprogram->name);
+     bxprintf(fp, "%s%sreturn -1;\n", indent, indent);
+     bxprintf(fp, "%s}\n", indent);
+     bxprintf(fp, "%sreturn 0;\n", indent);
+     bxprintf(fp, "}\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+     return 0;
+}
+
+
+
+static void fprintf_f77(bindx_buffer_data *fp, const char *fmt, ...)
 {
      va_list ap;
 
      va_start(ap, fmt);
 
-     bindx_fprintf_wrap(fp, 72, "     &", fmt, ap);
+     bxprintf_wrap(fp, 72, "     &", fmt, ap);
 
      va_end(ap);
 }
 
 
 
-static int write_type(FILE *fp, const type_data *d)
+static int write_type(bindx_buffer_data *fp, const type_data *d)
 {
      switch(d->type) {
           case LEX_BINDX_TYPE_ENUM:
@@ -190,9 +239,21 @@ static int write_type(FILE *fp, const type_data *d)
           case LEX_BINDX_TYPE_INT:
                fprintf_f77(fp, "integer");
                break;
+          case LEX_BINDX_TYPE_INT64:
+               fprintf_f77(fp, "integer*8");
+               break;
+          case LEX_BINDX_TYPE_SIZE_T:
+               fprintf_f77(fp, "integer*8");
+               break;
+          case LEX_BINDX_TYPE_FLOAT:
+               fprintf_f77(fp, "real*4");
+               break;
           case LEX_BINDX_TYPE_DOUBLE:
                fprintf_f77(fp, "real*8");
                break;
+          case LEX_BINDX_TYPE_COMPLEX:
+               fprintf_f77(fp, "complex*16");
+               break;
           case LEX_BINDX_TYPE_STRUCTURE:
                fprintf_f77(fp, "byte");
                break;
@@ -206,7 +267,7 @@ static int write_type(FILE *fp, const type_data *d)
 
 
 
-static int write_dimens(FILE *fp, const type_data *d)
+static int write_dimens(bindx_buffer_data *fp, const type_data *d)
 {
      if (d->rank > 0 || d->type == LEX_BINDX_TYPE_STRUCTURE) {
           fprintf_f77(fp,"(");
@@ -221,7 +282,7 @@ static int write_dimens(FILE *fp, const type_data *d)
 
 
 
-static int write_enumerations(FILE *fp, const bindx_data *d,
+static int write_enumerations(bindx_buffer_data *fp, const bindx_data *d,
                               const enumeration_data *enums)
 {
      enum_member_data *enum_member;
@@ -243,7 +304,7 @@ static int write_enumerations(FILE *fp, const bindx_data *d,
 
 
 
-static int write_structures(FILE *fp, const bindx_data *d,
+static int write_structures(bindx_buffer_data *fp, const bindx_data *d,
                             const structure_data *structs)
 {
      int i;
@@ -269,7 +330,7 @@ static int write_structures(FILE *fp, const bindx_data *d,
 
 
 
-static int write_subprograms(FILE *fp, const bindx_data *d,
+static int write_subprograms(bindx_buffer_data *fp, const bindx_data *d,
                              const subprogram_data *subs)
 {
      char *indent = "      ";
@@ -347,13 +408,42 @@ static int write_subprograms(FILE *fp, const bindx_data *d,
 
 
 
-int bindx_write_f77(FILE **fp, const bindx_data *d, const char *name)
+static int write_clone_subprogram(bindx_buffer_data *fp, const bindx_data *d)
+{
+     char *indent = "      ";
+
+     const subprogram_data *subprogram;
+
+     subprogram = bindx_clone_subprogram(d);
+     if (subprogram == NULL)
+          return 0;
+
+     fprintf_f77(fp, "%ssubroutine %s_%s_f77(d, src, error)\n", indent, d->prefix,
+                 subprogram->name);
+     fprintf_f77(fp, "%simplicit none\n", indent);
+     fprintf_f77(fp, "%sbyte d(*)\n", indent);
+     fprintf_f77(fp, "%sbyte src(*)\n", indent);
+     fprintf_f77(fp, "%sinteger error\n", indent);
+     fprintf_f77(fp, "%sinteger %s_%s_bindx_f77\n", indent, d->prefix, subprogram->name);
+     fprintf_f77(fp, "%serror = %s_%s_bindx_f77(d, src)\n", indent, d->prefix,
+                 subprogram->name);
+     fprintf_f77(fp, "%send subroutine %s_%s_f77\n", indent, d->prefix, subprogram->name);
+     fprintf_f77(fp, "\n");
+     fprintf_f77(fp, "\n");
+
+     return 0;
+}
+
+
+
+int bindx_write_f77(bindx_buffer_data **fp, const bindx_data *d, const char *name)
 {
      bindx_write_c_header_top(fp[0]);
-     fprintf(fp[0], "\n");
+     bxprintf(fp[0], "\n");
 
      bindx_write_c_util_header(fp[0], d);
      bindx_write_c_util_functions(fp[0], d, &d->subs_all);
+     write_c_clone_function(fp[0], d);
      bindx_write_c_util_trailer(fp[0], d);
 
      write_header_top(fp[1]);
@@ -375,6 +465,7 @@ int bindx_write_f77(FILE **fp, const bindx_data *d, const char *name)
      fprintf_f77(fp[2], "\n");
      fprintf_f77(fp[2], "\n");
      write_subprograms(fp[2], d, &d->subs_all);
+     write_clone_subprogram(fp[2], d);
 
      return 0;
 }
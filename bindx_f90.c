@@ -15,23 +15,23 @@
 #include "bindx_parse_int.h"
 
 
-static int write_header(FILE *fp)
+static int write_header(bindx_buffer_data *fp)
 {
-     fprintf(fp, "!*******************************************************************************\n");
-     fprintf(fp, "!\n");
-     fprintf(fp, "!*******************************************************************************\n");
+     bxprintf(fp, "!*******************************************************************************\n");
+     bxprintf(fp, "!\n");
+     bxprintf(fp, "!*******************************************************************************\n");
 
      return 0;
 }
 
 
 
-static int write_header_top(FILE *fp)
+static int write_header_top(bindx_buffer_data *fp)
 {
-     fprintf(fp, "!*******************************************************************************\n");
-     fprintf(fp, "! This file was generated by bindx version %s.  Edit at your own risk.\n",
-             bindx_version());
-     fprintf(fp, "!*******************************************************************************\n");
+     bxprintf(fp, "!*******************************************************************************\n");
+     bxprintf(fp, "! This file was generated by bindx version %s.  Edit at your own risk.\n",
+              bindx_version());
+     bxprintf(fp, "!*******************************************************************************\n");
 
      return 0;
 }
@@ -55,26 +55,38 @@ static char *crap_data_type_replace(const char *s)
 
 
 
-static int write_type(FILE *fp, const type_data *d)
+static int write_type(bindx_buffer_data *fp, const type_data *d)
 {
      char *crap;
 
      switch(d->type) {
           case LEX_BINDX_TYPE_ENUM:
-               fprintf(fp, "integer");
+               bxprintf(fp, "integer");
                break;
           case LEX_BINDX_TYPE_CHAR:
-               fprintf(fp, "character");
+               bxprintf(fp, "character");
                break;
           case LEX_BINDX_TYPE_INT:
-               fprintf(fp, "integer");
+               bxprintf(fp, "integer");
+               break;
+          case LEX_BINDX_TYPE_INT64:
+               bxprintf(fp, "integer(8)");
+               break;
+          case LEX_BINDX_TYPE_SIZE_T:
+               bxprintf(fp, "integer(8)");
+               break;
+          case LEX_BINDX_TYPE_FLOAT:
+               bxprintf(fp, "real(4)");
                break;
           case LEX_BINDX_TYPE_DOUBLE:
-               fprintf(fp, "real(8)");
+               bxprintf(fp, "real(8)");
+               break;
+          case LEX_BINDX_TYPE_COMPLEX:
+               bxprintf(fp, "complex(8)");
                break;
           case LEX_BINDX_TYPE_STRUCTURE:
                crap = crap_data_type_replace(d->name);
-               fprintf(fp, "type(%s)", crap);
+               bxprintf(fp, "type(%s)", crap);
                free(crap);
                break;
           default:
@@ -87,26 +99,38 @@ static int write_type(FILE *fp, const type_data *d)
 
 
 
-static int write_type_bind_c(FILE *fp, const type_data *d)
+static int write_type_bind_c(bindx_buffer_data *fp, const type_data *d)
 {
      char *crap;
 
      switch(d->type) {
           case LEX_BINDX_TYPE_ENUM:
-               fprintf(fp, "integer(c_int)");
+               bxprintf(fp, "integer(c_int)");
                break;
           case LEX_BINDX_TYPE_CHAR:
-               fprintf(fp, "character(c_char)");
+               bxprintf(fp, "character(c_char)");
                break;
           case LEX_BINDX_TYPE_INT:
-               fprintf(fp, "integer(c_int)");
+               bxprintf(fp, "integer(c_int)");
+               break;
+          case LEX_BINDX_TYPE_INT64:
+               bxprintf(fp, "integer(c_int64_t)");
+               break;
+          case LEX_BINDX_TYPE_SIZE_T:
+               bxprintf(fp, "integer(c_size_t)");
+               break;
+          case LEX_BINDX_TYPE_FLOAT:
+               bxprintf(fp, "real(c_float)");
                break;
           case LEX_BINDX_TYPE_DOUBLE:
-               fprintf(fp, "real(c_double)");
+               bxprintf(fp, "real(c_double)");
+               break;
+          case LEX_BINDX_TYPE_COMPLEX:
+               bxprintf(fp, "complex(c_double_complex)");
                break;
           case LEX_BINDX_TYPE_STRUCTURE:
                crap = crap_data_type_replace(d->name);
-               fprintf(fp, "type(%s)", crap);
+               bxprintf(fp, "type(%s)", crap);
                free(crap);
                break;
           default:
@@ -119,17 +143,17 @@ static int write_type_bind_c(FILE *fp, const type_data *d)
 
 
 
-static int write_usage(FILE *fp, int usage)
+static int write_usage(bindx_buffer_data *fp, int usage)
 {
      switch(usage) {
           case LEX_SUBPROGRAM_ARGUMENT_USAGE_IN:
-               fprintf(fp, "intent(in)");
+               bxprintf(fp, "intent(in)");
                break;
           case LEX_SUBPROGRAM_ARGUMENT_USAGE_OUT:
-               fprintf(fp, "intent(out)");
+               bxprintf(fp, "intent(out)");
                break;
           case LEX_SUBPROGRAM_ARGUMENT_USAGE_IN_OUT:
-               fprintf(fp, "intent(inout)");
+               bxprintf(fp, "intent(inout)");
                break;
           default:
                INTERNAL_ERROR("Invalid lex_subprogram_argument_usage value: %d", usage);
@@ -141,21 +165,40 @@ static int write_usage(FILE *fp, int usage)
 
 
 
-static int write_dimens(FILE *fp, const type_data *d)
+static int write_dimens(bindx_buffer_data *fp, const type_data *d)
 {
      int i;
 
      if (d->rank > 0) {
-          fprintf(fp, "(");
+          bxprintf(fp, "(");
 
           for (i = 0; i < d->rank; ++i) {
-               fprintf(fp, ":");
+               bxprintf(fp, ":");
 
                if (i + 1 < d->rank)
-                    fprintf(fp, ",");
+                    bxprintf(fp, ",");
           }
 
-          fprintf(fp, ")");
+          bxprintf(fp, ")");
+     }
+
+     return 0;
+}
+
+
+
+/*
+ * Subprograms with pointer to pointer or strided array arguments are called
+ * through a C function that builds them.  The rest are bound directly.
+ */
+static int needs_c_glue(const subprogram_data *subprogram)
+{
+     argument_data *argument;
+
+     list_for_each(subprogram->args, argument) {
+          if (argument_is_pointer_array(argument) ||
+              argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_STRIDED)
+               return 1;
      }
 
      return 0;
@@ -163,7 +206,29 @@ static int write_dimens(FILE *fp, const type_data *d)
 
 
 
-static int bindx_write_c_util_functions(FILE *fp, const bindx_data *d,
+/*
+ * The C interfaces are functions, and Fortran only allows a function to be
+ * pure if all of its arguments are intent(in).  Pure subprograms with out
+ * arguments are therefore bound as ordinary procedures.
+ */
+static int is_pure(const subprogram_data *subprogram)
+{
+     argument_data *argument;
+
+     if (! (subprogram->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_PURE))
+          return 0;
+
+     list_for_each(subprogram->args, argument) {
+          if (argument->usage != LEX_SUBPROGRAM_ARGUMENT_USAGE_IN)
+               return 0;
+     }
+
+     return 1;
+}
+
+
+
+static int bindx_write_c_util_functions(bindx_buffer_data *fp, const bindx_data *d,
                                         const subprogram_data *subs)
 {
      int i;
@@ -174,83 +239,94 @@ static int bindx_write_c_util_functions(FILE *fp, const bindx_data *d,
      subprogram_data *subprogram;
 
      list_for_each(subs, subprogram) {
-          if (! subprogram->has_multi_dimen_args)
+          if (! needs_c_glue(subprogram))
                continue;
 
           bindx_write_c_type(fp, d, &subprogram->type, NULL);
-          fprintf(fp, " %s_%s_bindx_f90(%s_data *d", d->prefix, subprogram->name,
-                  d->prefix);
+          bxprintf(fp, " %s_%s_bindx_f90(%s_data *d", d->prefix, subprogram->name,
+                   d->prefix);
 
           list_for_each(subprogram->args, argument) {
-               fprintf(fp, ", ");
+               bxprintf(fp, ", ");
                if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_ENUM_EXTERNAL)
                     bindx_write_c_type(fp, d, &argument->type,
                                        argument->options.enum_external_type);
                else
                     bindx_write_c_type(fp, d, &argument->type, NULL);
-               fprintf(fp, " ");
+               bxprintf(fp, " ");
                if (argument->type.rank > 0)
-                    fprintf(fp, "*");
-               fprintf(fp, "%s", argument->name);
+                    bxprintf(fp, "*");
+               bxprintf(fp, "%s", argument->name);
           }
 
-          fprintf(fp, ")\n");
-          fprintf(fp, "{\n");
+          bxprintf(fp, ")\n");
+          bxprintf(fp, "{\n");
 
           list_for_each(subprogram->args, argument) {
-               if (argument->type.rank > 1) {
-                    fprintf(fp, "%s", indent);
+               if (argument_is_pointer_array(argument)) {
+                    bxprintf(fp, "%s", indent);
                     bindx_write_c_type(fp, d, &argument->type, NULL);
-                    fprintf(fp, " ");
+                    bxprintf(fp, " ");
                     for (i = 0; i < argument->type.rank; ++i)
-                         fprintf(fp, "*");
-                    fprintf(fp, "%s2;", argument->name);
-                    fprintf(fp, "\n");
+                         bxprintf(fp, "*");
+                    bxprintf(fp, "%s2;", argument->name);
+                    bxprintf(fp, "\n");
                }
+
+               if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_STRIDED)
+                    bxprintf(fp, "%sptrdiff_t %s_strides[%d];\n", indent, argument->name,
+                             argument->type.rank);
           }
 
           list_for_each(subprogram->args, argument) {
-               if (argument->type.rank > 1) {
-                    fprintf(fp, "%s%s2 = array_from_mem%d_d(%s, ", indent,
-                            argument->name, argument->type.rank, argument->name);
+               if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_STRIDED)
+                    bindx_write_c_row_major_strides(fp, argument, indent);
+               else
+               if (argument_is_pointer_array(argument)) {
+                    bxprintf(fp, "%s%s2 = array_from_mem%d_%s(%s, ", indent,
+                             argument->name, argument->type.rank,
+                             bindx_c_type_postfix(&argument->type), argument->name);
 
                     for (i = 0; i < argument->type.rank; ++i) {
-                         fprintf(fp, "%s", argument->type.dimens[i]);
+                         bxprintf(fp, "%s", argument->type.dimens[i]);
                          if (i + 1 < argument->type.rank)
-                              fprintf(fp, ", ");
+                              bxprintf(fp, ", ");
                     }
 
-                    fprintf(fp, ");\n");
+                    bxprintf(fp, ");\n");
                }
           }
 
-          fprintf(fp, "%sif (%s_%s(d", indent, d->prefix, subprogram->name);
+          bxprintf(fp, "%sif (%s_%s(d", indent, d->prefix, subprogram->name);
 
           list_for_each(subprogram->args, argument) {
-               fprintf(fp, ", %s", argument->name);
-               if (argument->type.rank > 1)
-                    fprintf(fp, "2");
+               bxprintf(fp, ", %s", argument->name);
+               if (argument_is_pointer_array(argument))
+                    bxprintf(fp, "2");
+               if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_STRIDED)
+                    bxprintf(fp, ", %s_strides", argument->name);
           }
 
-          fprintf(fp, ")) {\n");
+          bxprintf(fp, ")) {\n");
 
-          fprintf(fp, "%s%sfprintf(stderr, \"ERROR: %s_%s()\\n\");\n", indent, indent,
-                  d->prefix, subprogram->name);
-          fprintf(fp, "%s%sreturn -1;\n", indent, indent);
+          bxprintf(fp, "%s%sfprintf(stderr, \"ERROR: %s_%s()\\n\");\n", indent, indent,
+                   d->prefix, subprogram->name);
+          bxprintf(fp, "%s%sreturn -1;\n", indent, indent);
 
-          fprintf(fp, "%s}\n", indent);
+          bxprintf(fp, "%s}\n", indent);
 
           list_for_each(subprogram->args, argument) {
-               if (argument->type.rank > 1)
-                    fprintf(fp, "%sfree_array%d_d(%s2);\n", indent,
-                            argument->type.rank, argument->name);
+               if (argument_is_pointer_array(argument))
+                    bxprintf(fp, "%sfree_array%d_%s(%s2);\n", indent,
+                             argument->type.rank, bindx_c_type_postfix(&argument->type),
+                             argument->name);
           }
 
-          fprintf(fp, "%sreturn 0;\n", indent);
+          bxprintf(fp, "%sreturn 0;\n", indent);
 
-          fprintf(fp, "}\n");
-          fprintf(fp, "\n");
-          fprintf(fp, "\n");
+          bxprintf(fp, "}\n");
+          bxprintf(fp, "\n");
+          bxprintf(fp, "\n");
      }
 
      return 0;
@@ -258,7 +334,7 @@ static int bindx_write_c_util_functions(FILE *fp, const bindx_data *d,
 
 
 
-static int write_public_list(FILE *fp, const bindx_data *d,
+static int write_public_list(bindx_buffer_data *fp, const bindx_data *d,
                              const structure_data *structs,
                              const subprogram_data *subs)
 {
@@ -267,28 +343,34 @@ static int write_public_list(FILE *fp, const bindx_data *d,
 
      structure_data *structure;
      subprogram_data *subprogram;
+     const subprogram_data *clone;
+
+     clone = bindx_clone_subprogram(d);
 
      if (! list_is_empty(structs) || ! list_is_empty(subs)) {
-          fprintf(fp, "public :: ");
+          bxprintf(fp, "public :: ");
 
           list_for_each(structs, structure) {
-               fprintf(fp, "%s%s", indent, structure->name);
+               bxprintf(fp, "%s%s", indent, structure->name);
                if (! list_is_last_elem(structs, structure))
-                    fprintf(fp, ", &\n");
+                    bxprintf(fp, ", &\n");
                indent = indent2;
           }
 
           if (! list_is_empty(subs))
-               fprintf(fp, ", &\n");
+               bxprintf(fp, ", &\n");
 
           list_for_each(subs, subprogram) {
-               fprintf(fp, "%s%s_%s_f90", indent, d->prefix, subprogram->name);
+               bxprintf(fp, "%s%s_%s_f90", indent, d->prefix, subprogram->name);
                if (! list_is_last_elem(subs, subprogram))
-                    fprintf(fp, ", &\n");
+                    bxprintf(fp, ", &\n");
                indent = indent2;
           }
 
-          fprintf(fp, "\n");
+          if (clone)
+               bxprintf(fp, ", &\n%s%s_%s_f90", indent2, d->prefix, clone->name);
+
+          bxprintf(fp, "\n");
      }
 
      return 0;
@@ -296,7 +378,7 @@ static int write_public_list(FILE *fp, const bindx_data *d,
 
 
 
-static int write_enumerations(FILE *fp, const bindx_data *d,
+static int write_enumerations(bindx_buffer_data *fp, const bindx_data *d,
                               const enumeration_data *enums)
 {
      enum_member_data *enum_member;
@@ -304,10 +386,10 @@ static int write_enumerations(FILE *fp, const bindx_data *d,
 
      list_for_each(enums, enumeration) {
           list_for_each(enumeration->members, enum_member)
-               fprintf(fp, "integer, parameter, public :: %s_%s = %d_int64\n",
-                       d->PREFIX, enum_member->name, enum_member->value);
+               bxprintf(fp, "integer, parameter, public :: %s_%s = %d_int64\n",
+                        d->PREFIX, enum_member->name, enum_member->value);
 
-          fprintf(fp, "\n");
+          bxprintf(fp, "\n");
      }
 
      return 0;
@@ -315,15 +397,51 @@ static int write_enumerations(FILE *fp, const bindx_data *d,
 
 
 
-static int write_structures(FILE *fp, const bindx_data *d,
+static int write_structures(bindx_buffer_data *fp, const bindx_data *d,
                             const structure_data *structs)
 {
+     int i;
+     int n_pads;
+
+     size_t offset;
+
+     field_data *field;
      structure_data *structure;
 
      list_for_each(structs, structure) {
-          fprintf(fp, "type, bind(c) :: %s\n", structure->name);
-          fprintf(fp, "     integer(c_signed_char) :: data(%lu)\n", structure->size);
-          fprintf(fp, "end type %s\n", structure->name);
+          bxprintf(fp, "type, bind(c) :: %s\n", structure->name);
+
+          if (list_is_empty(structure->fields))
+               bxprintf(fp, "     integer(c_signed_char) :: data(%lu)\n", structure->size);
+          else {
+               /* Explicit padding keeps the field offsets given in the definition. */
+               n_pads = 0;
+               offset = 0;
+               list_for_each(structure->fields, field) {
+                    if (field->offset > offset)
+                         bxprintf(fp, "     integer(c_signed_char) :: pad_%d(%lu)\n", n_pads++,
+                                  field->offset - offset);
+                    bxprintf(fp, "     ");
+                    write_type_bind_c(fp, &field->type);
+                    bxprintf(fp, " :: %s", field->name);
+                    if (field->type.rank > 0) {
+                         bxprintf(fp, "(");
+                         for (i = field->type.rank - 1; i >= 0; --i) {
+                              bxprintf(fp, "%s", field->type.dimens[i]);
+                              if (i > 0)
+                                   bxprintf(fp, ",");
+                         }
+                         bxprintf(fp, ")");
+                    }
+                    bxprintf(fp, "\n");
+                    offset = field->offset + field_size(field);
+               }
+               if (structure->size > offset)
+                    bxprintf(fp, "     integer(c_signed_char) :: pad_%d(%lu)\n", n_pads++,
+                             structure->size - offset);
+          }
+
+          bxprintf(fp, "end type %s\n", structure->name);
      }
 
      return 0;
@@ -331,7 +449,7 @@ static int write_structures(FILE *fp, const bindx_data *d,
 
 
 
-static int write_interfaces(FILE *fp, const bindx_data *d,
+static int write_interfaces(bindx_buffer_data *fp, const bindx_data *d,
                             const subprogram_data *subs)
 {
      char *indent = "     ";
@@ -340,55 +458,58 @@ static int write_interfaces(FILE *fp, const bindx_data *d,
      subprogram_data *subprogram;
 
      list_for_each(subs, subprogram) {
-          fprintf(fp, "interface\n");
+          bxprintf(fp, "interface\n");
 
-          fprintf(fp, "%s", indent);
+          bxprintf(fp, "%s", indent);
+          if (is_pure(subprogram))
+               bxprintf(fp, "pure ");
           write_type_bind_c(fp, &subprogram->type);
-          fprintf(fp, " ");
+          bxprintf(fp, " ");
 
-          fprintf(fp, "function %s_%s", d->prefix, subprogram->name);
-          if (subprogram->has_multi_dimen_args)
-               fprintf(fp, "_bindx_f90");
-          fprintf(fp, "(d");
+          bxprintf(fp, "function %s_%s", d->prefix, subprogram->name);
+          if (needs_c_glue(subprogram))
+               bxprintf(fp, "_bindx_f90");
+          bxprintf(fp, "(d");
 
           list_for_each(subprogram->args, argument)
-               fprintf(fp, ", %s", argument->name);
-
-          fprintf(fp, ") bind(c, name = \"%s_%s", d->prefix, subprogram->name);
-          if (subprogram->has_multi_dimen_args)
-               fprintf(fp, "_bindx_f90");
-          fprintf(fp, "\")\n");
-          fprintf(fp, "%suse iso_c_binding\n", indent);
-          fprintf(fp, "%simport %s_type\n", indent, d->prefix);
+               bxprintf(fp, ", %s", argument->name);
+
+          bxprintf(fp, ") bind(c, name = \"%s_%s", d->prefix, subprogram->name);
+          if (needs_c_glue(subprogram))
+               bxprintf(fp, "_bindx_f90");
+          bxprintf(fp, "\")\n");
+          bxprintf(fp, "%suse iso_c_binding\n", indent);
+          bxprintf(fp, "%simport %s_type\n", indent, d->prefix);
           if (d->include)
-               fprintf(fp, "%simport %s_type\n", indent, d->include);
-          fprintf(fp, "%simplicit none\n", indent);
+               bxprintf(fp, "%simport %s_type\n", indent, d->include);
+          bxprintf(fp, "%simplicit none\n", indent);
 
-          fprintf(fp, "%stype(%s_type), intent(inout) :: d\n", indent, d->prefix);
+          bxprintf(fp, "%stype(%s_type), intent(%s) :: d\n", indent, d->prefix,
+                   is_pure(subprogram) ? "in" : "inout");
 
           list_for_each(subprogram->args, argument) {
-               fprintf(fp, "%s", indent);
+               bxprintf(fp, "%s", indent);
                write_type_bind_c(fp, &argument->type);
-               fprintf(fp, ", ");
+               bxprintf(fp, ", ");
                write_usage(fp, argument->usage);
                if (argument->type.rank == 0 &&
                    argument->usage == LEX_SUBPROGRAM_ARGUMENT_USAGE_IN)
-                    fprintf(fp, ", value");
-               fprintf(fp, " :: ");
-               fprintf(fp, "%s", argument->name);
+                    bxprintf(fp, ", value");
+               bxprintf(fp, " :: ");
+               bxprintf(fp, "%s", argument->name);
                if (argument->type.type != LEX_BINDX_TYPE_STRUCTURE &&
                    argument->type.rank > 0)
-                    fprintf(fp, "(*)");
-               fprintf(fp, "\n");
+                    bxprintf(fp, "(*)");
+               bxprintf(fp, "\n");
           }
 
-          fprintf(fp, "%send function %s_%s", indent, d->prefix, subprogram->name);
-          if (subprogram->has_multi_dimen_args)
-               fprintf(fp, "_bindx_f90");
-          fprintf(fp, "\n");
-          fprintf(fp, "end interface\n");
-          fprintf(fp, "\n");
-          fprintf(fp, "\n");
+          bxprintf(fp, "%send function %s_%s", indent, d->prefix, subprogram->name);
+          if (needs_c_glue(subprogram))
+               bxprintf(fp, "_bindx_f90");
+          bxprintf(fp, "\n");
+          bxprintf(fp, "end interface\n");
+          bxprintf(fp, "\n");
+          bxprintf(fp, "\n");
      }
 
      return 0;
@@ -396,7 +517,7 @@ static int write_interfaces(FILE *fp, const bindx_data *d,
 
 
 
-static int write_subprograms(FILE *fp, const bindx_data *d,
+static int write_subprograms(bindx_buffer_data *fp, const bindx_data *d,
                              const subprogram_data *subs)
 {
      char *indent = "     ";
@@ -405,66 +526,70 @@ static int write_subprograms(FILE *fp, const bindx_data *d,
      subprogram_data *subprogram;
 
      list_for_each(subs, subprogram) {
+          if (is_pure(subprogram))
+               bxprintf(fp, "pure ");
+
           if (subprogram->has_return_value ||
               subprogram_n_scaler_out_args(subprogram) == 1) {
                write_type(fp, &subprogram->type);
-               fprintf(fp, " function %s_%s_f90(d", d->prefix, subprogram->name);
+               bxprintf(fp, " function %s_%s_f90(d", d->prefix, subprogram->name);
           }
           else
-               fprintf(fp, "subroutine %s_%s_f90(d", d->prefix, subprogram->name);
+               bxprintf(fp, "subroutine %s_%s_f90(d", d->prefix, subprogram->name);
 
           list_for_each(subprogram->args, argument)
-               fprintf(fp, ", %s", argument->name);
+               bxprintf(fp, ", %s", argument->name);
 
           if (! subprogram->has_return_value &&
               subprogram_n_scaler_out_args(subprogram) != 1)
-               fprintf(fp, ", error");
+               bxprintf(fp, ", error");
 
-          fprintf(fp, ")\n");
+          bxprintf(fp, ")\n");
 
-          fprintf(fp, "%simplicit none\n", indent);
+          bxprintf(fp, "%simplicit none\n", indent);
 
-          fprintf(fp, "%stype(%s_type), intent(inout) :: d\n", indent, d->prefix);
+          bxprintf(fp, "%stype(%s_type), intent(%s) :: d\n", indent, d->prefix,
+                   is_pure(subprogram) ? "in" : "inout");
 
           list_for_each(subprogram->args, argument) {
-               fprintf(fp, "%s", indent);
+               bxprintf(fp, "%s", indent);
                write_type(fp, &argument->type);
-               fprintf(fp, ", ");
+               bxprintf(fp, ", ");
                write_usage(fp, argument->usage);
-               fprintf(fp, " :: ");
-               fprintf(fp, "%s", argument->name);
+               bxprintf(fp, " :: ");
+               bxprintf(fp, "%s", argument->name);
                if (argument->type.type != LEX_BINDX_TYPE_STRUCTURE)
                     write_dimens(fp, &argument->type);
-               fprintf(fp, "\n");
+               bxprintf(fp, "\n");
           }
 
           if (! subprogram->has_return_value &&
               subprogram_n_scaler_out_args(subprogram) != 1)
-               fprintf(fp, "%sinteger, intent(out) :: error\n", indent);
+               bxprintf(fp, "%sinteger, intent(out) :: error\n", indent);
 
           if (subprogram->has_return_value ||
               subprogram_n_scaler_out_args(subprogram) == 1)
-               fprintf(fp, "%s%s_%s_f90 = ", indent, d->prefix, subprogram->name);
+               bxprintf(fp, "%s%s_%s_f90 = ", indent, d->prefix, subprogram->name);
           else
-               fprintf(fp, "%serror = ", indent);
+               bxprintf(fp, "%serror = ", indent);
 
-          fprintf(fp, "%s_%s", d->prefix, subprogram->name);
-          if (subprogram->has_multi_dimen_args)
-               fprintf(fp, "_bindx_f90");
-          fprintf(fp, "(d");
+          bxprintf(fp, "%s_%s", d->prefix, subprogram->name);
+          if (needs_c_glue(subprogram))
+               bxprintf(fp, "_bindx_f90");
+          bxprintf(fp, "(d");
 
           list_for_each(subprogram->args, argument)
-               fprintf(fp, ", %s", argument->name);
+               bxprintf(fp, ", %s", argument->name);
 
-          fprintf(fp, ")\n");
+          bxprintf(fp, ")\n");
 
           if (subprogram->has_return_value ||
               subprogram_n_scaler_out_args(subprogram) == 1)
-               fprintf(fp, "end function %s_%s_f90\n", d->prefix, subprogram->name);
+               bxprintf(fp, "end function %s_%s_f90\n", d->prefix, subprogram->name);
           else
-               fprintf(fp, "end subroutine %s_%s_f90\n", d->prefix, subprogram->name);
-          fprintf(fp, "\n");
-          fprintf(fp, "\n");
+               bxprintf(fp, "end subroutine %s_%s_f90\n", d->prefix, subprogram->name);
+          bxprintf(fp, "\n");
+          bxprintf(fp, "\n");
      }
 
      return 0;
@@ -472,57 +597,118 @@ static int write_subprograms(FILE *fp, const bindx_data *d,
 
 
 
-int bindx_write_f90(FILE **fp, const bindx_data *d, const char *name)
+/*
+ * The clone subprogram takes a second instance so it gets its own interface and
+ * wrapper rather than going through subs_all.
+ */
+static int write_clone_interface(bindx_buffer_data *fp, const bindx_data *d)
+{
+     char *indent = "     ";
+
+     const subprogram_data *subprogram;
+
+     subprogram = bindx_clone_subprogram(d);
+     if (subprogram == NULL)
+          return 0;
+
+     bxprintf(fp, "interface\n");
+     bxprintf(fp, "%s", indent);
+     write_type_bind_c(fp, &subprogram->type);
+     bxprintf(fp, " function %s_%s(d, src) bind(c, name = \"%s_%s\")\n",
+              d->prefix, subprogram->name, d->prefix, subprogram->name);
+     bxprintf(fp, "%suse iso_c_binding\n", indent);
+     bxprintf(fp, "%simport %s_type\n", indent, d->prefix);
+     bxprintf(fp, "%simplicit none\n", indent);
+     bxprintf(fp, "%stype(%s_type), intent(inout) :: d\n", indent, d->prefix);
+     bxprintf(fp, "%stype(%s_type), intent(inout) :: src\n", indent, d->prefix);
+     bxprintf(fp, "%send function %s_%s\n", indent, d->prefix, subprogram->name);
+     bxprintf(fp, "end interface\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+     return 0;
+}
+
+
+
+static int write_clone_subprogram(bindx_buffer_data *fp, const bindx_data *d)
+{
+     char *indent = "     ";
+
+     const subprogram_data *subprogram;
+
+     subprogram = bindx_clone_subprogram(d);
+     if (subprogram == NULL)
+          return 0;
+
+     bxprintf(fp, "subroutine %s_%s_f90(d, src, error)\n", d->prefix, subprogram->name);
+     bxprintf(fp, "%simplicit none\n", indent);
+     bxprintf(fp, "%stype(%s_type), intent(inout) :: d\n", indent, d->prefix);
+     bxprintf(fp, "%stype(%s_type), intent(inout) :: src\n", indent, d->prefix);
+     bxprintf(fp, "%sinteger, intent(out) :: error\n", indent);
+     bxprintf(fp, "%serror = %s_%s(d, src)\n", indent, d->prefix, subprogram->name);
+     bxprintf(fp, "end subroutine %s_%s_f90\n", d->prefix, subprogram->name);
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+     return 0;
+}
+
+
+
+int bindx_write_f90(bindx_buffer_data **fp, const bindx_data *d, const char *name)
 {
      bindx_write_c_header_top(fp[0]);
-     fprintf(fp[0], "\n");
+     bxprintf(fp[0], "\n");
 
      bindx_write_c_util_header(fp[0], d);
      bindx_write_c_util_functions(fp[0], d, &d->subs_all);
      bindx_write_c_util_trailer(fp[0], d);
 
      write_header_top(fp[1]);
-     fprintf(fp[1], "\n");
+     bxprintf(fp[1], "\n");
 
-     fprintf(fp[1], "module %s\n", name);
-     fprintf(fp[1], "\n");
-     fprintf(fp[1], "use iso_c_binding\n");
-     fprintf(fp[1], "use iso_fortran_env\n");
+     bxprintf(fp[1], "module %s\n", name);
+     bxprintf(fp[1], "\n");
+     bxprintf(fp[1], "use iso_c_binding\n");
+     bxprintf(fp[1], "use iso_fortran_env\n");
      if (d->include)
-          fprintf(fp[1], "use %s_int_f90\n", d->include);
-     fprintf(fp[1], "\n");
-     fprintf(fp[1], "\n");
+          bxprintf(fp[1], "use %s_int_f90\n", d->include);
+     bxprintf(fp[1], "\n");
+     bxprintf(fp[1], "\n");
 
-     fprintf(fp[1], "private\n");
-     fprintf(fp[1], "\n");
+     bxprintf(fp[1], "private\n");
+     bxprintf(fp[1], "\n");
      write_public_list(fp[1], d, &d->structs, &d->subs_all);
-     fprintf(fp[1], "\n");
-     fprintf(fp[1], "\n");
-     fprintf(fp[1], "\n");
+     bxprintf(fp[1], "\n");
+     bxprintf(fp[1], "\n");
+     bxprintf(fp[1], "\n");
 
      write_header(fp[1]);
      write_enumerations(fp[1], d, &d->enums);
-     fprintf(fp[1], "\n");
-     fprintf(fp[1], "\n");
+     bxprintf(fp[1], "\n");
+     bxprintf(fp[1], "\n");
 
      write_header(fp[1]);
      write_structures(fp[1], d, &d->structs);
-     fprintf(fp[1], "\n");
-     fprintf(fp[1], "\n");
-     fprintf(fp[1], "\n");
+     bxprintf(fp[1], "\n");
+     bxprintf(fp[1], "\n");
+     bxprintf(fp[1], "\n");
 
      write_header(fp[1]);
      write_interfaces(fp[1], d, &d->subs_all);
-     fprintf(fp[1], "\n");
+     write_clone_interface(fp[1], d);
+     bxprintf(fp[1], "\n");
 
      write_header(fp[1]);
-     fprintf(fp[1], "contains\n");
-     fprintf(fp[1], "\n");
-     fprintf(fp[1], "\n");
+     bxprintf(fp[1], "contains\n");
+     bxprintf(fp[1], "\n");
+     bxprintf(fp[1], "\n");
 
      write_subprograms(fp[1], d, &d->subs_all);
+     write_clone_subprogram(fp[1], d);
 
-     fprintf(fp[1], "end module %s\n", name);
+     bxprintf(fp[1], "end module %s\n", name);
 
      return 0;
 }
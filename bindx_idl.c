@@ -27,8 +27,16 @@ static const char *get_idl_type(const type_data *d)
 */
           case LEX_BINDX_TYPE_INT:
                return "IDL_TYP_LONG";
+          case LEX_BINDX_TYPE_INT64:
+               return "IDL_TYP_LONG64";
+          case LEX_BINDX_TYPE_SIZE_T:
+               return "IDL_TYP_ULONG64";
+          case LEX_BINDX_TYPE_FLOAT:
+               return "IDL_TYP_FLOAT";
           case LEX_BINDX_TYPE_DOUBLE:
                return "IDL_TYP_DOUBLE";
+          case LEX_BINDX_TYPE_COMPLEX:
+               return "IDL_TYP_DCOMPLEX";
 /*
           case LEX_BINDX_TYPE_STRUCTURE:
                break;
@@ -54,8 +62,16 @@ static const char *get_idl_type_alt(const type_data *d)
 */
           case LEX_BINDX_TYPE_INT:
                return "IDL_TYP_INT";
+          case LEX_BINDX_TYPE_INT64:
+               return "IDL_TYP_LONG";
+          case LEX_BINDX_TYPE_SIZE_T:
+               return "IDL_TYP_LONG64";
+          case LEX_BINDX_TYPE_FLOAT:
+               return "IDL_TYP_DOUBLE";
           case LEX_BINDX_TYPE_DOUBLE:
                return "IDL_TYP_FLOAT";
+          case LEX_BINDX_TYPE_COMPLEX:
+               return "IDL_TYP_COMPLEX";
 /*
           case LEX_BINDX_TYPE_STRUCTURE:
                break;
@@ -81,8 +97,16 @@ static const char *get_idl_value_var(const type_data *d)
 */
           case LEX_BINDX_TYPE_INT:
                return "l";
+          case LEX_BINDX_TYPE_INT64:
+               return "l64";
+          case LEX_BINDX_TYPE_SIZE_T:
+               return "ul64";
+          case LEX_BINDX_TYPE_FLOAT:
+               return "f";
           case LEX_BINDX_TYPE_DOUBLE:
                return "d";
+          case LEX_BINDX_TYPE_COMPLEX:
+               return "dcmp";
 /*
           case LEX_BINDX_TYPE_STRUCTURE:
                break;
@@ -108,8 +132,16 @@ static const char *get_idl_value_var_alt(const type_data *d)
 */
           case LEX_BINDX_TYPE_INT:
                return "i";
+          case LEX_BINDX_TYPE_INT64:
+               return "l";
+          case LEX_BINDX_TYPE_SIZE_T:
+               return "l64";
+          case LEX_BINDX_TYPE_FLOAT:
+               return "d";
           case LEX_BINDX_TYPE_DOUBLE:
                return "f";
+          case LEX_BINDX_TYPE_COMPLEX:
+               return "cmp";
 /*
           case LEX_BINDX_TYPE_STRUCTURE:
                break;
@@ -135,8 +167,16 @@ static const char *get_idl_type_name(const type_data *d)
 */
           case LEX_BINDX_TYPE_INT:
                return "long";
+          case LEX_BINDX_TYPE_INT64:
+               return "long64";
+          case LEX_BINDX_TYPE_SIZE_T:
+               return "ulong64";
+          case LEX_BINDX_TYPE_FLOAT:
+               return "float";
           case LEX_BINDX_TYPE_DOUBLE:
                return "double";
+          case LEX_BINDX_TYPE_COMPLEX:
+               return "dcomplex";
 /*
           case LEX_BINDX_TYPE_STRUCTURE:
                break;
@@ -162,8 +202,16 @@ static const char *get_idl_type_name_alt(const type_data *d)
 */
           case LEX_BINDX_TYPE_INT:
                return "int";
+          case LEX_BINDX_TYPE_INT64:
+               return "long";
+          case LEX_BINDX_TYPE_SIZE_T:
+               return "long64";
+          case LEX_BINDX_TYPE_FLOAT:
+               return "double";
           case LEX_BINDX_TYPE_DOUBLE:
                return "float";
+          case LEX_BINDX_TYPE_COMPLEX:
+               return "complex";
 /*
           case LEX_BINDX_TYPE_STRUCTURE:
                break;
@@ -178,32 +226,32 @@ static const char *get_idl_type_name_alt(const type_data *d)
 
 
 
-static int write_dlm_header_top(FILE *fp)
+static int write_dlm_header_top(bindx_buffer_data *fp)
 {
-     fprintf(fp, "#*******************************************************************************\n");
-     fprintf(fp, "# This file was generated by bindx version %s.  Edit at your own risk.\n", bindx_version());
-     fprintf(fp, "#*******************************************************************************\n");
+     bxprintf(fp, "#*******************************************************************************\n");
+     bxprintf(fp, "# This file was generated by bindx version %s.  Edit at your own risk.\n", bindx_version());
+     bxprintf(fp, "#*******************************************************************************\n");
 
      return 0;
 }
 
 
 
-static int write_prototypes(FILE *fp, const bindx_data *d,
+static int write_prototypes(bindx_buffer_data *fp, const bindx_data *d,
                             const subprogram_data *subs, int indent)
 {
      subprogram_data *subprogram;
 
      list_for_each(subs, subprogram)
-          fprintf(fp, "%svoid IDL_CDECL %s_%s_dlm(int argc, IDL_VPTR argv[], char *argk);\n",
-                  bxis(indent), d->prefix, subprogram->name);
+          bxprintf(fp, "%svoid IDL_CDECL %s_%s_dlm(int argc, IDL_VPTR argv[], char *argk);\n",
+                   bxis(indent), d->prefix, subprogram->name);
 
      return 0;
 }
 
 
 
-static int write_idl_sysfun_defs(FILE *fp, const bindx_data *d,
+static int write_idl_sysfun_defs(bindx_buffer_data *fp, const bindx_data *d,
                                  const subprogram_data *subs, int indent,
                                  int for_version_5_3)
 {
@@ -229,16 +277,16 @@ static int write_idl_sysfun_defs(FILE *fp, const bindx_data *d,
                count++;
 
           if (! for_version_5_3)
-               fprintf(fp, "%s{{(IDL_FUN_RET) %s_%s_dlm}, \"%s_%s\", %d, %d, 0}",
-                       bxis(indent), d->prefix, subprogram->name, PREFIX, NAME_,
-                       count, count);
+               bxprintf(fp, "%s{{(IDL_FUN_RET) %s_%s_dlm}, \"%s_%s\", %d, %d, 0}",
+                        bxis(indent), d->prefix, subprogram->name, PREFIX, NAME_,
+                        count, count);
           else
-               fprintf(fp, "%s{{(IDL_FUN_RET) %s_%s_dlm}, \"%s_%s\", %d, %d, 0, 0}",
-                       bxis(indent), d->prefix, subprogram->name, PREFIX, NAME_,
-                       count, count);
+               bxprintf(fp, "%s{{(IDL_FUN_RET) %s_%s_dlm}, \"%s_%s\", %d, %d, 0, 0}",
+                        bxis(indent), d->prefix, subprogram->name, PREFIX, NAME_,
+                        count, count);
           if (! list_is_last_elem(subs, subprogram))
-               fprintf(fp, ",");
-          fprintf(fp, "\n");
+               bxprintf(fp, ",");
+          bxprintf(fp, "\n");
     }
 
      return 0;
@@ -246,210 +294,308 @@ static int write_idl_sysfun_defs(FILE *fp, const bindx_data *d,
 
 
 
-static int write_parse_argument_enum_scalar(FILE *fp, int indent, int i_arg,
+static int write_idl_value_get(bindx_buffer_data *fp, int indent, const char *name,
+                               int i_arg, const type_data *type, const char *value_var)
+{
+     if (type->type == LEX_BINDX_TYPE_COMPLEX)
+          bxprintf(fp, "%s%s = argv[%d]->value.%s.r + argv[%d]->value.%s.i * _Complex_I;\n",
+                   bxis(indent), name, i_arg, value_var, i_arg, value_var);
+     else
+          bxprintf(fp, "%s%s = argv[%d]->value.%s;\n", bxis(indent), name, i_arg, value_var);
+
+     return 0;
+}
+
+
+
+static int write_idl_value_set(bindx_buffer_data *fp, int indent, const type_data *type,
+                               const char *name)
+{
+     if (type->type == LEX_BINDX_TYPE_COMPLEX) {
+          bxprintf(fp, "%svar.value.%s.r = creal(%s);\n", bxis(indent), get_idl_value_var(type), name);
+          bxprintf(fp, "%svar.value.%s.i = cimag(%s);\n", bxis(indent), get_idl_value_var(type), name);
+     }
+     else
+          bxprintf(fp, "%svar.value.%s = %s;\n", bxis(indent), get_idl_value_var(type), name);
+
+     return 0;
+}
+
+
+
+/* Position of interface dimension i in the IDL dimension list. */
+static int idl_dimen_index(const argument_data *argument, int i)
+{
+     if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_COL_MAJOR)
+          return i;
+
+     return argument->type.rank - i - 1;
+}
+
+
+
+static int write_parse_argument_enum_scalar(bindx_buffer_data *fp, int indent, int i_arg,
                                             argument_data *argument)
 {
-     fprintf(fp, "%sIDL_ENSURE_SCALAR(argv[%d]);\n", bxis(indent), i_arg);
-     fprintf(fp, "%sif (argv[%d]->type != IDL_TYP_STRING)\n", bxis(indent), i_arg);
-          fprintf(fp, "%sIDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP, \"ERROR: %s must be of type string\");\n", bxis(indent + 1), argument->name);
-     fprintf(fp, "%sif ((r = %s(IDL_STRING_STR(&argv[%d]->value.str))) == -1)\n", bxis(indent), argument->options.enum_name_to_value, i_arg);
-          fprintf(fp, "%sIDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP, \"ERROR: %s()\");\n", bxis(indent + 1), argument->options.enum_name_to_value);
-     fprintf(fp, "%s%s = r;\n", bxis(indent), argument->name);
+     bxprintf(fp, "%sIDL_ENSURE_SCALAR(argv[%d]);\n", bxis(indent), i_arg);
+     bxprintf(fp, "%sif (argv[%d]->type != IDL_TYP_STRING)\n", bxis(indent), i_arg);
+          bxprintf(fp, "%sIDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP, \"ERROR: %s must be of type string\");\n", bxis(indent + 1), argument->name);
+     bxprintf(fp, "%sif ((r = %s(IDL_STRING_STR(&argv[%d]->value.str))) == -1)\n", bxis(indent), argument->options.enum_name_to_value, i_arg);
+          bxprintf(fp, "%sIDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP, \"ERROR: %s()\");\n", bxis(indent + 1), argument->options.enum_name_to_value);
+     bxprintf(fp, "%s%s = r;\n", bxis(indent), argument->name);
 
      return 0;
 }
 
 
 
-static int write_parse_argument_enum_mask_scalar(FILE *fp, int indent, int i_arg,
+static int write_parse_argument_enum_mask_scalar(bindx_buffer_data *fp, int indent, int i_arg,
                                                  argument_data *argument)
 {
-     fprintf(fp, "%s{\n", bxis(indent));
-     fprintf(fp, "%sint i;\n", bxis(indent));
-     fprintf(fp, "%s%s = 0;\n", bxis(indent), argument->name);
-     fprintf(fp, "%sIDL_ENSURE_ARRAY(argv[%d]);\n", bxis(indent), i_arg);
-     fprintf(fp, "%sfor (i = 0; i < argv[%d]->value.arr->n_elts; ++i) {\n", bxis(indent), i_arg);
-          fprintf(fp, "%sif ((r = %s(((IDL_STRING *) argv[%d]->value.arr->data)[i].s)) == -1)\n", bxis(indent + 1), argument->options.enum_name_to_value, i_arg);
-               fprintf(fp, "%sIDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP, \"ERROR: %s()\");\n", bxis(indent + 2), argument->options.enum_name_to_value);
-          fprintf(fp, "%s%s |= r;\n", bxis(indent + 1), argument->name);
-     fprintf(fp, "%s}}\n", bxis(indent));
+     bxprintf(fp, "%s{\n", bxis(indent));
+     bxprintf(fp, "%sint i;\n", bxis(indent));
+     bxprintf(fp, "%s%s = 0;\n", bxis(indent), argument->name);
+     bxprintf(fp, "%sIDL_ENSURE_ARRAY(argv[%d]);\n", bxis(indent), i_arg);
+     bxprintf(fp, "%sfor (i = 0; i < argv[%d]->value.arr->n_elts; ++i) {\n", bxis(indent), i_arg);
+          bxprintf(fp, "%sif ((r = %s(((IDL_STRING *) argv[%d]->value.arr->data)[i].s)) == -1)\n", bxis(indent + 1), argument->options.enum_name_to_value, i_arg);
+               bxprintf(fp, "%sIDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP, \"ERROR: %s()\");\n", bxis(indent + 2), argument->options.enum_name_to_value);
+          bxprintf(fp, "%s%s |= r;\n", bxis(indent + 1), argument->name);
+     bxprintf(fp, "%s}}\n", bxis(indent));
 
      return 0;
 }
 
 
 
-static int write_parse_argument_number_scalar(FILE *fp, int indent, int i_arg,
+static int write_parse_argument_number_scalar(bindx_buffer_data *fp, int indent, int i_arg,
                                               argument_data *argument)
 {
-     fprintf(fp, "%sIDL_ENSURE_SCALAR(argv[%d]);\n", bxis(indent), i_arg);
-     fprintf(fp, "%sif (argv[%d]->type != %s && argv[%d]->type != %s)\n", bxis(indent), i_arg, get_idl_type(&argument->type), i_arg, get_idl_type_alt(&argument->type));
-          fprintf(fp, "%sIDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP, \"ERROR: %s must be of type %s or %s\");\n", bxis(indent + 1), argument->name, get_idl_type_name(&argument->type), get_idl_type_name_alt(&argument->type));
-     fprintf(fp, "%sif (argv[%d]->type == %s)\n", bxis(indent), i_arg, get_idl_type(&argument->type));
-          fprintf(fp, "%s%s = argv[%d]->value.%s;\n", bxis(indent + 1), argument->name, i_arg, get_idl_value_var    (&argument->type));
-     fprintf(fp, "%selse\n", bxis(indent));
-          fprintf(fp, "%s%s = argv[%d]->value.%s;\n", bxis(indent + 1), argument->name, i_arg, get_idl_value_var_alt(&argument->type));
+     bxprintf(fp, "%sIDL_ENSURE_SCALAR(argv[%d]);\n", bxis(indent), i_arg);
+     bxprintf(fp, "%sif (argv[%d]->type != %s && argv[%d]->type != %s)\n", bxis(indent), i_arg, get_idl_type(&argument->type), i_arg, get_idl_type_alt(&argument->type));
+          bxprintf(fp, "%sIDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP, \"ERROR: %s must be of type %s or %s\");\n", bxis(indent + 1), argument->name, get_idl_type_name(&argument->type), get_idl_type_name_alt(&argument->type));
+     bxprintf(fp, "%sif (argv[%d]->type == %s)\n", bxis(indent), i_arg, get_idl_type(&argument->type));
+          write_idl_value_get(fp, indent + 1, argument->name, i_arg, &argument->type, get_idl_value_var    (&argument->type));
+     bxprintf(fp, "%selse\n", bxis(indent));
+          write_idl_value_get(fp, indent + 1, argument->name, i_arg, &argument->type, get_idl_value_var_alt(&argument->type));
 
      return 0;
 }
 
 
 
-static int write_parse_argument_enum_array(FILE *fp, int indent, int i_arg,
+static int write_parse_argument_enum_array(bindx_buffer_data *fp, int indent, int i_arg,
                                            argument_data *argument)
 {
-     fprintf(fp, "%s{\n", bxis(indent));
-     fprintf(fp, "%sint i;\n", bxis(indent));
-     fprintf(fp, "%sIDL_ENSURE_ARRAY(argv[%d]);\n", bxis(indent), i_arg);
-     fprintf(fp, "%sn_%s = argv[%d]->value.arr->n_elts;\n", bxis(indent), argument->name, i_arg);
-     fprintf(fp, "%s%s = malloc(n_%s * sizeof(int));\n", bxis(indent), argument->name, argument->name);
-     fprintf(fp, "%sfor (i = 0; i < argv[%d]->value.arr->n_elts; ++i) {\n", bxis(indent), i_arg);
-          fprintf(fp, "%sif ((r = %s(((IDL_STRING *) argv[%d]->value.arr->data)[i].s)) == -1)\n", bxis(indent + 1), argument->options.enum_name_to_value, i_arg);
-               fprintf(fp, "%sIDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP, \"ERROR: %s()\");\n", bxis(indent + 2), argument->options.enum_name_to_value);
-          fprintf(fp, "%s%s[i] = r;\n", bxis(indent + 1), argument->name);
-     fprintf(fp, "%s}}\n", bxis(indent));
+     bxprintf(fp, "%s{\n", bxis(indent));
+     bxprintf(fp, "%sint i;\n", bxis(indent));
+     bxprintf(fp, "%sIDL_ENSURE_ARRAY(argv[%d]);\n", bxis(indent), i_arg);
+     bxprintf(fp, "%sn_%s = argv[%d]->value.arr->n_elts;\n", bxis(indent), argument->name, i_arg);
+     bxprintf(fp, "%s%s = malloc(n_%s * sizeof(int));\n", bxis(indent), argument->name, argument->name);
+     bxprintf(fp, "%sfor (i = 0; i < argv[%d]->value.arr->n_elts; ++i) {\n", bxis(indent), i_arg);
+          bxprintf(fp, "%sif ((r = %s(((IDL_STRING *) argv[%d]->value.arr->data)[i].s)) == -1)\n", bxis(indent + 1), argument->options.enum_name_to_value, i_arg);
+               bxprintf(fp, "%sIDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP, \"ERROR: %s()\");\n", bxis(indent + 2), argument->options.enum_name_to_value);
+          bxprintf(fp, "%s%s[i] = r;\n", bxis(indent + 1), argument->name);
+     bxprintf(fp, "%s}}\n", bxis(indent));
 
      return 0;
 }
 
 
 
-static int write_parse_argument_number_array(FILE *fp, const bindx_data *d,
+static int write_parse_argument_number_array(bindx_buffer_data *fp, const bindx_data *d,
                                              int indent, int i_arg,
                                              argument_data *argument)
 {
      int j;
 
+     char data[NM];
+
      if (argument->usage == LEX_SUBPROGRAM_ARGUMENT_USAGE_IN) {
-          fprintf(fp, "%sIDL_ENSURE_ARRAY(argv[%d]);\n", bxis(indent), i_arg);
-          fprintf(fp, "%sif (argv[%d]->type != %s)\n", bxis(indent), i_arg, get_idl_type(&argument->type));
-               fprintf(fp, "%sIDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP, \"ERROR: %s must be of type %s\");\n", bxis(indent + 1), argument->name, get_idl_type_name(&argument->type));
-          fprintf(fp, "%sif (argv[%d]->value.arr->n_dim != %d)\n", bxis(indent), i_arg, argument->type.rank);
-               fprintf(fp, "%sIDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP, \"ERROR: %s must be an array with 2 dimensions\");\n", bxis(indent + 1), argument->name);
+          bxprintf(fp, "%sIDL_ENSURE_ARRAY(argv[%d]);\n", bxis(indent), i_arg);
+          bxprintf(fp, "%sif (argv[%d]->type != %s)\n", bxis(indent), i_arg, get_idl_type(&argument->type));
+               bxprintf(fp, "%sIDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP, \"ERROR: %s must be of type %s\");\n", bxis(indent + 1), argument->name, get_idl_type_name(&argument->type));
+          bxprintf(fp, "%sif (argv[%d]->value.arr->n_dim != %d)\n", bxis(indent), i_arg, argument->type.rank);
+               bxprintf(fp, "%sIDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP, \"ERROR: %s must be an array with 2 dimensions\");\n", bxis(indent + 1), argument->name);
 
           for (j = 0; j < argument->type.rank; ++j) {
-               fprintf(fp, "%sif (argv[%d]->value.arr->dim[%d] != (%s))\n", bxis(indent), i_arg, argument->type.rank - j - 1, argument->type.dimens[j]);
-                    fprintf(fp, "%sIDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP, \"ERROR: %s dimension %d must have %s elements\");\n", bxis(indent + 1), argument->name, argument->type.rank - j, argument->type.dimens[j]);
+               bxprintf(fp, "%sif (argv[%d]->value.arr->dim[%d] != dimens[%d])\n", bxis(indent), i_arg, idl_dimen_index(argument, j), argument->i_dimens[j]);
+                    bxprintf(fp, "%sIDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP, \"ERROR: %s dimension %d must have %s elements\");\n", bxis(indent + 1), argument->name, argument->type.rank - j, argument->type.dimens[j]);
           }
 
-          if (argument->type.rank == 1) {
-               fprintf(fp, "%s%s = (", bxis(indent), argument->name);
-               bindx_write_c_declaration(fp, d, &argument->type, NULL);
-               fprintf(fp, ") argv[%d]->value.arr->data;\n", i_arg);
+          if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_ALIGN) {
+               sprintf(data, "%s_aligned", argument->name);
+               bxprintf(fp, "%s%s = argv[%d]->value.arr->data;\n", bxis(indent), data, i_arg);
+               bxprintf(fp, "%sif ((size_t) %s %% %d != 0) {\n", bxis(indent), data, argument->options.align);
+               bxprintf(fp, "%sif (posix_memalign(&%s, %d, argv[%d]->value.arr->arr_len) != 0)\n",
+                        bxis(indent + 1), data, argument->options.align, i_arg);
+                    bxprintf(fp, "%sIDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP, \"ERROR: posix_memalign()\");\n", bxis(indent + 2));
+               bxprintf(fp, "%smemcpy(%s, argv[%d]->value.arr->data, argv[%d]->value.arr->arr_len);\n",
+                        bxis(indent + 1), data, i_arg, i_arg);
+               bxprintf(fp, "%s}\n", bxis(indent));
+          }
+          else
+               sprintf(data, "argv[%d]->value.arr->data", i_arg);
+
+          if (! argument_is_pointer_array(argument)) {
+               bxprintf(fp, "%s%s = (", bxis(indent), argument->name);
+               bindx_write_c_argument_declaration(fp, d, argument);
+               bxprintf(fp, ") %s;\n", data);
           }
           else {
                for (j = 0; j < argument->type.rank; ++j)
-                    fprintf(fp, "%sdim[%d] = %s;\n", bxis(indent), j, argument->type.dimens[j]);
-               fprintf(fp, "%s%s = (", bxis(indent), argument->name);
+                    bxprintf(fp, "%sdim[%d] = dimens[%d];\n", bxis(indent), j, argument->i_dimens[j]);
+               bxprintf(fp, "%s%s = (", bxis(indent), argument->name);
                bindx_write_c_declaration(fp, d, &argument->type, NULL);
-               fprintf(fp, ") array_from_mem((void *) argv[%d]->value.arr->data, %d, dim, sizeof(", i_arg, argument->type.rank);
+               bxprintf(fp, ") array_from_mem((void *) %s, %d, dim, sizeof(", data, argument->type.rank);
                bindx_write_c_type(fp, d, &argument->type, NULL);
-               fprintf(fp, "), 1);\n");
+               bxprintf(fp, "), 1);\n");
           }
      }
      else {
-          if (argument->type.rank == 1)
-               fprintf(fp, "%s%s = malloc(", bxis(indent), argument->name);
+          if (! argument_is_pointer_array(argument))
+               sprintf(data, "%s", argument->name);
+          else
+               sprintf(data, "%s_data", argument->name);
+
+          if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_ALIGN)
+               bxprintf(fp, "%sif (posix_memalign((void **) &%s, %d, ", bxis(indent), data,
+                        argument->options.align);
           else
-               fprintf(fp, "%s%s_data = malloc(", bxis(indent), argument->name);
+               bxprintf(fp, "%s%s = malloc(", bxis(indent), data);
 
           for (j = 0; j < argument->type.rank; ++j)
-               fprintf(fp, "(%s) * ", argument->type.dimens[j]);
-          fprintf(fp, "sizeof(");
+               bxprintf(fp, "dimens[%d] * ", argument->i_dimens[j]);
+          bxprintf(fp, "sizeof(");
           bindx_write_c_type(fp, d, &argument->type, NULL);
-          fprintf(fp, "));\n");
 
-          if (argument->type.rank > 1) {
+          if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_ALIGN) {
+               bxprintf(fp, ")) != 0)\n");
+                    bxprintf(fp, "%sIDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP, \"ERROR: posix_memalign()\");\n", bxis(indent + 1));
+          }
+          else
+               bxprintf(fp, "));\n");
+
+          if (argument_is_pointer_array(argument)) {
                for (j = 0; j < argument->type.rank; ++j)
-                    fprintf(fp, "%sdim[%d] = %s;\n", bxis(indent), j, argument->type.dimens[j]);
-               fprintf(fp, "%s%s = (", bxis(indent), argument->name);
+                    bxprintf(fp, "%sdim[%d] = dimens[%d];\n", bxis(indent), j, argument->i_dimens[j]);
+               bxprintf(fp, "%s%s = (", bxis(indent), argument->name);
                bindx_write_c_declaration(fp, d, &argument->type, NULL);
-               fprintf(fp, ") array_from_mem(%s_data, %d, dim, sizeof(double), 1);\n", argument->name, argument->type.rank);
+               bxprintf(fp, ") array_from_mem(%s_data, %d, dim, sizeof(", argument->name, argument->type.rank);
+               bindx_write_c_type(fp, d, &argument->type, NULL);
+               bxprintf(fp, "), 1);\n");
           }
      }
 
+     if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_STRIDED)
+          bindx_write_c_row_major_strides(fp, argument, bxis(indent));
+
      return 0;
 }
 
 
 
-static int write_subprograms(FILE *fp, const bindx_data *d,
+static int write_subprograms(bindx_buffer_data *fp, const bindx_data *d,
                              enum subprogram_type sub_type,
                              const subprogram_data *subs, int indent)
 {
      int i;
      int j;
 
+     int n_dimens;
+
+     int stats;
+     int i_stats = 0;
+
      argument_data *argument;
      subprogram_data *subprogram;
 
+     stats = d->stats && sub_type == SUBPROGRAM_TYPE_GENERAL;
+
      list_for_each(subs, subprogram) {
-          fprintf(fp, "%svoid IDL_CDECL %s_%s_dlm(int argc, IDL_VPTR argv[], char *argk)\n",
-                  bxis(indent), d->prefix, subprogram->name);
-          fprintf(fp, "{\n");
+          bxprintf(fp, "%svoid IDL_CDECL %s_%s_dlm(int argc, IDL_VPTR argv[], char *argk)\n",
+                   bxis(indent), d->prefix, subprogram->name);
+          bxprintf(fp, "{\n");
 
           indent++;
 
-          fprintf(fp, "%s", bxis(indent));
+          bxprintf(fp, "%s", bxis(indent));
           bindx_write_c_type(fp, d, &subprogram->type, NULL);
-          fprintf(fp, " r;\n");
+          bxprintf(fp, " r;\n");
 
           if (max_argument_rank(subprogram->args) > 1)
-               fprintf(fp, "%ssize_t dim[%d];\n", bxis(indent), MAX_DIMENS);
+               bxprintf(fp, "%ssize_t dim[%d];\n", bxis(indent), MAX_DIMENS);
 
-          fprintf(fp, "%s%s_data *d;\n", bxis(indent), d->prefix);
+          bxprintf(fp, "%s%s_data *d;\n", bxis(indent), d->prefix);
 
           if (subprogram->has_return_value)
-               fprintf(fp, "%sIDL_VARIABLE var;\n", bxis(indent));
+               bxprintf(fp, "%sIDL_VARIABLE var;\n", bxis(indent));
           else {
                list_for_each(subprogram->args, argument) {
                     if (argument->usage == LEX_SUBPROGRAM_ARGUMENT_USAGE_OUT &&
                         argument->type.rank == 0) {
-                         fprintf(fp, "%sIDL_VARIABLE var;\n", bxis(indent));
+                         bxprintf(fp, "%sIDL_VARIABLE var;\n", bxis(indent));
                          break;
                     }
                }
           }
 
           if (sub_type == SUBPROGRAM_TYPE_INIT) {
-               fprintf(fp, "%sIDL_VPTR ptr;\n", bxis(indent));
-               fprintf(fp, "%sIDL_MEMINT dim_idl[%d];\n", bxis(indent), MAX_DIMENS);
+               bxprintf(fp, "%sIDL_VPTR ptr;\n", bxis(indent));
+               bxprintf(fp, "%sIDL_MEMINT dim_idl[%d];\n", bxis(indent), MAX_DIMENS);
           }
           else {
                list_for_each(subprogram->args, argument) {
                     if (argument->usage == LEX_SUBPROGRAM_ARGUMENT_USAGE_OUT &&
                         argument->type.rank > 0) {
-                         fprintf(fp, "%sIDL_VPTR ptr;\n", bxis(indent));
-                         fprintf(fp, "%sIDL_MEMINT dim_idl[%d];\n", bxis(indent), MAX_DIMENS);
+                         bxprintf(fp, "%sIDL_VPTR ptr;\n", bxis(indent));
+                         bxprintf(fp, "%sIDL_MEMINT dim_idl[%d];\n", bxis(indent), MAX_DIMENS);
                          break;
                     }
                }
           }
 
+          if (subprogram->n_dimens > 0)
+               bxprintf(fp, "%sIDL_MEMINT dimens[%d];\n", bxis(indent), subprogram->n_dimens);
+
           list_for_each(subprogram->args, argument) {
-               fprintf(fp, "%s", bxis(indent));
-               bindx_write_c_declaration(fp, d, &argument->type, NULL);
-               fprintf(fp, "%s;\n", argument->name);
+               bxprintf(fp, "%s", bxis(indent));
+               bindx_write_c_argument_declaration(fp, d, argument);
+               bxprintf(fp, "%s;\n", argument->name);
+
+               if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_STRIDED)
+                    bxprintf(fp, "%sptrdiff_t %s_strides[%d];\n", bxis(indent), argument->name, argument->type.rank);
 
                if (argument->usage == LEX_SUBPROGRAM_ARGUMENT_USAGE_OUT  &&
-                   argument->type.rank > 1)
-                    fprintf(fp, "%svoid *%s_data;\n", bxis(indent), argument->name);
+                   argument_is_pointer_array(argument))
+                    bxprintf(fp, "%svoid *%s_data;\n", bxis(indent), argument->name);
+
+               if (argument->usage == LEX_SUBPROGRAM_ARGUMENT_USAGE_IN &&
+                   argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_ALIGN)
+                    bxprintf(fp, "%svoid *%s_aligned;\n", bxis(indent), argument->name);
 
                i++;
           }
 
+          if (stats) {
+               bindx_write_c_stats_declaration(fp, d, indent);
+               bindx_write_c_stats_time(fp, d, 0, i_stats, indent);
+          }
+
           if (sub_type != SUBPROGRAM_TYPE_INIT) {
-               fprintf(fp, "%sIDL_ENSURE_ARRAY(argv[0]);\n", bxis(indent));
-               fprintf(fp, "%sif (argv[0]->type != IDL_TYP_BYTE)\n", bxis(indent));
-               fprintf(fp, "%sIDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP, \"ERROR: Invalid %s instance\");\n", bxis(indent + 1), d->prefix);
-               fprintf(fp, "%sd = (%s_data *) argv[0]->value.arr->data;\n", bxis(indent), d->prefix);
+               bxprintf(fp, "%sIDL_ENSURE_ARRAY(argv[0]);\n", bxis(indent));
+               bxprintf(fp, "%sif (argv[0]->type != IDL_TYP_BYTE)\n", bxis(indent));
+               bxprintf(fp, "%sIDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP, \"ERROR: Invalid %s instance\");\n", bxis(indent + 1), d->prefix);
+               bxprintf(fp, "%sd = (%s_data *) argv[0]->value.arr->data;\n", bxis(indent), d->prefix);
           }
 
+          n_dimens = 0;
           i = 1;
           list_for_each(subprogram->args, argument) {
                if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_LIST_SIZE)
                     continue;
 
+               bindx_write_c_subprogram_dimens(fp, subprogram, argument, &n_dimens, bxis(indent));
+
                if (argument->type.rank == 0) {
                     if (argument->type.type == LEX_BINDX_TYPE_ENUM)
                          write_parse_argument_enum_scalar(fp, indent, i, argument);
@@ -465,7 +611,11 @@ static int write_subprograms(FILE *fp, const bindx_data *d,
                                    break;
 */
                               case LEX_BINDX_TYPE_INT:
+                              case LEX_BINDX_TYPE_INT64:
+                              case LEX_BINDX_TYPE_SIZE_T:
+                              case LEX_BINDX_TYPE_FLOAT:
                               case LEX_BINDX_TYPE_DOUBLE:
+                              case LEX_BINDX_TYPE_COMPLEX:
                                    write_parse_argument_number_scalar(fp, indent, i, argument);
                                    break;
 /*
@@ -492,7 +642,11 @@ static int write_subprograms(FILE *fp, const bindx_data *d,
                                    break;
 */
                               case LEX_BINDX_TYPE_INT:
+                              case LEX_BINDX_TYPE_INT64:
+                              case LEX_BINDX_TYPE_SIZE_T:
+                              case LEX_BINDX_TYPE_FLOAT:
                               case LEX_BINDX_TYPE_DOUBLE:
+                              case LEX_BINDX_TYPE_COMPLEX:
                                    write_parse_argument_number_array(fp, d, indent, i, argument);
                                    break;
 /*
@@ -511,76 +665,96 @@ static int write_subprograms(FILE *fp, const bindx_data *d,
           }
 
           if (sub_type == SUBPROGRAM_TYPE_INIT)
-               fprintf(fp, "%sd = malloc(sizeof(%s_data));\n", bxis(indent), d->prefix);
+               bxprintf(fp, "%sd = malloc(sizeof(%s_data));\n", bxis(indent), d->prefix);
+
+          if (stats)
+               bindx_write_c_stats_time(fp, d, 1, i_stats, indent);
 
-          fprintf(fp, "%sr = %s_%s(d", bxis(indent), d->prefix, subprogram->name);
+          bxprintf(fp, "%sr = %s_%s(d", bxis(indent), d->prefix, subprogram->name);
 
           list_for_each(subprogram->args, argument) {
-               fprintf(fp, ", ");
+               bxprintf(fp, ", ");
                if (argument->type.type == LEX_BINDX_TYPE_ENUM) {
-                    fprintf(fp, "(enum %s_%s", d->prefix, argument->type.name);
+                    bxprintf(fp, "(enum %s_%s", d->prefix, argument->type.name);
                     if (argument->type.rank > 0)
-                         fprintf(fp, " ");
-                    bindx_write_c_dimens_args(fp, d, &argument->type, argument->usage);
-                    fprintf(fp, ") ");
+                         bxprintf(fp, " ");
+                    bindx_write_c_argument_dimens_args(fp, d, argument);
+                    bxprintf(fp, ") ");
                }
 
                if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_ENUM_MASK ||
                    argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_ENUM_ARRAY)
-                    fprintf(fp,  "%s", argument->name);
+                    bxprintf(fp,  "%s", argument->name);
                else
                if (argument->type.rank == 0  &&
                    argument->usage == LEX_SUBPROGRAM_ARGUMENT_USAGE_IN)
-                    fprintf(fp,  "%s", argument->name);
+                    bxprintf(fp,  "%s", argument->name);
                else
                if (argument->type.rank == 0  &&
                    argument->usage == LEX_SUBPROGRAM_ARGUMENT_USAGE_OUT)
-                    fprintf(fp, "&%s", argument->name);
+                    bxprintf(fp, "&%s", argument->name);
                else
-                    fprintf(fp,  "%s", argument->name);
+                    bxprintf(fp,  "%s", argument->name);
+
+               if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_STRIDED)
+                    bxprintf(fp, ", %s_strides", argument->name);
           }
 
-          fprintf(fp, ");\n");
+          bxprintf(fp, ");\n");
+
+          if (stats)
+               bindx_write_c_stats_time(fp, d, 2, i_stats, indent);
 
+          i = 1;
           list_for_each(subprogram->args, argument) {
-               if (argument->type.rank > 1)
-                    fprintf(fp, "%sfree_array((void *) %s, %d);\n", bxis(indent), argument->name, argument->type.rank);
+               if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_LIST_SIZE)
+                    continue;
+
+               if (argument_is_pointer_array(argument))
+                    bxprintf(fp, "%sfree_array((void *) %s, %d);\n", bxis(indent), argument->name, argument->type.rank);
+
+               if (argument->usage == LEX_SUBPROGRAM_ARGUMENT_USAGE_IN &&
+                   argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_ALIGN)
+                    bxprintf(fp, "%sif (%s_aligned != argv[%d]->value.arr->data)\n%sfree(%s_aligned);\n",
+                             bxis(indent), argument->name, i, bxis(indent + 1), argument->name);
+
+               i++;
           }
 
-          fprintf(fp, "%sif (r == %s)\n", bxis(indent), bindx_c_error_conditional(d, subprogram->type.type));
-          fprintf(fp, "%sIDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP, \"ERROR: %s_%s()\");\n", bxis(indent + 1), d->prefix, subprogram->name);
+          bxprintf(fp, "%sif (r == %s)\n", bxis(indent), bindx_c_error_conditional(d, subprogram->type.type));
+          bxprintf(fp, "%sIDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP, \"ERROR: %s_%s()\");\n", bxis(indent + 1), d->prefix, subprogram->name);
 
           list_for_each(subprogram->args, argument) {
                if (argument->type.type == LEX_BINDX_TYPE_ENUM &&
                    argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_ENUM_ARRAY)
-                    fprintf(fp, "%sfree(%s);\n", bxis(indent), argument->name);
+                    bxprintf(fp, "%sfree(%s);\n", bxis(indent), argument->name);
           }
 
           if (sub_type == SUBPROGRAM_TYPE_INIT) {
-               fprintf(fp, "%sdim_idl[0] = sizeof(%s_data);\n", bxis(indent), d->prefix);
-               fprintf(fp, "%sptr = IDL_ImportArray(1, (IDL_MEMINT *) dim_idl, IDL_TYP_BYTE, (UCHAR *) d, 0, NULL);\n", bxis(indent));
-               fprintf(fp, "%sIDL_VarCopy(ptr, argv[0]);\n", bxis(indent));
+               bxprintf(fp, "%sdim_idl[0] = sizeof(%s_data);\n", bxis(indent), d->prefix);
+               bxprintf(fp, "%sptr = IDL_ImportArray(1, (IDL_MEMINT *) dim_idl, IDL_TYP_BYTE, (UCHAR *) d, 0, NULL);\n", bxis(indent));
+               bxprintf(fp, "%sIDL_VarCopy(ptr, argv[0]);\n", bxis(indent));
           }
           else {
                i = 1;
                list_for_each(subprogram->args, argument) {
                     if (argument->usage == LEX_SUBPROGRAM_ARGUMENT_USAGE_OUT) {
                          if (argument->type.rank == 0) {
-                              fprintf(fp, "%svar.type = %s;\n", bxis(indent), get_idl_type(&argument->type));
-                              fprintf(fp, "%svar.flags = 0;\n", bxis(indent));
-                              fprintf(fp, "%svar.value.%s = r;\n", bxis(indent), get_idl_value_var(&argument->type));
-                              fprintf(fp, "%sif (var.value.d == %s)\n", bxis(indent), d->errors.err_ret_dbl);
-                                   fprintf(fp, "%sIDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP, \"ERROR: %s_%s()\");\n", bxis(indent), d->prefix, subprogram->name);
-                              fprintf(fp, "%sIDL_VarCopy((IDL_VPTR) &var, argv[%d]);\n", bxis(indent), i);
+                              bxprintf(fp, "%svar.type = %s;\n", bxis(indent), get_idl_type(&argument->type));
+                              bxprintf(fp, "%svar.flags = 0;\n", bxis(indent));
+                              write_idl_value_set(fp, indent, &argument->type, argument->name);
+                              bxprintf(fp, "%sif (var.value.d == %s)\n", bxis(indent), d->errors.err_ret_dbl);
+                                   bxprintf(fp, "%sIDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP, \"ERROR: %s_%s()\");\n", bxis(indent), d->prefix, subprogram->name);
+                              bxprintf(fp, "%sIDL_VarCopy((IDL_VPTR) &var, argv[%d]);\n", bxis(indent), i);
                          }
                          else {
                               for (j = 0; j < argument->type.rank; ++j)
-                                   fprintf(fp, "%sdim_idl[%d] = %s;\n", bxis(indent), argument->type.rank - j - 1, argument->type.dimens[j]);
-                              if (argument->type.rank == 1)
-                                   fprintf(fp, "%sptr = IDL_ImportArray(%d, (IDL_MEMINT *) dim_idl, %s, (UCHAR *) %s, 0, NULL);\n", bxis(indent), argument->type.rank, get_idl_type(&argument->type), argument->name);
+                                   bxprintf(fp, "%sdim_idl[%d] = dimens[%d];\n", bxis(indent), idl_dimen_index(argument, j), argument->i_dimens[j]);
+                              if (! argument_is_pointer_array(argument))
+                                   bxprintf(fp, "%sptr = IDL_ImportArray(%d, (IDL_MEMINT *) dim_idl, %s, (UCHAR *) %s, 0, NULL);\n", bxis(indent), argument->type.rank, get_idl_type(&argument->type), argument->name);
                               else
-                                   fprintf(fp, "%sptr = IDL_ImportArray(%d, (IDL_MEMINT *) dim_idl, %s, (UCHAR *) %s_data, 0, NULL);\n", bxis(indent), argument->type.rank, get_idl_type(&argument->type), argument->name);
-                              fprintf(fp, "%sIDL_VarCopy((IDL_VPTR) ptr, argv[%d]);\n", bxis(indent), i);
+                                   bxprintf(fp, "%sptr = IDL_ImportArray(%d, (IDL_MEMINT *) dim_idl, %s, (UCHAR *) %s_data, 0, NULL);\n", bxis(indent), argument->type.rank, get_idl_type(&argument->type), argument->name);
+                              bxprintf(fp, "%sIDL_VarCopy((IDL_VPTR) ptr, argv[%d]);\n", bxis(indent), i);
                          }
                     }
 
@@ -590,25 +764,28 @@ static int write_subprograms(FILE *fp, const bindx_data *d,
 
           if (subprogram->has_return_value) {
                if (subprogram->type.rank == 0) {
-                    fprintf(fp, "%svar.type = %s;\n", bxis(indent), get_idl_type(&subprogram->type));
-                    fprintf(fp, "%svar.flags = 0;\n", bxis(indent));
-                    fprintf(fp, "%svar.value.%s = r;\n", bxis(indent), get_idl_value_var(&subprogram->type));
-                    fprintf(fp, "%sif (var.value.d == %s)\n", bxis(indent), d->errors.err_ret_dbl);
-                         fprintf(fp, "%sIDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP, \"ERROR: %s_%s()\");\n", bxis(indent), d->prefix, subprogram->name);
-                    fprintf(fp, "%sIDL_VarCopy((IDL_VPTR) &var, argv[%d]);\n", bxis(indent), i);
+                    bxprintf(fp, "%svar.type = %s;\n", bxis(indent), get_idl_type(&subprogram->type));
+                    bxprintf(fp, "%svar.flags = 0;\n", bxis(indent));
+                    write_idl_value_set(fp, indent, &subprogram->type, "r");
+                    bxprintf(fp, "%sif (var.value.d == %s)\n", bxis(indent), d->errors.err_ret_dbl);
+                         bxprintf(fp, "%sIDL_Message(IDL_M_NAMED_GENERIC, IDL_MSG_LONGJMP, \"ERROR: %s_%s()\");\n", bxis(indent), d->prefix, subprogram->name);
+                    bxprintf(fp, "%sIDL_VarCopy((IDL_VPTR) &var, argv[%d]);\n", bxis(indent), i);
                }
                else {
 
                }
           }
 
-          fprintf(fp, "%sreturn;\n", bxis(indent));
+          if (stats)
+               bindx_write_c_stats_time(fp, d, 3, i_stats++, indent);
+
+          bxprintf(fp, "%sreturn;\n", bxis(indent));
 
           indent--;
 
-          fprintf(fp, "}\n");
-          fprintf(fp, "\n");
-          fprintf(fp, "\n");
+          bxprintf(fp, "}\n");
+          bxprintf(fp, "\n");
+          bxprintf(fp, "\n");
      }
 
      return 0;
@@ -616,7 +793,36 @@ static int write_subprograms(FILE *fp, const bindx_data *d,
 
 
 
-static int write_dlm_procedures(FILE *fp, const bindx_data *d,
+static int write_stats(bindx_buffer_data *fp, const bindx_data *d)
+{
+     bxprintf(fp, "void IDL_CDECL %s_stats_dlm(int argc, IDL_VPTR argv[], char *argk)\n", d->prefix);
+     bxprintf(fp, "{\n");
+     bxprintf(fp, "     int i;\n");
+     bxprintf(fp, "     int j;\n");
+     bxprintf(fp, "     uint64_t n_calls;\n");
+     bxprintf(fp, "     %s_stats_data *s;\n", d->prefix);
+
+     bxprintf(fp, "     printf(\"%%-32s %%12s %%12s %%12s %%12s\\n\", \"subprogram\", \"calls\", \"args (ns)\", \"call (ns)\", \"results (ns)\");\n");
+     bxprintf(fp, "     for (i = 0; i < %s_STATS_N_SUBPROGRAMS; ++i) {\n", d->PREFIX);
+     bxprintf(fp, "          s = &%s_stats[i];\n", d->prefix);
+     bxprintf(fp, "          n_calls = __atomic_load_n(&s->n_calls, __ATOMIC_RELAXED);\n");
+     bxprintf(fp, "          if (n_calls == 0)\n");
+     bxprintf(fp, "               continue;\n");
+     bxprintf(fp, "          printf(\"%%-32s %%12llu\", s->name, (unsigned long long) n_calls);\n");
+     bxprintf(fp, "          for (j = 0; j < %s_STATS_N_PHASES; ++j)\n", d->PREFIX);
+     bxprintf(fp, "               printf(\" %%12.1f\", (double) __atomic_load_n(&s->ns[j], __ATOMIC_RELAXED) / n_calls);\n");
+     bxprintf(fp, "          printf(\"\\n\");\n");
+     bxprintf(fp, "     }\n");
+     bxprintf(fp, "}\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+     return 0;
+}
+
+
+
+static int write_dlm_procedures(bindx_buffer_data *fp, const bindx_data *d,
                                 const subprogram_data *subs)
 {
      char PREFIX[NM];
@@ -640,7 +846,7 @@ static int write_dlm_procedures(FILE *fp, const bindx_data *d,
           if (subprogram->has_return_value)
                count++;
 
-          fprintf(fp, "PROCEDURE   %s_%s %d %d\n", PREFIX, NAME_, count, count);
+          bxprintf(fp, "PROCEDURE   %s_%s %d %d\n", PREFIX, NAME_, count, count);
      }
 
      return 0;
@@ -648,82 +854,98 @@ static int write_dlm_procedures(FILE *fp, const bindx_data *d,
 
 
 
-int bindx_write_idl(FILE **fp, const bindx_data *d, const char *name)
+int bindx_write_idl(bindx_buffer_data **fp, const bindx_data *d, const char *name)
 {
      bindx_write_c_header_top(fp[0]);
-     fprintf(fp[0], "\n");
+     bxprintf(fp[0], "\n");
 
-     fprintf(fp[0], "#include <gutil.h>\n");
-     fprintf(fp[0], "\n");
+     bxprintf(fp[0], "#include <gutil.h>\n");
+     bxprintf(fp[0], "\n");
 
-     fprintf(fp[0], "#include <export.h>\n");
-     fprintf(fp[0], "\n");
+     bxprintf(fp[0], "#include <export.h>\n");
+     bxprintf(fp[0], "\n");
 
-     fprintf(fp[0], "#include <%s_interface.h>\n", d->prefix);
-     fprintf(fp[0], "\n");
+     bxprintf(fp[0], "#include <%s_interface.h>\n", d->prefix);
+     bxprintf(fp[0], "\n");
 
-     fprintf(fp[0], "#define ARRLEN(arr) (sizeof(arr)/sizeof(arr[0]))\n");
-     fprintf(fp[0], "\n");
-     fprintf(fp[0], "\n");
+     bxprintf(fp[0], "#define ARRLEN(arr) (sizeof(arr)/sizeof(arr[0]))\n");
+     bxprintf(fp[0], "\n");
+     bxprintf(fp[0], "\n");
 
-     fprintf(fp[0], "int  %s_int_startup(void);\n", d->prefix);
-     fprintf(fp[0], "void %s_int_exit_handler(void);\n", d->prefix);
-     fprintf(fp[0], "\n");
-     write_prototypes(fp[0], d, &d->subs_all, 0);
-     fprintf(fp[0], "\n");
-     fprintf(fp[0], "\n");
+     if (d->stats) {
+          bindx_write_c_stats_header(fp[0], d);
+          bindx_write_c_stats_utilities(fp[0], d);
+     }
 
-     fprintf(fp[0], "#ifdef __IDLPRE53__\n");
-     fprintf(fp[0], "     static IDL_SYSFUN_DEF %s_int_procedures[] = {\n", d->prefix);
+     bxprintf(fp[0], "int  %s_int_startup(void);\n", d->prefix);
+     bxprintf(fp[0], "void %s_int_exit_handler(void);\n", d->prefix);
+     bxprintf(fp[0], "\n");
+     write_prototypes(fp[0], d, &d->subs_all, 0);
+     if (d->stats)
+          bxprintf(fp[0], "void IDL_CDECL %s_stats_dlm(int argc, IDL_VPTR argv[], char *argk);\n", d->prefix);
+     bxprintf(fp[0], "\n");
+     bxprintf(fp[0], "\n");
+
+     bxprintf(fp[0], "#ifdef __IDLPRE53__\n");
+     bxprintf(fp[0], "     static IDL_SYSFUN_DEF %s_int_procedures[] = {\n", d->prefix);
+     if (d->stats)
+          bxprintf(fp[0], "          {{(IDL_FUN_RET) %s_stats_dlm}, \"%s_STATS\", 0, 0, 0},\n", d->prefix, d->PREFIX);
      write_idl_sysfun_defs(fp[0], d, &d->subs_all, 2, 0);
-     fprintf(fp[0], "     };\n");
-     fprintf(fp[0], "#else\n");
-     fprintf(fp[0], "     static IDL_SYSFUN_DEF2 %s_int_procedures[] = {\n", d->prefix);
+     bxprintf(fp[0], "     };\n");
+     bxprintf(fp[0], "#else\n");
+     bxprintf(fp[0], "     static IDL_SYSFUN_DEF2 %s_int_procedures[] = {\n", d->prefix);
+     if (d->stats)
+          bxprintf(fp[0], "          {{(IDL_FUN_RET) %s_stats_dlm}, \"%s_STATS\", 0, 0, 0, 0},\n", d->prefix, d->PREFIX);
      write_idl_sysfun_defs(fp[0], d, &d->subs_all, 2, 1);
-     fprintf(fp[0], "     };\n");
-     fprintf(fp[0], "#endif\n");
-     fprintf(fp[0], "\n");
-     fprintf(fp[0], "\n");
-
-     fprintf(fp[0], "int IDL_Load(void)\n");
-     fprintf(fp[0], "{\n");
-     fprintf(fp[0], "#ifdef __IDLPRE53__\n");
-     fprintf(fp[0], "     if (! IDL_AddSystemRoutine(%s_int_procedures, FALSE,\n", d->prefix);
-     fprintf(fp[0], "                                ARRLEN(%s_int_procedures))) {\n", d->prefix);
-     fprintf(fp[0], "          return IDL_FALSE;\n");
-     fprintf(fp[0], "     }\n");
-     fprintf(fp[0], "#else\n");
-     fprintf(fp[0], "     if (! IDL_SysRtnAdd       (%s_int_procedures, FALSE,\n", d->prefix);
-     fprintf(fp[0], "                                ARRLEN(%s_int_procedures))) {\n", d->prefix);
-     fprintf(fp[0], "          return IDL_FALSE;\n");
-     fprintf(fp[0], "     }\n");
-     fprintf(fp[0], "#endif\n");
-     fprintf(fp[0], "     IDL_ExitRegister(%s_int_exit_handler);\n", d->prefix);
-     fprintf(fp[0], "     return(IDL_TRUE);\n");
-     fprintf(fp[0], "}\n");
-     fprintf(fp[0], "\n");
-     fprintf(fp[0], "\n");
-
-     fprintf(fp[0], "void %s_int_exit_handler(void)\n", d->prefix);
-     fprintf(fp[0], "{\n");
-     fprintf(fp[0], "\n");
-     fprintf(fp[0], "}\n");
-     fprintf(fp[0], "\n");
-     fprintf(fp[0], "\n");
+     bxprintf(fp[0], "     };\n");
+     bxprintf(fp[0], "#endif\n");
+     bxprintf(fp[0], "\n");
+     bxprintf(fp[0], "\n");
+
+     bxprintf(fp[0], "int IDL_Load(void)\n");
+     bxprintf(fp[0], "{\n");
+     bxprintf(fp[0], "#ifdef __IDLPRE53__\n");
+     bxprintf(fp[0], "     if (! IDL_AddSystemRoutine(%s_int_procedures, FALSE,\n", d->prefix);
+     bxprintf(fp[0], "                                ARRLEN(%s_int_procedures))) {\n", d->prefix);
+     bxprintf(fp[0], "          return IDL_FALSE;\n");
+     bxprintf(fp[0], "     }\n");
+     bxprintf(fp[0], "#else\n");
+     bxprintf(fp[0], "     if (! IDL_SysRtnAdd       (%s_int_procedures, FALSE,\n", d->prefix);
+     bxprintf(fp[0], "                                ARRLEN(%s_int_procedures))) {\n", d->prefix);
+     bxprintf(fp[0], "          return IDL_FALSE;\n");
+     bxprintf(fp[0], "     }\n");
+     bxprintf(fp[0], "#endif\n");
+     bxprintf(fp[0], "     IDL_ExitRegister(%s_int_exit_handler);\n", d->prefix);
+     bxprintf(fp[0], "     return(IDL_TRUE);\n");
+     bxprintf(fp[0], "}\n");
+     bxprintf(fp[0], "\n");
+     bxprintf(fp[0], "\n");
+
+     bxprintf(fp[0], "void %s_int_exit_handler(void)\n", d->prefix);
+     bxprintf(fp[0], "{\n");
+     bxprintf(fp[0], "\n");
+     bxprintf(fp[0], "}\n");
+     bxprintf(fp[0], "\n");
+     bxprintf(fp[0], "\n");
 
      write_subprograms(fp[0], d, SUBPROGRAM_TYPE_INIT,    &d->subs_init, 0);
      write_subprograms(fp[0], d, SUBPROGRAM_TYPE_FREE,    &d->subs_free, 0);
      write_subprograms(fp[0], d, SUBPROGRAM_TYPE_GENERAL, &d->subs_general, 0);
 
+     if (d->stats)
+          write_stats(fp[0], d);
 
-     write_dlm_header_top(fp[1]);
-     fprintf(fp[1], "\n");
 
-     fprintf(fp[1], "MODULE      %s\n", d->prefix);
-     fprintf(fp[1], "DESCRIPTION %s\n", d->prefix);
-     fprintf(fp[1], "VERSION     0.1\n");
-     fprintf(fp[1], "SOURCE      %s developers\n", d->prefix);
-     fprintf(fp[1], "BUILD_DATE  xxxx/xx/xx\n");
+     write_dlm_header_top(fp[1]);
+     bxprintf(fp[1], "\n");
+
+     bxprintf(fp[1], "MODULE      %s\n", d->prefix);
+     bxprintf(fp[1], "DESCRIPTION %s\n", d->prefix);
+     bxprintf(fp[1], "VERSION     0.1\n");
+     bxprintf(fp[1], "SOURCE      %s developers\n", d->prefix);
+     bxprintf(fp[1], "BUILD_DATE  xxxx/xx/xx\n");
+     if (d->stats)
+          bxprintf(fp[1], "PROCEDURE   %s_STATS 0 0\n", d->PREFIX);
      write_dlm_procedures(fp[1], d, &d->subs_all);
 
      return 0;
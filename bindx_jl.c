@@ -22,9 +22,21 @@ static const char *type_to_julia_type(const type_data *d)
           case LEX_BINDX_TYPE_INT:
                return "Int32";
                break;
+          case LEX_BINDX_TYPE_INT64:
+               return "Int64";
+               break;
+          case LEX_BINDX_TYPE_SIZE_T:
+               return "UInt";
+               break;
+          case LEX_BINDX_TYPE_FLOAT:
+               return "Float32";
+               break;
           case LEX_BINDX_TYPE_DOUBLE:
                return "Float64";
                break;
+          case LEX_BINDX_TYPE_COMPLEX:
+               return "ComplexF64";
+               break;
           default:
                INTERNAL_ERROR("Invalid lex_bindx_type value: %d", d->type);
                break;
@@ -47,9 +59,21 @@ static const char *type_to_julia_c_alias(const type_data *d, int flag, int flag2
           case LEX_BINDX_TYPE_INT:
                return "Cint";
                break;
+          case LEX_BINDX_TYPE_INT64:
+               return "Int64";
+               break;
+          case LEX_BINDX_TYPE_SIZE_T:
+               return "Csize_t";
+               break;
+          case LEX_BINDX_TYPE_FLOAT:
+               return "Cfloat";
+               break;
           case LEX_BINDX_TYPE_DOUBLE:
                return "Cdouble";
                break;
+          case LEX_BINDX_TYPE_COMPLEX:
+               return "ComplexF64";
+               break;
           default:
                INTERNAL_ERROR("Invalid lex_bindx_type value: %d", d->type);
                break;
@@ -93,6 +117,36 @@ static const char *type_to_julia_c_type(const type_data *d, int flag, int flag2)
                          return "Ref{Cint}";
                }
                break;
+          case LEX_BINDX_TYPE_INT64:
+               if (d->rank == 0 && ! flag)
+                    return "Int64";
+               else {
+                    if (! flag2)
+                         return "Ptr{Int64}";
+                    else
+                         return "Ref{Int64}";
+               }
+               break;
+          case LEX_BINDX_TYPE_SIZE_T:
+               if (d->rank == 0 && ! flag)
+                    return "Csize_t";
+               else {
+                    if (! flag2)
+                         return "Ptr{Csize_t}";
+                    else
+                         return "Ref{Csize_t}";
+               }
+               break;
+          case LEX_BINDX_TYPE_FLOAT:
+               if (d->rank == 0 && ! flag)
+                    return "Cfloat";
+               else {
+                    if (! flag2)
+                         return "Ptr{Cfloat}";
+                    else
+                         return "Ref{Cfloat}";
+               }
+               break;
           case LEX_BINDX_TYPE_DOUBLE:
                if (d->rank == 0 && ! flag)
                     return "Cdouble";
@@ -103,6 +157,16 @@ static const char *type_to_julia_c_type(const type_data *d, int flag, int flag2)
                          return "Ref{Cdouble}";
                }
                break;
+          case LEX_BINDX_TYPE_COMPLEX:
+               if (d->rank == 0 && ! flag)
+                    return "ComplexF64";
+               else {
+                    if (! flag2)
+                         return "Ptr{ComplexF64}";
+                    else
+                         return "Ref{ComplexF64}";
+               }
+               break;
           default:
                INTERNAL_ERROR("Invalid lex_bindx_type value: %d", d->type);
                break;
@@ -113,30 +177,45 @@ static const char *type_to_julia_c_type(const type_data *d, int flag, int flag2)
 
 
 
-static int write_header(FILE *fp)
+/*
+ * Julia arrays are column-major so the dimensions of row-major (and strided)
+ * arguments are reversed on the Julia side while column-major arguments keep
+ * the order given in the interface.
+ */
+static int julia_dimen_index(const argument_data *argument, int i)
 {
-     fprintf(fp, "#***********************************************************************\n");
-     fprintf(fp, "#\n");
-     fprintf(fp, "#***********************************************************************\n");
+     if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_COL_MAJOR)
+          return i;
+
+     return argument->type.rank - i - 1;
+}
+
+
+
+static int write_header(bindx_buffer_data *fp)
+{
+     bxprintf(fp, "#***********************************************************************\n");
+     bxprintf(fp, "#\n");
+     bxprintf(fp, "#***********************************************************************\n");
 
      return 0;
 }
 
 
 
-static int write_header_top(FILE *fp)
+static int write_header_top(bindx_buffer_data *fp)
 {
-     fprintf(fp, "#***********************************************************************\n");
-     fprintf(fp, "# This file was generated by bindx version %s.  Edit at your own risk.\n",
-             bindx_version());
-     fprintf(fp, "#***********************************************************************\n");
+     bxprintf(fp, "#***********************************************************************\n");
+     bxprintf(fp, "# This file was generated by bindx version %s.  Edit at your own risk.\n",
+              bindx_version());
+     bxprintf(fp, "#***********************************************************************\n");
 
      return 0;
 }
 
 
 
-static int bindx_write_c_util_functions(FILE *fp, const bindx_data *d,
+static int bindx_write_c_util_functions(bindx_buffer_data *fp, const bindx_data *d,
                                         const subprogram_data *subs)
 {
      int i;
@@ -144,45 +223,37 @@ static int bindx_write_c_util_functions(FILE *fp, const bindx_data *d,
      int indent = 0;
 
      argument_data *argument;
-     argument_data *argument2;
      subprogram_data *subprogram;
 
      list_for_each(subs, subprogram) {
+          if (subprogram->n_dimens == 0)
+               continue;
+
+          bxprintf(fp, "int %s_dims(%s_data *d, ", subprogram->name, d->prefix);
+
           list_for_each(subprogram->args, argument) {
-               if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_ENUM_MASK ||
-                   argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_ENUM_ARRAY)
-                   continue;
-               else
-               if (argument->type.rank > 0) {
-                    fprintf(fp, "int %s_%s_dims(%s_data *d, ",
-                            subprogram->name, argument->name, d->prefix);
-
-                    list_for_each(subprogram->args, argument2) {
-                         if (argument2->usage != LEX_SUBPROGRAM_ARGUMENT_USAGE_OUT) {
-                              bindx_write_c_type(fp, d, &argument2->type, NULL);
-                              fprintf(fp, " ");
-                              bindx_write_c_dimens_args(fp, d, &argument2->type,
-                                                                argument2->usage);
-                              fprintf(fp, "%s, ", argument2->name);
-                         }
-                    }
-                    fprintf(fp, "size_t *dims)\n");
+               if (argument->usage != LEX_SUBPROGRAM_ARGUMENT_USAGE_OUT) {
+                    bindx_write_c_type(fp, d, &argument->type, NULL);
+                    bxprintf(fp, " ");
+                    bindx_write_c_argument_dimens_args(fp, d, argument);
+                    bxprintf(fp, "%s, ", argument->name);
+               }
+          }
+          bxprintf(fp, "size_t *dims)\n");
 
-                    fprintf(fp, "{\n");
-                    indent++;
+          bxprintf(fp, "{\n");
+          indent++;
 
-                    for (i = 0; i < argument->type.rank; ++i)
-                         fprintf(fp, "%sdims[%d] = %s;\n",
-                                 bxis4(indent), i, argument->type.dimens[i]);
+          for (i = 0; i < subprogram->n_dimens; ++i)
+               bxprintf(fp, "%sdims[%d] = %s;\n",
+                        bxis4(indent), i, subprogram->dimens[i]);
 
-                    fprintf(fp, "%sreturn 0;\n", bxis4(indent));
-                    indent--;
-                    fprintf(fp, "}\n");
+          bxprintf(fp, "%sreturn 0;\n", bxis4(indent));
+          indent--;
+          bxprintf(fp, "}\n");
 
-                    fprintf(fp, "\n");
-                    fprintf(fp, "\n");
-               }
-          }
+          bxprintf(fp, "\n");
+          bxprintf(fp, "\n");
      }
 
      return 0;
@@ -190,25 +261,96 @@ static int bindx_write_c_util_functions(FILE *fp, const bindx_data *d,
 
 
 
-static int write_global_consts(FILE *fp, const bindx_data *d,
+/*
+ * Like the <prefix>_<init>2() the library provides for create(), restoring
+ * needs an allocated instance to hand back to Julia.
+ */
+static int write_c_state_functions(bindx_buffer_data *fp, const bindx_data *d)
+{
+     const argument_data *argument;
+     const subprogram_data *restore;
+
+     restore = bindx_restore_subprogram(d);
+     if (restore == NULL)
+          return 0;
+
+     argument = (argument_data *) restore->args->next;
+
+     bxprintf(fp, "%s_data *%s_%s2(size_t %s, char *%s)\n", d->prefix, d->prefix, restore->name,
+              argument->name, ((argument_data *) argument->next)->name);
+     bxprintf(fp, "{\n");
+     bxprintf(fp, "    %s_data *d;\n", d->prefix);
+     bxprintf(fp, "    d = calloc(1, sizeof(%s_data));\n", d->prefix);
+     bxprintf(fp, "    if (d == NULL)\n");
+     bxprintf(fp, "        return NULL;\n");
+     bxprintf(fp, "    if (%s_%s(d, %s, %s) == %s) {\n", d->prefix, restore->name,
+              argument->name, ((argument_data *) argument->next)->name,
+              bindx_c_error_conditional(d, restore->type.type));
+     bxprintf(fp, "        free(d);\n");
+     bxprintf(fp, "        return NULL;\n");
+     bxprintf(fp, "    }\n");
+     bxprintf(fp, "    return d;\n");
+     bxprintf(fp, "}\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+     return 0;
+}
+
+
+
+static int write_c_clone_function(bindx_buffer_data *fp, const bindx_data *d)
+{
+     const subprogram_data *subprogram;
+
+     subprogram = bindx_clone_subprogram(d);
+     if (subprogram == NULL)
+          return 0;
+
+     bxprintf(fp, "%s_data *%s_%s2(%s_data *src)\n", d->prefix, d->prefix, subprogram->name,
+              d->prefix);
+     bxprintf(fp, "{\n");
+     bxprintf(fp, "    %s_data *d;\n", d->prefix);
+     bxprintf(fp, "    d = calloc(1, sizeof(%s_data));\n", d->prefix);
+     bxprintf(fp, "    if (d == NULL)\n");
+     bxprintf(fp, "        return NULL;\n");
+     bxprintf(fp, "    if (%s_%s(d, src) == %s) {\n", d->prefix, subprogram->name,
+              bindx_c_error_conditional(d, subprogram->type.type));
+     bxprintf(fp, "        free(d);\n");
+     bxprintf(fp, "        return NULL;\n");
+     bxprintf(fp, "    }\n");
+     bxprintf(fp, "    return d;\n");
+     bxprintf(fp, "}\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+     return 0;
+}
+
+
+
+static int write_global_consts(bindx_buffer_data *fp, const bindx_data *d,
                                const global_const_data *consts)
 {
      global_const_data *global_const;
 
      list_for_each(consts, global_const) {
-          fprintf(fp, "%s = ", global_const->name);
+          bxprintf(fp, "%s = ", global_const->name);
           switch(global_const->type.type) {
           case LEX_BINDX_TYPE_INT:
-               fprintf(fp, "%ld", global_const->lex_type.l);
+          case LEX_BINDX_TYPE_INT64:
+          case LEX_BINDX_TYPE_SIZE_T:
+               bxprintf(fp, "%ld", global_const->lex_type.l);
                break;
+          case LEX_BINDX_TYPE_FLOAT:
           case LEX_BINDX_TYPE_DOUBLE:
-               fprintf(fp, "%f", global_const->lex_type.d);
+               bxprintf(fp, "%f", global_const->lex_type.d);
                break;
           default:
                INTERNAL_ERROR("Invalid lex_bindx_type value: %d", global_const->type.type);
                break;
           }
-          fprintf(fp, "\n");
+          bxprintf(fp, "\n");
      }
 
      return 0;
@@ -216,103 +358,247 @@ static int write_global_consts(FILE *fp, const bindx_data *d,
 
 
 
-static int write_utilities(FILE *fp, const bindx_data *d)
+static int write_utilities(bindx_buffer_data *fp, const bindx_data *d)
 {
-     fprintf(fp, "function list_to_mask(list, name_to_mask)\n");
-     fprintf(fp, "    mask = 0\n");
-     fprintf(fp, "    n = length(list)\n");
-     fprintf(fp, "    for i = 1:n\n");
-     fprintf(fp, "        r = @eval ccall(($name_to_mask, library_path), Cint, (Cstring, ), $(string(list[i])))\n");
-     fprintf(fp, "        if r == -1\n");
-     fprintf(fp, "            error(\"list_to_mask()\")\n");
-     fprintf(fp, "        end\n");
-     fprintf(fp, "        mask |= r\n");
-     fprintf(fp, "    end\n");
-     fprintf(fp, "    mask\n");
-     fprintf(fp, "end\n");
-     fprintf(fp, "\n");
-     fprintf(fp, "\n");
+     bxprintf(fp, "function list_to_mask(list, name_to_mask)\n");
+     bxprintf(fp, "    mask = 0\n");
+     bxprintf(fp, "    n = length(list)\n");
+     bxprintf(fp, "    for i = 1:n\n");
+     bxprintf(fp, "        r = @eval ccall(($name_to_mask, library_path), Cint, (Cstring, ), $(string(list[i])))\n");
+     bxprintf(fp, "        if r == -1\n");
+     bxprintf(fp, "            error(\"list_to_mask()\")\n");
+     bxprintf(fp, "        end\n");
+     bxprintf(fp, "        mask |= r\n");
+     bxprintf(fp, "    end\n");
+     bxprintf(fp, "    mask\n");
+     bxprintf(fp, "end\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
 /*
-     fprintf(fp, "function mask_to_list(mask, n, index_to_mask, index_to_name)\n");
-     fprintf(fp, "    list = Vector{String}(undef, 0)\n");
-     fprintf(fp, "    for i = 1:n\n");
-     fprintf(fp, "        mask2 = @eval ccall(($index_to_mask, library_path), Cint, (Cint, ), $(i - 1))\n");
-     fprintf(fp, "        if mask & mask2 != 0\n");
-     fprintf(fp, "            name = @eval ccall(($index_to_name, library_path), Cstring, (Cint, ), $(i - 1))\n");
-     fprintf(fp, "            push!(list, unsafe_string(name))\n");
-     fprintf(fp, "        end\n");
-     fprintf(fp, "    end\n");
-     fprintf(fp, "    list\n");
-     fprintf(fp, "end\n");
-     fprintf(fp, "\n");
-     fprintf(fp, "\n");
+     bxprintf(fp, "function mask_to_list(mask, n, index_to_mask, index_to_name)\n");
+     bxprintf(fp, "    list = Vector{String}(undef, 0)\n");
+     bxprintf(fp, "    for i = 1:n\n");
+     bxprintf(fp, "        mask2 = @eval ccall(($index_to_mask, library_path), Cint, (Cint, ), $(i - 1))\n");
+     bxprintf(fp, "        if mask & mask2 != 0\n");
+     bxprintf(fp, "            name = @eval ccall(($index_to_name, library_path), Cstring, (Cint, ), $(i - 1))\n");
+     bxprintf(fp, "            push!(list, unsafe_string(name))\n");
+     bxprintf(fp, "        end\n");
+     bxprintf(fp, "    end\n");
+     bxprintf(fp, "    list\n");
+     bxprintf(fp, "end\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
 */
-     fprintf(fp, "function mask_to_list(mask, index_to_mask, index_to_name)\n");
-     fprintf(fp, "    list = Vector{String}(undef, 0)\n");
-     fprintf(fp, "    global i = 1\n");
-     fprintf(fp, "    while true\n");
-     fprintf(fp, "        mask2 = @eval ccall(($index_to_mask, library_path), Cint, (Cint, ), $(i - 1))\n");
-     fprintf(fp, "        if mask2 == -1\n");
-     fprintf(fp, "            break\n");
-     fprintf(fp, "        end\n");
-     fprintf(fp, "        if mask & mask2 != 0\n");
-     fprintf(fp, "            name = @eval ccall(($index_to_name, library_path), Cstring, (Cint, ), $(i - 1))\n");
-     fprintf(fp, "            push!(list, unsafe_string(name))\n");
-     fprintf(fp, "        end\n");
-     fprintf(fp, "        global i += 1\n");
-     fprintf(fp, "    end\n");
-     fprintf(fp, "    list\n");
-     fprintf(fp, "end\n");
-     fprintf(fp, "\n");
-     fprintf(fp, "\n");
-
-     fprintf(fp, "function list_to_array(list, name_to_value)\n");
-     fprintf(fp, "    n = length(list)\n");
-     fprintf(fp, "    array = Array{Int32,1}(undef, n)\n");
-     fprintf(fp, "    for i = 1:n\n");
-     fprintf(fp, "        r = @eval ccall(($name_to_value, library_path), Cint, (Cstring, ), $(string(list[i])))\n");
-     fprintf(fp, "        if r == -1 0\n");
-     fprintf(fp, "            error(\"list_to_mask()\")\n");
-     fprintf(fp, "        end\n");
-     fprintf(fp, "        array[i] = r\n");
-     fprintf(fp, "    end\n");
-     fprintf(fp, "    n, array\n");
-     fprintf(fp, "end\n");
-     fprintf(fp, "\n");
-     fprintf(fp, "\n");
+     bxprintf(fp, "function mask_to_list(mask, index_to_mask, index_to_name)\n");
+     bxprintf(fp, "    list = Vector{String}(undef, 0)\n");
+     bxprintf(fp, "    global i = 1\n");
+     bxprintf(fp, "    while true\n");
+     bxprintf(fp, "        mask2 = @eval ccall(($index_to_mask, library_path), Cint, (Cint, ), $(i - 1))\n");
+     bxprintf(fp, "        if mask2 == -1\n");
+     bxprintf(fp, "            break\n");
+     bxprintf(fp, "        end\n");
+     bxprintf(fp, "        if mask & mask2 != 0\n");
+     bxprintf(fp, "            name = @eval ccall(($index_to_name, library_path), Cstring, (Cint, ), $(i - 1))\n");
+     bxprintf(fp, "            push!(list, unsafe_string(name))\n");
+     bxprintf(fp, "        end\n");
+     bxprintf(fp, "        global i += 1\n");
+     bxprintf(fp, "    end\n");
+     bxprintf(fp, "    list\n");
+     bxprintf(fp, "end\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+     bxprintf(fp, "function aligned_array(T, alignment, dims)\n");
+     bxprintf(fp, "    p = Ref{Ptr{Cvoid}}(C_NULL)\n");
+     bxprintf(fp, "    if ccall(:posix_memalign, Cint, (Ptr{Ptr{Cvoid}}, Csize_t, Csize_t), p, alignment, max(prod(dims), 1) * sizeof(T)) != 0\n");
+     bxprintf(fp, "        throw(OutOfMemoryError())\n");
+     bxprintf(fp, "    end\n");
+     bxprintf(fp, "    unsafe_wrap(Array, Ptr{T}(p[]), Int.(dims); own = true)\n");
+     bxprintf(fp, "end\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+     bxprintf(fp, "function align_array(array, alignment)\n");
+     bxprintf(fp, "    if UInt(pointer(array)) %% alignment == 0\n");
+     bxprintf(fp, "        return array\n");
+     bxprintf(fp, "    end\n");
+     bxprintf(fp, "    copyto!(aligned_array(eltype(array), alignment, size(array)), array)\n");
+     bxprintf(fp, "end\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+     bxprintf(fp, "function list_to_array(list, name_to_value)\n");
+     bxprintf(fp, "    n = length(list)\n");
+     bxprintf(fp, "    array = Array{Int32,1}(undef, n)\n");
+     bxprintf(fp, "    for i = 1:n\n");
+     bxprintf(fp, "        r = @eval ccall(($name_to_value, library_path), Cint, (Cstring, ), $(string(list[i])))\n");
+     bxprintf(fp, "        if r == -1 0\n");
+     bxprintf(fp, "            error(\"list_to_mask()\")\n");
+     bxprintf(fp, "        end\n");
+     bxprintf(fp, "        array[i] = r\n");
+     bxprintf(fp, "    end\n");
+     bxprintf(fp, "    n, array\n");
+     bxprintf(fp, "end\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+     return 0;
+}
+
+
+
+static int write_stats(bindx_buffer_data *fp, const bindx_data *d)
+{
+     subprogram_data *subprogram;
+
+     bxprintf(fp, "const STATS_N_PHASES  = %d\n", BINDX_STATS_N_PHASES);
+     bxprintf(fp, "const STATS_N_BUCKETS = %d\n", BINDX_STATS_N_BUCKETS);
+     bxprintf(fp, "\n");
+
+     bxprintf(fp, "struct StatsData\n");
+     bxprintf(fp, "    name::String\n");
+     bxprintf(fp, "    n_calls::Threads.Atomic{UInt64}\n");
+     bxprintf(fp, "    ns::Vector{Threads.Atomic{UInt64}}\n");
+     bxprintf(fp, "    hist::Matrix{Threads.Atomic{UInt64}}\n");
+     bxprintf(fp, "end\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "StatsData(name) = StatsData(name, Threads.Atomic{UInt64}(0),\n");
+     bxprintf(fp, "                            [Threads.Atomic{UInt64}(0) for j = 1:STATS_N_PHASES],\n");
+     bxprintf(fp, "                            [Threads.Atomic{UInt64}(0) for j = 1:STATS_N_PHASES, k = 1:STATS_N_BUCKETS])\n");
+     bxprintf(fp, "\n");
+
+     bxprintf(fp, "const stats_data = [\n");
+     list_for_each(&d->subs_general, subprogram)
+          bxprintf(fp, "    StatsData(\"%s\"),\n", subprogram->name);
+     bxprintf(fp, "]\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+     bxprintf(fp, "function stats_record(i, t)\n");
+     bxprintf(fp, "    s = stats_data[i]\n");
+     bxprintf(fp, "    Threads.atomic_add!(s.n_calls, UInt64(1))\n");
+     bxprintf(fp, "    for j = 1:STATS_N_PHASES\n");
+     bxprintf(fp, "        dt = t[j + 1] - t[j]\n");
+     bxprintf(fp, "        k = dt == 0 ? 1 : min(64 - leading_zeros(dt), STATS_N_BUCKETS)\n");
+     bxprintf(fp, "        Threads.atomic_add!(s.ns[j], dt)\n");
+     bxprintf(fp, "        Threads.atomic_add!(s.hist[j, k], UInt64(1))\n");
+     bxprintf(fp, "    end\n");
+     bxprintf(fp, "end\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+     bxprintf(fp, "function stats()\n");
+     bxprintf(fp, "    Dict(s.name => Dict(\"calls\" => s.n_calls[],\n");
+     bxprintf(fp, "                        \"ns\"    => [x[] for x in s.ns],\n");
+     bxprintf(fp, "                        \"hist\"  => [x[] for x in s.hist]) for s in stats_data)\n");
+     bxprintf(fp, "end\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
 
      return 0;
 }
 
 
 
-static int write_subprograms(FILE *fp, const bindx_data *d,
+static void write_ccall_arg_types(bindx_buffer_data *fp, const subprogram_data *subprogram)
+{
+     argument_data *argument;
+
+     list_for_each(subprogram->args, argument) {
+          bxprintf(fp, "%s", type_to_julia_c_type(&argument->type,
+                   argument->type.rank == 0 &&
+                   argument->usage == LEX_SUBPROGRAM_ARGUMENT_USAGE_OUT,
+                   argument->usage == LEX_SUBPROGRAM_ARGUMENT_USAGE_OUT));
+
+          if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_STRIDED)
+               bxprintf(fp, ", Ptr{Cptrdiff_t}");
+
+          if (! list_is_last_elem(subprogram->args, argument))
+               bxprintf(fp, ", ");
+     }
+}
+
+
+
+static void write_return_value(bindx_buffer_data *fp, const subprogram_data *subprogram,
+                               int indent)
+{
+     int flag;
+
+     char *crap = "";
+
+     argument_data *argument;
+
+     if (subprogram->has_return_value) {
+          if (subprogram->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_ENUM_MASK)
+               bxprintf(fp, "%smask_to_list(r, \"%s\", \"%s\")\n", bxis4(indent),
+                        subprogram->options.enum_index_to_mask,
+                        subprogram->options.enum_index_to_name);
+          else
+          if (subprogram->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_ENUM_ARRAY) {
+               bxprintf(fp, "%sr = ccall((:xrtm_kernel_value_to_name, library_path), Cstring, (Cint, ), r)\n", bxis4(indent));
+               bxprintf(fp, "%sif r == C_NULL\n", bxis4(indent));
+               indent++;
+               bxprintf(fp, "%serror(\"%s()\")\n", bxis4(indent), subprogram->name);
+               indent--;
+               bxprintf(fp, "%send\n", bxis4(indent));
+               bxprintf(fp, "%sunsafe_string(r)\n", bxis4(indent));
+          }
+          else
+               bxprintf(fp, "%sr\n", bxis4(indent));
+     }
+     else {
+          flag = 0;
+          if (subprogram_n_out_args(subprogram) != 0) {
+               bxprintf(fp, "%s", bxis4(indent));
+               list_for_each(subprogram->args, argument) {
+                    if (argument->usage == LEX_SUBPROGRAM_ARGUMENT_USAGE_OUT) {
+                         crap = "";
+                         if (argument->type.rank == 0)
+                              crap = "[]";
+                         if (! flag) {
+                              flag = 1;
+                              bxprintf(fp, "%s%s", argument->name, crap);
+                         }
+                         else {
+                              bxprintf(fp, ", %s%s", argument->name, crap);
+                         }
+                    }
+               }
+               bxprintf(fp, "\n");
+          }
+     }
+}
+
+
+
+static int write_subprograms(bindx_buffer_data *fp, const bindx_data *d,
                              enum subprogram_type sub_type,
                              const subprogram_data *subs)
 {
      int i;
      int ii;
 
-     int flag;
-
      int indent = 0;
 
-     char *crap = "";
-
      char *postfix = "";
 
+     int stats;
+     int i_stats = 0;
+
      argument_data *argument;
-     argument_data *argument2;
      subprogram_data *subprogram;
 
+     stats = d->stats && sub_type == SUBPROGRAM_TYPE_GENERAL;
+
      list_for_each(subs, subprogram) {
           /**** Start function declaration ****/
 
-          fprintf(fp, "function %s(", subprogram->name);
+          bxprintf(fp, "function %s(", subprogram->name);
           if (sub_type != SUBPROGRAM_TYPE_INIT) {
-               fprintf(fp, "d");
+               bxprintf(fp, "d");
                if (subprogram_n_in_args(subprogram) > 0)
-                    fprintf(fp, ", ");
+                    bxprintf(fp, ", ");
           }
 
           list_for_each(subprogram->args, argument) {
@@ -320,87 +606,86 @@ static int write_subprograms(FILE *fp, const bindx_data *d,
                     continue;
 
                if (argument->type.rank == 0 && argument->type.type == LEX_BINDX_TYPE_ENUM)
-                    fprintf(fp, "%s_string::String", argument->name);
+                    bxprintf(fp, "%s_string::String", argument->name);
                else
                if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_ENUM_MASK ||
                    argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_ENUM_ARRAY)
-                    fprintf(fp, "%s_list::Vector{String}", argument->name);
+                    bxprintf(fp, "%s_list::Vector{String}", argument->name);
                else
                if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_LIST_SIZE)
                     continue;
                else
+               if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_STRIDED)
+                    bxprintf(fp, "%s::StridedArray{%s, %d}", argument->name,
+                             type_to_julia_type(&argument->type), argument->type.rank);
+               else
                if (argument->type.rank > 0)
-                    fprintf(fp, "%s::Array{%s, %d}", argument->name,
-                            type_to_julia_type(&argument->type), argument->type.rank);
+                    bxprintf(fp, "%s::Array{%s, %d}", argument->name,
+                             type_to_julia_type(&argument->type), argument->type.rank);
                else
-                    fprintf(fp, "%s", argument->name);
+                    bxprintf(fp, "%s", argument->name);
 
                if (! list_is_last_elem(subprogram->args, argument) &&
                    ((argument_data *) list_next_elem(argument))->usage == LEX_SUBPROGRAM_ARGUMENT_USAGE_IN)
-                    fprintf(fp, ", ");
+                    bxprintf(fp, ", ");
           }
 
-          fprintf(fp, ")\n");
+          bxprintf(fp, ")\n");
 
 
           indent++;
 
+          if (stats)
+               bxprintf(fp, "%sstats_t0 = time_ns()\n", bxis4(indent));
+
 
           /**** Convert lists to masks or arrays ****/
 
           list_for_each(subprogram->args, argument) {
                if (argument->type.rank == 0 && argument->type.type == LEX_BINDX_TYPE_ENUM) {
-                    fprintf(fp, "%s%s = ccall((:%s, library_path), Cint, (Cstring, ), %s_string)\n",
-                            bxis4(indent), argument->name, argument->options.enum_name_to_value, argument->name);
-                    fprintf(fp, "%sif %s == -1\n", bxis4(indent), argument->name);
+                    bxprintf(fp, "%s%s = ccall((:%s, library_path), Cint, (Cstring, ), %s_string)\n",
+                             bxis4(indent), argument->name, argument->options.enum_name_to_value, argument->name);
+                    bxprintf(fp, "%sif %s == -1\n", bxis4(indent), argument->name);
                     indent++;
-                    fprintf(fp, "%serror(\"%s()\")\n", bxis4(indent), argument->options.enum_name_to_value);
+                    bxprintf(fp, "%serror(\"%s()\")\n", bxis4(indent), argument->options.enum_name_to_value);
                     indent--;
-                    fprintf(fp, "%send\n", bxis4(indent));
+                    bxprintf(fp, "%send\n", bxis4(indent));
                }
                else
                if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_ENUM_MASK)
-                    fprintf(fp, "%s%s = list_to_mask(%s_list, \"%s\")\n",
-                            bxis4(indent), argument->name, argument->name,
-                            argument->options.enum_name_to_value);
+                    bxprintf(fp, "%s%s = list_to_mask(%s_list, \"%s\")\n",
+                             bxis4(indent), argument->name, argument->name,
+                             argument->options.enum_name_to_value);
                else
                if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_ENUM_ARRAY)
-                    fprintf(fp, "%sn_%s, %s = list_to_array(%s_list, \"%s\")\n",
-                            bxis4(indent), argument->name, argument->name, argument->name,
-                            argument->options.enum_name_to_value);
+                    bxprintf(fp, "%sn_%s, %s = list_to_array(%s_list, \"%s\")\n",
+                             bxis4(indent), argument->name, argument->name, argument->name,
+                             argument->options.enum_name_to_value);
           }
 
 
           /**** Get dimensions****/
 
-          if (sub_type == SUBPROGRAM_TYPE_GENERAL) {
-              list_for_each(subprogram->args, argument) {
-                   if (argument->type.rank > 0) {
-                        fprintf(fp, "%sdims_%s = Array{UInt64, 1}(undef, (%d))\n",
-                                bxis4(indent), argument->name, argument->type.rank);
-
-                        fprintf(fp, "%sr = ccall((:%s_%s_dims, library_path), Cint, (Ptr{Cvoid}, ",
-                                bxis4(indent), subprogram->name, argument->name);
-
-                        list_for_each(subprogram->args, argument2) {
-                             if (argument2->usage == LEX_SUBPROGRAM_ARGUMENT_USAGE_IN) {
-                                  fprintf(fp, "%s, ", type_to_julia_c_type(&argument2->type,
-                                          argument2->type.rank == 0 &&
-                                          argument2->usage == LEX_SUBPROGRAM_ARGUMENT_USAGE_OUT,
-                                          argument2->usage == LEX_SUBPROGRAM_ARGUMENT_USAGE_OUT));
-                             }
-                        }
-                        fprintf(fp, "Ref{Csize_t}), ");
+          if (sub_type == SUBPROGRAM_TYPE_GENERAL && subprogram->n_dimens > 0) {
+              bxprintf(fp, "%sdimens = Array{UInt64, 1}(undef, (%d))\n",
+                       bxis4(indent), subprogram->n_dimens);
 
-                        fprintf(fp, "d");
-                        list_for_each(subprogram->args, argument2) {
-                             if (argument2->usage != LEX_SUBPROGRAM_ARGUMENT_USAGE_OUT)
-                                  fprintf(fp, ", %s", argument2->name);
-                        }
+              bxprintf(fp, "%sr = ccall((:%s_dims, library_path), Cint, (Ptr{Cvoid}, ",
+                       bxis4(indent), subprogram->name);
 
-                        fprintf(fp, ", dims_%s)\n", argument->name);
-                   }
+              list_for_each(subprogram->args, argument) {
+                   if (argument->usage == LEX_SUBPROGRAM_ARGUMENT_USAGE_IN)
+                        bxprintf(fp, "%s, ", type_to_julia_c_type(&argument->type, 0, 0));
+              }
+              bxprintf(fp, "Ref{Csize_t}), ");
+
+              bxprintf(fp, "d");
+              list_for_each(subprogram->args, argument) {
+                   if (argument->usage != LEX_SUBPROGRAM_ARGUMENT_USAGE_OUT)
+                        bxprintf(fp, ", %s", argument->name);
               }
+
+              bxprintf(fp, ", dimens)\n");
           }
 
 
@@ -411,14 +696,14 @@ static int write_subprograms(FILE *fp, const bindx_data *d,
                    if (argument->type.rank > 0 &&
                        argument->usage == LEX_SUBPROGRAM_ARGUMENT_USAGE_IN) {
                         for (i = 0; i < argument->type.rank; ++i) {
-                             ii = argument->type.rank - i - 1;
-                             fprintf(fp, "%sdims = collect(UInt, size(%s))\n", bxis4(indent), argument->name);
-                             fprintf(fp, "%sif dims[%d] != dims_%s[%d]\n", bxis4(indent), i + 1, argument->name, ii + 1);
+                             ii = argument->i_dimens[julia_dimen_index(argument, i)];
+                             bxprintf(fp, "%sdims = collect(UInt, size(%s))\n", bxis4(indent), argument->name);
+                             bxprintf(fp, "%sif dims[%d] != dimens[%d]\n", bxis4(indent), i + 1, ii + 1);
                              indent++;
-                             fprintf(fp, "%serror(@sprintf(\"dimension %d of %s input (%%d) must be == %%d\", dims[%d], dims_%s[%d]))\n",
-                                     bxis4(indent), i + 1, argument->name, i + 1, argument->name, ii + 1);
+                             bxprintf(fp, "%serror(@sprintf(\"dimension %d of %s input (%%d) must be == %%d\", dims[%d], dimens[%d]))\n",
+                                      bxis4(indent), i + 1, argument->name, i + 1, ii + 1);
                              indent--;
-                             fprintf(fp, "%send\n", bxis4(indent));
+                             bxprintf(fp, "%send\n", bxis4(indent));
                         }
                    }
               }
@@ -430,19 +715,23 @@ static int write_subprograms(FILE *fp, const bindx_data *d,
           list_for_each(subprogram->args, argument) {
                if (argument->type.rank == 0 &&
                    argument->usage == LEX_SUBPROGRAM_ARGUMENT_USAGE_OUT)
-                    fprintf(fp, "%s%s = Ref{%s}(0)\n", bxis4(indent), argument->name,
-                            type_to_julia_c_type(&argument->type, 0, 0));
+                    bxprintf(fp, "%s%s = Ref{%s}(0)\n", bxis4(indent), argument->name,
+                             type_to_julia_c_type(&argument->type, 0, 0));
                else
                if (argument->type.rank > 0 &&
                    argument->usage == LEX_SUBPROGRAM_ARGUMENT_USAGE_OUT) {
-                    fprintf(fp, "%s%s = Array{%s, %d}(undef, (", bxis4(indent), argument->name,
-                            type_to_julia_type(&argument->type), argument->type.rank);
+                    if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_ALIGN)
+                         bxprintf(fp, "%s%s = aligned_array(%s, %d, (", bxis4(indent), argument->name,
+                                  type_to_julia_type(&argument->type), argument->options.align);
+                    else
+                         bxprintf(fp, "%s%s = Array{%s, %d}(undef, (", bxis4(indent), argument->name,
+                                  type_to_julia_type(&argument->type), argument->type.rank);
                     for (i = 0; i < argument->type.rank; ++i) {
-                         fprintf(fp, "dims_%s[%d]", argument->name, argument->type.rank - i);
+                         bxprintf(fp, "dimens[%d]", argument->i_dimens[julia_dimen_index(argument, i)] + 1);
                          if (i + 1 < argument->type.rank)
-                              fprintf(fp, ", ");
+                              bxprintf(fp, ", ");
                     }
-                    fprintf(fp, "))\n");
+                    bxprintf(fp, "))\n");
                }
           }
 
@@ -450,10 +739,26 @@ static int write_subprograms(FILE *fp, const bindx_data *d,
           /**** Create C memory maps of Julia arrays ****/
 
           list_for_each(subprogram->args, argument) {
-               if (argument->type.rank > 1)
-                   fprintf(fp, "%s%s_mmap = ccall((:array_from_mem, library_path), %s, (%s, Cint, Ref{Csize_t}, Csize_t, Cint), %s, %d, dims_%s, sizeof(%s), 1)\n",
-                           bxis4(indent), argument->name, type_to_julia_c_type(&argument->type, 1, 0), type_to_julia_c_type(&argument->type, 1, 1), argument->name,
-                           argument->type.rank, argument->name, type_to_julia_c_alias(&argument->type, 0, 0));
+               if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_ALIGN &&
+                   argument->usage == LEX_SUBPROGRAM_ARGUMENT_USAGE_IN)
+                   bxprintf(fp, "%s%s = align_array(%s, %d)\n",
+                            bxis4(indent), argument->name, argument->name, argument->options.align);
+
+               if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_STRIDED)
+                   bxprintf(fp, "%s%s_strides = Cptrdiff_t[reverse(strides(%s))...]\n",
+                            bxis4(indent), argument->name, argument->name);
+               else
+               if (argument_is_pointer_array(argument)) {
+                   bxprintf(fp, "%s%s_mmap = ccall((:array_from_mem, library_path), %s, (%s, Cint, Ref{Csize_t}, Csize_t, Cint), %s, %d, Csize_t[",
+                            bxis4(indent), argument->name, type_to_julia_c_type(&argument->type, 1, 0), type_to_julia_c_type(&argument->type, 1, 1), argument->name,
+                            argument->type.rank);
+                   for (i = 0; i < argument->type.rank; ++i) {
+                        bxprintf(fp, "dimens[%d]", argument->i_dimens[i] + 1);
+                        if (i + 1 < argument->type.rank)
+                             bxprintf(fp, ", ");
+                   }
+                   bxprintf(fp, "], sizeof(%s), 1)\n", type_to_julia_c_alias(&argument->type, 0, 0));
+               }
           }
 
 
@@ -463,122 +768,417 @@ static int write_subprograms(FILE *fp, const bindx_data *d,
               sub_type == SUBPROGRAM_TYPE_FREE)
               postfix = "2";
 
-          fprintf(fp, "%sr = ccall((:%s_%s%s, library_path), ",
-                  bxis4(indent), d->prefix, subprogram->name, postfix);
+          if (stats)
+               bxprintf(fp, "%sstats_t1 = time_ns()\n", bxis4(indent));
+
+          bxprintf(fp, "%sr = ccall((:%s_%s%s, library_path), ",
+                   bxis4(indent), d->prefix, subprogram->name, postfix);
           if (sub_type == SUBPROGRAM_TYPE_INIT)
-               fprintf(fp, "Ptr{Cvoid}, ");
+               bxprintf(fp, "Ptr{Cvoid}, ");
           else
-               fprintf(fp, "%s, ",
-                       type_to_julia_c_type(&subprogram->type, 0, 0));
+               bxprintf(fp, "%s, ",
+                        type_to_julia_c_type(&subprogram->type, 0, 0));
 
-          fprintf(fp, "(");
+          bxprintf(fp, "(");
 
           if (sub_type != SUBPROGRAM_TYPE_INIT)
-              fprintf(fp, "Ptr{Cvoid}, ");
-
-          list_for_each(subprogram->args, argument) {
-               fprintf(fp, "%s", type_to_julia_c_type(&argument->type,
-                       argument->type.rank == 0 &&
-                       argument->usage == LEX_SUBPROGRAM_ARGUMENT_USAGE_OUT,
-                       argument->usage == LEX_SUBPROGRAM_ARGUMENT_USAGE_OUT));
+              bxprintf(fp, "Ptr{Cvoid}, ");
 
-               if (! list_is_last_elem(subprogram->args, argument))
-                    fprintf(fp, ", ");
-          }
-          fprintf(fp, ")");
+          write_ccall_arg_types(fp, subprogram);
+          bxprintf(fp, ")");
 
           if (sub_type != SUBPROGRAM_TYPE_INIT)
-              fprintf(fp, ", d");
+              bxprintf(fp, ", d");
 
           list_for_each(subprogram->args, argument) {
-               if (argument->type.rank <= 1)
-                    fprintf(fp, ", %s",      argument->name);
+               if (! argument_is_pointer_array(argument))
+                    bxprintf(fp, ", %s",      argument->name);
                else
-                    fprintf(fp, ", %s_mmap", argument->name);
+                    bxprintf(fp, ", %s_mmap", argument->name);
+
+               if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_STRIDED)
+                    bxprintf(fp, ", %s_strides", argument->name);
           }
 
-          fprintf(fp, ")\n");
+          bxprintf(fp, ")\n");
+
+          if (stats)
+               bxprintf(fp, "%sstats_t2 = time_ns()\n", bxis4(indent));
 
 
           if (sub_type == SUBPROGRAM_TYPE_INIT)
-               fprintf(fp, "%sif r == C_NULL\n",  bxis4(indent));
+               bxprintf(fp, "%sif r == C_NULL\n",  bxis4(indent));
           else
-               fprintf(fp, "%sif r == %s\n",           bxis4(indent),
-                       bindx_c_error_conditional(d, subprogram->type.type));
+               bxprintf(fp, "%sif r == %s\n",           bxis4(indent),
+                        bindx_c_error_conditional(d, subprogram->type.type));
 
           indent++;
-          fprintf(fp, "%serror(\"%s_%s%s()\")\n", bxis4(indent),
-                  d->prefix, subprogram->name, postfix);
+          bxprintf(fp, "%serror(\"%s_%s%s()\")\n", bxis4(indent),
+                   d->prefix, subprogram->name, postfix);
           indent--;
-          fprintf(fp, "%send\n", bxis4(indent));
+          bxprintf(fp, "%send\n", bxis4(indent));
 
 
           /**** Free C memory maps of Julia arrays ****/
 
           list_for_each(subprogram->args, argument) {
-               if (argument->type.rank > 1)
-                   fprintf(fp, "%sccall((:free_array, library_path), Cvoid, (%s, Cint), %s_mmap, %d)\n",
-                           bxis4(indent), type_to_julia_c_type(&argument->type, 1, 0), argument->name,
-                           argument->type.rank);
+               if (argument_is_pointer_array(argument))
+                   bxprintf(fp, "%sccall((:free_array, library_path), Cvoid, (%s, Cint), %s_mmap, %d)\n",
+                            bxis4(indent), type_to_julia_c_type(&argument->type, 1, 0), argument->name,
+                            argument->type.rank);
           }
 
 
           /**** Return value(s) ****/
 
+          if (stats) {
+               bxprintf(fp, "%sstats_result = begin\n", bxis4(indent));
+               indent++;
+          }
+
           if (sub_type == SUBPROGRAM_TYPE_INIT)
-               fprintf(fp, "%sr\n", bxis4(indent));
+               bxprintf(fp, "%sr\n", bxis4(indent));
           else {
-               if (subprogram->has_return_value) {
-                    if (subprogram->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_ENUM_MASK)
-                         fprintf(fp, "%smask_to_list(r, \"%s\", \"%s\")\n", bxis4(indent),
-                                 subprogram->options.enum_index_to_mask,
-                                 subprogram->options.enum_index_to_name);
+               write_return_value(fp, subprogram, indent);
+          }
+
+          if (stats) {
+               indent--;
+               bxprintf(fp, "%send\n", bxis4(indent));
+               bxprintf(fp, "%sstats_record(%d, (stats_t0, stats_t1, stats_t2, time_ns()))\n",
+                        bxis4(indent), ++i_stats);
+               bxprintf(fp, "%sstats_result\n", bxis4(indent));
+          }
+
+
+          indent--;
+
+
+          /**** End function declaration ****/
+          bxprintf(fp, "end\n");
+
+
+          bxprintf(fp, "\n");
+          bxprintf(fp, "\n");
+     }
+
+     return 0;
+}
+
+
+
+/*
+ * The snapshot is copied into a Vector{UInt8} owned by Julia and restoring
+ * returns a new instance handle like create().
+ */
+static int write_state_subprograms(bindx_buffer_data *fp, const bindx_data *d)
+{
+     const argument_data *argument;
+     const subprogram_data *snapshot;
+     const subprogram_data *restore;
+
+     snapshot = bindx_snapshot_subprogram(d);
+     restore  = bindx_restore_subprogram(d);
+     if (snapshot == NULL)
+          return 0;
+
+     argument = (argument_data *) snapshot->args->next;
+
+     bxprintf(fp, "function %s(d)\n", snapshot->name);
+     bxprintf(fp, "    %s = Ref{Csize_t}(0)\n", argument->name);
+     bxprintf(fp, "    r = ccall((:%s_%s, library_path), Ptr{UInt8}, (Ptr{Cvoid}, Ref{Csize_t}), d, %s)\n",
+              d->prefix, snapshot->name, argument->name);
+     bxprintf(fp, "    if r == C_NULL\n");
+     bxprintf(fp, "        error(\"%s_%s()\")\n", d->prefix, snapshot->name);
+     bxprintf(fp, "    end\n");
+     bxprintf(fp, "    state = copy(unsafe_wrap(Array, r, %s[]))\n", argument->name);
+     bxprintf(fp, "    Libc.free(r)\n");
+     bxprintf(fp, "    state\n");
+     bxprintf(fp, "end\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+     bxprintf(fp, "function %s(state::Vector{UInt8})\n", restore->name);
+     bxprintf(fp, "    r = ccall((:%s_%s2, library_path), Ptr{Cvoid}, (Csize_t, Ptr{UInt8}), length(state), state)\n",
+              d->prefix, restore->name);
+     bxprintf(fp, "    if r == C_NULL\n");
+     bxprintf(fp, "        error(\"%s_%s2()\")\n", d->prefix, restore->name);
+     bxprintf(fp, "    end\n");
+     bxprintf(fp, "    r\n");
+     bxprintf(fp, "end\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+     return 0;
+}
+
+
+
+static int write_clone_subprogram(bindx_buffer_data *fp, const bindx_data *d)
+{
+     const subprogram_data *subprogram;
+
+     subprogram = bindx_clone_subprogram(d);
+     if (subprogram == NULL)
+          return 0;
+
+     bxprintf(fp, "function %s(d)\n", subprogram->name);
+     bxprintf(fp, "    r = ccall((:%s_%s2, library_path), Ptr{Cvoid}, (Ptr{Cvoid}, ), d)\n",
+              d->prefix, subprogram->name);
+     bxprintf(fp, "    if r == C_NULL\n");
+     bxprintf(fp, "        error(\"%s_%s2()\")\n", d->prefix, subprogram->name);
+     bxprintf(fp, "    end\n");
+     bxprintf(fp, "    r\n");
+     bxprintf(fp, "end\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+     return 0;
+}
+
+
+
+/*
+ * For subprograms with the plan option <name>_prepare() converts and checks the
+ * bound arguments once and returns a <name>_plan, and execute() dispatches on
+ * the plan type to take the remaining in scalars and go straight to ccall.
+ */
+static int write_plan_subprograms(bindx_buffer_data *fp, const bindx_data *d)
+{
+     int i;
+     int ii;
+
+     int flag;
+
+     argument_data *argument;
+     subprogram_data *subprogram;
+
+     list_for_each(&d->subs_general, subprogram) {
+          if (! (subprogram->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_PLAN))
+               continue;
+
+          flag = 0;
+          bxprintf(fp, "mutable struct %s_plan\n", subprogram->name);
+          bxprintf(fp, "    d\n");
+          list_for_each(subprogram->args, argument) {
+               if (bindx_plan_argument_is_bound(subprogram, argument)) {
+                    if (argument->type.rank > 0)
+                         bxprintf(fp, "    %s::Array{%s, %d}\n", argument->name,
+                                  type_to_julia_type(&argument->type), argument->type.rank);
                     else
-                    if (subprogram->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_ENUM_ARRAY) {
-                         fprintf(fp, "%sr = ccall((:xrtm_kernel_value_to_name, library_path), Cstring, (Cint, ), r)\n", bxis4(indent));
-                         fprintf(fp, "%sif r == C_NULL\n", bxis4(indent));
-                         indent++;
-                         fprintf(fp, "%serror(\"%s()\")\n", bxis4(indent), subprogram->name);
-                         indent--;
-                         fprintf(fp, "%send\n", bxis4(indent));
-                         fprintf(fp, "%sunsafe_string(r)\n", bxis4(indent));
+                         bxprintf(fp, "    %s\n", argument->name);
+                    if (argument_is_pointer_array(argument)) {
+                         bxprintf(fp, "    %s_mmap\n", argument->name);
+                         flag = 1;
                     }
+               }
+               else
+               if (argument->type.rank > 0 &&
+                   argument->usage == LEX_SUBPROGRAM_ARGUMENT_USAGE_OUT) {
+                    bxprintf(fp, "    %s_dims\n", argument->name);
+                    if (argument_is_pointer_array(argument))
+                         bxprintf(fp, "    %s_mdims\n", argument->name);
+               }
+          }
+          bxprintf(fp, "end\n");
+          bxprintf(fp, "\n");
+          bxprintf(fp, "\n");
+
+
+          bxprintf(fp, "function %s_prepare(d", subprogram->name);
+          list_for_each(subprogram->args, argument) {
+               if (! bindx_plan_argument_is_bound(subprogram, argument))
+                    continue;
+
+               if (argument->type.rank == 0 && argument->type.type == LEX_BINDX_TYPE_ENUM)
+                    bxprintf(fp, ", %s_string::String", argument->name);
+               else
+               if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_ENUM_MASK)
+                    bxprintf(fp, ", %s_list::Vector{String}", argument->name);
+               else
+               if (argument->type.rank > 0)
+                    bxprintf(fp, ", %s::Array{%s, %d}", argument->name,
+                             type_to_julia_type(&argument->type), argument->type.rank);
+               else
+                    bxprintf(fp, ", %s", argument->name);
+          }
+          bxprintf(fp, ")\n");
+
+          list_for_each(subprogram->args, argument) {
+               if (! bindx_plan_argument_is_bound(subprogram, argument))
+                    continue;
+
+               if (argument->type.rank == 0 && argument->type.type == LEX_BINDX_TYPE_ENUM) {
+                    bxprintf(fp, "    %s = ccall((:%s, library_path), Cint, (Cstring, ), %s_string)\n",
+                             argument->name, argument->options.enum_name_to_value, argument->name);
+                    bxprintf(fp, "    if %s == -1\n", argument->name);
+                    bxprintf(fp, "        error(\"%s()\")\n", argument->options.enum_name_to_value);
+                    bxprintf(fp, "    end\n");
+               }
+               else
+               if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_ENUM_MASK)
+                    bxprintf(fp, "    %s = list_to_mask(%s_list, \"%s\")\n",
+                             argument->name, argument->name, argument->options.enum_name_to_value);
+          }
+
+          if (subprogram->n_dimens > 0) {
+               bxprintf(fp, "    dimens = Array{UInt64, 1}(undef, (%d))\n", subprogram->n_dimens);
+               bxprintf(fp, "    r = ccall((:%s_dims, library_path), Cint, (Ptr{Cvoid}, ", subprogram->name);
+               list_for_each(subprogram->args, argument) {
+                    if (argument->usage == LEX_SUBPROGRAM_ARGUMENT_USAGE_IN)
+                         bxprintf(fp, "%s, ", type_to_julia_c_type(&argument->type, 0, 0));
+               }
+               bxprintf(fp, "Ref{Csize_t}), d");
+               list_for_each(subprogram->args, argument) {
+                    if (argument->usage != LEX_SUBPROGRAM_ARGUMENT_USAGE_IN)
+                         continue;
+                    if (bindx_plan_argument_is_bound(subprogram, argument))
+                         bxprintf(fp, ", %s", argument->name);
                     else
-                         fprintf(fp, "%sr\n", bxis4(indent));
+                         bxprintf(fp, ", 0");
                }
-               else {
-                    flag = 0;
-                    if (subprogram_n_out_args(subprogram) != 0) {
-                         fprintf(fp, "%s", bxis4(indent));
-                         list_for_each(subprogram->args, argument) {
-                              if (argument->usage == LEX_SUBPROGRAM_ARGUMENT_USAGE_OUT) {
-                                   crap = "";
-                                   if (argument->type.rank == 0)
-                                        crap = "[]";
-                                   if (! flag) {
-                                        flag = 1;
-                                        fprintf(fp, "%s%s", argument->name, crap);
-                                   }
-                                   else {
-                                        fprintf(fp, ", %s%s", argument->name, crap);
-                                   }
-                              }
+               bxprintf(fp, ", dimens)\n");
+          }
+
+          list_for_each(subprogram->args, argument) {
+               if (! bindx_plan_argument_is_bound(subprogram, argument) || argument->type.rank == 0)
+                    continue;
+
+               for (i = 0; i < argument->type.rank; ++i) {
+                    ii = argument->i_dimens[julia_dimen_index(argument, i)];
+                    bxprintf(fp, "    dims = collect(UInt, size(%s))\n", argument->name);
+                    bxprintf(fp, "    if dims[%d] != dimens[%d]\n", i + 1, ii + 1);
+                    bxprintf(fp, "        error(@sprintf(\"dimension %d of %s input (%%d) must be == %%d\", dims[%d], dimens[%d]))\n",
+                             i + 1, argument->name, i + 1, ii + 1);
+                    bxprintf(fp, "    end\n");
+               }
+
+               if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_ALIGN) {
+                    bxprintf(fp, "    if align_array(%s, %d) !== %s\n",
+                             argument->name, argument->options.align, argument->name);
+                    bxprintf(fp, "        error(\"argument %s to %s_prepare() must be aligned to %d bytes\")\n",
+                             argument->name, subprogram->name, argument->options.align);
+                    bxprintf(fp, "    end\n");
+               }
+
+               if (argument_is_pointer_array(argument)) {
+                    bxprintf(fp, "    %s_mmap = ccall((:array_from_mem, library_path), %s, (%s, Cint, Ref{Csize_t}, Csize_t, Cint), %s, %d, Csize_t[",
+                             argument->name, type_to_julia_c_type(&argument->type, 1, 0), type_to_julia_c_type(&argument->type, 1, 1),
+                             argument->name, argument->type.rank);
+                    for (i = 0; i < argument->type.rank; ++i) {
+                         bxprintf(fp, "dimens[%d]", argument->i_dimens[i] + 1);
+                         if (i + 1 < argument->type.rank)
+                              bxprintf(fp, ", ");
+                    }
+                    bxprintf(fp, "], sizeof(%s), 1)\n", type_to_julia_c_alias(&argument->type, 0, 0));
+               }
+          }
+
+          bxprintf(fp, "    plan = %s_plan(d", subprogram->name);
+          list_for_each(subprogram->args, argument) {
+               if (bindx_plan_argument_is_bound(subprogram, argument)) {
+                    bxprintf(fp, ", %s", argument->name);
+                    if (argument_is_pointer_array(argument))
+                         bxprintf(fp, ", %s_mmap", argument->name);
+               }
+               else
+               if (argument->type.rank > 0 &&
+                   argument->usage == LEX_SUBPROGRAM_ARGUMENT_USAGE_OUT) {
+                    bxprintf(fp, ", (");
+                    for (i = 0; i < argument->type.rank; ++i) {
+                         bxprintf(fp, "dimens[%d]", argument->i_dimens[julia_dimen_index(argument, i)] + 1);
+                         if (i + 1 < argument->type.rank)
+                              bxprintf(fp, ", ");
+                    }
+                    bxprintf(fp, ")");
+                    if (argument_is_pointer_array(argument)) {
+                         bxprintf(fp, ", Csize_t[");
+                         for (i = 0; i < argument->type.rank; ++i) {
+                              bxprintf(fp, "dimens[%d]", argument->i_dimens[i] + 1);
+                              if (i + 1 < argument->type.rank)
+                                   bxprintf(fp, ", ");
                          }
-                         fprintf(fp, "\n");
+                         bxprintf(fp, "]");
                     }
                }
           }
+          bxprintf(fp, ")\n");
+
+          if (flag) {
+               bxprintf(fp, "    finalizer(plan) do plan\n");
+               list_for_each(subprogram->args, argument) {
+                    if (bindx_plan_argument_is_bound(subprogram, argument) &&
+                        argument_is_pointer_array(argument))
+                         bxprintf(fp, "        ccall((:free_array, library_path), Cvoid, (%s, Cint), plan.%s_mmap, %d)\n",
+                                  type_to_julia_c_type(&argument->type, 1, 0), argument->name, argument->type.rank);
+               }
+               bxprintf(fp, "    end\n");
+          }
+          bxprintf(fp, "    plan\n");
+          bxprintf(fp, "end\n");
+          bxprintf(fp, "\n");
+          bxprintf(fp, "\n");
 
 
-          indent--;
+          bxprintf(fp, "function execute(plan::%s_plan", subprogram->name);
+          list_for_each(subprogram->args, argument) {
+               if (! bindx_plan_argument_is_bound(subprogram, argument) &&
+                   argument->usage == LEX_SUBPROGRAM_ARGUMENT_USAGE_IN)
+                    bxprintf(fp, ", %s", argument->name);
+          }
+          bxprintf(fp, ")\n");
 
+          list_for_each(subprogram->args, argument) {
+               if (argument->usage != LEX_SUBPROGRAM_ARGUMENT_USAGE_OUT)
+                    continue;
 
-          /**** End function declaration ****/
-          fprintf(fp, "end\n");
+               if (argument->type.rank == 0)
+                    bxprintf(fp, "    %s = Ref{%s}(0)\n", argument->name,
+                             type_to_julia_c_type(&argument->type, 0, 0));
+               else {
+                    if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_ALIGN)
+                         bxprintf(fp, "    %s = aligned_array(%s, %d, plan.%s_dims)\n", argument->name,
+                                  type_to_julia_type(&argument->type), argument->options.align, argument->name);
+                    else
+                         bxprintf(fp, "    %s = Array{%s, %d}(undef, plan.%s_dims)\n", argument->name,
+                                  type_to_julia_type(&argument->type), argument->type.rank, argument->name);
+                    if (argument_is_pointer_array(argument))
+                         bxprintf(fp, "    %s_mmap = ccall((:array_from_mem, library_path), %s, (%s, Cint, Ref{Csize_t}, Csize_t, Cint), %s, %d, plan.%s_mdims, sizeof(%s), 1)\n",
+                                  argument->name, type_to_julia_c_type(&argument->type, 1, 0), type_to_julia_c_type(&argument->type, 1, 1),
+                                  argument->name, argument->type.rank, argument->name, type_to_julia_c_alias(&argument->type, 0, 0));
+               }
+          }
 
+          bxprintf(fp, "    r = ccall((:%s_%s, library_path), %s, (Ptr{Cvoid}, ",
+                   d->prefix, subprogram->name, type_to_julia_c_type(&subprogram->type, 0, 0));
+          write_ccall_arg_types(fp, subprogram);
+          bxprintf(fp, "), plan.d");
+          list_for_each(subprogram->args, argument) {
+               bxprintf(fp, ", ");
+               if (bindx_plan_argument_is_bound(subprogram, argument))
+                    bxprintf(fp, "plan.");
+               bxprintf(fp, "%s", argument->name);
+               if (argument_is_pointer_array(argument))
+                    bxprintf(fp, "_mmap");
+          }
+          bxprintf(fp, ")\n");
+
+          bxprintf(fp, "    if r == %s\n", bindx_c_error_conditional(d, subprogram->type.type));
+          bxprintf(fp, "        error(\"%s_%s()\")\n", d->prefix, subprogram->name);
+          bxprintf(fp, "    end\n");
+
+          list_for_each(subprogram->args, argument) {
+               if (! bindx_plan_argument_is_bound(subprogram, argument) &&
+                   argument_is_pointer_array(argument))
+                    bxprintf(fp, "    ccall((:free_array, library_path), Cvoid, (%s, Cint), %s_mmap, %d)\n",
+                             type_to_julia_c_type(&argument->type, 1, 0), argument->name, argument->type.rank);
+          }
 
-          fprintf(fp, "\n");
-          fprintf(fp, "\n");
+          write_return_value(fp, subprogram, 1);
+
+          bxprintf(fp, "end\n");
+          bxprintf(fp, "\n");
+          bxprintf(fp, "\n");
      }
 
      return 0;
@@ -586,40 +1186,48 @@ static int write_subprograms(FILE *fp, const bindx_data *d,
 
 
 
-int bindx_write_jl(FILE **fp, const bindx_data *d, const char *name)
+int bindx_write_jl(bindx_buffer_data **fp, const bindx_data *d, const char *name)
 {
      bindx_write_c_header_top(fp[0]);
-     fprintf(fp[0], "\n");
+     bxprintf(fp[0], "\n");
 
      bindx_write_c_util_header(fp[0], d);
      bindx_write_c_util_functions(fp[0], d, &d->subs_all);
+     write_c_clone_function(fp[0], d);
+     write_c_state_functions(fp[0], d);
      bindx_write_c_util_trailer(fp[0], d);
 
      write_header_top(fp[1]);
-     fprintf(fp[1], "\n");
+     bxprintf(fp[1], "\n");
 
-     fprintf(fp[1], "module %s\n", d->PREFIX);
+     bxprintf(fp[1], "module %s\n", d->PREFIX);
 
-     fprintf(fp[1], "using Printf\n");
-     fprintf(fp[1], "\n");
+     bxprintf(fp[1], "using Printf\n");
+     bxprintf(fp[1], "\n");
 
-     fprintf(fp[1], "library_path = \"../interfaces/%s\"\n", d->PREFIX);
-     fprintf(fp[1], "\n");
+     bxprintf(fp[1], "library_path = \"../interfaces/%s\"\n", d->PREFIX);
+     bxprintf(fp[1], "\n");
 
-     fprintf(fp[1], "struct %sError <: Exception end\n", d->PREFIX);
-     fprintf(fp[1], "\n");
+     bxprintf(fp[1], "struct %sError <: Exception end\n", d->PREFIX);
+     bxprintf(fp[1], "\n");
 
      write_global_consts(fp[1], d, &d->consts);
-     fprintf(fp[1], "\n");
-     fprintf(fp[1], "\n");
+     bxprintf(fp[1], "\n");
+     bxprintf(fp[1], "\n");
 
      write_utilities(fp[1], d);
 
+     if (d->stats)
+          write_stats(fp[1], d);
+
      write_subprograms(fp[1], d, SUBPROGRAM_TYPE_INIT,    &d->subs_init);
      write_subprograms(fp[1], d, SUBPROGRAM_TYPE_FREE,    &d->subs_free);
+     write_clone_subprogram(fp[1], d);
      write_subprograms(fp[1], d, SUBPROGRAM_TYPE_GENERAL, &d->subs_general);
+     write_plan_subprograms(fp[1], d);
+     write_state_subprograms(fp[1], d);
 
-     fprintf(fp[1], "end\n");
+     bxprintf(fp[1], "end\n");
 
      return 0;
 }
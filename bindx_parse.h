@@ -32,7 +32,11 @@ enum lex_bindx_type {
      LEX_BINDX_TYPE_ENUM,
      LEX_BINDX_TYPE_CHAR,
      LEX_BINDX_TYPE_INT,
+     LEX_BINDX_TYPE_INT64,
+     LEX_BINDX_TYPE_SIZE_T,
+     LEX_BINDX_TYPE_FLOAT,
      LEX_BINDX_TYPE_DOUBLE,
+     LEX_BINDX_TYPE_COMPLEX,
      LEX_BINDX_TYPE_STRUCTURE
 };
 
@@ -10,6 +10,9 @@
 #include <gutil.h>
 #include <gindex_name_value.h>
 
+#include <ctype.h>
+
+#include "bindx_c.h"
 #include "bindx_parse.h"
 #include "bindx_parse_int.h"
 #include "bindx_util.h"
@@ -23,7 +26,20 @@ static const char *subprogram_argument_option_names[] = {
      "enum_external",
      "enum_mask",
      "enum_array",
-     "list_size"
+     "list_size",
+     "rowmajor",
+     "colmajor",
+     "strided",
+     "align",
+     "threadsafe",
+     "instance_local",
+     "pure",
+     "borrowed",
+     "owned",
+     "buffer",
+     "snapshot",
+     "restore",
+     "plan"
 };
 
 
@@ -31,7 +47,20 @@ static long subprogram_argument_option_masks[] = {
      SUBPROGRAM_ARGUMENT_OPTION_MASK_ENUM_EXTERNAL,
      SUBPROGRAM_ARGUMENT_OPTION_MASK_ENUM_MASK,
      SUBPROGRAM_ARGUMENT_OPTION_MASK_ENUM_ARRAY,
-     SUBPROGRAM_ARGUMENT_OPTION_MASK_LIST_SIZE
+     SUBPROGRAM_ARGUMENT_OPTION_MASK_LIST_SIZE,
+     SUBPROGRAM_ARGUMENT_OPTION_MASK_ROW_MAJOR,
+     SUBPROGRAM_ARGUMENT_OPTION_MASK_COL_MAJOR,
+     SUBPROGRAM_ARGUMENT_OPTION_MASK_STRIDED,
+     SUBPROGRAM_ARGUMENT_OPTION_MASK_ALIGN,
+     SUBPROGRAM_ARGUMENT_OPTION_MASK_THREADSAFE,
+     SUBPROGRAM_ARGUMENT_OPTION_MASK_INSTANCE_LOCAL,
+     SUBPROGRAM_ARGUMENT_OPTION_MASK_PURE,
+     SUBPROGRAM_ARGUMENT_OPTION_MASK_BORROWED,
+     SUBPROGRAM_ARGUMENT_OPTION_MASK_OWNED,
+     SUBPROGRAM_ARGUMENT_OPTION_MASK_BUFFER,
+     SUBPROGRAM_ARGUMENT_OPTION_MASK_SNAPSHOT,
+     SUBPROGRAM_ARGUMENT_OPTION_MASK_RESTORE,
+     SUBPROGRAM_ARGUMENT_OPTION_MASK_PLAN
 };
 
 
@@ -77,6 +106,18 @@ static int parse_int(locus_data *locus)
 
 
 
+static long parse_long(locus_data *locus)
+{
+     lex_type_data lex_type;
+
+     if (yy_lex(locus, &lex_type) != LEX_TYPE_LONG)
+          parse_error(locus, "expected an integer at %s", get_yytext());
+
+     return lex_type.l;
+}
+
+
+
 static double parse_double(locus_data *locus)
 {
      lex_type_data lex_type;
@@ -102,8 +143,24 @@ static char *parse_identifier(locus_data *locus)
 
 
 /*******************************************************************************
- *
+ * The type names added after the original set are not reserved words but are
+ * recognized here, in type position, so that existing interfaces may still use
+ * them as identifiers.
  ******************************************************************************/
+static int identifier_to_type(const char *name)
+{
+     if (strcmp(name, "int64") == 0)
+          return LEX_BINDX_TYPE_INT64;
+     if (strcmp(name, "size_t") == 0)
+          return LEX_BINDX_TYPE_SIZE_T;
+     if (strcmp(name, "float") == 0)
+          return LEX_BINDX_TYPE_FLOAT;
+
+     return LEX_TYPE_IDENTIFIER;
+}
+
+
+
 static type_data parse_type(locus_data *locus)
 {
      int i;
@@ -116,6 +173,12 @@ static type_data parse_type(locus_data *locus)
 
      r = yy_lex(locus, &lex_type);
 
+     if (r == LEX_TYPE_IDENTIFIER) {
+          r = identifier_to_type(lex_type.s);
+          if (r != LEX_TYPE_IDENTIFIER)
+               free(lex_type.s);
+     }
+
      switch(r) {
           case LEX_BINDX_TYPE_VOID:
                type.type = LEX_BINDX_TYPE_VOID;
@@ -137,11 +200,31 @@ static type_data parse_type(locus_data *locus)
                type.name = "int";
                type.rank = parse_int(locus);
                break;
+          case LEX_BINDX_TYPE_INT64:
+               type.type = LEX_BINDX_TYPE_INT64;
+               type.name = "int64";
+               type.rank = parse_int(locus);
+               break;
+          case LEX_BINDX_TYPE_SIZE_T:
+               type.type = LEX_BINDX_TYPE_SIZE_T;
+               type.name = "size_t";
+               type.rank = parse_int(locus);
+               break;
+          case LEX_BINDX_TYPE_FLOAT:
+               type.type = LEX_BINDX_TYPE_FLOAT;
+               type.name = "float";
+               type.rank = parse_int(locus);
+               break;
           case LEX_BINDX_TYPE_DOUBLE:
                type.type = LEX_BINDX_TYPE_DOUBLE;
                type.name = "double";
                type.rank = parse_int(locus);
                break;
+          case LEX_BINDX_TYPE_COMPLEX:
+               type.type = LEX_BINDX_TYPE_COMPLEX;
+               type.name = "complex double";
+               type.rank = parse_int(locus);
+               break;
           case LEX_TYPE_IDENTIFIER:
                type.type = LEX_BINDX_TYPE_STRUCTURE;
                type.name = lex_type.s;
@@ -234,6 +317,11 @@ static global_const_data *parse_global_const(locus_data *locus)
      case LEX_BINDX_TYPE_INT:
           global_const->lex_type.l = parse_int(locus);
           break;
+     case LEX_BINDX_TYPE_INT64:
+     case LEX_BINDX_TYPE_SIZE_T:
+          global_const->lex_type.l = parse_long(locus);
+          break;
+     case LEX_BINDX_TYPE_FLOAT:
      case LEX_BINDX_TYPE_DOUBLE:
           global_const->lex_type.d = parse_double(locus);
           break;
@@ -266,19 +354,92 @@ static err_ret_val_data parse_err_ret_vals(locus_data *locus)
 
 
 
+/*******************************************************************************
+ *
+ ******************************************************************************/
+static field_data *parse_field(locus_data *locus, const structure_data *structure,
+                               size_t offset)
+{
+     int i;
+
+     char *p;
+
+     field_data *field;
+
+     field = malloc(sizeof(field_data));
+
+     field->type   = parse_type(locus);
+     field->name   = parse_identifier(locus);
+     field->offset = parse_int(locus);
+
+     switch(field->type.type) {
+          case LEX_BINDX_TYPE_CHAR:
+          case LEX_BINDX_TYPE_INT:
+          case LEX_BINDX_TYPE_INT64:
+          case LEX_BINDX_TYPE_SIZE_T:
+          case LEX_BINDX_TYPE_FLOAT:
+          case LEX_BINDX_TYPE_DOUBLE:
+          case LEX_BINDX_TYPE_COMPLEX:
+               break;
+          default:
+               parse_error(locus, "invalid type for structure field: %s", field->name);
+               break;
+     }
+
+     for (i = 0; i < field->type.rank; ++i) {
+          if (strtol(field->type.dimens[i], &p, 10) <= 0 || *p != '\0')
+               parse_error(locus, "structure field dimension must be a positive integer: %s",
+                           field->name);
+     }
+
+     if (field->offset < offset)
+          parse_error(locus, "structure field offset out of order or overlapping: %s",
+                      field->name);
+
+     if (field->offset + field_size(field) > structure->size)
+          parse_error(locus, "structure field extends past the structure size: %s",
+                      field->name);
+
+     return field;
+}
+
+
+
 /*******************************************************************************
  *
  ******************************************************************************/
 static structure_data *parse_structure(locus_data *locus)
 {
+     int r;
+
+     size_t offset;
+
+     field_data *field;
+
      structure_data *structure;
 
+     lex_type_data lex_type;
+
      structure = malloc(sizeof(structure_data));
 
      structure->name = parse_identifier(locus);
      structure->size = parse_int(locus);
 
-     parse_char(locus, ';');
+     structure->fields = malloc(sizeof(field_data));
+     list_init(structure->fields);
+
+     offset = 0;
+     while ((r = yy_lex(locus, &lex_type)) == ',') {
+          field = parse_field(locus, structure, offset);
+
+          offset = field->offset + field_size(field);
+
+          if (list_append(structure->fields, field, 1) == NULL)
+               parse_error(locus, "duplicate structure field name: %s", field->name);
+     }
+
+     if (r != ';')
+          parse_error(locus, "expected an \';\' at %s", get_yytext());
 
      return structure;
 }
@@ -312,8 +473,24 @@ static int parse_usage(locus_data *locus)
 
 
 /*******************************************************************************
- *
+ * Only the original option names are reserved words.  The rest lex as
+ * identifiers and are looked up here, in option position, so that existing
+ * interfaces may still use them as names.
  ******************************************************************************/
+static int identifier_to_option(const char *name)
+{
+     int i;
+
+     for (i = 0; i < N_SUBPROGRAM_ARGUMENT_OPTIONS; ++i) {
+          if (strcmp(name, subprogram_argument_option_names[i]) == 0)
+               return LEX_SUBPROGRAM_ARGUMENT_OPTION_ENUM_EXTERNAL + i;
+     }
+
+     return LEX_TYPE_IDENTIFIER;
+}
+
+
+
 static option_data parse_options(locus_data *locus, const char *delims, int *r, int flag)
 {
      int i;
@@ -332,6 +509,8 @@ static option_data parse_options(locus_data *locus, const char *delims, int *r,
      options.enum_index_to_name  = NULL;
      options.enum_value_to_name  = NULL;
 
+     options.align = 0;
+
      while (1) {
           *r = yy_lex(locus, &lex_type);
 
@@ -341,6 +520,11 @@ static option_data parse_options(locus_data *locus, const char *delims, int *r,
                     goto L1;
           }
 
+          if (*r == LEX_TYPE_IDENTIFIER) {
+               *r = identifier_to_option(lex_type.s);
+               free(lex_type.s);
+          }
+
           switch(*r) {
                case LEX_SUBPROGRAM_ARGUMENT_OPTION_ENUM_EXTERNAL:
                     options.flags |= SUBPROGRAM_ARGUMENT_OPTION_MASK_ENUM_EXTERNAL;
@@ -366,6 +550,46 @@ static option_data parse_options(locus_data *locus, const char *delims, int *r,
                case LEX_SUBPROGRAM_ARGUMENT_OPTION_LIST_SIZE:
                     options.flags |= SUBPROGRAM_ARGUMENT_OPTION_MASK_LIST_SIZE;
                     break;
+               case LEX_SUBPROGRAM_ARGUMENT_OPTION_ROW_MAJOR:
+                    options.flags |= SUBPROGRAM_ARGUMENT_OPTION_MASK_ROW_MAJOR;
+                    break;
+               case LEX_SUBPROGRAM_ARGUMENT_OPTION_COL_MAJOR:
+                    options.flags |= SUBPROGRAM_ARGUMENT_OPTION_MASK_COL_MAJOR;
+                    break;
+               case LEX_SUBPROGRAM_ARGUMENT_OPTION_STRIDED:
+                    options.flags |= SUBPROGRAM_ARGUMENT_OPTION_MASK_STRIDED;
+                    break;
+               case LEX_SUBPROGRAM_ARGUMENT_OPTION_ALIGN:
+                    options.flags |= SUBPROGRAM_ARGUMENT_OPTION_MASK_ALIGN;
+                    options.align = parse_int(locus);
+                    break;
+               case LEX_SUBPROGRAM_ARGUMENT_OPTION_THREADSAFE:
+                    options.flags |= SUBPROGRAM_ARGUMENT_OPTION_MASK_THREADSAFE;
+                    break;
+               case LEX_SUBPROGRAM_ARGUMENT_OPTION_INSTANCE_LOCAL:
+                    options.flags |= SUBPROGRAM_ARGUMENT_OPTION_MASK_INSTANCE_LOCAL;
+                    break;
+               case LEX_SUBPROGRAM_ARGUMENT_OPTION_PURE:
+                    options.flags |= SUBPROGRAM_ARGUMENT_OPTION_MASK_PURE;
+                    break;
+               case LEX_SUBPROGRAM_ARGUMENT_OPTION_BORROWED:
+                    options.flags |= SUBPROGRAM_ARGUMENT_OPTION_MASK_BORROWED;
+                    break;
+               case LEX_SUBPROGRAM_ARGUMENT_OPTION_OWNED:
+                    options.flags |= SUBPROGRAM_ARGUMENT_OPTION_MASK_OWNED;
+                    break;
+               case LEX_SUBPROGRAM_ARGUMENT_OPTION_BUFFER:
+                    options.flags |= SUBPROGRAM_ARGUMENT_OPTION_MASK_BUFFER;
+                    break;
+               case LEX_SUBPROGRAM_ARGUMENT_OPTION_SNAPSHOT:
+                    options.flags |= SUBPROGRAM_ARGUMENT_OPTION_MASK_SNAPSHOT;
+                    break;
+               case LEX_SUBPROGRAM_ARGUMENT_OPTION_RESTORE:
+                    options.flags |= SUBPROGRAM_ARGUMENT_OPTION_MASK_RESTORE;
+                    break;
+               case LEX_SUBPROGRAM_ARGUMENT_OPTION_PLAN:
+                    options.flags |= SUBPROGRAM_ARGUMENT_OPTION_MASK_PLAN;
+                    break;
                default:
                     parse_error(locus, "Invalid argument option: %s", get_yytext());
                     break;
@@ -382,6 +606,8 @@ L1:  return options;
  ******************************************************************************/
 static argument_data *parse_argument(locus_data *locus, const char *delims, int *r)
 {
+     int layout;
+
      argument_data *argument;
 
      argument = malloc(sizeof(argument_data));
@@ -391,6 +617,31 @@ static argument_data *parse_argument(locus_data *locus, const char *delims, int
      argument->usage   = parse_usage(locus);
      argument->options = parse_options(locus, delims, r, 0);
 
+     layout = argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_LAYOUT;
+     if (layout) {
+          if (argument->type.rank == 0)
+               parse_error(locus, "layout option for scalar argument: %s", argument->name);
+          if (layout & (layout - 1))
+               parse_error(locus, "more than one layout option for argument: %s", argument->name);
+     }
+
+     if (argument->options.flags & (SUBPROGRAM_ARGUMENT_OPTION_MASK_CONCURRENCY |
+                                    SUBPROGRAM_ARGUMENT_OPTION_MASK_OWNERSHIP |
+                                    SUBPROGRAM_ARGUMENT_OPTION_MASK_BUFFER |
+                                    SUBPROGRAM_ARGUMENT_OPTION_MASK_SNAPSHOT |
+                                    SUBPROGRAM_ARGUMENT_OPTION_MASK_RESTORE |
+                                    SUBPROGRAM_ARGUMENT_OPTION_MASK_PLAN))
+          parse_error(locus, "subprogram option for argument: %s", argument->name);
+
+     if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_ALIGN) {
+          if (argument->type.rank == 0)
+               parse_error(locus, "align option for scalar argument: %s", argument->name);
+          if (argument->options.align < (int) sizeof(void *) ||
+              argument->options.align & (argument->options.align - 1))
+               parse_error(locus, "alignment must be a power of two multiple of %d: %s",
+                           (int) sizeof(void *), argument->name);
+     }
+
      return argument;
 }
 
@@ -415,6 +666,17 @@ static subprogram_data *parse_subprogram(locus_data *locus)
      subprogram->name             = parse_identifier(locus);
      subprogram->has_return_value = parse_int(locus);
      subprogram->options          = parse_options(locus, delims, &r, 1);
+     subprogram->n_dimens         = 0;
+     subprogram->dimens           = NULL;
+
+     if (subprogram->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_OWNERSHIP) {
+          if (! subprogram->has_return_value || subprogram->type.rank == 0)
+               parse_error(locus, "ownership option for subprogram without an array return value: %s",
+                           subprogram->name);
+          if ((subprogram->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_OWNERSHIP) ==
+              SUBPROGRAM_ARGUMENT_OPTION_MASK_OWNERSHIP)
+               parse_error(locus, "both borrowed and owned for subprogram: %s", subprogram->name);
+     }
 
      subprogram->args = malloc(sizeof(argument_data));
      list_init(subprogram->args);
@@ -450,6 +712,61 @@ static subprogram_data *parse_subprogram(locus_data *locus)
      else
           parse_error(locus, "unexpected character at: %s", get_yytext());
 
+     if (subprogram->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_BUFFER) {
+          if (! subprogram->has_return_value || subprogram->type.rank == 0 ||
+              ! list_is_empty(subprogram->args))
+               parse_error(locus, "buffer option for subprogram that does not return an array "
+                           "without arguments: %s", subprogram->name);
+          if (subprogram->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_OWNED)
+               parse_error(locus, "both buffer and owned for subprogram: %s", subprogram->name);
+     }
+
+     if (subprogram->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_SNAPSHOT) {
+          argument = (argument_data *) subprogram->args->next;
+          if (! subprogram->has_return_value || subprogram->type.type != LEX_BINDX_TYPE_CHAR ||
+              subprogram->type.rank != 1 || list_count(subprogram->args) != 1 ||
+              argument->type.type != LEX_BINDX_TYPE_SIZE_T || argument->type.rank != 0 ||
+              argument->usage != LEX_SUBPROGRAM_ARGUMENT_USAGE_OUT ||
+              strcmp(subprogram->type.dimens[0], argument->name) != 0)
+               parse_error(locus, "snapshot option for subprogram that does not return a char "
+                           "array sized by its only argument, a size_t out: %s", subprogram->name);
+          if (! (subprogram->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_OWNED))
+               parse_error(locus, "snapshot option for subprogram that is not owned: %s", subprogram->name);
+     }
+
+     if (subprogram->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_RESTORE) {
+          argument = (argument_data *) subprogram->args->next;
+          if (subprogram->has_return_value || list_count(subprogram->args) != 2 ||
+              argument->type.type != LEX_BINDX_TYPE_SIZE_T || argument->type.rank != 0 ||
+              argument->usage != LEX_SUBPROGRAM_ARGUMENT_USAGE_IN ||
+              ((argument_data *) argument->next)->type.type != LEX_BINDX_TYPE_CHAR ||
+              ((argument_data *) argument->next)->type.rank != 1 ||
+              ((argument_data *) argument->next)->usage != LEX_SUBPROGRAM_ARGUMENT_USAGE_IN ||
+              strcmp(((argument_data *) argument->next)->type.dimens[0], argument->name) != 0)
+               parse_error(locus, "restore option for subprogram that does not take a size_t in "
+                           "and a char array of that size in: %s", subprogram->name);
+     }
+
+     if (subprogram->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_PLAN) {
+          if (subprogram->options.flags & (SUBPROGRAM_ARGUMENT_OPTION_MASK_BUFFER |
+                                           SUBPROGRAM_ARGUMENT_OPTION_MASK_SNAPSHOT |
+                                           SUBPROGRAM_ARGUMENT_OPTION_MASK_RESTORE))
+               parse_error(locus, "plan option with buffer, snapshot or restore for subprogram: %s",
+                           subprogram->name);
+          if (subprogram->has_return_value && subprogram->type.rank > 0)
+               parse_error(locus, "plan option for subprogram with an array return value: %s",
+                           subprogram->name);
+          list_for_each(subprogram->args, argument) {
+               if (argument->type.type == LEX_BINDX_TYPE_STRUCTURE ||
+                   argument->usage == LEX_SUBPROGRAM_ARGUMENT_USAGE_IN_OUT ||
+                   argument->options.flags & (SUBPROGRAM_ARGUMENT_OPTION_MASK_STRIDED  |
+                                              SUBPROGRAM_ARGUMENT_OPTION_MASK_LIST_SIZE |
+                                              SUBPROGRAM_ARGUMENT_OPTION_MASK_ENUM_ARRAY))
+                    parse_error(locus, "plan option for subprogram with a structure, in_out, "
+                                "strided, list_size or enum_array argument: %s", subprogram->name);
+          }
+     }
+
      return subprogram;
 }
 
@@ -484,7 +801,7 @@ int subprogram_n_in_args(subprogram_data *d)
 
 
 
-int subprogram_n_out_args(subprogram_data *d)
+int subprogram_n_out_args(const subprogram_data *d)
 {
      int i = 0;
 
@@ -539,15 +856,350 @@ int subprogram_n_scaler_out_args(subprogram_data *d)
 void bindx_init(bindx_data *d)
 {
      d->include = NULL;
+     d->prefix  = NULL;
+     d->PREFIX  = NULL;
+
+     d->stats         = 0;
+     d->free_threaded = 0;
+     d->limited_api   = 0;
+     d->async         = 0;
+
+     d->errors.err_ret_int = NULL;
+     d->errors.err_ret_dbl = NULL;
 
      list_init(&d->enums);
      list_init(&d->consts);
-     list_init(&d->errors);
      list_init(&d->structs);
      list_init(&d->subs_all);
      list_init(&d->subs_general);
      list_init(&d->subs_init);
      list_init(&d->subs_free);
+     list_init(&d->subs_state);
+     list_init(&d->subs_clone);
+}
+
+
+
+static int is_identifier_char(int c)
+{
+     return isalnum(c) || c == '_';
+}
+
+
+
+/*
+ * Copy a dimension expression without white space, except a single space where
+ * it separates two identifier or number tokens.
+ */
+static void normalize_dimen(const char *s, char *t)
+{
+     char *t0 = t;
+
+     for ( ; *s != '\0'; ++s) {
+          if (isspace((int) *s)) {
+               while (isspace((int) s[1]))
+                    s++;
+               if (t > t0 && is_identifier_char((int) t[-1]) &&
+                   is_identifier_char((int) s[1]))
+                    *t++ = ' ';
+          }
+          else
+               *t++ = *s;
+     }
+
+     *t = '\0';
+}
+
+
+
+/*******************************************************************************
+ * Build the table of distinct dimension expressions used by the array arguments
+ * of a subprogram and record for each argument dimension the index of its
+ * expression, so that back-ends can evaluate each distinct dimension once per
+ * call.  Enum mask and array arguments are sized at run time and are left out.
+ ******************************************************************************/
+static void subprogram_index_dimens(subprogram_data *d)
+{
+     int i;
+     int j;
+
+     char *temp;
+     char **temps;
+
+     argument_data *argument;
+
+     /* Subprograms moved by bindx_merge() have already been indexed. */
+     free(d->dimens);
+
+     d->n_dimens = 0;
+     d->dimens   = NULL;
+
+     temps = NULL;
+
+     list_for_each(d->args, argument) {
+          for (i = 0; i < argument->type.rank; ++i) {
+               argument->i_dimens[i] = -1;
+
+               if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_ENUM_MASK ||
+                   argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_ENUM_ARRAY)
+                    continue;
+
+               temp = malloc(strlen(argument->type.dimens[i]) + 1);
+               normalize_dimen(argument->type.dimens[i], temp);
+
+               for (j = 0; j < d->n_dimens; ++j) {
+                    if (strcmp(temp, temps[j]) == 0)
+                         break;
+               }
+
+               if (j < d->n_dimens)
+                    free(temp);
+               else {
+                    d->dimens = bindx_realloc(d->dimens, (d->n_dimens + 1) * sizeof(char *));
+                    temps     = bindx_realloc(temps,     (d->n_dimens + 1) * sizeof(char *));
+                    d->dimens[d->n_dimens] = argument->type.dimens[i];
+                    temps    [d->n_dimens] = temp;
+                    d->n_dimens++;
+               }
+
+               argument->i_dimens[i] = j;
+          }
+     }
+
+     for (j = 0; j < d->n_dimens; ++j)
+          free(temps[j]);
+     free(temps);
+}
+
+
+
+/*******************************************************************************
+ * Add a subprogram to the list for its type and to the list of all
+ * subprograms, which keeps the order of definition.
+ ******************************************************************************/
+void bindx_add_subprogram(bindx_data *d, int sub_type, subprogram_data *subprogram,
+                          locus_data *locus)
+{
+     subprogram_index_dimens(subprogram);
+
+     if (subprogram->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_BUFFER) {
+          if (sub_type != SUBPROGRAM_TYPE_GENERAL)
+               parse_error(locus, "buffer option for init or free subprogram: %s", subprogram->name);
+          if (bindx_buffer_subprogram(d))
+               parse_error(locus, "more than one buffer subprogram defined: %s", subprogram->name);
+     }
+
+     if (subprogram->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_SNAPSHOT) {
+          if (sub_type != SUBPROGRAM_TYPE_GENERAL)
+               parse_error(locus, "snapshot option for init or free subprogram: %s", subprogram->name);
+          if (bindx_snapshot_subprogram(d))
+               parse_error(locus, "more than one snapshot subprogram defined: %s", subprogram->name);
+     }
+
+     if (subprogram->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_RESTORE) {
+          if (sub_type != SUBPROGRAM_TYPE_GENERAL)
+               parse_error(locus, "restore option for init or free subprogram: %s", subprogram->name);
+          if (bindx_restore_subprogram(d))
+               parse_error(locus, "more than one restore subprogram defined: %s", subprogram->name);
+     }
+
+     if (subprogram->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_PLAN &&
+         sub_type != SUBPROGRAM_TYPE_GENERAL)
+          parse_error(locus, "plan option for init, free or clone subprogram: %s", subprogram->name);
+
+     if (subprogram->options.flags & (SUBPROGRAM_ARGUMENT_OPTION_MASK_SNAPSHOT |
+                                      SUBPROGRAM_ARGUMENT_OPTION_MASK_RESTORE)) {
+          if (list_find(&d->subs_all, subprogram->name) ||
+              list_find(&d->subs_clone, subprogram->name) ||
+              list_append(&d->subs_state, subprogram, 1) == NULL)
+               parse_error(locus, "duplicate subprogram name: %s", subprogram->name);
+          return;
+     }
+
+     if (sub_type == SUBPROGRAM_TYPE_CLONE) {
+          if (subprogram->has_return_value || ! list_is_empty(subprogram->args))
+               parse_error(locus, "clone subprogram with a return value or arguments: %s",
+                           subprogram->name);
+          if (! list_is_empty(&d->subs_clone))
+               parse_error(locus, "more than one clone subprogram defined: %s", subprogram->name);
+          if (list_find(&d->subs_all, subprogram->name) ||
+              list_find(&d->subs_state, subprogram->name))
+               parse_error(locus, "duplicate subprogram name: %s", subprogram->name);
+          list_append(&d->subs_clone, subprogram, 1);
+          return;
+     }
+
+     switch(sub_type) {
+          case SUBPROGRAM_TYPE_GENERAL:
+               if (list_append(&d->subs_general, subprogram, 1) == NULL)
+                    parse_error(locus, "duplicate subprogram name: %s", subprogram->name);
+               break;
+          case SUBPROGRAM_TYPE_INIT:
+               if (! list_is_empty(&d->subs_init))
+                    parse_error(locus, "more than one init subprogram defined: %s", subprogram->name);
+               list_append(&d->subs_init, subprogram, 1);
+               break;
+          case SUBPROGRAM_TYPE_FREE:
+               if (! list_is_empty(&d->subs_free))
+                    parse_error(locus, "more than one free subprogram defined: %s", subprogram->name);
+               list_append(&d->subs_free, subprogram, 1);
+               break;
+          default:
+               INTERNAL_ERROR("Invalid subprogram_type value: %d", sub_type);
+               break;
+     }
+
+     if (list_find(&d->subs_state, subprogram->name) ||
+         list_find(&d->subs_clone, subprogram->name) ||
+         list_append(&d->subs_all, subprogram_duplicate(subprogram), 1) == NULL)
+          parse_error(locus, "duplicate subprogram name: %s", subprogram->name);
+}
+
+
+
+/*
+ * The subprogram whose returned array backs the buffer protocol of an instance,
+ * or NULL if there is none.
+ */
+const subprogram_data *bindx_buffer_subprogram(const bindx_data *d)
+{
+     subprogram_data *subprogram;
+
+     list_for_each(&d->subs_general, subprogram) {
+          if (subprogram->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_BUFFER)
+               return subprogram;
+     }
+
+     return NULL;
+}
+
+
+
+/*
+ * The subprograms that serialize an instance to a char array and rebuild one
+ * from it, or NULL if there are none.  They are kept in subs_state rather than
+ * subs_general as they are only reached through the snapshot helpers of the
+ * back-ends.  The restore subprogram is called on a zeroed instance in place of
+ * the init subprogram.
+ */
+const subprogram_data *bindx_snapshot_subprogram(const bindx_data *d)
+{
+     subprogram_data *subprogram;
+
+     list_for_each(&d->subs_state, subprogram) {
+          if (subprogram->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_SNAPSHOT)
+               return subprogram;
+     }
+
+     return NULL;
+}
+
+
+
+const subprogram_data *bindx_restore_subprogram(const bindx_data *d)
+{
+     subprogram_data *subprogram;
+
+     list_for_each(&d->subs_state, subprogram) {
+          if (subprogram->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_RESTORE)
+               return subprogram;
+     }
+
+     return NULL;
+}
+
+
+
+/*
+ * The subprogram that fills a zeroed instance, its first argument, with a deep
+ * copy of an initialized one, its second, or NULL if there is none.  Like the
+ * snapshot and restore subprograms it is kept out of subs_all as its C
+ * signature has the extra instance argument.
+ */
+const subprogram_data *bindx_clone_subprogram(const bindx_data *d)
+{
+     if (list_is_empty(&d->subs_clone))
+          return NULL;
+
+     return (subprogram_data *) d->subs_clone.next;
+}
+
+
+
+/*
+ * Whether an identifier in a dimension expression is name, not counting members
+ * such as d->name.
+ */
+static int dimen_uses_name(const char *s, const char *name)
+{
+     const char *s0 = s;
+     const char *t;
+
+     size_t n;
+
+     n = strlen(name);
+
+     while (*s != '\0') {
+          if (! isalpha((int) *s) && *s != '_') {
+               ++s;
+               continue;
+          }
+
+          for (t = s; is_identifier_char((int) *t); ++t) ;
+
+          if ((size_t) (t - s) == n && strncmp(s, name, n) == 0 &&
+              ! (s - s0 >= 1 && s[-1] == '.') && ! (s - s0 >= 2 && s[-2] == '-' && s[-1] == '>'))
+               return 1;
+
+          s = t;
+     }
+
+     return 0;
+}
+
+
+
+/*
+ * A subprogram with the plan option is split into a prepare call taking the in
+ * arguments that are validated or converted, enums, masks, arrays and the
+ * scalars their shapes depend on, and an execute call taking the remaining in
+ * scalars.
+ */
+int bindx_plan_argument_is_bound(const subprogram_data *subprogram, const argument_data *argument)
+{
+     int i;
+
+     argument_data *argument2;
+
+     if (argument->usage != LEX_SUBPROGRAM_ARGUMENT_USAGE_IN)
+          return 0;
+
+     if (argument->type.rank > 0 || argument->type.type == LEX_BINDX_TYPE_ENUM ||
+         argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_ENUM_MASK)
+          return 1;
+
+     list_for_each(subprogram->args, argument2) {
+          for (i = 0; i < argument2->type.rank; ++i) {
+               if (dimen_uses_name(argument2->type.dimens[i], argument->name))
+                    return 1;
+          }
+     }
+
+     return 0;
+}
+
+
+
+int bindx_subprogram_type(const bindx_data *d, const subprogram_data *subprogram)
+{
+     if (list_find(&d->subs_init, subprogram->name))
+          return SUBPROGRAM_TYPE_INIT;
+     if (list_find(&d->subs_free, subprogram->name))
+          return SUBPROGRAM_TYPE_FREE;
+     if (list_find(&d->subs_clone, subprogram->name))
+          return SUBPROGRAM_TYPE_CLONE;
+
+     return SUBPROGRAM_TYPE_GENERAL;
 }
 
 
@@ -598,26 +1250,19 @@ void bindx_parse(bindx_data *d, locus_data *locus)
                     break;
                case LEX_ITEM_SUBPROGRAM_GENERAL:
                     subprogram = parse_subprogram(locus);
-                    if (list_append(&d->subs_general, subprogram, 1) == NULL)
-                         parse_error(locus, "duplicate subprogram name: %s", subprogram->name);
-                    if (list_append(&d->subs_all, subprogram_duplicate(subprogram), 1) == NULL)
-                         parse_error(locus, "duplicate subprogram name: %s", subprogram->name);
+                    bindx_add_subprogram(d, SUBPROGRAM_TYPE_GENERAL, subprogram, locus);
                     break;
                case LEX_ITEM_SUBPROGRAM_INIT:
                     subprogram = parse_subprogram(locus);
-                    if (! list_is_empty(&d->subs_init))
-                         parse_error(locus, "more than one init subprogram defined: %s", subprogram->name);
-                    list_append(&d->subs_init, subprogram, 1);
-                    if (list_append(&d->subs_all, subprogram_duplicate(subprogram), 1) == NULL)
-                         parse_error(locus, "duplicate subprogram name: %s", subprogram->name);
+                    bindx_add_subprogram(d, SUBPROGRAM_TYPE_INIT, subprogram, locus);
                     break;
                case LEX_ITEM_SUBPROGRAM_FREE:
                     subprogram = parse_subprogram(locus);
-                    if (! list_is_empty(&d->subs_free))
-                         parse_error(locus, "more than one free subprogram defined: %s", subprogram->name);
-                    list_append(&d->subs_free, subprogram, 1);
-                    if (list_append(&d->subs_all, subprogram_duplicate(subprogram), 1) == NULL)
-                         parse_error(locus, "duplicate subprogram name: %s", subprogram->name);
+                    bindx_add_subprogram(d, SUBPROGRAM_TYPE_FREE, subprogram, locus);
+                    break;
+               case LEX_ITEM_SUBPROGRAM_CLONE:
+                    subprogram = parse_subprogram(locus);
+                    bindx_add_subprogram(d, SUBPROGRAM_TYPE_CLONE, subprogram, locus);
                     break;
                default:
                     parse_error(locus, "Invalid interface item: %s", get_yytext());
@@ -628,6 +1273,101 @@ void bindx_parse(bindx_data *d, locus_data *locus)
 
 
 
+/*******************************************************************************
+ * Move the items of the interface definition parsed separately into a (from a
+ * single input file) onto the end of d as if they had been parsed into d.  a
+ * is left empty.
+ ******************************************************************************/
+static void *item_move(const void *item, size_t size)
+{
+     void *p;
+
+     p = malloc(size);
+
+     memcpy(p, item, size);
+
+     return p;
+}
+
+
+
+void bindx_merge(bindx_data *d, bindx_data *a, locus_data *locus)
+{
+     enumeration_data *enumeration;
+     global_const_data *global_const;
+     structure_data *structure;
+     subprogram_data *subprogram;
+
+     if (a->prefix) {
+          free(d->prefix);
+          free(d->PREFIX);
+          d->prefix = a->prefix;
+          d->PREFIX = a->PREFIX;
+          a->prefix = NULL;
+          a->PREFIX = NULL;
+     }
+
+     if (a->include) {
+          free(d->include);
+          d->include = a->include;
+          a->include = NULL;
+     }
+
+     if (a->errors.err_ret_int) {
+          d->errors = a->errors;
+          a->errors.err_ret_int = NULL;
+          a->errors.err_ret_dbl = NULL;
+     }
+
+     list_for_each(&a->enums, enumeration) {
+          if (list_append(&d->enums, item_move(enumeration, sizeof(enumeration_data)), 1) == NULL)
+               parse_error(locus, "duplicate enumeration name: %s", enumeration->name);
+     }
+     list_free(&a->enums);
+     list_init(&a->enums);
+
+     list_for_each(&a->consts, global_const) {
+          if (list_append(&d->consts, item_move(global_const, sizeof(global_const_data)), 1) == NULL)
+               parse_error(locus, "duplicate global_const name: %s", global_const->name);
+     }
+     list_free(&a->consts);
+     list_init(&a->consts);
+
+     list_for_each(&a->structs, structure) {
+          if (list_append(&d->structs, item_move(structure, sizeof(structure_data)), 1) == NULL)
+               parse_error(locus, "duplicate structure name: %s", structure->name);
+     }
+     list_free(&a->structs);
+     list_init(&a->structs);
+
+     list_for_each(&a->subs_all, subprogram)
+          bindx_add_subprogram(d, bindx_subprogram_type(a, subprogram),
+                               item_move(subprogram, sizeof(subprogram_data)), locus);
+
+     list_for_each(&a->subs_state, subprogram)
+          bindx_add_subprogram(d, SUBPROGRAM_TYPE_GENERAL,
+                               item_move(subprogram, sizeof(subprogram_data)), locus);
+
+     list_for_each(&a->subs_clone, subprogram)
+          bindx_add_subprogram(d, SUBPROGRAM_TYPE_CLONE,
+                               item_move(subprogram, sizeof(subprogram_data)), locus);
+
+     list_free(&a->subs_all);
+     list_free(&a->subs_general);
+     list_free(&a->subs_init);
+     list_free(&a->subs_free);
+     list_free(&a->subs_state);
+     list_free(&a->subs_clone);
+     list_init(&a->subs_all);
+     list_init(&a->subs_general);
+     list_init(&a->subs_init);
+     list_init(&a->subs_free);
+     list_init(&a->subs_state);
+     list_init(&a->subs_clone);
+}
+
+
+
 /*******************************************************************************
  *
  ******************************************************************************/
@@ -641,6 +1381,65 @@ void bindx_finialize(bindx_data *d)
           fprintf(stderr, "ERROR: An free subprogram has not been defined");
           exit(1);
      }
+     if (! bindx_snapshot_subprogram(d) != ! bindx_restore_subprogram(d)) {
+          fprintf(stderr, "ERROR: A snapshot subprogram requires a restore subprogram and vice versa");
+          exit(1);
+     }
+}
+
+
+
+/*******************************************************************************
+ *
+ ******************************************************************************/
+static void free_type(type_data *d)
+{
+     int i;
+
+     for (i = 0; i < d->rank; ++i)
+          free(d->dimens[i]);
+
+     switch(d->type) {
+          case LEX_BINDX_TYPE_VOID:
+               break;
+          case LEX_BINDX_TYPE_ENUM:
+               free(d->name);
+          case LEX_BINDX_TYPE_CHAR:
+               break;
+          case LEX_BINDX_TYPE_INT:
+               break;
+          case LEX_BINDX_TYPE_INT64:
+               break;
+          case LEX_BINDX_TYPE_SIZE_T:
+               break;
+          case LEX_BINDX_TYPE_FLOAT:
+               break;
+          case LEX_BINDX_TYPE_DOUBLE:
+               break;
+          case LEX_BINDX_TYPE_COMPLEX:
+               break;
+          case LEX_BINDX_TYPE_STRUCTURE:
+               free(d->name);
+               break;
+          default:
+               INTERNAL_ERROR("Invalid lex_bindx_type value: %d", d->type);
+               break;
+     }
+}
+
+
+
+/*******************************************************************************
+ *
+ ******************************************************************************/
+static void free_options(option_data *d)
+{
+     free(d->enum_external_type);
+     free(d->enum_external_class);
+     free(d->enum_name_to_value);
+     free(d->enum_index_to_mask);
+     free(d->enum_index_to_name);
+     free(d->enum_value_to_name);
 }
 
 
@@ -678,6 +1477,7 @@ static void free_enumeration(enumeration_data *d)
 static void free_global_const(global_const_data *d)
 {
      free(d->name);
+     free_type(&d->type);
 }
 
 
@@ -685,9 +1485,10 @@ static void free_global_const(global_const_data *d)
 /*******************************************************************************
  *
  ******************************************************************************/
-static void free_structure(structure_data *d)
+static void free_field(field_data *d)
 {
      free(d->name);
+     free_type(&d->type);
 }
 
 
@@ -695,26 +1496,16 @@ static void free_structure(structure_data *d)
 /*******************************************************************************
  *
  ******************************************************************************/
-static void free_type(type_data *d)
+static void free_structure(structure_data *d)
 {
-     switch(d->type) {
-          case LEX_BINDX_TYPE_VOID:
-               break;
-          case LEX_BINDX_TYPE_ENUM:
-               free(d->name);
-          case LEX_BINDX_TYPE_CHAR:
-               break;
-          case LEX_BINDX_TYPE_INT:
-               break;
-          case LEX_BINDX_TYPE_DOUBLE:
-               break;
-          case LEX_BINDX_TYPE_STRUCTURE:
-               free(d->name);
-               break;
-          default:
-               INTERNAL_ERROR("Invalid lex_bindx_type value: %d", d->type);
-               break;
-     }
+     field_data *field;
+
+     free(d->name);
+
+     list_for_each(d->fields, field)
+          free_field(field);
+     list_free(d->fields);
+     free(d->fields);
 }
 
 
@@ -724,19 +1515,9 @@ static void free_type(type_data *d)
  ******************************************************************************/
 static void free_argument(argument_data *d)
 {
-     int i;
-
      free(d->name);
      free_type(&d->type);
-
-     if (d->type.rank > 1) {
-          for (i = 0; i < d->type.rank; ++i)
-               free(d->type.dimens[i]);
-     }
-
-     free(d->options.enum_name_to_value);
-     free(d->options.enum_external_type);
-     free(d->options.enum_external_class);
+     free_options(&d->options);
 }
 
 
@@ -744,17 +1525,20 @@ static void free_argument(argument_data *d)
 /*******************************************************************************
  *
  ******************************************************************************/
-static void free_subprogram(subprogram_data *d)
+void bindx_free_subprogram(subprogram_data *d)
 {
      argument_data *argument;
 
      free(d->name);
      free_type(&d->type);
+     free_options(&d->options);
 
      list_for_each(d->args, argument)
           free_argument(argument);
      list_free(d->args);
      free(d->args);
+
+     free(d->dimens);
 }
 
 
@@ -774,6 +1558,9 @@ void bindx_free(bindx_data *d)
 
      free(d->include);
 
+     free(d->errors.err_ret_int);
+     free(d->errors.err_ret_dbl);
+
      list_for_each(&d->enums, enumeration)
           free_enumeration(enumeration);
      list_free(&d->enums);
@@ -787,12 +1574,20 @@ void bindx_free(bindx_data *d)
      list_free(&d->structs);
 
      list_for_each(&d->subs_all, subprogram)
-          free_subprogram(subprogram);
+          bindx_free_subprogram(subprogram);
      list_free(&d->subs_all);
 
      list_free(&d->subs_general);
      list_free(&d->subs_init);
      list_free(&d->subs_free);
+
+     list_for_each(&d->subs_state, subprogram)
+          bindx_free_subprogram(subprogram);
+     list_free(&d->subs_state);
+
+     list_for_each(&d->subs_clone, subprogram)
+          bindx_free_subprogram(subprogram);
+     list_free(&d->subs_clone);
 }
 
 
@@ -800,7 +1595,7 @@ void bindx_free(bindx_data *d)
 /*******************************************************************************
  *
  ******************************************************************************/
-static int write_type(FILE *fp, const type_data *d)
+static int write_type(bindx_buffer_data *fp, const type_data *d)
 {
      int i;
 
@@ -808,14 +1603,22 @@ static int write_type(FILE *fp, const type_data *d)
           case LEX_BINDX_TYPE_VOID:
                break;
           case LEX_BINDX_TYPE_ENUM:
-               fprintf(fp, "enum ");
+               bxprintf(fp, "enum ");
                break;
           case LEX_BINDX_TYPE_CHAR:
                break;
           case LEX_BINDX_TYPE_INT:
                break;
+          case LEX_BINDX_TYPE_INT64:
+               break;
+          case LEX_BINDX_TYPE_SIZE_T:
+               break;
+          case LEX_BINDX_TYPE_FLOAT:
+               break;
           case LEX_BINDX_TYPE_DOUBLE:
                break;
+          case LEX_BINDX_TYPE_COMPLEX:
+               break;
           case LEX_BINDX_TYPE_STRUCTURE:
                break;
           default:
@@ -823,12 +1626,12 @@ static int write_type(FILE *fp, const type_data *d)
                break;
      }
 
-     fprintf(fp, "%s ", d->name);
-     fprintf(fp, "%d",  d->rank);
+     bxprintf(fp, "%s ", d->name);
+     bxprintf(fp, "%d",  d->rank);
 
      if (d->rank > 0) {
           for (i = 0; i < d->rank; ++i)
-               fprintf(fp, " \"%s\"", d->dimens[i]);
+               bxprintf(fp, " \"%s\"", d->dimens[i]);
      }
 
      return 0;
@@ -839,9 +1642,9 @@ static int write_type(FILE *fp, const type_data *d)
 /*******************************************************************************
  *
  ******************************************************************************/
-static int write_enum_member(FILE *fp, const enum_member_data *d)
+static int write_enum_member(bindx_buffer_data *fp, const enum_member_data *d)
 {
-     fprintf(fp, "%s = %d", d->name, d->value);
+     bxprintf(fp, "%s = %d", d->name, d->value);
 
      return 0;
 }
@@ -851,25 +1654,25 @@ static int write_enum_member(FILE *fp, const enum_member_data *d)
 /*******************************************************************************
  *
  ******************************************************************************/
-static int write_enumeration(FILE *fp, const enumeration_data *d)
+static int write_enumeration(bindx_buffer_data *fp, const enumeration_data *d)
 {
      char *indent = "     ";
 
      enum_member_data *enum_member;
 
-     fprintf(fp, "enumeration ");
+     bxprintf(fp, "enumeration ");
 
-     fprintf(fp, "%s,\n", d->name);
+     bxprintf(fp, "%s,\n", d->name);
 
      list_for_each(d->members, enum_member) {
-          fprintf(fp, "%s", indent);
+          bxprintf(fp, "%s", indent);
           write_enum_member(fp, enum_member);
 
           if (! list_is_last_elem(d->members, enum_member))
-               fprintf(fp, ",\n");
+               bxprintf(fp, ",\n");
      }
 
-     fprintf(fp, ";\n");
+     bxprintf(fp, ";\n");
 
      return 0;
 }
@@ -879,9 +1682,9 @@ static int write_enumeration(FILE *fp, const enumeration_data *d)
 /*******************************************************************************
  *
  ******************************************************************************/
-static int write_err_ret_vals(FILE *fp, const err_ret_val_data *d)
+static int write_err_ret_vals(bindx_buffer_data *fp, const err_ret_val_data *d)
 {
-     fprintf(fp, "err_ret_vals %s %s;", d->err_ret_int, d->err_ret_dbl);
+     bxprintf(fp, "err_ret_vals %s %s;", d->err_ret_int, d->err_ret_dbl);
 
      return 0;
 }
@@ -891,23 +1694,26 @@ static int write_err_ret_vals(FILE *fp, const err_ret_val_data *d)
 /*******************************************************************************
  *
  ******************************************************************************/
-static int write_global_const(FILE *fp, const global_const_data *d)
+static int write_global_const(bindx_buffer_data *fp, const global_const_data *d)
 {
-     fprintf(fp, "global_const ");
+     bxprintf(fp, "global_const ");
      write_type(fp, &d->type);
-     fprintf(fp, " %s = ", d->name);
+     bxprintf(fp, " %s = ", d->name);
      switch(d->type.type) {
      case LEX_BINDX_TYPE_INT:
-          fprintf(fp, "%ld", d->lex_type.l);
+     case LEX_BINDX_TYPE_INT64:
+     case LEX_BINDX_TYPE_SIZE_T:
+          bxprintf(fp, "%ld", d->lex_type.l);
           break;
+     case LEX_BINDX_TYPE_FLOAT:
      case LEX_BINDX_TYPE_DOUBLE:
-          fprintf(fp, "%f",  d->lex_type.d);
+          bxprintf(fp, "%f",  d->lex_type.d);
           break;
      default:
           INTERNAL_ERROR("Invalid lex_bindx_type value: %s", d->type.name);
           break;
      }
-     fprintf(fp, ";\n");
+     bxprintf(fp, ";\n");
 
      return 0;
 }
@@ -917,9 +1723,22 @@ static int write_global_const(FILE *fp, const global_const_data *d)
 /*******************************************************************************
  *
  ******************************************************************************/
-static int write_structure(FILE *fp, const structure_data *d)
+static int write_structure(bindx_buffer_data *fp, const structure_data *d)
 {
-     fprintf(fp, "structure %s %lu;\n", d->name, d->size);
+     int i;
+
+     field_data *field;
+
+     bxprintf(fp, "structure %s %lu", d->name, d->size);
+
+     list_for_each(d->fields, field) {
+          bxprintf(fp, ", %s %d", field->type.name, field->type.rank);
+          for (i = 0; i < field->type.rank; ++i)
+               bxprintf(fp, " \"%s\"", field->type.dimens[i]);
+          bxprintf(fp, " %s %lu", field->name, field->offset);
+     }
+
+     bxprintf(fp, ";\n");
 
      return 0;
 }
@@ -929,17 +1748,17 @@ static int write_structure(FILE *fp, const structure_data *d)
 /*******************************************************************************
  *
  ******************************************************************************/
-static int write_usage(FILE *fp, int usage)
+static int write_usage(bindx_buffer_data *fp, int usage)
 {
      switch(usage) {
           case LEX_SUBPROGRAM_ARGUMENT_USAGE_IN:
-               fprintf(fp, "in");
+               bxprintf(fp, "in");
                break;
           case LEX_SUBPROGRAM_ARGUMENT_USAGE_OUT:
-               fprintf(fp, "out");
+               bxprintf(fp, "out");
                break;
           case LEX_SUBPROGRAM_ARGUMENT_USAGE_IN_OUT:
-               fprintf(fp, "in_out");
+               bxprintf(fp, "in_out");
                break;
           default:
                INTERNAL_ERROR("Invalid lex_subprogram_argument_usage: %d", usage);
@@ -954,7 +1773,7 @@ static int write_usage(FILE *fp, int usage)
 /*******************************************************************************
  *
  ******************************************************************************/
-static int write_options(FILE *fp, const option_data *d, int flag)
+static int write_options(bindx_buffer_data *fp, const option_data *d, int flag)
 {
      int i;
      int n;
@@ -967,24 +1786,63 @@ static int write_options(FILE *fp, const option_data *d, int flag)
      for (i = 0; i < n; ++i) {
           switch(options[i]) {
                case SUBPROGRAM_ARGUMENT_OPTION_MASK_ENUM_EXTERNAL:
-                    fprintf(fp, " enum_external %s %s", d->enum_external_type,
-                            d->enum_external_class);
+                    bxprintf(fp, " enum_external %s %s", d->enum_external_type,
+                             d->enum_external_class);
                     break;
                case SUBPROGRAM_ARGUMENT_OPTION_MASK_ENUM_MASK:
                     if (! flag)
-                         fprintf(fp, " enum_mask %s", d->enum_name_to_value);
+                         bxprintf(fp, " enum_mask %s", d->enum_name_to_value);
                     else
-                         fprintf(fp, " enum_mask %s %s", d->enum_index_to_mask,
-                                                         d->enum_index_to_name);
+                         bxprintf(fp, " enum_mask %s %s", d->enum_index_to_mask,
+                                                          d->enum_index_to_name);
                     break;
                case SUBPROGRAM_ARGUMENT_OPTION_MASK_ENUM_ARRAY:
                     if (! flag)
-                        fprintf(fp, " enum_array %s", d->enum_name_to_value);
+                        bxprintf(fp, " enum_array %s", d->enum_name_to_value);
                     else
-                        fprintf(fp, " enum_array %s", d->enum_value_to_name);
+                        bxprintf(fp, " enum_array %s", d->enum_value_to_name);
                     break;
                case SUBPROGRAM_ARGUMENT_OPTION_MASK_LIST_SIZE:
-                    fprintf(fp, " list_size");
+                    bxprintf(fp, " list_size");
+                    break;
+               case SUBPROGRAM_ARGUMENT_OPTION_MASK_ROW_MAJOR:
+                    bxprintf(fp, " rowmajor");
+                    break;
+               case SUBPROGRAM_ARGUMENT_OPTION_MASK_COL_MAJOR:
+                    bxprintf(fp, " colmajor");
+                    break;
+               case SUBPROGRAM_ARGUMENT_OPTION_MASK_STRIDED:
+                    bxprintf(fp, " strided");
+                    break;
+               case SUBPROGRAM_ARGUMENT_OPTION_MASK_ALIGN:
+                    bxprintf(fp, " align %d", d->align);
+                    break;
+               case SUBPROGRAM_ARGUMENT_OPTION_MASK_THREADSAFE:
+                    bxprintf(fp, " threadsafe");
+                    break;
+               case SUBPROGRAM_ARGUMENT_OPTION_MASK_INSTANCE_LOCAL:
+                    bxprintf(fp, " instance_local");
+                    break;
+               case SUBPROGRAM_ARGUMENT_OPTION_MASK_PURE:
+                    bxprintf(fp, " pure");
+                    break;
+               case SUBPROGRAM_ARGUMENT_OPTION_MASK_BORROWED:
+                    bxprintf(fp, " borrowed");
+                    break;
+               case SUBPROGRAM_ARGUMENT_OPTION_MASK_OWNED:
+                    bxprintf(fp, " owned");
+                    break;
+               case SUBPROGRAM_ARGUMENT_OPTION_MASK_BUFFER:
+                    bxprintf(fp, " buffer");
+                    break;
+               case SUBPROGRAM_ARGUMENT_OPTION_MASK_SNAPSHOT:
+                    bxprintf(fp, " snapshot");
+                    break;
+               case SUBPROGRAM_ARGUMENT_OPTION_MASK_RESTORE:
+                    bxprintf(fp, " restore");
+                    break;
+               case SUBPROGRAM_ARGUMENT_OPTION_MASK_PLAN:
+                    bxprintf(fp, " plan");
                     break;
                default:
                     INTERNAL_ERROR("Invalid subprogram_argument_option_mask: %d",
@@ -1001,12 +1859,12 @@ static int write_options(FILE *fp, const option_data *d, int flag)
 /*******************************************************************************
  *
  ******************************************************************************/
-static int write_argument(FILE *fp, const argument_data *d)
+static int write_argument(bindx_buffer_data *fp, const argument_data *d)
 {
      write_type(fp, &d->type);
-     fprintf(fp, " ");
+     bxprintf(fp, " ");
 
-     fprintf(fp, "%s ", d->name);
+     bxprintf(fp, "%s ", d->name);
      write_usage(fp, d->usage);
 
      write_options(fp, &d->options, 0);
@@ -1019,30 +1877,30 @@ static int write_argument(FILE *fp, const argument_data *d)
 /*******************************************************************************
  *
  ******************************************************************************/
-static int write_subprogram(FILE *fp, const subprogram_data *d, const char *tag)
+static int write_subprogram(bindx_buffer_data *fp, const subprogram_data *d, const char *tag)
 {
      argument_data *argument;
 
-     fprintf(fp, "subprogram%s ", tag);
+     bxprintf(fp, "subprogram%s ", tag);
 
      write_type(fp, &d->type);
-     fprintf(fp, " ");
-     fprintf(fp, "%s ", d->name);
-     fprintf(fp, "%d", d->has_return_value);
+     bxprintf(fp, " ");
+     bxprintf(fp, "%s ", d->name);
+     bxprintf(fp, "%d", d->has_return_value);
 
      write_options(fp, &d->options, 1);
 
      if (! list_is_empty(d->args))
-          fprintf(fp, ", ");
+          bxprintf(fp, ", ");
 
      list_for_each(d->args, argument) {
           write_argument(fp, argument);
 
           if (! list_is_last_elem(d->args, argument))
-               fprintf(fp, ", ");
+               bxprintf(fp, ", ");
      }
 
-     fprintf(fp, ";");
+     bxprintf(fp, ";");
 
      return 0;
 }
@@ -1052,48 +1910,58 @@ static int write_subprogram(FILE *fp, const subprogram_data *d, const char *tag)
 /*******************************************************************************
  *
  ******************************************************************************/
-int bindx_write(FILE *fp, const bindx_data *d)
+int bindx_write(bindx_buffer_data *fp, const bindx_data *d)
 {
      enumeration_data *enumeration;
      global_const_data *global_const;
      structure_data *structure;
      subprogram_data *subprogram;
 
-     fprintf(fp, "prefix %s;\n", d->prefix);
-     fprintf(fp, "\n");
+     bxprintf(fp, "prefix %s;\n", d->prefix);
+     bxprintf(fp, "\n");
 
      list_for_each(&d->enums, enumeration) {
           write_enumeration(fp, enumeration);
-          fprintf(fp, "\n");
+          bxprintf(fp, "\n");
      }
 
      list_for_each(&d->consts, global_const) {
           write_global_const(fp, global_const);
-          fprintf(fp, "\n");
+          bxprintf(fp, "\n");
      }
 
      write_err_ret_vals(fp, &d->errors);
-     fprintf(fp, "\n");
-     fprintf(fp, "\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
 
      list_for_each(&d->structs, structure) {
           write_structure(fp, structure);
-          fprintf(fp, "\n");
+          bxprintf(fp, "\n");
      }
 
      list_for_each(&d->subs_init, subprogram) {
           write_subprogram(fp, subprogram, "_init");
-          fprintf(fp, "\n");
+          bxprintf(fp, "\n");
      }
 
      list_for_each(&d->subs_free, subprogram) {
           write_subprogram(fp, subprogram, "_free");
-          fprintf(fp, "\n");
+          bxprintf(fp, "\n");
+     }
+
+     list_for_each(&d->subs_clone, subprogram) {
+          write_subprogram(fp, subprogram, "_clone");
+          bxprintf(fp, "\n");
      }
 
      list_for_each(&d->subs_general, subprogram) {
           write_subprogram(fp, subprogram, "_general");
-          fprintf(fp, "\n");
+          bxprintf(fp, "\n");
+     }
+
+     list_for_each(&d->subs_state, subprogram) {
+          write_subprogram(fp, subprogram, "_general");
+          bxprintf(fp, "\n");
      }
 
      return 0;
@@ -1133,3 +2001,47 @@ int max_argument_rank(argument_data *args)
 
      return max;
 }
+
+
+
+/*******************************************************************************
+ * Array arguments with a layout option are passed to C as a flat pointer while
+ * other multi-dimensional arrays are passed as a pointer to pointers built with
+ * array_from_mem().
+ ******************************************************************************/
+int argument_is_flat_array(const argument_data *d)
+{
+     return d->type.rank > 0 && d->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_LAYOUT;
+}
+
+
+
+int argument_is_pointer_array(const argument_data *d)
+{
+     return d->type.rank > 1 && ! (d->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_LAYOUT);
+}
+
+
+
+/*******************************************************************************
+ * Number of elements and bytes of a structure field.  Field dimensions are
+ * checked to be integer literals by parse_field().
+ ******************************************************************************/
+size_t field_n_elems(const field_data *d)
+{
+     int i;
+
+     size_t n = 1;
+
+     for (i = 0; i < d->type.rank; ++i)
+          n *= strtol(d->type.dimens[i], NULL, 10);
+
+     return n;
+}
+
+
+
+size_t field_size(const field_data *d)
+{
+     return field_n_elems(d) * bindx_c_type_size(&d->type);
+}
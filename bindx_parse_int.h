@@ -32,7 +32,8 @@ enum lex_item {
      LEX_ITEM_STRUCTURE,
      LEX_ITEM_SUBPROGRAM_GENERAL,
      LEX_ITEM_SUBPROGRAM_INIT,
-     LEX_ITEM_SUBPROGRAM_FREE
+     LEX_ITEM_SUBPROGRAM_FREE,
+     LEX_ITEM_SUBPROGRAM_CLONE
 };
 
 
@@ -47,26 +48,64 @@ enum lex_subprogram_argument_option {
      LEX_SUBPROGRAM_ARGUMENT_OPTION_ENUM_EXTERNAL = 512,
      LEX_SUBPROGRAM_ARGUMENT_OPTION_ENUM_MASK,
      LEX_SUBPROGRAM_ARGUMENT_OPTION_ENUM_ARRAY,
-     LEX_SUBPROGRAM_ARGUMENT_OPTION_LIST_SIZE
+     LEX_SUBPROGRAM_ARGUMENT_OPTION_LIST_SIZE,
+     LEX_SUBPROGRAM_ARGUMENT_OPTION_ROW_MAJOR,
+     LEX_SUBPROGRAM_ARGUMENT_OPTION_COL_MAJOR,
+     LEX_SUBPROGRAM_ARGUMENT_OPTION_STRIDED,
+     LEX_SUBPROGRAM_ARGUMENT_OPTION_ALIGN,
+     LEX_SUBPROGRAM_ARGUMENT_OPTION_THREADSAFE,
+     LEX_SUBPROGRAM_ARGUMENT_OPTION_INSTANCE_LOCAL,
+     LEX_SUBPROGRAM_ARGUMENT_OPTION_PURE,
+     LEX_SUBPROGRAM_ARGUMENT_OPTION_BORROWED,
+     LEX_SUBPROGRAM_ARGUMENT_OPTION_OWNED,
+     LEX_SUBPROGRAM_ARGUMENT_OPTION_BUFFER,
+     LEX_SUBPROGRAM_ARGUMENT_OPTION_SNAPSHOT,
+     LEX_SUBPROGRAM_ARGUMENT_OPTION_RESTORE,
+     LEX_SUBPROGRAM_ARGUMENT_OPTION_PLAN
 };
 
 
 enum subprogram_type {
      SUBPROGRAM_TYPE_GENERAL,
      SUBPROGRAM_TYPE_INIT,
-     SUBPROGRAM_TYPE_FREE
+     SUBPROGRAM_TYPE_FREE,
+     SUBPROGRAM_TYPE_CLONE
 };
 
 
-#define N_SUBPROGRAM_ARGUMENT_OPTIONS 4
+#define N_SUBPROGRAM_ARGUMENT_OPTIONS 17
 
 enum subprogram_argument_option_mask {
-     SUBPROGRAM_ARGUMENT_OPTION_MASK_ENUM_EXTERNAL = (1<<0),
-     SUBPROGRAM_ARGUMENT_OPTION_MASK_ENUM_MASK     = (1<<1),
-     SUBPROGRAM_ARGUMENT_OPTION_MASK_ENUM_ARRAY    = (1<<2),
-     SUBPROGRAM_ARGUMENT_OPTION_MASK_LIST_SIZE     = (1<<3)
+     SUBPROGRAM_ARGUMENT_OPTION_MASK_ENUM_EXTERNAL  = (1<<0),
+     SUBPROGRAM_ARGUMENT_OPTION_MASK_ENUM_MASK      = (1<<1),
+     SUBPROGRAM_ARGUMENT_OPTION_MASK_ENUM_ARRAY     = (1<<2),
+     SUBPROGRAM_ARGUMENT_OPTION_MASK_LIST_SIZE      = (1<<3),
+     SUBPROGRAM_ARGUMENT_OPTION_MASK_ROW_MAJOR      = (1<<4),
+     SUBPROGRAM_ARGUMENT_OPTION_MASK_COL_MAJOR      = (1<<5),
+     SUBPROGRAM_ARGUMENT_OPTION_MASK_STRIDED        = (1<<6),
+     SUBPROGRAM_ARGUMENT_OPTION_MASK_ALIGN          = (1<<7),
+     SUBPROGRAM_ARGUMENT_OPTION_MASK_THREADSAFE     = (1<<8),
+     SUBPROGRAM_ARGUMENT_OPTION_MASK_INSTANCE_LOCAL = (1<<9),
+     SUBPROGRAM_ARGUMENT_OPTION_MASK_PURE           = (1<<10),
+     SUBPROGRAM_ARGUMENT_OPTION_MASK_BORROWED       = (1<<11),
+     SUBPROGRAM_ARGUMENT_OPTION_MASK_OWNED          = (1<<12),
+     SUBPROGRAM_ARGUMENT_OPTION_MASK_BUFFER         = (1<<13),
+     SUBPROGRAM_ARGUMENT_OPTION_MASK_SNAPSHOT       = (1<<14),
+     SUBPROGRAM_ARGUMENT_OPTION_MASK_RESTORE        = (1<<15),
+     SUBPROGRAM_ARGUMENT_OPTION_MASK_PLAN           = (1<<16)
 };
 
+#define SUBPROGRAM_ARGUMENT_OPTION_MASK_LAYOUT (SUBPROGRAM_ARGUMENT_OPTION_MASK_ROW_MAJOR | \
+                                                SUBPROGRAM_ARGUMENT_OPTION_MASK_COL_MAJOR | \
+                                                SUBPROGRAM_ARGUMENT_OPTION_MASK_STRIDED)
+
+#define SUBPROGRAM_ARGUMENT_OPTION_MASK_CONCURRENCY (SUBPROGRAM_ARGUMENT_OPTION_MASK_THREADSAFE     | \
+                                                     SUBPROGRAM_ARGUMENT_OPTION_MASK_INSTANCE_LOCAL | \
+                                                     SUBPROGRAM_ARGUMENT_OPTION_MASK_PURE)
+
+#define SUBPROGRAM_ARGUMENT_OPTION_MASK_OWNERSHIP (SUBPROGRAM_ARGUMENT_OPTION_MASK_BORROWED | \
+                                                   SUBPROGRAM_ARGUMENT_OPTION_MASK_OWNED)
+
 
 typedef struct {
      int type;
@@ -110,12 +149,23 @@ typedef struct {
 } err_ret_val_data;
 
 
+typedef struct {
+     char *name;
+     struct list_data *prev;
+     struct list_data *next;
+
+     type_data type;
+     size_t offset;
+} field_data;
+
+
 typedef struct {
      char *name;
      struct list_data *prev;
      struct list_data *next;
 
      size_t size;
+     field_data *fields;
 } structure_data;
 
 
@@ -131,6 +181,7 @@ typedef struct {
      char *enum_index_to_mask;
      char *enum_index_to_name;
      char *enum_value_to_name;
+     int align;
 } option_data;
 
 
@@ -142,6 +193,8 @@ typedef struct {
      int usage;
      type_data type;
      option_data options;
+
+     int i_dimens[MAX_DIMENS];
 } argument_data;
 
 
@@ -159,6 +212,9 @@ typedef struct {
 
      int n_args;
      argument_data *args;
+
+     int n_dimens;
+     char **dimens;
 } subprogram_data;
 
 
@@ -166,6 +222,10 @@ typedef struct {
      char *include;
      char *prefix;
      char *PREFIX;
+     int stats;
+     int free_threaded;
+     int limited_api;
+     int async;
      enumeration_data enums;
      global_const_data consts;
      err_ret_val_data errors;
@@ -174,6 +234,8 @@ typedef struct {
      subprogram_data subs_general;
      subprogram_data subs_init;
      subprogram_data subs_free;
+     subprogram_data subs_state;
+     subprogram_data subs_clone;
 } bindx_data;
 
 
@@ -40,12 +40,36 @@ static const char *type_to_py_format(const type_data *d, int enum_mask, int enum
                else
                     return "i";
                break;
+          case LEX_BINDX_TYPE_INT64:
+               if (d->rank > 0)
+                    return "O";
+               else
+                    return "L";
+               break;
+          case LEX_BINDX_TYPE_SIZE_T:
+               if (d->rank > 0)
+                    return "O";
+               else
+                    return "n";
+               break;
+          case LEX_BINDX_TYPE_FLOAT:
+               if (d->rank > 0)
+                    return "O";
+               else
+                    return "f";
+               break;
           case LEX_BINDX_TYPE_DOUBLE:
                if (d->rank > 0)
                     return "O";
                else
                     return "d";
                break;
+          case LEX_BINDX_TYPE_COMPLEX:
+               if (d->rank > 0)
+                    return "O";
+               else
+                    return "D";
+               break;
           case LEX_BINDX_TYPE_STRUCTURE:
                return "O";
                break;
@@ -68,9 +92,51 @@ static const char *type_to_numpy_typenum(const type_data *d)
           case LEX_BINDX_TYPE_INT:
                return "NPY_INT";
                break;
+          case LEX_BINDX_TYPE_INT64:
+               return "NPY_INT64";
+               break;
+          case LEX_BINDX_TYPE_SIZE_T:
+               return "NPY_UINTP";
+               break;
+          case LEX_BINDX_TYPE_FLOAT:
+               return "NPY_FLOAT32";
+               break;
           case LEX_BINDX_TYPE_DOUBLE:
                return "NPY_DOUBLE";
                break;
+          case LEX_BINDX_TYPE_COMPLEX:
+               return "NPY_COMPLEX128";
+               break;
+          default:
+               INTERNAL_ERROR("Invalid lex_bindx_type value: %d", d->type);
+               break;
+     }
+
+     return NULL;
+}
+
+
+
+/*
+ * Format string of a type for the buffer protocol, as used by the struct module.
+ */
+static const char *type_to_buffer_format(const type_data *d)
+{
+     switch(d->type) {
+          case LEX_BINDX_TYPE_CHAR:
+               return "c";
+          case LEX_BINDX_TYPE_INT:
+               return "i";
+          case LEX_BINDX_TYPE_INT64:
+               return "q";
+          case LEX_BINDX_TYPE_SIZE_T:
+               return "N";
+          case LEX_BINDX_TYPE_FLOAT:
+               return "f";
+          case LEX_BINDX_TYPE_DOUBLE:
+               return "d";
+          case LEX_BINDX_TYPE_COMPLEX:
+               return "Zd";
           default:
                INTERNAL_ERROR("Invalid lex_bindx_type value: %d", d->type);
                break;
@@ -81,9 +147,29 @@ static const char *type_to_numpy_typenum(const type_data *d)
 
 
 
-static const char *usage_to_numpy_requirements(enum lex_subprogram_argument_usage usage)
+static const char *argument_to_numpy_requirements(const argument_data *argument)
 {
-     switch(usage) {
+     if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_STRIDED)
+          return "NPY_ARRAY_ALIGNED";
+
+     if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_COL_MAJOR) {
+          switch(argument->usage) {
+               case LEX_SUBPROGRAM_ARGUMENT_USAGE_IN:
+                    return "NPY_ARRAY_IN_FARRAY";
+                    break;
+               case LEX_SUBPROGRAM_ARGUMENT_USAGE_OUT:
+                    return "NPY_ARRAY_OUT_FARRAY";
+                    break;
+               case LEX_SUBPROGRAM_ARGUMENT_USAGE_IN_OUT:
+                    return "NPY_ARRAY_INOUT_FARRAY";
+                    break;
+               default:
+                    INTERNAL_ERROR("Invalid lex_subprogram_argument_usage value: %d", argument->usage);
+                    break;
+          }
+     }
+
+     switch(argument->usage) {
           case LEX_SUBPROGRAM_ARGUMENT_USAGE_IN:
                return "NPY_ARRAY_IN_ARRAY";
                break;
@@ -94,7 +180,7 @@ static const char *usage_to_numpy_requirements(enum lex_subprogram_argument_usag
                return "NPY_ARRAY_INOUT_ARRAY";
                break;
           default:
-               INTERNAL_ERROR("Invalid lex_subprogram_argument_usage value: %d", usage);
+               INTERNAL_ERROR("Invalid lex_subprogram_argument_usage value: %d", argument->usage);
                break;
      }
 
@@ -103,6 +189,234 @@ static const char *usage_to_numpy_requirements(enum lex_subprogram_argument_usag
 
 
 
+/*
+ * If any subprogram is instance_local each instance carries a lock, which such
+ * subprograms hold in place of the GIL while in C.  With -free_threaded every
+ * subprogram that is not threadsafe or pure is treated as instance_local.
+ */
+static int has_instance_locks(const bindx_data *d)
+{
+     subprogram_data *subprogram;
+
+     if (d->free_threaded)
+          return 1;
+
+     list_for_each(&d->subs_general, subprogram) {
+          if (subprogram->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_INSTANCE_LOCAL)
+               return 1;
+     }
+
+     return 0;
+}
+
+
+
+static int is_instance_locked(const bindx_data *d, const subprogram_data *subprogram)
+{
+     if (subprogram->options.flags & (SUBPROGRAM_ARGUMENT_OPTION_MASK_THREADSAFE |
+                                      SUBPROGRAM_ARGUMENT_OPTION_MASK_PURE))
+          return 0;
+
+     return d->free_threaded ||
+            subprogram->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_INSTANCE_LOCAL;
+}
+
+
+
+/*
+ * With -async a general subprogram gets an awaitable counterpart only if its
+ * C call already runs without the GIL, otherwise the worker would hold it.
+ */
+static int is_async(const bindx_data *d, const subprogram_data *subprogram)
+{
+     if (! d->async)
+          return 0;
+
+     return subprogram->options.flags & (SUBPROGRAM_ARGUMENT_OPTION_MASK_THREADSAFE |
+                                         SUBPROGRAM_ARGUMENT_OPTION_MASK_PURE) ||
+            is_instance_locked(d, subprogram);
+}
+
+
+
+static int has_async(const bindx_data *d)
+{
+     subprogram_data *subprogram;
+
+     list_for_each(&d->subs_general, subprogram) {
+          if (is_async(d, subprogram))
+               return 1;
+     }
+
+     return 0;
+}
+
+
+
+static void write_instance_lock(bindx_buffer_data *fp, const bindx_data *d, int indent)
+{
+     if (d->free_threaded)
+          bxprintf(fp, "%sINSTANCE_LOCK(self);\n", bxis(indent));
+     else
+          bxprintf(fp, "%sPyThread_acquire_lock(self->lock, WAIT_LOCK);\n", bxis(indent));
+}
+
+
+
+static void write_instance_unlock(bindx_buffer_data *fp, const bindx_data *d, int indent)
+{
+     if (d->free_threaded)
+          bxprintf(fp, "%sINSTANCE_UNLOCK(self);\n", bxis(indent));
+     else
+          bxprintf(fp, "%sPyThread_release_lock(self->lock);\n", bxis(indent));
+}
+
+
+
+/*
+ * The SET_ITEM macros reach into the tuple and list layouts so the limited API
+ * mode uses the function forms.
+ */
+static const char *py_tuple_set_item(const bindx_data *d)
+{
+     return d->limited_api ? "PyTuple_SetItem" : "PyTuple_SET_ITEM";
+}
+
+
+
+static const char *py_list_set_item(const bindx_data *d)
+{
+     return d->limited_api ? "PyList_SetItem" : "PyList_SET_ITEM";
+}
+
+
+
+/*
+ * Py_complex is not part of the limited API but Py_BuildValue()'s "D" is, so
+ * the limited API mode passes the complex value's address untyped.
+ */
+static const char *py_complex_cast(const bindx_data *d)
+{
+     return d->limited_api ? "(void *) " : "(Py_complex *) ";
+}
+
+
+
+static int argument_is_structure(const argument_data *argument)
+{
+     return argument->type.type == LEX_BINDX_TYPE_STRUCTURE && argument->type.rank == 0;
+}
+
+
+
+/*
+ * NumPy array-protocol type string for a structure field, e.g. "(4,3)f8".
+ */
+static int write_field_format(bindx_buffer_data *fp, const field_data *field)
+{
+     int i;
+
+     if (field->type.rank > 0) {
+          bxprintf(fp, "(");
+          for (i = 0; i < field->type.rank; ++i)
+               bxprintf(fp, "%s,", field->type.dimens[i]);
+          bxprintf(fp, ")");
+     }
+
+     switch(field->type.type) {
+          case LEX_BINDX_TYPE_CHAR:
+               bxprintf(fp, "S1");
+               break;
+          case LEX_BINDX_TYPE_INT:
+          case LEX_BINDX_TYPE_INT64:
+               bxprintf(fp, "i%lu", bindx_c_type_size(&field->type));
+               break;
+          case LEX_BINDX_TYPE_SIZE_T:
+               bxprintf(fp, "u%lu", bindx_c_type_size(&field->type));
+               break;
+          case LEX_BINDX_TYPE_FLOAT:
+          case LEX_BINDX_TYPE_DOUBLE:
+               bxprintf(fp, "f%lu", bindx_c_type_size(&field->type));
+               break;
+          case LEX_BINDX_TYPE_COMPLEX:
+               bxprintf(fp, "c%lu", bindx_c_type_size(&field->type));
+               break;
+          default:
+               INTERNAL_ERROR("Invalid lex_bindx_type value: %d", field->type.type);
+               break;
+     }
+
+     return 0;
+}
+
+
+
+static int has_array_return_value(const subprogram_data *subprogram)
+{
+     return subprogram->has_return_value && subprogram->type.rank > 0;
+}
+
+
+
+/*******************************************************************************
+ * Used to emit the ndarray utilities only when a wrapper calls them.  usage < 0
+ * matches any usage.
+ ******************************************************************************/
+static int has_ndarray_argument(const bindx_data *d, int usage, int flags)
+{
+     argument_data *argument;
+     subprogram_data *subprogram;
+
+     list_for_each(&d->subs_all, subprogram) {
+          list_for_each(subprogram->args, argument) {
+               if (argument->type.rank == 0 || argument_is_structure(argument))
+                    continue;
+               if (argument->options.flags & (SUBPROGRAM_ARGUMENT_OPTION_MASK_ENUM_MASK |
+                                              SUBPROGRAM_ARGUMENT_OPTION_MASK_ENUM_ARRAY))
+                    continue;
+               if (usage >= 0 && argument->usage != usage)
+                    continue;
+               if ((argument->options.flags & flags) == flags)
+                    return 1;
+          }
+     }
+
+     return 0;
+}
+
+
+
+static int has_array_return_values(const bindx_data *d)
+{
+     subprogram_data *subprogram;
+
+     list_for_each(&d->subs_all, subprogram) {
+          if (has_array_return_value(subprogram))
+               return 1;
+     }
+
+     return 0;
+}
+
+
+
+/*
+ * Ownership argument to the generated ndarray_from_return(): 0 copies the
+ * returned array, 1 wraps it read-only with the instance as the base object,
+ * and 2 wraps it with a capsule that frees it with the array.
+ */
+static int get_return_ownership(const subprogram_data *subprogram)
+{
+     if (subprogram->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_BORROWED)
+          return 1;
+     if (subprogram->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_OWNED)
+          return 2;
+
+     return 0;
+}
+
+
+
 static const char *get_error_return_value(enum subprogram_type sub_type)
 {
      switch(sub_type) {
@@ -120,154 +434,1103 @@ static const char *get_error_return_value(enum subprogram_type sub_type)
                break;
      }
 
-     return NULL;
+     return NULL;
+}
+
+
+
+static int write_array_from_ndarray(bindx_buffer_data *fp, const bindx_data *d,
+                                    const argument_data *argument, int indent)
+{
+     if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_ALIGN &&
+         argument->usage == LEX_SUBPROGRAM_ARGUMENT_USAGE_IN) {
+          bxprintf(fp, "%sif (ndarray_align(&%s_ndarray, %d) < 0)\n",
+                   bxis(indent), argument->name, argument->options.align);
+          bxprintf(fp, "%sreturn NULL;\n", bxis(indent + 1));
+     }
+
+     if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_STRIDED) {
+          bxprintf(fp, "%sif (strides_from_ndarray(&%s_ndarray, %s_strides) < 0)\n",
+                   bxis(indent), argument->name, argument->name);
+          bxprintf(fp, "%sreturn NULL;\n", bxis(indent + 1));
+     }
+
+     bxprintf(fp, "%s%s = (", bxis(indent), argument->name);
+     bindx_write_c_argument_declaration(fp, d, argument);
+     if (argument_is_flat_array(argument))
+          bxprintf(fp, ") PyArray_DATA((PyArrayObject *) %s_ndarray);\n", argument->name);
+     else
+          bxprintf(fp, ") array_from_ndarray(%s_ndarray, %ld);\n", argument->name, bindx_c_type_size(&argument->type));
+
+     return 0;
+}
+
+
+
+static int write_utilities(bindx_buffer_data *fp, const bindx_data *d)
+{
+     int align;
+     int align_in;
+     int arrays_in;
+     int returns;
+     int strided;
+
+     align     = has_ndarray_argument(d, -1, SUBPROGRAM_ARGUMENT_OPTION_MASK_ALIGN);
+     align_in  = has_ndarray_argument(d, LEX_SUBPROGRAM_ARGUMENT_USAGE_IN, SUBPROGRAM_ARGUMENT_OPTION_MASK_ALIGN);
+     strided   = has_ndarray_argument(d, -1, SUBPROGRAM_ARGUMENT_OPTION_MASK_STRIDED);
+     arrays_in = has_ndarray_argument(d, LEX_SUBPROGRAM_ARGUMENT_USAGE_IN, 0) || strided;
+     returns   = has_array_return_values(d);
+
+     bxprintf(fp, "static int list_to_mask(PyObject *list, int *mask, int (*name_to_mask)(const char *name), const char *name)\n");
+     bxprintf(fp, "{\n");
+     bxprintf(fp, "     int i;\n");
+     bxprintf(fp, "     int n;\n");
+     bxprintf(fp, "     int r;\n");
+
+     bxprintf(fp, "     char *format;\n");
+     bxprintf(fp, "     char *error;\n");
+
+     bxprintf(fp, "     *mask = 0;\n");
+     bxprintf(fp, "     n = PyList_Size(list);\n");
+     bxprintf(fp, "     for (i = 0; i < n; ++i) {\n");
+     bxprintf(fp, "#if PY_MAJOR_VERSION < 3\n");
+     bxprintf(fp, "          r = name_to_mask(PyString_AsString(PyList_GetItem(list, i)));\n");
+     bxprintf(fp, "#else\n");
+     if (d->limited_api)
+          bxprintf(fp, "          r = name_to_mask(PyUnicode_AsUTF8AndSize(PyList_GetItem(list, i), NULL));\n");
+     else
+          bxprintf(fp, "          r = name_to_mask(PyUnicode_AsUTF8 (PyList_GetItem(list, i)));\n");
+     bxprintf(fp, "#endif\n");
+     bxprintf(fp, "          if (r == -1) {\n");
+     bxprintf(fp, "               format = \"ERROR: %%s()\";\n");
+     bxprintf(fp, "               error  = malloc(strlen(format) - 2 + strlen(name) + 1);\n");
+     bxprintf(fp, "               sprintf(error, format, name);\n");
+     bxprintf(fp, "               PyErr_SetString(%sError, error);\n", d->PREFIX);
+     bxprintf(fp, "               free(error);\n");
+     bxprintf(fp, "               return -1;\n");
+     bxprintf(fp, "          }\n");
+     bxprintf(fp, "          *mask |= r;\n");
+     bxprintf(fp, "     }\n");
+
+     bxprintf(fp, "     return 0;\n");
+     bxprintf(fp, "}\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+
+     bxprintf(fp, "static int list_to_array(PyObject *list, int *n, int **array, int (*name_to_value)(const char *name), const char *name)\n");
+     bxprintf(fp, "{\n");
+     bxprintf(fp, "     int i;\n");
+     bxprintf(fp, "     int r;\n");
+
+     bxprintf(fp, "     char *format;\n");
+     bxprintf(fp, "     char *error;\n");
+
+     bxprintf(fp, "     *n = PyList_Size(list);\n");
+     bxprintf(fp, "     *array = malloc(*n * sizeof(int));\n");
+     bxprintf(fp, "     for (i = 0; i < *n; ++i) {\n");
+     bxprintf(fp, "#if PY_MAJOR_VERSION < 3\n");
+     bxprintf(fp, "          r = name_to_value(PyString_AsString(PyList_GetItem(list, i)));\n");
+     bxprintf(fp, "#else\n");
+     if (d->limited_api)
+          bxprintf(fp, "          r = name_to_value(PyUnicode_AsUTF8AndSize(PyList_GetItem(list, i), NULL));\n");
+     else
+          bxprintf(fp, "          r = name_to_value(PyUnicode_AsUTF8 (PyList_GetItem(list, i)));\n");
+     bxprintf(fp, "#endif\n");
+     bxprintf(fp, "          if (r == -1) {\n");
+     bxprintf(fp, "               format = \"ERROR: %%s()\";\n");
+     bxprintf(fp, "               error  = malloc(strlen(format) - 2 + strlen(name) + 1);\n");
+     bxprintf(fp, "               sprintf(error, format, name);\n");
+     bxprintf(fp, "               PyErr_SetString(%sError, error);\n", d->PREFIX);
+     bxprintf(fp, "               free(error);\n");
+     bxprintf(fp, "               return -1;\n");
+     bxprintf(fp, "          }\n");
+     bxprintf(fp, "          (*array)[i] = r;\n");
+     bxprintf(fp, "     }\n");
+
+     bxprintf(fp, "     return 0;\n");
+     bxprintf(fp, "}\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+
+     bxprintf(fp, "static int check_pyarray_shape(PyObject *array, const char *name, int n, ...)\n");
+     bxprintf(fp, "{\n");
+     bxprintf(fp, "     int i;\n");
+     bxprintf(fp, "     int n_py;\n");
+     bxprintf(fp, "     npy_intp dim;\n");
+     bxprintf(fp, "     npy_intp dim_py;\n");
+     bxprintf(fp, "     va_list valist;\n");
+
+     bxprintf(fp, "     n_py = PyArray_NDIM((PyArrayObject *) array);\n");
+     bxprintf(fp, "     if (n_py != n) {\n");
+     bxprintf(fp, "          PyErr_Format(%sError, \"ERROR: Number of dimensions for %%s input (%%d) must be == %%d\", name, n_py);\n", d->PREFIX);
+     bxprintf(fp, "          return -1;\n");
+     bxprintf(fp, "     }\n");
+
+     bxprintf(fp, "     va_start(valist, n);\n");
+
+     bxprintf(fp, "     for (i = 0; i < n; ++i) {\n");
+     bxprintf(fp, "          dim = va_arg(valist, npy_intp);\n");
+     bxprintf(fp, "          dim_py = PyArray_DIM((PyArrayObject *) array, i);\n");
+     bxprintf(fp, "          if (dim_py != dim) {\n");
+     bxprintf(fp, "              PyErr_Format(%sError, \"ERROR: Dimension %%d of %%s input (%%zd) must be == %%zd\", i, name, (Py_ssize_t) dim_py, (Py_ssize_t) dim);\n", d->PREFIX);
+     bxprintf(fp, "              return -1;\n");
+     bxprintf(fp, "          }\n");
+     bxprintf(fp, "     }\n");
+
+     bxprintf(fp, "     va_end(valist);\n");
+
+     bxprintf(fp, "     return 0;\n");
+     bxprintf(fp, "}\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+
+     bxprintf(fp, "static void *array_from_ndarray(PyObject *ndarray, size_t size)\n");
+     bxprintf(fp, "{\n");
+     bxprintf(fp, "     int i;\n");
+     bxprintf(fp, "     int n_dims;\n");
+     bxprintf(fp, "     size_t *dims;\n");
+     bxprintf(fp, "     void *array;\n");
+
+     bxprintf(fp, "     n_dims = PyArray_NDIM((PyArrayObject *) ndarray);\n");
+     bxprintf(fp, "     dims = malloc(n_dims * sizeof(long));\n");
+     bxprintf(fp, "     for (i = 0; i < n_dims; ++i)\n");
+     bxprintf(fp, "          dims[i] = PyArray_DIM((PyArrayObject *) ndarray, i);\n");
+
+     bxprintf(fp, "     array = array_from_mem(PyArray_DATA((PyArrayObject *) ndarray), n_dims, dims, size, 1);\n");
+
+     bxprintf(fp, "     free(dims);\n");
+
+     bxprintf(fp, "     return array;\n");
+     bxprintf(fp, "}\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+
+     bxprintf(fp, "static Py_ssize_t n_array_copies = 0;\n");
+     bxprintf(fp, "static int strict_arrays = 0;\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+
+     if (arrays_in || align) {
+          bxprintf(fp, "static int check_strict_arrays(void)\n");
+          bxprintf(fp, "{\n");
+          if (d->free_threaded)
+               bxprintf(fp, "     if (__atomic_load_n(&strict_arrays, __ATOMIC_RELAXED)) {\n");
+          else
+               bxprintf(fp, "     if (strict_arrays) {\n");
+          bxprintf(fp, "          PyErr_SetString(%sError, \"array argument would be copied to match its type or layout and strict_arrays is set\");\n", d->PREFIX);
+          bxprintf(fp, "          return -1;\n");
+          bxprintf(fp, "     }\n");
+          bxprintf(fp, "     return 0;\n");
+          bxprintf(fp, "}\n");
+          bxprintf(fp, "\n");
+          bxprintf(fp, "\n");
+     }
+
+
+     if (arrays_in) {
+          bxprintf(fp, "static PyObject *ndarray_from_object(PyObject *object, int typenum, int requirements)\n");
+          bxprintf(fp, "{\n");
+          bxprintf(fp, "     PyObject *ndarray;\n");
+          bxprintf(fp, "     PyArrayObject *array;\n");
+
+          bxprintf(fp, "     if (PyArray_CheckExact(object)) {\n");
+          bxprintf(fp, "          array = (PyArrayObject *) object;\n");
+          bxprintf(fp, "          if (PyArray_TYPE(array) == typenum && PyArray_ISNOTSWAPPED(array) &&\n");
+          bxprintf(fp, "              PyArray_CHKFLAGS(array, requirements & (NPY_ARRAY_C_CONTIGUOUS | NPY_ARRAY_F_CONTIGUOUS |\n");
+          bxprintf(fp, "                                                      NPY_ARRAY_ALIGNED | NPY_ARRAY_WRITEABLE))) {\n");
+          bxprintf(fp, "               Py_INCREF(object);\n");
+          bxprintf(fp, "               return object;\n");
+          bxprintf(fp, "          }\n");
+          bxprintf(fp, "     }\n");
+          bxprintf(fp, "     if (check_strict_arrays() < 0)\n");
+          bxprintf(fp, "          return NULL;\n");
+          bxprintf(fp, "     ndarray = PyArray_FROM_OTF(object, typenum, requirements);\n");
+          bxprintf(fp, "     if (ndarray != NULL && ndarray != object)\n");
+          if (d->free_threaded)
+               bxprintf(fp, "          __atomic_fetch_add(&n_array_copies, 1, __ATOMIC_RELAXED);\n");
+          else
+               bxprintf(fp, "          n_array_copies++;\n");
+
+          bxprintf(fp, "     return ndarray;\n");
+          bxprintf(fp, "}\n");
+          bxprintf(fp, "\n");
+          bxprintf(fp, "\n");
+     }
+
+
+     if (strided) {
+          bxprintf(fp, "static int strides_from_ndarray(PyObject **ndarray, ptrdiff_t *strides)\n");
+          bxprintf(fp, "{\n");
+          bxprintf(fp, "     int i;\n");
+          bxprintf(fp, "     int n_dims;\n");
+          bxprintf(fp, "     npy_intp size;\n");
+          bxprintf(fp, "     PyObject *temp;\n");
+
+          bxprintf(fp, "     n_dims = PyArray_NDIM((PyArrayObject *) *ndarray);\n");
+          bxprintf(fp, "     size   = PyArray_ITEMSIZE((PyArrayObject *) *ndarray);\n");
+          bxprintf(fp, "     for (i = 0; i < n_dims; ++i) {\n");
+          bxprintf(fp, "          if (PyArray_STRIDE((PyArrayObject *) *ndarray, i) %% size != 0)\n");
+          bxprintf(fp, "               break;\n");
+          bxprintf(fp, "     }\n");
+          bxprintf(fp, "     if (i < n_dims) {\n");
+          bxprintf(fp, "          temp = ndarray_from_object(*ndarray, PyArray_TYPE((PyArrayObject *) *ndarray), NPY_ARRAY_IN_ARRAY);\n");
+          bxprintf(fp, "          if (temp == NULL)\n");
+          bxprintf(fp, "               return -1;\n");
+          bxprintf(fp, "          Py_DECREF(*ndarray);\n");
+          bxprintf(fp, "          *ndarray = temp;\n");
+          bxprintf(fp, "     }\n");
+          bxprintf(fp, "     for (i = 0; i < n_dims; ++i)\n");
+          bxprintf(fp, "          strides[i] = PyArray_STRIDE((PyArrayObject *) *ndarray, i) / size;\n");
+
+          bxprintf(fp, "     return 0;\n");
+          bxprintf(fp, "}\n");
+          bxprintf(fp, "\n");
+          bxprintf(fp, "\n");
+     }
+
+
+     if (align) {
+          bxprintf(fp, "static PyObject *ndarray_new_aligned(int n_dims, npy_intp *dims, int typenum, size_t size, int fortran, size_t alignment)\n");
+          bxprintf(fp, "{\n");
+          bxprintf(fp, "     int i;\n");
+          bxprintf(fp, "     char *data;\n");
+          bxprintf(fp, "     npy_intp n;\n");
+          bxprintf(fp, "     PyObject *buffer;\n");
+          bxprintf(fp, "     PyObject *ndarray;\n");
+
+          bxprintf(fp, "     n = size;\n");
+          bxprintf(fp, "     for (i = 0; i < n_dims; ++i)\n");
+          bxprintf(fp, "          n *= dims[i];\n");
+          bxprintf(fp, "     n += alignment;\n");
+          bxprintf(fp, "     buffer = PyArray_SimpleNew(1, &n, NPY_UBYTE);\n");
+          bxprintf(fp, "     if (buffer == NULL)\n");
+          bxprintf(fp, "          return NULL;\n");
+          bxprintf(fp, "     data  = PyArray_DATA((PyArrayObject *) buffer);\n");
+          bxprintf(fp, "     data += (alignment - (size_t) data %% alignment) %% alignment;\n");
+          bxprintf(fp, "     ndarray = PyArray_New(&PyArray_Type, n_dims, dims, typenum, NULL, data, 0, fortran ? NPY_ARRAY_FARRAY : NPY_ARRAY_CARRAY, NULL);\n");
+          bxprintf(fp, "     if (ndarray == NULL) {\n");
+          bxprintf(fp, "          Py_DECREF(buffer);\n");
+          bxprintf(fp, "          return NULL;\n");
+          bxprintf(fp, "     }\n");
+          bxprintf(fp, "     if (PyArray_SetBaseObject((PyArrayObject *) ndarray, buffer) < 0) {\n");
+          bxprintf(fp, "          Py_DECREF(ndarray);\n");
+          bxprintf(fp, "          return NULL;\n");
+          bxprintf(fp, "     }\n");
+
+          bxprintf(fp, "     return ndarray;\n");
+          bxprintf(fp, "}\n");
+          bxprintf(fp, "\n");
+          bxprintf(fp, "\n");
+     }
+
+
+     if (align_in) {
+          bxprintf(fp, "static int ndarray_align(PyObject **ndarray, size_t alignment)\n");
+          bxprintf(fp, "{\n");
+          bxprintf(fp, "     PyArrayObject *array;\n");
+          bxprintf(fp, "     PyObject *temp;\n");
+
+          bxprintf(fp, "     array = (PyArrayObject *) *ndarray;\n");
+          bxprintf(fp, "     if ((size_t) PyArray_DATA(array) %% alignment == 0)\n");
+          bxprintf(fp, "          return 0;\n");
+          bxprintf(fp, "     if (check_strict_arrays() < 0)\n");
+          bxprintf(fp, "          return -1;\n");
+          bxprintf(fp, "     temp = ndarray_new_aligned(PyArray_NDIM(array), PyArray_DIMS(array), PyArray_TYPE(array), PyArray_ITEMSIZE(array), PyArray_IS_F_CONTIGUOUS(array) && ! PyArray_IS_C_CONTIGUOUS(array), alignment);\n");
+          bxprintf(fp, "     if (temp == NULL)\n");
+          bxprintf(fp, "          return -1;\n");
+          bxprintf(fp, "     if (PyArray_CopyInto((PyArrayObject *) temp, array) < 0) {\n");
+          bxprintf(fp, "          Py_DECREF(temp);\n");
+          bxprintf(fp, "          return -1;\n");
+          bxprintf(fp, "     }\n");
+          bxprintf(fp, "     Py_DECREF(*ndarray);\n");
+          bxprintf(fp, "     *ndarray = temp;\n");
+          if (d->free_threaded)
+               bxprintf(fp, "     __atomic_fetch_add(&n_array_copies, 1, __ATOMIC_RELAXED);\n");
+          else
+               bxprintf(fp, "     n_array_copies++;\n");
+
+          bxprintf(fp, "     return 0;\n");
+          bxprintf(fp, "}\n");
+          bxprintf(fp, "\n");
+          bxprintf(fp, "\n");
+     }
+
+
+     if (returns) {
+          bxprintf(fp, "static void free_array_capsule(PyObject *capsule)\n");
+          bxprintf(fp, "{\n");
+          bxprintf(fp, "     free_array(PyCapsule_GetPointer(capsule, NULL), (int) (size_t) PyCapsule_GetContext(capsule));\n");
+          bxprintf(fp, "}\n");
+          bxprintf(fp, "\n");
+          bxprintf(fp, "\n");
+
+
+          bxprintf(fp, "static PyObject *ndarray_from_return(void *array, void *data, int n_dims, npy_intp *dims, int typenum, PyObject *self, int ownership)\n");
+          bxprintf(fp, "{\n");
+          bxprintf(fp, "     PyObject *base;\n");
+          bxprintf(fp, "     PyObject *ndarray;\n");
+          bxprintf(fp, "     PyObject *temp;\n");
+
+          bxprintf(fp, "     ndarray = PyArray_SimpleNewFromData(n_dims, dims, typenum, data);\n");
+          bxprintf(fp, "     if (ndarray == NULL)\n");
+          bxprintf(fp, "          return NULL;\n");
+          bxprintf(fp, "     if (ownership == 0) {\n");
+          bxprintf(fp, "          temp = PyArray_NewCopy((PyArrayObject *) ndarray, NPY_CORDER);\n");
+          bxprintf(fp, "          Py_DECREF(ndarray);\n");
+          bxprintf(fp, "          if (temp != NULL)\n");
+          if (d->free_threaded)
+               bxprintf(fp, "               __atomic_fetch_add(&n_array_copies, 1, __ATOMIC_RELAXED);\n");
+          else
+               bxprintf(fp, "               n_array_copies++;\n");
+          bxprintf(fp, "          return temp;\n");
+          bxprintf(fp, "     }\n");
+          bxprintf(fp, "     if (ownership == 1) {\n");
+          bxprintf(fp, "          PyArray_CLEARFLAGS((PyArrayObject *) ndarray, NPY_ARRAY_WRITEABLE);\n");
+          bxprintf(fp, "          base = self;\n");
+          bxprintf(fp, "          Py_INCREF(base);\n");
+          bxprintf(fp, "     }\n");
+          bxprintf(fp, "     else {\n");
+          bxprintf(fp, "          base = PyCapsule_New(array, NULL, free_array_capsule);\n");
+          bxprintf(fp, "          if (base == NULL || PyCapsule_SetContext(base, (void *) (size_t) n_dims) < 0) {\n");
+          bxprintf(fp, "               Py_XDECREF(base);\n");
+          bxprintf(fp, "               Py_DECREF(ndarray);\n");
+          bxprintf(fp, "               return NULL;\n");
+          bxprintf(fp, "          }\n");
+          bxprintf(fp, "     }\n");
+          bxprintf(fp, "     if (PyArray_SetBaseObject((PyArrayObject *) ndarray, base) < 0) {\n");
+          bxprintf(fp, "          Py_DECREF(ndarray);\n");
+          bxprintf(fp, "          return NULL;\n");
+          bxprintf(fp, "     }\n");
+
+          bxprintf(fp, "     return ndarray;\n");
+          bxprintf(fp, "}\n");
+          bxprintf(fp, "\n");
+          bxprintf(fp, "\n");
+     }
+
+
+     bxprintf(fp, "static PyObject *array_copies_py(PyObject *self, PyObject *args)\n");
+     bxprintf(fp, "{\n");
+     if (d->free_threaded)
+          bxprintf(fp, "     return Py_BuildValue(\"n\", __atomic_load_n(&n_array_copies, __ATOMIC_RELAXED));\n");
+     else
+          bxprintf(fp, "     return Py_BuildValue(\"n\", n_array_copies);\n");
+     bxprintf(fp, "}\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+
+     bxprintf(fp, "static PyObject *strict_arrays_py(PyObject *self, PyObject *args)\n");
+     bxprintf(fp, "{\n");
+     bxprintf(fp, "     int strict = -1;\n");
+     bxprintf(fp, "     int previous;\n");
+     bxprintf(fp, "     if (! PyArg_ParseTuple(args, \"|i\", &strict))\n");
+     bxprintf(fp, "          return NULL;\n");
+     if (d->free_threaded) {
+          bxprintf(fp, "     if (strict < 0)\n");
+          bxprintf(fp, "          previous = __atomic_load_n(&strict_arrays, __ATOMIC_RELAXED);\n");
+          bxprintf(fp, "     else\n");
+          bxprintf(fp, "          previous = __atomic_exchange_n(&strict_arrays, strict != 0, __ATOMIC_RELAXED);\n");
+     }
+     else {
+          bxprintf(fp, "     previous = strict_arrays;\n");
+          bxprintf(fp, "     if (strict >= 0)\n");
+          bxprintf(fp, "          strict_arrays = strict != 0;\n");
+     }
+     bxprintf(fp, "     return PyBool_FromLong(previous);\n");
+     bxprintf(fp, "}\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+     return 0;
+}
+
+
+
+static int write_stats(bindx_buffer_data *fp, const bindx_data *d)
+{
+     bindx_write_c_stats_header(fp, d);
+     bindx_write_c_stats_utilities(fp, d);
+
+     bxprintf(fp, "static PyObject *stats_py(PyObject *self, PyObject *args)\n");
+     bxprintf(fp, "{\n");
+     bxprintf(fp, "     int i;\n");
+     bxprintf(fp, "     int j;\n");
+     bxprintf(fp, "     int k;\n");
+     bxprintf(fp, "     PyObject *dict;\n");
+     bxprintf(fp, "     PyObject *item;\n");
+     bxprintf(fp, "     PyObject *ns;\n");
+     bxprintf(fp, "     PyObject *hist;\n");
+     bxprintf(fp, "     PyObject *row;\n");
+     bxprintf(fp, "     %s_stats_data *s;\n", d->prefix);
+
+     bxprintf(fp, "     if ((dict = PyDict_New()) == NULL)\n");
+     bxprintf(fp, "          return NULL;\n");
+     bxprintf(fp, "     for (i = 0; i < %s_STATS_N_SUBPROGRAMS; ++i) {\n", d->PREFIX);
+     bxprintf(fp, "          s = &%s_stats[i];\n", d->prefix);
+     bxprintf(fp, "          ns   = PyTuple_New(%s_STATS_N_PHASES);\n", d->PREFIX);
+     bxprintf(fp, "          hist = PyTuple_New(%s_STATS_N_PHASES);\n", d->PREFIX);
+     bxprintf(fp, "          for (j = 0; j < %s_STATS_N_PHASES; ++j) {\n", d->PREFIX);
+     bxprintf(fp, "               %s(ns, j, PyLong_FromUnsignedLongLong(__atomic_load_n(&s->ns[j], __ATOMIC_RELAXED)));\n", py_tuple_set_item(d));
+     bxprintf(fp, "               row = PyTuple_New(%s_STATS_N_BUCKETS);\n", d->PREFIX);
+     bxprintf(fp, "               for (k = 0; k < %s_STATS_N_BUCKETS; ++k)\n", d->PREFIX);
+     bxprintf(fp, "                    %s(row, k, PyLong_FromUnsignedLongLong(__atomic_load_n(&s->hist[j][k], __ATOMIC_RELAXED)));\n", py_tuple_set_item(d));
+     bxprintf(fp, "               %s(hist, j, row);\n", py_tuple_set_item(d));
+     bxprintf(fp, "          }\n");
+     bxprintf(fp, "          item = Py_BuildValue(\"{s:K,s:N,s:N}\", \"calls\", (unsigned long long) __atomic_load_n(&s->n_calls, __ATOMIC_RELAXED), \"ns\", ns, \"hist\", hist);\n");
+     bxprintf(fp, "          if (item == NULL || PyDict_SetItemString(dict, s->name, item) < 0) {\n");
+     bxprintf(fp, "               Py_XDECREF(item);\n");
+     bxprintf(fp, "               Py_DECREF(dict);\n");
+     bxprintf(fp, "               return NULL;\n");
+     bxprintf(fp, "          }\n");
+     bxprintf(fp, "          Py_DECREF(item);\n");
+     bxprintf(fp, "     }\n");
+     bxprintf(fp, "     return dict;\n");
+     bxprintf(fp, "}\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+     return 0;
+}
+
+
+
+static int write_structure_utilities(bindx_buffer_data *fp, const bindx_data *d)
+{
+     structure_data *structure;
+
+     if (list_is_empty(&d->structs))
+          return 0;
+
+     list_for_each(&d->structs, structure)
+          bxprintf(fp, "static PyArray_Descr *%s_descr = NULL;\n", structure->name);
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+
+     bxprintf(fp, "static PyArray_Descr *descr_from_fields(int n_fields, const char **names, const char **formats, const int *offsets, int itemsize)\n");
+     bxprintf(fp, "{\n");
+     bxprintf(fp, "     int i;\n");
+     bxprintf(fp, "     PyObject *names_list;\n");
+     bxprintf(fp, "     PyObject *formats_list;\n");
+     bxprintf(fp, "     PyObject *offsets_list;\n");
+     bxprintf(fp, "     PyObject *dict = NULL;\n");
+     bxprintf(fp, "     PyArray_Descr *descr = NULL;\n");
+
+     bxprintf(fp, "     names_list   = PyList_New(n_fields);\n");
+     bxprintf(fp, "     formats_list = PyList_New(n_fields);\n");
+     bxprintf(fp, "     offsets_list = PyList_New(n_fields);\n");
+     bxprintf(fp, "     if (names_list != NULL && formats_list != NULL && offsets_list != NULL) {\n");
+     bxprintf(fp, "          for (i = 0; i < n_fields; ++i) {\n");
+     bxprintf(fp, "               %s(names_list,   i, Py_BuildValue(\"s\", names[i]));\n", py_list_set_item(d));
+     bxprintf(fp, "               %s(formats_list, i, Py_BuildValue(\"s\", formats[i]));\n", py_list_set_item(d));
+     bxprintf(fp, "               %s(offsets_list, i, Py_BuildValue(\"i\", offsets[i]));\n", py_list_set_item(d));
+     bxprintf(fp, "          }\n");
+     bxprintf(fp, "          dict = Py_BuildValue(\"{sOsOsOsi}\", \"names\", names_list, \"formats\", formats_list, \"offsets\", offsets_list, \"itemsize\", itemsize);\n");
+     bxprintf(fp, "     }\n");
+     bxprintf(fp, "     if (dict != NULL && ! PyArray_DescrConverter(dict, &descr))\n");
+     bxprintf(fp, "          descr = NULL;\n");
+     bxprintf(fp, "     Py_XDECREF(names_list);\n");
+     bxprintf(fp, "     Py_XDECREF(formats_list);\n");
+     bxprintf(fp, "     Py_XDECREF(offsets_list);\n");
+     bxprintf(fp, "     Py_XDECREF(dict);\n");
+
+     bxprintf(fp, "     return descr;\n");
+     bxprintf(fp, "}\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+
+     bxprintf(fp, "static PyObject *ndarray_from_structure(PyObject *object, PyArray_Descr *descr, const char *name)\n");
+     bxprintf(fp, "{\n");
+     bxprintf(fp, "     PyObject *ndarray;\n");
+
+     bxprintf(fp, "     Py_INCREF((PyObject *) descr);\n");
+     bxprintf(fp, "     ndarray = PyArray_FromAny(object, descr, 0, 0, NPY_ARRAY_IN_ARRAY, NULL);\n");
+     bxprintf(fp, "     if (ndarray == NULL)\n");
+     bxprintf(fp, "          return NULL;\n");
+     bxprintf(fp, "     if (PyArray_SIZE((PyArrayObject *) ndarray) != 1) {\n");
+     bxprintf(fp, "          PyErr_Format(PyExc_ValueError, \"%%s must be a single structure\", name);\n");
+     bxprintf(fp, "          Py_DECREF(ndarray);\n");
+     bxprintf(fp, "          return NULL;\n");
+     bxprintf(fp, "     }\n");
+
+     bxprintf(fp, "     return ndarray;\n");
+     bxprintf(fp, "}\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+     return 0;
+}
+
+
+
+static int write_structure_descrs_init(bindx_buffer_data *fp, const bindx_data *d)
+{
+     field_data *field;
+     structure_data *structure;
+
+     if (list_is_empty(&d->structs))
+          return 0;
+
+     bxprintf(fp, "static int structure_descrs_init(PyObject *module)\n");
+     bxprintf(fp, "{\n");
+
+     list_for_each(&d->structs, structure) {
+          if (list_is_empty(structure->fields))
+               bxprintf(fp, "     %s_descr = descr_from_fields(0, NULL, NULL, NULL, %lu);\n",
+                        structure->name, structure->size);
+          else {
+               bxprintf(fp, "     {\n");
+               bxprintf(fp, "          static const char *names[]   = {");
+               list_for_each(structure->fields, field)
+                    bxprintf(fp, "\"%s\"%s", field->name,
+                             list_is_last_elem(structure->fields, field) ? "" : ", ");
+               bxprintf(fp, "};\n");
+               bxprintf(fp, "          static const char *formats[] = {");
+               list_for_each(structure->fields, field) {
+                    bxprintf(fp, "\"");
+                    write_field_format(fp, field);
+                    bxprintf(fp, "\"%s", list_is_last_elem(structure->fields, field) ? "" : ", ");
+               }
+               bxprintf(fp, "};\n");
+               bxprintf(fp, "          static const int offsets[]   = {");
+               list_for_each(structure->fields, field)
+                    bxprintf(fp, "%lu%s", field->offset,
+                             list_is_last_elem(structure->fields, field) ? "" : ", ");
+               bxprintf(fp, "};\n");
+               bxprintf(fp, "          %s_descr = descr_from_fields(%d, names, formats, offsets, %lu);\n",
+                        structure->name, list_count(structure->fields), structure->size);
+               bxprintf(fp, "     }\n");
+          }
+          bxprintf(fp, "     if (%s_descr == NULL)\n", structure->name);
+          bxprintf(fp, "          return -1;\n");
+          bxprintf(fp, "     Py_INCREF((PyObject *) %s_descr);\n", structure->name);
+          bxprintf(fp, "     PyModule_AddObject(module, \"%s\", (PyObject *) %s_descr);\n",
+                   structure->name, structure->name);
+     }
+
+     bxprintf(fp, "     return 0;\n");
+     bxprintf(fp, "}\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+     return 0;
+}
+
+
+
+/*
+ * bf_getbuffer and bf_releasebuffer for the instance type, exposing the array
+ * returned by the subprogram marked with the buffer option.  The array is owned
+ * by the instance so the view holds a reference to the instance.  Shape and
+ * strides are kept in view->internal until the view is released.
+ */
+static int write_buffer_procs(bindx_buffer_data *fp, const bindx_data *d)
+{
+     int i;
+
+     const subprogram_data *subprogram;
+
+     subprogram = bindx_buffer_subprogram(d);
+     if (subprogram == NULL)
+          return 0;
+
+     bxprintf(fp, "#if PY_MAJOR_VERSION >= 3\n");
+     bxprintf(fp, "static int buffer_fill_info(Py_buffer *view, PyObject *obj, void *buf, int n_dims, Py_ssize_t *shape, Py_ssize_t itemsize, const char *format, int flags)\n");
+     bxprintf(fp, "{\n");
+     bxprintf(fp, "     int i;\n");
+     bxprintf(fp, "     Py_ssize_t *strides;\n");
+
+     bxprintf(fp, "     strides = shape + n_dims;\n");
+     bxprintf(fp, "     view->len = itemsize;\n");
+     bxprintf(fp, "     for (i = n_dims - 1; i >= 0; --i) {\n");
+     bxprintf(fp, "          strides[i] = view->len;\n");
+     bxprintf(fp, "          view->len *= shape[i];\n");
+     bxprintf(fp, "     }\n");
+     bxprintf(fp, "     view->obj        = obj;\n");
+     bxprintf(fp, "     view->buf        = buf;\n");
+     bxprintf(fp, "     view->readonly   = 1;\n");
+     bxprintf(fp, "     view->itemsize   = itemsize;\n");
+     bxprintf(fp, "     view->format     = flags & PyBUF_FORMAT  ? (char *) format : NULL;\n");
+     bxprintf(fp, "     view->ndim       = flags & PyBUF_ND      ? n_dims  : 1;\n");
+     bxprintf(fp, "     view->shape      = flags & PyBUF_ND      ? shape   : NULL;\n");
+     bxprintf(fp, "     view->strides    = flags & PyBUF_STRIDES ? strides : NULL;\n");
+     bxprintf(fp, "     view->suboffsets = NULL;\n");
+     bxprintf(fp, "     view->internal   = shape;\n");
+     bxprintf(fp, "     Py_INCREF(obj);\n");
+
+     bxprintf(fp, "     return 0;\n");
+     bxprintf(fp, "}\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+
+     bxprintf(fp, "static int %s_getbuffer(%s_data_py *self, Py_buffer *view, int flags)\n",
+              d->prefix, d->prefix);
+     bxprintf(fp, "{\n");
+     bxprintf(fp, "     ");
+     bindx_write_c_declaration(fp, d, &subprogram->type, NULL);
+     bxprintf(fp, "r;\n");
+     bxprintf(fp, "     %s_data *d = &self->%s;\n", d->prefix, d->prefix);
+     bxprintf(fp, "     Py_ssize_t *shape;\n");
+
+     bxprintf(fp, "     view->obj = NULL;\n");
+     bxprintf(fp, "     if (flags & PyBUF_WRITABLE) {\n");
+     bxprintf(fp, "          PyErr_SetString(PyExc_BufferError, \"%s buffer is read-only\");\n", d->prefix);
+     bxprintf(fp, "          return -1;\n");
+     bxprintf(fp, "     }\n");
+     if (is_instance_locked(d, subprogram))
+          write_instance_lock(fp, d, 1);
+     bxprintf(fp, "     r = %s_%s(d);\n", d->prefix, subprogram->name);
+     if (is_instance_locked(d, subprogram))
+          write_instance_unlock(fp, d, 1);
+     bxprintf(fp, "     if (r == NULL) {\n");
+     bxprintf(fp, "          PyErr_SetString(%sError, \"ERROR: %s_%s()\");\n", d->PREFIX, d->prefix, subprogram->name);
+     bxprintf(fp, "          return -1;\n");
+     bxprintf(fp, "     }\n");
+     bxprintf(fp, "     shape = malloc(%d * sizeof(Py_ssize_t));\n", 2 * subprogram->type.rank);
+     bxprintf(fp, "     if (shape == NULL) {\n");
+     bxprintf(fp, "          PyErr_NoMemory();\n");
+     bxprintf(fp, "          return -1;\n");
+     bxprintf(fp, "     }\n");
+     for (i = 0; i < subprogram->type.rank; ++i)
+          bxprintf(fp, "     shape[%d] = %s;\n", i, subprogram->type.dimens[i]);
+     bxprintf(fp, "     return buffer_fill_info(view, (PyObject *) self, (void *) r");
+     for (i = 1; i < subprogram->type.rank; ++i)
+          bxprintf(fp, "[0]");
+     bxprintf(fp, ", %d, shape, %ld, \"%s\", flags);\n", subprogram->type.rank,
+              bindx_c_type_size(&subprogram->type), type_to_buffer_format(&subprogram->type));
+     bxprintf(fp, "}\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+
+     bxprintf(fp, "static void %s_releasebuffer(%s_data_py *self, Py_buffer *view)\n",
+              d->prefix, d->prefix);
+     bxprintf(fp, "{\n");
+     bxprintf(fp, "     free(view->internal);\n");
+     bxprintf(fp, "}\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+
+     if (! d->limited_api) {
+          bxprintf(fp, "static PyBufferProcs %s_as_buffer = {\n", d->prefix);
+          bxprintf(fp, "     (getbufferproc) %s_getbuffer,\n", d->prefix);
+          bxprintf(fp, "     (releasebufferproc) %s_releasebuffer\n", d->prefix);
+          bxprintf(fp, "};\n");
+     }
+     bxprintf(fp, "#endif\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+     return 0;
+}
+
+
+
+/*
+ * Pickling goes through copyreg.__newobj__ so that unpickling makes a bare
+ * instance with tp_new and hands the snapshot to __setstate__, which frees
+ * whatever the instance held and rebuilds it with the restore subprogram.
+ */
+static int write_state_procs(bindx_buffer_data *fp, const bindx_data *d)
+{
+     const argument_data *argument;
+     const subprogram_data *subprogram;
+     const subprogram_data *snapshot;
+     const subprogram_data *restore;
+
+     snapshot = bindx_snapshot_subprogram(d);
+     restore  = bindx_restore_subprogram(d);
+     if (snapshot == NULL)
+          return 0;
+
+     argument = (argument_data *) snapshot->args->next;
+
+     bxprintf(fp, "static PyObject *%s_reduce_py(%s_data_py *self, PyObject *args)\n",
+              d->prefix, d->prefix);
+     bxprintf(fp, "{\n");
+     bxprintf(fp, "     char *r;\n");
+     bxprintf(fp, "     size_t %s;\n", argument->name);
+     bxprintf(fp, "     %s_data *d = &self->%s;\n", d->prefix, d->prefix);
+     bxprintf(fp, "     PyObject *copyreg;\n");
+     bxprintf(fp, "     PyObject *newobj;\n");
+     bxprintf(fp, "     PyObject *state;\n");
+     if (is_instance_locked(d, snapshot))
+          write_instance_lock(fp, d, 1);
+     bxprintf(fp, "     r = %s_%s(d, &%s);\n", d->prefix, snapshot->name, argument->name);
+     if (is_instance_locked(d, snapshot))
+          write_instance_unlock(fp, d, 1);
+     bxprintf(fp, "     if (r == NULL) {\n");
+     bxprintf(fp, "          PyErr_SetString(%sError, \"ERROR: %s_%s()\");\n", d->PREFIX, d->prefix, snapshot->name);
+     bxprintf(fp, "          return NULL;\n");
+     bxprintf(fp, "     }\n");
+     bxprintf(fp, "     state = PyBytes_FromStringAndSize(r, (Py_ssize_t) %s);\n", argument->name);
+     bxprintf(fp, "     free(r);\n");
+     bxprintf(fp, "     if (state == NULL)\n");
+     bxprintf(fp, "          return NULL;\n");
+     bxprintf(fp, "#if PY_MAJOR_VERSION < 3\n");
+     bxprintf(fp, "     copyreg = PyImport_ImportModule(\"copy_reg\");\n");
+     bxprintf(fp, "#else\n");
+     bxprintf(fp, "     copyreg = PyImport_ImportModule(\"copyreg\");\n");
+     bxprintf(fp, "#endif\n");
+     bxprintf(fp, "     if (copyreg == NULL) {\n");
+     bxprintf(fp, "          Py_DECREF(state);\n");
+     bxprintf(fp, "          return NULL;\n");
+     bxprintf(fp, "     }\n");
+     bxprintf(fp, "     newobj = PyObject_GetAttrString(copyreg, \"__newobj__\");\n");
+     bxprintf(fp, "     Py_DECREF(copyreg);\n");
+     bxprintf(fp, "     if (newobj == NULL) {\n");
+     bxprintf(fp, "          Py_DECREF(state);\n");
+     bxprintf(fp, "          return NULL;\n");
+     bxprintf(fp, "     }\n");
+     bxprintf(fp, "     return Py_BuildValue(\"(N(O)N)\", newobj, (PyObject *) Py_TYPE((PyObject *) self), state);\n");
+     bxprintf(fp, "}\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+
+     argument = (argument_data *) restore->args->next;
+
+     bxprintf(fp, "static PyObject *%s_setstate_py(%s_data_py *self, PyObject *args)\n",
+              d->prefix, d->prefix);
+     bxprintf(fp, "{\n");
+     bxprintf(fp, "     int r;\n");
+     bxprintf(fp, "     char *%s;\n", ((argument_data *) argument->next)->name);
+     bxprintf(fp, "     Py_ssize_t %s;\n", argument->name);
+     bxprintf(fp, "     %s_data *d = &self->%s;\n", d->prefix, d->prefix);
+     bxprintf(fp, "     if (PyBytes_AsStringAndSize(args, &%s, &%s) < 0)\n",
+              ((argument_data *) argument->next)->name, argument->name);
+     bxprintf(fp, "          return NULL;\n");
+     if (has_instance_locks(d)) {
+          if (d->free_threaded && ! d->limited_api)
+               bxprintf(fp, "#if PY_VERSION_HEX < 0x030D0000\n");
+          bxprintf(fp, "     if (self->lock == NULL && (self->lock = PyThread_allocate_lock()) == NULL)\n");
+          bxprintf(fp, "          return PyErr_NoMemory();\n");
+          if (d->free_threaded && ! d->limited_api)
+               bxprintf(fp, "#endif\n");
+     }
+     if (is_instance_locked(d, restore))
+          write_instance_lock(fp, d, 1);
+     list_for_each(&d->subs_free, subprogram)
+          bxprintf(fp, "     %s_%s(d);\n", d->prefix, subprogram->name);
+     bxprintf(fp, "     memset(d, 0, sizeof(%s_data));\n", d->prefix);
+     bxprintf(fp, "     r = %s_%s(d, (size_t) %s, %s);\n", d->prefix, restore->name,
+              argument->name, ((argument_data *) argument->next)->name);
+     if (is_instance_locked(d, restore))
+          write_instance_unlock(fp, d, 1);
+     bxprintf(fp, "     if (r == %s) {\n", bindx_c_error_conditional(d, restore->type.type));
+     bxprintf(fp, "          PyErr_SetString(%sError, \"ERROR: %s_%s()\");\n", d->PREFIX, d->prefix, restore->name);
+     bxprintf(fp, "          return NULL;\n");
+     bxprintf(fp, "     }\n");
+     bxprintf(fp, "     Py_RETURN_NONE;\n");
+     bxprintf(fp, "}\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+     return 0;
+}
+
+
+
+/*
+ * clone(), __copy__() and __deepcopy__() all make a new instance of the same
+ * type filled by the clone subprogram.  The instance holds no Python objects
+ * so a shallow and a deep copy are the same thing.
+ */
+static int write_clone_proc(bindx_buffer_data *fp, const bindx_data *d)
+{
+     const subprogram_data *subprogram;
+
+     subprogram = bindx_clone_subprogram(d);
+     if (subprogram == NULL)
+          return 0;
+
+     bxprintf(fp, "static PyObject *%s_clone_py(%s_data_py *self, PyObject *args)\n",
+              d->prefix, d->prefix);
+     bxprintf(fp, "{\n");
+     bxprintf(fp, "     int r;\n");
+     bxprintf(fp, "     PyTypeObject *type;\n");
+     bxprintf(fp, "     %s_data_py *clone;\n", d->prefix);
+     bxprintf(fp, "     type = Py_TYPE((PyObject *) self);\n");
+     if (d->limited_api)
+          bxprintf(fp, "     clone = (%s_data_py *) ((allocfunc) PyType_GetSlot(type, Py_tp_alloc))(type, 0);\n", d->prefix);
+     else
+          bxprintf(fp, "     clone = (%s_data_py *) type->tp_alloc(type, 0);\n", d->prefix);
+     bxprintf(fp, "     if (clone == NULL)\n");
+     bxprintf(fp, "          return NULL;\n");
+     if (has_instance_locks(d)) {
+          if (d->free_threaded && ! d->limited_api)
+               bxprintf(fp, "#if PY_VERSION_HEX < 0x030D0000\n");
+          bxprintf(fp, "     if ((clone->lock = PyThread_allocate_lock()) == NULL) {\n");
+          bxprintf(fp, "          Py_DECREF(clone);\n");
+          bxprintf(fp, "          return PyErr_NoMemory();\n");
+          bxprintf(fp, "     }\n");
+          if (d->free_threaded && ! d->limited_api)
+               bxprintf(fp, "#endif\n");
+     }
+     if (is_instance_locked(d, subprogram))
+          write_instance_lock(fp, d, 1);
+     bxprintf(fp, "     r = %s_%s(&clone->%s, &self->%s);\n", d->prefix, subprogram->name,
+              d->prefix, d->prefix);
+     if (is_instance_locked(d, subprogram))
+          write_instance_unlock(fp, d, 1);
+     bxprintf(fp, "     if (r == %s) {\n", bindx_c_error_conditional(d, subprogram->type.type));
+     bxprintf(fp, "          PyErr_SetString(%sError, \"ERROR: %s_%s()\");\n", d->PREFIX, d->prefix, subprogram->name);
+     bxprintf(fp, "          Py_DECREF(clone);\n");
+     bxprintf(fp, "          return NULL;\n");
+     bxprintf(fp, "     }\n");
+     bxprintf(fp, "     return (PyObject *) clone;\n");
+     bxprintf(fp, "}\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+     return 0;
 }
 
 
 
-static int write_utilities(FILE *fp, const bindx_data *d)
-{
-     fprintf(fp, "static int list_to_mask(PyObject *list, int *mask, int (*name_to_mask)(const char *name), const char *name)\n");
-     fprintf(fp, "{\n");
-     fprintf(fp, "     int i;\n");
-     fprintf(fp, "     int n;\n");
-     fprintf(fp, "     int r;\n");
-
-     fprintf(fp, "     char *format;\n");
-     fprintf(fp, "     char *error;\n");
-
-     fprintf(fp, "     *mask = 0;\n");
-     fprintf(fp, "     n = PyList_Size(list);\n");
-     fprintf(fp, "     for (i = 0; i < n; ++i) {\n");
-     fprintf(fp, "#if PY_MAJOR_VERSION < 3\n");
-     fprintf(fp, "          r = name_to_mask(PyString_AsString(PyList_GetItem(list, i)));\n");
-     fprintf(fp, "#else\n");
-     fprintf(fp, "          r = name_to_mask(PyUnicode_AsUTF8 (PyList_GetItem(list, i)));\n");
-     fprintf(fp, "#endif\n");
-     fprintf(fp, "          if (r == -1) {\n");
-     fprintf(fp, "               format = \"ERROR: %%s()\";\n");
-     fprintf(fp, "               error  = malloc(strlen(format) - 2 + strlen(name) + 1);\n");
-     fprintf(fp, "               sprintf(error, format, name);\n");
-     fprintf(fp, "               PyErr_SetString(%sError, error);\n", d->PREFIX);
-     fprintf(fp, "               free(error);\n");
-     fprintf(fp, "               return -1;\n");
-     fprintf(fp, "          }\n");
-     fprintf(fp, "          *mask |= r;\n");
-     fprintf(fp, "     }\n");
-
-     fprintf(fp, "     return 0;\n");
-     fprintf(fp, "}\n");
-     fprintf(fp, "\n");
-     fprintf(fp, "\n");
-
-
-     fprintf(fp, "static int list_to_array(PyObject *list, int *n, int **array, int (*name_to_value)(const char *name), const char *name)\n");
-     fprintf(fp, "{\n");
-     fprintf(fp, "     int i;\n");
-     fprintf(fp, "     int r;\n");
-
-     fprintf(fp, "     char *format;\n");
-     fprintf(fp, "     char *error;\n");
-
-     fprintf(fp, "     *n = PyList_Size(list);\n");
-     fprintf(fp, "     *array = malloc(*n * sizeof(int));\n");
-     fprintf(fp, "     for (i = 0; i < *n; ++i) {\n");
-     fprintf(fp, "#if PY_MAJOR_VERSION < 3\n");
-     fprintf(fp, "          r = name_to_value(PyString_AsString(PyList_GetItem(list, i)));\n");
-     fprintf(fp, "#else\n");
-     fprintf(fp, "          r = name_to_value(PyUnicode_AsUTF8 (PyList_GetItem(list, i)));\n");
-     fprintf(fp, "#endif\n");
-     fprintf(fp, "          if (r == -1) {\n");
-     fprintf(fp, "               format = \"ERROR: %%s()\";\n");
-     fprintf(fp, "               error  = malloc(strlen(format) - 2 + strlen(name) + 1);\n");
-     fprintf(fp, "               sprintf(error, format, name);\n");
-     fprintf(fp, "               PyErr_SetString(%sError, error);\n", d->PREFIX);
-     fprintf(fp, "               free(error);\n");
-     fprintf(fp, "               return -1;\n");
-     fprintf(fp, "          }\n");
-     fprintf(fp, "          (*array)[i] = r;\n");
-     fprintf(fp, "     }\n");
-
-     fprintf(fp, "     return 0;\n");
-     fprintf(fp, "}\n");
-     fprintf(fp, "\n");
-     fprintf(fp, "\n");
-
-
-     fprintf(fp, "static int check_pyarray_shape(PyObject *array, const char *name, int n, ...)\n");
-     fprintf(fp, "{\n");
-     fprintf(fp, "     int i;\n");
-     fprintf(fp, "     int dim;\n");
-     fprintf(fp, "     int n_py;\n");
-     fprintf(fp, "     int dim_py;\n");
-     fprintf(fp, "     va_list valist;\n");
-
-     fprintf(fp, "     n_py = PyArray_NDIM((PyArrayObject *) array);\n");
-     fprintf(fp, "     if (n_py != n) {\n");
-     fprintf(fp, "          PyErr_Format(%sError, \"ERROR: Number of dimensions for %%s input (%%d) must be == %%d\", name, n_py);\n", d->PREFIX);
-     fprintf(fp, "          return -1;\n");
-     fprintf(fp, "     }\n");
-
-     fprintf(fp, "     va_start(valist, n);\n");
-
-     fprintf(fp, "     for (i = 0; i < n; ++i) {\n");
-     fprintf(fp, "          dim = va_arg(valist, int);\n");
-     fprintf(fp, "          dim_py = PyArray_DIM((PyArrayObject *) array, i);\n");
-     fprintf(fp, "          if (dim_py != dim) {\n");
-     fprintf(fp, "              PyErr_Format(%sError, \"ERROR: Dimension %%d of %%s input (%%d) must be == %%d\", i, name, dim_py, dim);\n", d->PREFIX);
-     fprintf(fp, "              return -1;\n");
-     fprintf(fp, "          }\n");
-     fprintf(fp, "     }\n");
-
-     fprintf(fp, "     va_end(valist);\n");
-
-     fprintf(fp, "     return 0;\n");
-     fprintf(fp, "}\n");
-     fprintf(fp, "\n");
-     fprintf(fp, "\n");
-
-
-     fprintf(fp, "static void *array_from_ndarray(PyObject *ndarray, size_t size)\n");
-     fprintf(fp, "{\n");
-     fprintf(fp, "     int i;\n");
-     fprintf(fp, "     int n_dims;\n");
-     fprintf(fp, "     size_t *dims;\n");
-     fprintf(fp, "     void *array;\n");
-
-     fprintf(fp, "     n_dims = PyArray_NDIM((PyArrayObject *) ndarray);\n");
-     fprintf(fp, "     dims = malloc(n_dims * sizeof(long));\n");
-     fprintf(fp, "     for (i = 0; i < n_dims; ++i)\n");
-     fprintf(fp, "          dims[i] = PyArray_DIM((PyArrayObject *) ndarray, i);\n");
-
-     fprintf(fp, "     array = array_from_mem(PyArray_DATA((PyArrayObject *) ndarray), n_dims, dims, size, 1);\n");
-
-     fprintf(fp, "     free(dims);\n");
-
-     fprintf(fp, "     return array;\n");
-     fprintf(fp, "}\n");
-     fprintf(fp, "\n");
-     fprintf(fp, "\n");
+/*
+ * A fixed pool of pthreads takes jobs from a FIFO.  Each job runs the ordinary
+ * wrapper, which releases the GIL around the C call, and hands the result or
+ * exception to the job's event loop with call_soon_threadsafe().
+ */
+static int write_async(bindx_buffer_data *fp, const bindx_data *d)
+{
+     subprogram_data *subprogram;
+
+     if (! has_async(d))
+          return 0;
+
+     bxprintf(fp, "#ifndef %s_ASYNC_N_THREADS\n", d->PREFIX);
+     bxprintf(fp, "#define %s_ASYNC_N_THREADS 4\n", d->PREFIX);
+     bxprintf(fp, "#endif\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+     bxprintf(fp, "typedef struct async_job_data {\n");
+     bxprintf(fp, "     PyObject *(*function)(%s_data_py *, PyObject *);\n", d->prefix);
+     bxprintf(fp, "     %s_data_py *self;\n", d->prefix);
+     bxprintf(fp, "     PyObject *args;\n");
+     bxprintf(fp, "     PyObject *loop;\n");
+     bxprintf(fp, "     PyObject *future;\n");
+     bxprintf(fp, "     struct async_job_data *next;\n");
+     bxprintf(fp, "} async_job_data;\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+     bxprintf(fp, "static pthread_once_t  async_once  = PTHREAD_ONCE_INIT;\n");
+     bxprintf(fp, "static pthread_mutex_t async_mutex = PTHREAD_MUTEX_INITIALIZER;\n");
+     bxprintf(fp, "static pthread_cond_t  async_cond  = PTHREAD_COND_INITIALIZER;\n");
+     bxprintf(fp, "static async_job_data *async_head = NULL;\n");
+     bxprintf(fp, "static async_job_data *async_tail = NULL;\n");
+     bxprintf(fp, "static int async_n_threads = 0;\n");
+     bxprintf(fp, "static PyObject *async_complete = NULL;\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+     bxprintf(fp, "static PyObject *async_complete_py(PyObject *self, PyObject *args)\n");
+     bxprintf(fp, "{\n");
+     bxprintf(fp, "     int ok;\n");
+     bxprintf(fp, "     PyObject *future;\n");
+     bxprintf(fp, "     PyObject *value;\n");
+     bxprintf(fp, "     PyObject *cancelled;\n");
+     bxprintf(fp, "     if (! PyArg_ParseTuple(args, \"OiO\", &future, &ok, &value))\n");
+     bxprintf(fp, "          return NULL;\n");
+     bxprintf(fp, "     cancelled = PyObject_CallMethod(future, \"cancelled\", NULL);\n");
+     bxprintf(fp, "     if (cancelled == NULL)\n");
+     bxprintf(fp, "          return NULL;\n");
+     bxprintf(fp, "     if (PyObject_IsTrue(cancelled)) {\n");
+     bxprintf(fp, "          Py_DECREF(cancelled);\n");
+     bxprintf(fp, "          Py_RETURN_NONE;\n");
+     bxprintf(fp, "     }\n");
+     bxprintf(fp, "     Py_DECREF(cancelled);\n");
+     bxprintf(fp, "     return PyObject_CallMethod(future, ok ? \"set_result\" : \"set_exception\", \"O\", value);\n");
+     bxprintf(fp, "}\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+     bxprintf(fp, "static PyMethodDef async_complete_def = {\"async_complete\", (PyCFunction) async_complete_py, METH_VARARGS, NULL};\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+     bxprintf(fp, "static void *async_worker(void *arg)\n");
+     bxprintf(fp, "{\n");
+     bxprintf(fp, "     int ok;\n");
+     bxprintf(fp, "     PyObject *r;\n");
+     bxprintf(fp, "     PyObject *type;\n");
+     bxprintf(fp, "     PyObject *value;\n");
+     bxprintf(fp, "     PyObject *traceback;\n");
+     bxprintf(fp, "     PyGILState_STATE state;\n");
+     bxprintf(fp, "     async_job_data *job;\n");
+     bxprintf(fp, "     for (;;) {\n");
+     bxprintf(fp, "          pthread_mutex_lock(&async_mutex);\n");
+     bxprintf(fp, "          while (async_head == NULL)\n");
+     bxprintf(fp, "               pthread_cond_wait(&async_cond, &async_mutex);\n");
+     bxprintf(fp, "          job = async_head;\n");
+     bxprintf(fp, "          async_head = job->next;\n");
+     bxprintf(fp, "          if (async_head == NULL)\n");
+     bxprintf(fp, "               async_tail = NULL;\n");
+     bxprintf(fp, "          pthread_mutex_unlock(&async_mutex);\n");
+     bxprintf(fp, "          state = PyGILState_Ensure();\n");
+     bxprintf(fp, "          value = job->function(job->self, job->args);\n");
+     bxprintf(fp, "          ok = value != NULL;\n");
+     bxprintf(fp, "          if (! ok) {\n");
+     bxprintf(fp, "               PyErr_Fetch(&type, &value, &traceback);\n");
+     bxprintf(fp, "               PyErr_NormalizeException(&type, &value, &traceback);\n");
+     bxprintf(fp, "               if (value != NULL && traceback != NULL)\n");
+     bxprintf(fp, "                    PyException_SetTraceback(value, traceback);\n");
+     bxprintf(fp, "               Py_XDECREF(type);\n");
+     bxprintf(fp, "               Py_XDECREF(traceback);\n");
+     bxprintf(fp, "          }\n");
+     bxprintf(fp, "          r = PyObject_CallMethod(job->loop, \"call_soon_threadsafe\", \"OOiO\", async_complete, job->future, ok, value != NULL ? value : Py_None);\n");
+     bxprintf(fp, "          if (r == NULL)\n");
+     bxprintf(fp, "               PyErr_WriteUnraisable(job->future);\n");
+     bxprintf(fp, "          Py_XDECREF(r);\n");
+     bxprintf(fp, "          Py_XDECREF(value);\n");
+     bxprintf(fp, "          Py_DECREF((PyObject *) job->self);\n");
+     bxprintf(fp, "          Py_DECREF(job->args);\n");
+     bxprintf(fp, "          Py_DECREF(job->loop);\n");
+     bxprintf(fp, "          Py_DECREF(job->future);\n");
+     bxprintf(fp, "          PyGILState_Release(state);\n");
+     bxprintf(fp, "          free(job);\n");
+     bxprintf(fp, "     }\n");
+     bxprintf(fp, "     return NULL;\n");
+     bxprintf(fp, "}\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+     bxprintf(fp, "static void async_start(void)\n");
+     bxprintf(fp, "{\n");
+     bxprintf(fp, "     int i;\n");
+     bxprintf(fp, "     pthread_t thread;\n");
+     bxprintf(fp, "     for (i = 0; i < %s_ASYNC_N_THREADS; ++i) {\n", d->PREFIX);
+     bxprintf(fp, "          if (pthread_create(&thread, NULL, async_worker, NULL) != 0)\n");
+     bxprintf(fp, "               break;\n");
+     bxprintf(fp, "          pthread_detach(thread);\n");
+     bxprintf(fp, "     }\n");
+     bxprintf(fp, "     async_n_threads = i;\n");
+     bxprintf(fp, "}\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+     bxprintf(fp, "static PyObject *async_submit(%s_data_py *self, PyObject *args, PyObject *(*function)(%s_data_py *, PyObject *))\n", d->prefix, d->prefix);
+     bxprintf(fp, "{\n");
+     bxprintf(fp, "     PyObject *asyncio;\n");
+     bxprintf(fp, "     PyObject *loop;\n");
+     bxprintf(fp, "     PyObject *future;\n");
+     bxprintf(fp, "     PyObject *complete;\n");
+     bxprintf(fp, "     async_job_data *job;\n");
+     bxprintf(fp, "     if (async_complete == NULL) {\n");
+     bxprintf(fp, "          if ((complete = PyCFunction_New(&async_complete_def, NULL)) == NULL)\n");
+     bxprintf(fp, "               return NULL;\n");
+     bxprintf(fp, "          if (async_complete == NULL)\n");
+     bxprintf(fp, "               async_complete = complete;\n");
+     bxprintf(fp, "          else\n");
+     bxprintf(fp, "               Py_DECREF(complete);\n");
+     bxprintf(fp, "     }\n");
+     bxprintf(fp, "     pthread_once(&async_once, async_start);\n");
+     bxprintf(fp, "     if (async_n_threads == 0) {\n");
+     bxprintf(fp, "          PyErr_SetString(%sError, \"unable to start async worker threads\");\n", d->PREFIX);
+     bxprintf(fp, "          return NULL;\n");
+     bxprintf(fp, "     }\n");
+     bxprintf(fp, "     if ((asyncio = PyImport_ImportModule(\"asyncio\")) == NULL)\n");
+     bxprintf(fp, "          return NULL;\n");
+     bxprintf(fp, "     loop = PyObject_CallMethod(asyncio, \"get_running_loop\", NULL);\n");
+     bxprintf(fp, "     Py_DECREF(asyncio);\n");
+     bxprintf(fp, "     if (loop == NULL)\n");
+     bxprintf(fp, "          return NULL;\n");
+     bxprintf(fp, "     if ((future = PyObject_CallMethod(loop, \"create_future\", NULL)) == NULL) {\n");
+     bxprintf(fp, "          Py_DECREF(loop);\n");
+     bxprintf(fp, "          return NULL;\n");
+     bxprintf(fp, "     }\n");
+     bxprintf(fp, "     if ((job = malloc(sizeof(async_job_data))) == NULL) {\n");
+     bxprintf(fp, "          Py_DECREF(future);\n");
+     bxprintf(fp, "          Py_DECREF(loop);\n");
+     bxprintf(fp, "          return PyErr_NoMemory();\n");
+     bxprintf(fp, "     }\n");
+     bxprintf(fp, "     Py_INCREF((PyObject *) self);\n");
+     bxprintf(fp, "     Py_INCREF(args);\n");
+     bxprintf(fp, "     Py_INCREF(future);\n");
+     bxprintf(fp, "     job->function = function;\n");
+     bxprintf(fp, "     job->self     = self;\n");
+     bxprintf(fp, "     job->args     = args;\n");
+     bxprintf(fp, "     job->loop     = loop;\n");
+     bxprintf(fp, "     job->future   = future;\n");
+     bxprintf(fp, "     job->next     = NULL;\n");
+     bxprintf(fp, "     pthread_mutex_lock(&async_mutex);\n");
+     bxprintf(fp, "     if (async_tail == NULL)\n");
+     bxprintf(fp, "          async_head = job;\n");
+     bxprintf(fp, "     else\n");
+     bxprintf(fp, "          async_tail->next = job;\n");
+     bxprintf(fp, "     async_tail = job;\n");
+     bxprintf(fp, "     pthread_cond_signal(&async_cond);\n");
+     bxprintf(fp, "     pthread_mutex_unlock(&async_mutex);\n");
+     bxprintf(fp, "     return future;\n");
+     bxprintf(fp, "}\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+     list_for_each(&d->subs_general, subprogram) {
+          if (! is_async(d, subprogram))
+               continue;
+          bxprintf(fp, "static PyObject *%s_%s_async_py(%s_data_py *self, PyObject *args)\n",
+                   d->prefix, subprogram->name, d->prefix);
+          bxprintf(fp, "{\n");
+          bxprintf(fp, "     return async_submit(self, args, %s_%s_py);\n", d->prefix, subprogram->name);
+          bxprintf(fp, "}\n");
+          bxprintf(fp, "\n");
+          bxprintf(fp, "\n");
+     }
 
      return 0;
 }
 
 
 
-static int write_methods(FILE *fp, const bindx_data *d,
+static int write_methods(bindx_buffer_data *fp, const bindx_data *d,
                          const subprogram_data *subs, const char *name)
 {
      subprogram_data *subprogram;
 
-     fprintf(fp, "static PyMethodDef %s_methods[] = {\n", d->prefix);
+     bxprintf(fp, "static PyMethodDef %s_methods[] = {\n", d->prefix);
 
-     list_for_each(subs, subprogram)
-          fprintf(fp, "     {\"%s\", (PyCFunction) %s_%s_py, METH_VARARGS, \"null\"},\n",
-                  subprogram->name, d->prefix, subprogram->name);
+     list_for_each(subs, subprogram) {
+          bxprintf(fp, "     {\"%s\", (PyCFunction) %s_%s_py, METH_VARARGS, \"null\"},\n",
+                   subprogram->name, d->prefix, subprogram->name);
+          if (subprogram->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_PLAN) {
+               bxprintf(fp, "     {\"%s_prepare\", (PyCFunction) %s_%s_prepare_py, METH_VARARGS, \"Check and bind the array, enum and size arguments of %s()\"},\n",
+                        subprogram->name, d->prefix, subprogram->name, subprogram->name);
+               bxprintf(fp, "     {\"%s_execute\", (PyCFunction) %s_%s_execute_py, METH_VARARGS, \"Call %s() with a plan from %s_prepare()\"},\n",
+                        subprogram->name, d->prefix, subprogram->name, subprogram->name, subprogram->name);
+          }
+          if (is_async(d, subprogram))
+               bxprintf(fp, "     {\"%s_async\", (PyCFunction) %s_%s_async_py, METH_VARARGS, \"Awaitable %s() run on a worker thread\"},\n",
+                        subprogram->name, d->prefix, subprogram->name, subprogram->name);
+     }
+
+     if (bindx_clone_subprogram(d)) {
+          bxprintf(fp, "     {\"clone\", (PyCFunction) %s_clone_py, METH_NOARGS, \"Deep copy of the instance\"},\n", d->prefix);
+          bxprintf(fp, "     {\"__copy__\", (PyCFunction) %s_clone_py, METH_NOARGS, \"Deep copy of the instance\"},\n", d->prefix);
+          bxprintf(fp, "     {\"__deepcopy__\", (PyCFunction) %s_clone_py, METH_O, \"Deep copy of the instance\"},\n", d->prefix);
+     }
+
+     if (bindx_snapshot_subprogram(d)) {
+          bxprintf(fp, "     {\"__reduce__\", (PyCFunction) %s_reduce_py, METH_NOARGS, \"Pickle support\"},\n", d->prefix);
+          bxprintf(fp, "     {\"__setstate__\", (PyCFunction) %s_setstate_py, METH_O, \"Unpickle support\"},\n", d->prefix);
+     }
 
-     fprintf(fp, "     {NULL}\n");
-     fprintf(fp, "};\n");
-     fprintf(fp, "\n");
-     fprintf(fp, "\n");
+     bxprintf(fp, "     {NULL}\n");
+     bxprintf(fp, "};\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
 
      return 0;
 }
@@ -275,37 +1538,145 @@ static int write_methods(FILE *fp, const bindx_data *d,
 
 
 
-static int write_subprograms(FILE *fp, const bindx_data *d,
+/*
+ * Arguments to the C call after d.  With plan set the arguments bound by
+ * <name>_prepare() are taken from the plan.
+ */
+static void write_call_args(bindx_buffer_data *fp, const bindx_data *d,
+                            const subprogram_data *subprogram, int plan)
+{
+     argument_data *argument;
+
+     list_for_each(subprogram->args, argument) {
+          bxprintf(fp, ", ");
+          if (argument->type.type == LEX_BINDX_TYPE_ENUM) {
+               bxprintf(fp, "(enum %s_%s", d->prefix, argument->type.name);
+               if (argument->type.rank > 0)
+                    bxprintf(fp, " ");
+               bindx_write_c_dimens_args(fp, d, &argument->type, argument->usage);
+               bxprintf(fp, ") ");
+          }
+
+          if (plan && bindx_plan_argument_is_bound(subprogram, argument))
+               bxprintf(fp,  "plan->%s", argument->name);
+          else
+          if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_ENUM_MASK ||
+              argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_ENUM_ARRAY)
+               bxprintf(fp,  "%s", argument->name);
+          else
+          if (argument->type.rank == 0  &&
+              argument->usage == LEX_SUBPROGRAM_ARGUMENT_USAGE_IN)
+               bxprintf(fp,  "%s", argument->name);
+          else
+          if (argument->type.rank == 0  &&
+              argument->usage == LEX_SUBPROGRAM_ARGUMENT_USAGE_OUT &&
+              ! argument_is_structure(argument))
+               bxprintf(fp, "&%s", argument->name);
+          else
+               bxprintf(fp,  "%s", argument->name);
+
+          if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_STRIDED)
+               bxprintf(fp, ", %s_strides", argument->name);
+     }
+}
+
+
+
+static void write_return_value(bindx_buffer_data *fp, const bindx_data *d,
+                               const subprogram_data *subprogram, const char *ret, int indent)
+{
+     int i;
+
+     argument_data *argument;
+
+          if (has_array_return_value(subprogram)) {
+               for (i = 0; i < subprogram->type.rank; ++i)
+                    bxprintf(fp, "%sr_dims[%d] = %s;\n", bxis(indent), i, subprogram->type.dimens[i]);
+               bxprintf(fp, "%s%sndarray_from_return(r, (void *) r", bxis(indent), ret);
+               for (i = 1; i < subprogram->type.rank; ++i)
+                    bxprintf(fp, "[0]");
+               bxprintf(fp, ", %d, r_dims, %s, (PyObject *) self, %d);\n",
+                        subprogram->type.rank, type_to_numpy_typenum(&subprogram->type),
+                        get_return_ownership(subprogram));
+          }
+          else
+          if (subprogram->has_return_value) {
+               bxprintf(fp, "%s%sPy_BuildValue(\"%s\", ", bxis(indent), ret, type_to_py_format(&subprogram->type, 0, 0));
+               if (subprogram->type.type == LEX_BINDX_TYPE_COMPLEX)
+                    bxprintf(fp, "%s&r);\n", py_complex_cast(d));
+               else
+                    bxprintf(fp, "r);\n");
+          }
+          else {
+               if (subprogram_n_out_args(subprogram) == 0)
+                    bxprintf(fp, "%s%sPy_BuildValue(\"i\",  0);\n", bxis(indent), ret);
+               else {
+                    bxprintf(fp, "%s%sPy_BuildValue(\"", bxis(indent), ret);
+                    list_for_each(subprogram->args, argument) {
+                         if (argument->usage == LEX_SUBPROGRAM_ARGUMENT_USAGE_OUT)
+                              bxprintf(fp, "%s", type_to_py_format(&argument->type, 0, 0));
+                    }
+                    bxprintf(fp, "\"");
+                    list_for_each(subprogram->args, argument) {
+                          if (argument->usage == LEX_SUBPROGRAM_ARGUMENT_USAGE_OUT) {
+                               if (argument->type.rank == 0 &&
+                                   argument->type.type == LEX_BINDX_TYPE_COMPLEX)
+                                    bxprintf(fp, ", %s&%s", py_complex_cast(d), argument->name);
+                               else
+                               if (argument->type.rank == 0 && ! argument_is_structure(argument))
+                                    bxprintf(fp, ", %s", argument->name);
+                               else
+                                    bxprintf(fp, ", %s_ndarray", argument->name);
+                          }
+                    }
+                    bxprintf(fp, ");\n");
+               }
+          }
+}
+
+
+
+static int write_subprograms(bindx_buffer_data *fp, const bindx_data *d,
                              enum subprogram_type sub_type,
                              const subprogram_data *subs, const char *name)
 {
      char temp[NM];
 
      const char *format;
+     const char *ret;
 
      int i;
 
      int flag;
+     int locked;
 
      int indent = 0;
 
      int max_dims;
+     int n_dimens;
+
+     int stats;
+     int i_stats = 0;
 
      argument_data *argument;
      subprogram_data *subprogram;
 
+     stats = d->stats && sub_type == SUBPROGRAM_TYPE_GENERAL;
+
+     ret = stats ? "stats_result = " : "return ";
+
      list_for_each(subs, subprogram) {
           if (sub_type == SUBPROGRAM_TYPE_INIT)
-               fprintf(fp, "static int %s_init(%s_data_py *self, PyObject *args)\n",
-                       d->prefix, d->prefix);
+               bxprintf(fp, "static int %s_init(%s_data_py *self, PyObject *args)\n",
+                        d->prefix, d->prefix);
           else
           if (sub_type == SUBPROGRAM_TYPE_FREE)
-               fprintf(fp, "static void %s_dealloc(%s_data_py *self)\n",
-                       d->prefix, d->prefix);
+               bxprintf(fp, "static void %s_dealloc(%s_data_py *self)\n",
+                        d->prefix, d->prefix);
           else
-               fprintf(fp, "static PyObject *%s_%s_py(%s_data_py *self, PyObject *args)\n",
-                       d->prefix, subprogram->name, d->prefix);
-          fprintf(fp, "{\n");
+               bxprintf(fp, "static PyObject *%s_%s_py(%s_data_py *self, PyObject *args)\n",
+                        d->prefix, subprogram->name, d->prefix);
+          bxprintf(fp, "{\n");
 
           max_dims = 0;
           list_for_each(subprogram->args, argument) {
@@ -315,51 +1686,75 @@ static int write_subprograms(FILE *fp, const bindx_data *d,
 
           indent++;
 
-          fprintf(fp, "%s", bxis(indent));
-          bindx_write_c_type(fp, d, &subprogram->type, NULL);
-          fprintf(fp, " r;\n");
+          bxprintf(fp, "%s", bxis(indent));
+          bindx_write_c_declaration(fp, d, &subprogram->type, NULL);
+          bxprintf(fp, "r;\n");
+
+          bxprintf(fp, "%s%s_data *d = &self->%s;\n", bxis(indent), d->prefix, d->prefix);
+
+          if (sub_type == SUBPROGRAM_TYPE_FREE && d->limited_api)
+               bxprintf(fp, "%sPyTypeObject *type;\n", bxis(indent));
+
+          if (stats) {
+               bindx_write_c_stats_declaration(fp, d, indent);
+               bxprintf(fp, "%sPyObject *stats_result;\n", bxis(indent));
+          }
+
+          if (has_array_return_value(subprogram))
+               bxprintf(fp, "%snpy_intp r_dims[%d];\n", bxis(indent), subprogram->type.rank);
 
-          fprintf(fp, "%s%s_data *d = &self->%s;\n", bxis(indent), d->prefix, d->prefix);
+          if (subprogram->n_dimens > 0)
+               bxprintf(fp, "%snpy_intp dimens[%d];\n", bxis(indent), subprogram->n_dimens);
 
           flag = 0;
           temp[0] = '\0';
           list_for_each(subprogram->args, argument) {
+               if (argument_is_structure(argument)) {
+                    if (argument->usage == LEX_SUBPROGRAM_ARGUMENT_USAGE_IN)
+                         bxprintf(fp, "%sPyObject *%s_object  = NULL;\n", bxis(indent), argument->name);
+                    bxprintf(fp, "%sPyObject *%s_ndarray = NULL;\n", bxis(indent), argument->name);
+                    bxprintf(fp, "%s%s *%s;\n", bxis(indent), argument->type.name, argument->name);
+               }
+               else
                if (argument->type.rank == 0 ||
                    argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_ENUM_ARRAY) {
-                    fprintf(fp, "%s", bxis(indent));
-                    bindx_write_c_declaration(fp, d, &argument->type, NULL);
-                    fprintf(fp, "%s;\n", argument->name);
+                    bxprintf(fp, "%s", bxis(indent));
+                    bindx_write_c_argument_declaration(fp, d, argument);
+                    bxprintf(fp, "%s;\n", argument->name);
                }
 
                if (argument->type.rank == 0 &&
                    argument->type.type == LEX_BINDX_TYPE_ENUM)
-                    fprintf(fp, "%sconst char *%s_string = NULL;\n", bxis(indent), argument->name);
+                    bxprintf(fp, "%sconst char *%s_string = NULL;\n", bxis(indent), argument->name);
                else
                if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_ENUM_MASK ||
                    argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_ENUM_ARRAY)
-                    fprintf(fp, "%sPyObject *%s_list;\n", bxis(indent), argument->name);
+                    bxprintf(fp, "%sPyObject *%s_list;\n", bxis(indent), argument->name);
                else
                if (argument->type.rank > 0 &&
                    argument->usage == LEX_SUBPROGRAM_ARGUMENT_USAGE_IN) {
-                    fprintf(fp, "%sPyObject *%s_object  = NULL;\n", bxis(indent), argument->name);
-                    fprintf(fp, "%sPyObject *%s_ndarray = NULL;\n", bxis(indent), argument->name);
-                    fprintf(fp, "%s", bxis(indent));
-                    bindx_write_c_declaration(fp, d, &argument->type, NULL);
-                    fprintf(fp, "%s;\n", argument->name);
+                    bxprintf(fp, "%sPyObject *%s_object  = NULL;\n", bxis(indent), argument->name);
+                    bxprintf(fp, "%sPyObject *%s_ndarray = NULL;\n", bxis(indent), argument->name);
+                    bxprintf(fp, "%s", bxis(indent));
+                    bindx_write_c_argument_declaration(fp, d, argument);
+                    bxprintf(fp, "%s;\n", argument->name);
                }
                else
                if (argument->type.rank > 0 &&
                    argument->usage == LEX_SUBPROGRAM_ARGUMENT_USAGE_OUT) {
                     if (! flag) {
                          flag = 1;
-                         fprintf(fp, "%snpy_intp dims[%d];\n", bxis(indent), max_dims);
+                         bxprintf(fp, "%snpy_intp dims[%d];\n", bxis(indent), max_dims);
                     }
-                    fprintf(fp, "%sPyObject *%s_ndarray = NULL;\n", bxis(indent), argument->name);
-                    fprintf(fp, "%s", bxis(indent));
-                    bindx_write_c_declaration(fp, d, &argument->type, NULL);
-                    fprintf(fp, "%s;\n", argument->name);
+                    bxprintf(fp, "%sPyObject *%s_ndarray = NULL;\n", bxis(indent), argument->name);
+                    bxprintf(fp, "%s", bxis(indent));
+                    bindx_write_c_argument_declaration(fp, d, argument);
+                    bxprintf(fp, "%s;\n", argument->name);
                }
 
+               if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_STRIDED)
+                    bxprintf(fp, "%sptrdiff_t %s_strides[%d];\n", bxis(indent), argument->name, argument->type.rank);
+
                if (argument->usage != LEX_SUBPROGRAM_ARGUMENT_USAGE_IN)
                     continue;
 
@@ -372,182 +1767,522 @@ static int write_subprograms(FILE *fp, const bindx_data *d,
                strcat(temp, format);
           }
 
+          if (stats)
+               bindx_write_c_stats_time(fp, d, 0, i_stats, indent);
+
           if (sub_type != SUBPROGRAM_TYPE_FREE) {
-               fprintf(fp, "%sif (! PyArg_ParseTuple(args, \"%s\"", bxis(indent), temp);
+               bxprintf(fp, "%sif (! PyArg_ParseTuple(args, \"%s\"", bxis(indent), temp);
                list_for_each(subprogram->args, argument) {
                     if (argument->usage != LEX_SUBPROGRAM_ARGUMENT_USAGE_IN)
                          continue;
                     if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_LIST_SIZE)
                          continue;
 
-                    fprintf(fp, ", &%s", argument->name);
+                    bxprintf(fp, ", &%s", argument->name);
                     if (argument->type.rank == 0 && argument->type.type == LEX_BINDX_TYPE_ENUM)
-                         fprintf(fp, "_string");
+                         bxprintf(fp, "_string");
                     else
                     if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_ENUM_MASK ||
                         argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_ENUM_ARRAY)
-                         fprintf(fp, "_list");
+                         bxprintf(fp, "_list");
                     else
-                    if (argument->type.rank > 0)
-                         fprintf(fp, "_object");
+                    if (argument->type.rank > 0 || argument_is_structure(argument))
+                         bxprintf(fp, "_object");
 
                }
-               fprintf(fp, "))\n");
+               bxprintf(fp, "))\n");
                indent++;
-               fprintf(fp, "%sreturn %s;\n", bxis(indent), get_error_return_value(sub_type));
+               bxprintf(fp, "%sreturn %s;\n", bxis(indent), get_error_return_value(sub_type));
                indent--;
           }
 
+          n_dimens = 0;
           list_for_each(subprogram->args, argument) {
+               bindx_write_c_subprogram_dimens(fp, subprogram, argument, &n_dimens, bxis(indent));
+
+               if (argument_is_structure(argument)) {
+                    if (argument->usage == LEX_SUBPROGRAM_ARGUMENT_USAGE_IN)
+                         bxprintf(fp, "%s%s_ndarray = ndarray_from_structure(%s_object, %s_descr, \"%s\");\n",
+                                  bxis(indent), argument->name, argument->name, argument->type.name, argument->name);
+                    else {
+                         bxprintf(fp, "%sPy_INCREF((PyObject *) %s_descr);\n", bxis(indent), argument->type.name);
+                         bxprintf(fp, "%s%s_ndarray = PyArray_Zeros(0, NULL, %s_descr, 0);\n",
+                                  bxis(indent), argument->name, argument->type.name);
+                    }
+                    bxprintf(fp, "%sif (%s_ndarray == NULL)\n", bxis(indent), argument->name);
+                    indent++;
+                    bxprintf(fp, "%sreturn %s;\n", bxis(indent), get_error_return_value(sub_type));
+                    indent--;
+                    bxprintf(fp, "%s%s = (%s *) PyArray_DATA((PyArrayObject *) %s_ndarray);\n",
+                             bxis(indent), argument->name, argument->type.name, argument->name);
+               }
+               else
                if (argument->type.rank == 0 && argument->type.type == LEX_BINDX_TYPE_ENUM) {
-                    fprintf(fp, "%s%s = %s(%s_string);\n", bxis(indent), argument->name, argument->options.enum_name_to_value, argument->name);
-                    fprintf(fp, "%sif ((int) %s < 0) {\n", bxis(indent), argument->name);
+                    bxprintf(fp, "%s%s = %s(%s_string);\n", bxis(indent), argument->name, argument->options.enum_name_to_value, argument->name);
+                    bxprintf(fp, "%sif ((int) %s < 0) {\n", bxis(indent), argument->name);
                     indent++;
-                    fprintf(fp, "%sPyErr_SetString(%sError, \"ERROR: %s()\");\n", bxis(indent), d->PREFIX, argument->options.enum_name_to_value);
-                    fprintf(fp, "%sreturn %s;\n", bxis(indent), get_error_return_value(sub_type));
+                    bxprintf(fp, "%sPyErr_SetString(%sError, \"ERROR: %s()\");\n", bxis(indent), d->PREFIX, argument->options.enum_name_to_value);
+                    bxprintf(fp, "%sreturn %s;\n", bxis(indent), get_error_return_value(sub_type));
                     indent--;
-                    fprintf(fp, "%s}\n", bxis(indent));
+                    bxprintf(fp, "%s}\n", bxis(indent));
                }
                else
                if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_ENUM_MASK) {
-                    fprintf(fp, "%sif (list_to_mask(%s_list, &%s, (int (*)(const char *)) %s, \"%s\"))\n",
-                            bxis(indent), argument->name, argument->name, argument->options.enum_name_to_value, argument->options.enum_name_to_value);
+                    bxprintf(fp, "%sif (list_to_mask(%s_list, &%s, (int (*)(const char *)) %s, \"%s\"))\n",
+                             bxis(indent), argument->name, argument->name, argument->options.enum_name_to_value, argument->options.enum_name_to_value);
                     indent++;
-                    fprintf(fp, "%sreturn %s;\n", bxis(indent), get_error_return_value(sub_type));
+                    bxprintf(fp, "%sreturn %s;\n", bxis(indent), get_error_return_value(sub_type));
                     indent--;
                }
                else
                if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_ENUM_ARRAY) {
-                    fprintf(fp, "%sif (list_to_array(%s_list, &n_%s, (int **) &%s, (int (*)(const char *)) %s, \"%s\"))\n",
-                            bxis(indent), argument->name, argument->name, argument->name, argument->options.enum_name_to_value, argument->options.enum_name_to_value);
+                    bxprintf(fp, "%sif (list_to_array(%s_list, &n_%s, (int **) &%s, (int (*)(const char *)) %s, \"%s\"))\n",
+                             bxis(indent), argument->name, argument->name, argument->name, argument->options.enum_name_to_value, argument->options.enum_name_to_value);
                     indent++;
-                    fprintf(fp, "%sreturn %s;\n", bxis(indent), get_error_return_value(sub_type));
+                    bxprintf(fp, "%sreturn %s;\n", bxis(indent), get_error_return_value(sub_type));
                     indent--;
                }
                else
                if (argument->type.rank > 0 && argument->usage == LEX_SUBPROGRAM_ARGUMENT_USAGE_IN) {
-                    fprintf(fp, "%s%s_ndarray = PyArray_FROM_OTF(%s_object, %s, %s);\n",
-                            bxis(indent), argument->name, argument->name, type_to_numpy_typenum(&argument->type), usage_to_numpy_requirements(argument->usage));
-                    fprintf(fp, "%sif (%s_ndarray == NULL)\n", bxis(indent), argument->name);
+                    bxprintf(fp, "%s%s_ndarray = ndarray_from_object(%s_object, %s, %s);\n",
+                             bxis(indent), argument->name, argument->name, type_to_numpy_typenum(&argument->type), argument_to_numpy_requirements(argument));
+                    bxprintf(fp, "%sif (%s_ndarray == NULL)\n", bxis(indent), argument->name);
                     indent++;
-                    fprintf(fp, "%sreturn NULL;\n", bxis(indent));
+                    bxprintf(fp, "%sreturn NULL;\n", bxis(indent));
                     indent--;
-                    fprintf(fp, "%sif (check_pyarray_shape(%s_ndarray, \"%s\", %d", bxis(indent), argument->name, argument->name, argument->type.rank);
+                    bxprintf(fp, "%sif (check_pyarray_shape(%s_ndarray, \"%s\", %d", bxis(indent), argument->name, argument->name, argument->type.rank);
                     for (i = 0; i < argument->type.rank; ++i)
-                         fprintf(fp, ", %s", argument->type.dimens[i]);
-                    fprintf(fp, ") < 0)\n");
+                         bxprintf(fp, ", dimens[%d]", argument->i_dimens[i]);
+                    bxprintf(fp, ") < 0)\n");
                     indent++;
-                    fprintf(fp, "%sreturn NULL;\n", bxis(indent));
+                    bxprintf(fp, "%sreturn NULL;\n", bxis(indent));
                     indent--;
-                    fprintf(fp, "%s%s = (", bxis(indent), argument->name);
-                    bindx_write_c_declaration(fp, d, &argument->type, NULL);
-                    fprintf(fp, ") array_from_ndarray(%s_ndarray, %ld);\n", argument->name, bindx_c_type_size(&argument->type));
+                    write_array_from_ndarray(fp, d, argument, indent);
                }
                else
                if (argument->type.rank > 0 && argument->usage == LEX_SUBPROGRAM_ARGUMENT_USAGE_OUT) {
                     for (i = 0; i < argument->type.rank; ++i)
-                         fprintf(fp, "%sdims[%d] = %s;\n", bxis(indent), i, argument->type.dimens[i]);
-                    fprintf(fp, "%s%s_ndarray = PyArray_SimpleNew(%d, dims, %s);\n",
-                            bxis(indent), argument->name, argument->type.rank, type_to_numpy_typenum(&argument->type));
-                    fprintf(fp, "%sif (%s_ndarray == NULL)\n", bxis(indent), argument->name);
+                         bxprintf(fp, "%sdims[%d] = dimens[%d];\n", bxis(indent), i, argument->i_dimens[i]);
+                    if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_ALIGN)
+                         bxprintf(fp, "%s%s_ndarray = ndarray_new_aligned(%d, dims, %s, %ld, %d, %d);\n",
+                                  bxis(indent), argument->name, argument->type.rank, type_to_numpy_typenum(&argument->type),
+                                  bindx_c_type_size(&argument->type),
+                                  argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_COL_MAJOR ? 1 : 0,
+                                  argument->options.align);
+                    else
+                    if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_COL_MAJOR)
+                         bxprintf(fp, "%s%s_ndarray = PyArray_EMPTY(%d, dims, %s, 1);\n",
+                                  bxis(indent), argument->name, argument->type.rank, type_to_numpy_typenum(&argument->type));
+                    else
+                         bxprintf(fp, "%s%s_ndarray = PyArray_SimpleNew(%d, dims, %s);\n",
+                                  bxis(indent), argument->name, argument->type.rank, type_to_numpy_typenum(&argument->type));
+                    bxprintf(fp, "%sif (%s_ndarray == NULL)\n", bxis(indent), argument->name);
                     indent++;
-                    fprintf(fp, "%sreturn NULL;\n", bxis(indent));
+                    bxprintf(fp, "%sreturn NULL;\n", bxis(indent));
                     indent--;
-                    fprintf(fp, "%s%s = (", bxis(indent), argument->name);
-                    bindx_write_c_declaration(fp, d, &argument->type, NULL);
-                    fprintf(fp, ") array_from_ndarray(%s_ndarray, %ld);\n", argument->name, bindx_c_type_size(&argument->type));
+                    write_array_from_ndarray(fp, d, argument, indent);
                }
           }
 
-          fprintf(fp, "%sr = %s_%s(d", bxis(indent), d->prefix, subprogram->name);
+          flag = subprogram->options.flags & (SUBPROGRAM_ARGUMENT_OPTION_MASK_THREADSAFE |
+                                              SUBPROGRAM_ARGUMENT_OPTION_MASK_PURE);
+          locked = sub_type == SUBPROGRAM_TYPE_GENERAL && is_instance_locked(d, subprogram);
+          if (flag)
+               bxprintf(fp, "%sPy_BEGIN_ALLOW_THREADS\n", bxis(indent));
+          else
+          if (locked) {
+               bxprintf(fp, "%sPy_BEGIN_ALLOW_THREADS\n", bxis(indent));
+               write_instance_lock(fp, d, indent);
+          }
 
-          list_for_each(subprogram->args, argument) {
-               fprintf(fp, ", ");
-               if (argument->type.type == LEX_BINDX_TYPE_ENUM) {
-                    fprintf(fp, "(enum %s_%s", d->prefix, argument->type.name);
-                    if (argument->type.rank > 0)
-                         fprintf(fp, " ");
-                    bindx_write_c_dimens_args(fp, d, &argument->type, argument->usage);
-                    fprintf(fp, ") ");
-               }
+          if (stats)
+               bindx_write_c_stats_time(fp, d, 1, i_stats, indent);
 
-               if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_ENUM_MASK ||
-                   argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_ENUM_ARRAY)
-                    fprintf(fp,  "%s", argument->name);
-               else
-               if (argument->type.rank == 0  &&
-                   argument->usage == LEX_SUBPROGRAM_ARGUMENT_USAGE_IN)
-                    fprintf(fp,  "%s", argument->name);
-               else
-               if (argument->type.rank == 0  &&
-                   argument->usage == LEX_SUBPROGRAM_ARGUMENT_USAGE_OUT)
-                    fprintf(fp, "&%s", argument->name);
-               else
-                    fprintf(fp,  "%s", argument->name);
-          }
+          bxprintf(fp, "%sr = %s_%s(d", bxis(indent), d->prefix, subprogram->name);
+          write_call_args(fp, d, subprogram, 0);
+          bxprintf(fp, ");\n");
+
+          if (stats)
+               bindx_write_c_stats_time(fp, d, 2, i_stats, indent);
 
-          fprintf(fp, ");\n");
+          if (flag)
+               bxprintf(fp, "%sPy_END_ALLOW_THREADS\n", bxis(indent));
+          else
+          if (locked) {
+               write_instance_unlock(fp, d, indent);
+               bxprintf(fp, "%sPy_END_ALLOW_THREADS\n", bxis(indent));
+          }
 
-          fprintf(fp, "%sif (r == %s) {\n", bxis(indent), bindx_c_error_conditional(d, subprogram->type.type));
+          if (has_array_return_value(subprogram))
+               bxprintf(fp, "%sif (r == NULL) {\n", bxis(indent));
+          else
+               bxprintf(fp, "%sif (r == %s) {\n", bxis(indent), bindx_c_error_conditional(d, subprogram->type.type));
           indent++;
-          fprintf(fp, "%sPyErr_SetString(%sError, \"ERROR: %s_%s()\");\n", bxis(indent), d->PREFIX, d->prefix, subprogram->name);
-          fprintf(fp, "%sreturn %s;\n", bxis(indent), get_error_return_value(sub_type));
+          bxprintf(fp, "%sPyErr_SetString(%sError, \"ERROR: %s_%s()\");\n", bxis(indent), d->PREFIX, d->prefix, subprogram->name);
+          bxprintf(fp, "%sreturn %s;\n", bxis(indent), get_error_return_value(sub_type));
           indent--;
-          fprintf(fp, "%s}\n", bxis(indent));
+          bxprintf(fp, "%s}\n", bxis(indent));
 
           list_for_each(subprogram->args, argument) {
                if (argument->type.type == LEX_BINDX_TYPE_ENUM && argument->type.rank > 0)
-                    fprintf(fp, "%sfree(%s);\n", bxis(indent), argument->name);
+                    bxprintf(fp, "%sfree(%s);\n", bxis(indent), argument->name);
                else
-               if (argument->type.rank > 0 && argument->usage == LEX_SUBPROGRAM_ARGUMENT_USAGE_IN)
-                    fprintf(fp, "%sPy_DECREF(%s_ndarray);\n", bxis(indent), argument->name);
+               if ((argument->type.rank > 0 || argument_is_structure(argument)) &&
+                   argument->usage == LEX_SUBPROGRAM_ARGUMENT_USAGE_IN)
+                    bxprintf(fp, "%sPy_DECREF(%s_ndarray);\n", bxis(indent), argument->name);
 
-               if (argument->type.rank > 1)
-                    fprintf(fp, "%sfree_array(%s, %d);\n", bxis(indent), argument->name, argument->type.rank);
+               if (argument_is_pointer_array(argument))
+                    bxprintf(fp, "%sfree_array(%s, %d);\n", bxis(indent), argument->name, argument->type.rank);
           }
 
-          if (sub_type == SUBPROGRAM_TYPE_INIT)
-               fprintf(fp, "%sreturn 0;\n", bxis(indent));
+          if (sub_type == SUBPROGRAM_TYPE_INIT) {
+               if (has_instance_locks(d)) {
+                    if (d->free_threaded && ! d->limited_api)
+                         bxprintf(fp, "#if PY_VERSION_HEX < 0x030D0000\n");
+                    bxprintf(fp, "%sif (self->lock == NULL && (self->lock = PyThread_allocate_lock()) == NULL) {\n", bxis(indent));
+                    bxprintf(fp, "%sPyErr_NoMemory();\n", bxis(indent + 1));
+                    bxprintf(fp, "%sreturn -1;\n", bxis(indent + 1));
+                    bxprintf(fp, "%s}\n", bxis(indent));
+                    if (d->free_threaded && ! d->limited_api)
+                         bxprintf(fp, "#endif\n");
+               }
+               bxprintf(fp, "%sreturn 0;\n", bxis(indent));
+          }
           else
           if (sub_type == SUBPROGRAM_TYPE_FREE) {
-               fprintf(fp, "#if PY_MAJOR_VERSION < 3\n");
-               fprintf(fp, "%sself->ob_type->tp_free((PyObject *) self);\n", bxis(indent));
-               fprintf(fp, "#else\n");
-               fprintf(fp, "%s((PyObject*)(self))->ob_type->tp_free((PyObject *) self);\n", bxis(indent));
-               fprintf(fp, "#endif\n");
+               if (has_instance_locks(d)) {
+                    if (d->free_threaded && ! d->limited_api)
+                         bxprintf(fp, "#if PY_VERSION_HEX < 0x030D0000\n");
+                    bxprintf(fp, "%sif (self->lock != NULL)\n", bxis(indent));
+                    bxprintf(fp, "%sPyThread_free_lock(self->lock);\n", bxis(indent + 1));
+                    if (d->free_threaded && ! d->limited_api)
+                         bxprintf(fp, "#endif\n");
+               }
+               if (d->limited_api) {
+                    bxprintf(fp, "%stype = Py_TYPE((PyObject *) self);\n", bxis(indent));
+                    bxprintf(fp, "%s((freefunc) PyType_GetSlot(type, Py_tp_free))((PyObject *) self);\n", bxis(indent));
+                    bxprintf(fp, "%sPy_DECREF(type);\n", bxis(indent));
+               }
+               else {
+                    bxprintf(fp, "#if PY_MAJOR_VERSION < 3\n");
+                    bxprintf(fp, "%sself->ob_type->tp_free((PyObject *) self);\n", bxis(indent));
+                    bxprintf(fp, "#else\n");
+                    bxprintf(fp, "%s((PyObject*)(self))->ob_type->tp_free((PyObject *) self);\n", bxis(indent));
+                    bxprintf(fp, "#endif\n");
+               }
           }
           else {
-               if (subprogram->has_return_value)
-                    fprintf(fp, "%sreturn Py_BuildValue(\"%s\", r);\n", bxis(indent), type_to_py_format(&subprogram->type, 0, 0));
-               else {
-                    if (subprogram_n_out_args(subprogram) == 0)
-                         fprintf(fp, "%sreturn Py_BuildValue(\"i\",  0);\n", bxis(indent));
-                    else {
-                         fprintf(fp, "%sreturn Py_BuildValue(\"", bxis(indent));
-                         list_for_each(subprogram->args, argument) {
-                              if (argument->usage == LEX_SUBPROGRAM_ARGUMENT_USAGE_OUT)
-                                   fprintf(fp, "%s", type_to_py_format(&argument->type, 0, 0));
-                         }
-                         fprintf(fp, "\"");
-                         list_for_each(subprogram->args, argument) {
-                               if (argument->usage == LEX_SUBPROGRAM_ARGUMENT_USAGE_OUT) {
-                                    if (argument->type.rank == 0)
-                                         fprintf(fp, ", %s", argument->name);
-                                    else
-                                         fprintf(fp, ", %s_ndarray", argument->name);
-                               }
-                         }
-                         fprintf(fp, ");\n");
-                    }
+               write_return_value(fp, d, subprogram, ret, indent);
+
+               if (stats) {
+                    bindx_write_c_stats_time(fp, d, 3, i_stats++, indent);
+                    bxprintf(fp, "%sreturn stats_result;\n", bxis(indent));
                }
           }
 
           indent--;
 
-          fprintf(fp, "}\n");
+          bxprintf(fp, "}\n");
+
+          bxprintf(fp, "\n");
+          bxprintf(fp, "\n");
+     }
+
+     return 0;
+}
+
+
+
+/*
+ * For subprograms with the plan option <name>_prepare() converts and checks the
+ * bound arguments once and returns them in a capsule, and <name>_execute()
+ * takes the capsule and the remaining in scalars and goes straight to the C
+ * call.  Bound arrays are kept by reference so they must not need a copy.
+ */
+static int write_plan_procs(bindx_buffer_data *fp, const bindx_data *d)
+{
+     char temp[NM];
+
+     int i;
+
+     int flag;
+     int locked;
+     int n_dimens;
+
+     argument_data *argument;
+     subprogram_data *subprogram;
+
+     list_for_each(&d->subs_general, subprogram) {
+          if (! (subprogram->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_PLAN))
+               continue;
+
+          bxprintf(fp, "typedef struct {\n");
+          bxprintf(fp, "     PyObject *self;\n");
+          list_for_each(subprogram->args, argument) {
+               if (bindx_plan_argument_is_bound(subprogram, argument)) {
+                    if (argument->type.rank > 0)
+                         bxprintf(fp, "     PyObject *%s_ndarray;\n", argument->name);
+                    bxprintf(fp, "     ");
+                    bindx_write_c_argument_declaration(fp, d, argument);
+                    bxprintf(fp, "%s;\n", argument->name);
+               }
+               else
+               if (argument->type.rank > 0 &&
+                   argument->usage == LEX_SUBPROGRAM_ARGUMENT_USAGE_OUT)
+                    bxprintf(fp, "     npy_intp %s_dims[%d];\n", argument->name, argument->type.rank);
+          }
+          bxprintf(fp, "} %s_%s_plan;\n", d->prefix, subprogram->name);
+          bxprintf(fp, "\n");
+          bxprintf(fp, "\n");
+
+          bxprintf(fp, "static void %s_%s_plan_free(PyObject *capsule)\n", d->prefix, subprogram->name);
+          bxprintf(fp, "{\n");
+          bxprintf(fp, "     %s_%s_plan *plan;\n", d->prefix, subprogram->name);
+          bxprintf(fp, "     plan = (%s_%s_plan *) PyCapsule_GetPointer(capsule, \"%s.%s_plan\");\n",
+                   d->prefix, subprogram->name, d->prefix, subprogram->name);
+          list_for_each(subprogram->args, argument) {
+               if (! bindx_plan_argument_is_bound(subprogram, argument) || argument->type.rank == 0)
+                    continue;
+               if (argument_is_pointer_array(argument))
+                    bxprintf(fp, "     free_array(plan->%s, %d);\n", argument->name, argument->type.rank);
+               bxprintf(fp, "     Py_DECREF(plan->%s_ndarray);\n", argument->name);
+          }
+          bxprintf(fp, "     Py_DECREF(plan->self);\n");
+          bxprintf(fp, "     free(plan);\n");
+          bxprintf(fp, "}\n");
+          bxprintf(fp, "\n");
+          bxprintf(fp, "\n");
+
+
+          bxprintf(fp, "static PyObject *%s_%s_prepare_py(%s_data_py *self, PyObject *args)\n",
+                   d->prefix, subprogram->name, d->prefix);
+          bxprintf(fp, "{\n");
+          bxprintf(fp, "     %s_%s_plan *plan;\n", d->prefix, subprogram->name);
+          flag = 0;
+          list_for_each(subprogram->args, argument) {
+               for (i = 0; i < argument->type.rank; ++i) {
+                    if (strstr(argument->type.dimens[i], "d->"))
+                         flag = 1;
+               }
+          }
+          if (flag)
+               bxprintf(fp, "     %s_data *d = &self->%s;\n", d->prefix, d->prefix);
+          if (subprogram->n_dimens > 0)
+               bxprintf(fp, "     npy_intp dimens[%d];\n", subprogram->n_dimens);
+
+          temp[0] = '\0';
+          list_for_each(subprogram->args, argument) {
+               if (! bindx_plan_argument_is_bound(subprogram, argument))
+                    continue;
+
+               if (argument->type.rank > 0) {
+                    bxprintf(fp, "     PyObject *%s_object  = NULL;\n", argument->name);
+                    bxprintf(fp, "     PyObject *%s_ndarray = NULL;\n", argument->name);
+               }
+               bxprintf(fp, "     ");
+               bindx_write_c_argument_declaration(fp, d, argument);
+               bxprintf(fp, "%s;\n", argument->name);
+               if (argument->type.rank == 0 && argument->type.type == LEX_BINDX_TYPE_ENUM)
+                    bxprintf(fp, "     const char *%s_string = NULL;\n", argument->name);
+               else
+               if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_ENUM_MASK)
+                    bxprintf(fp, "     PyObject *%s_list;\n", argument->name);
+
+               strcat(temp, type_to_py_format(&argument->type,
+                                              argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_ENUM_MASK, 0));
+          }
+
+          bxprintf(fp, "     if (! PyArg_ParseTuple(args, \"%s\"", temp);
+          list_for_each(subprogram->args, argument) {
+               if (! bindx_plan_argument_is_bound(subprogram, argument))
+                    continue;
+               bxprintf(fp, ", &%s", argument->name);
+               if (argument->type.rank == 0 && argument->type.type == LEX_BINDX_TYPE_ENUM)
+                    bxprintf(fp, "_string");
+               else
+               if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_ENUM_MASK)
+                    bxprintf(fp, "_list");
+               else
+               if (argument->type.rank > 0)
+                    bxprintf(fp, "_object");
+          }
+          bxprintf(fp, "))\n");
+          bxprintf(fp, "          return NULL;\n");
+
+          n_dimens = 0;
+          list_for_each(subprogram->args, argument) {
+               if (! bindx_plan_argument_is_bound(subprogram, argument))
+                    continue;
+
+               bindx_write_c_subprogram_dimens(fp, subprogram, argument, &n_dimens, bxis(1));
+
+               if (argument->type.rank == 0 && argument->type.type == LEX_BINDX_TYPE_ENUM) {
+                    bxprintf(fp, "     %s = %s(%s_string);\n", argument->name, argument->options.enum_name_to_value, argument->name);
+                    bxprintf(fp, "     if ((int) %s < 0) {\n", argument->name);
+                    bxprintf(fp, "          PyErr_SetString(%sError, \"ERROR: %s()\");\n", d->PREFIX, argument->options.enum_name_to_value);
+                    bxprintf(fp, "          return NULL;\n");
+                    bxprintf(fp, "     }\n");
+               }
+               else
+               if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_ENUM_MASK) {
+                    bxprintf(fp, "     if (list_to_mask(%s_list, &%s, (int (*)(const char *)) %s, \"%s\"))\n",
+                             argument->name, argument->name, argument->options.enum_name_to_value, argument->options.enum_name_to_value);
+                    bxprintf(fp, "          return NULL;\n");
+               }
+               else
+               if (argument->type.rank > 0) {
+                    bxprintf(fp, "     %s_ndarray = ndarray_from_object(%s_object, %s, %s);\n",
+                             argument->name, argument->name, type_to_numpy_typenum(&argument->type), argument_to_numpy_requirements(argument));
+                    bxprintf(fp, "     if (%s_ndarray == NULL)\n", argument->name);
+                    bxprintf(fp, "          return NULL;\n");
+                    bxprintf(fp, "     if (check_pyarray_shape(%s_ndarray, \"%s\", %d", argument->name, argument->name, argument->type.rank);
+                    for (i = 0; i < argument->type.rank; ++i)
+                         bxprintf(fp, ", dimens[%d]", argument->i_dimens[i]);
+                    bxprintf(fp, ") < 0)\n");
+                    bxprintf(fp, "          return NULL;\n");
+                    if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_ALIGN) {
+                         bxprintf(fp, "     if (ndarray_align(&%s_ndarray, %d) < 0)\n", argument->name, argument->options.align);
+                         bxprintf(fp, "          return NULL;\n");
+                    }
+                    bxprintf(fp, "     if (%s_ndarray != %s_object) {\n", argument->name, argument->name);
+                    bxprintf(fp, "          Py_DECREF(%s_ndarray);\n", argument->name);
+                    bxprintf(fp, "          PyErr_SetString(%sError, \"argument %s to %s_prepare() must be an ndarray of the required type and layout\");\n",
+                             d->PREFIX, argument->name, subprogram->name);
+                    bxprintf(fp, "          return NULL;\n");
+                    bxprintf(fp, "     }\n");
+                    bxprintf(fp, "     %s = (", argument->name);
+                    bindx_write_c_argument_declaration(fp, d, argument);
+                    if (argument_is_flat_array(argument))
+                         bxprintf(fp, ") PyArray_DATA((PyArrayObject *) %s_ndarray);\n", argument->name);
+                    else
+                         bxprintf(fp, ") array_from_ndarray(%s_ndarray, %ld);\n", argument->name, bindx_c_type_size(&argument->type));
+               }
+          }
+
+          bxprintf(fp, "     if ((plan = (%s_%s_plan *) malloc(sizeof(%s_%s_plan))) == NULL)\n",
+                   d->prefix, subprogram->name, d->prefix, subprogram->name);
+          bxprintf(fp, "          return PyErr_NoMemory();\n");
+          bxprintf(fp, "     Py_INCREF((PyObject *) self);\n");
+          bxprintf(fp, "     plan->self = (PyObject *) self;\n");
+          list_for_each(subprogram->args, argument) {
+               if (bindx_plan_argument_is_bound(subprogram, argument)) {
+                    if (argument->type.rank > 0)
+                         bxprintf(fp, "     plan->%s_ndarray = %s_ndarray;\n", argument->name, argument->name);
+                    bxprintf(fp, "     plan->%s = %s;\n", argument->name, argument->name);
+               }
+               else
+               if (argument->type.rank > 0 &&
+                   argument->usage == LEX_SUBPROGRAM_ARGUMENT_USAGE_OUT) {
+                    bindx_write_c_subprogram_dimens(fp, subprogram, argument, &n_dimens, bxis(1));
+                    for (i = 0; i < argument->type.rank; ++i)
+                         bxprintf(fp, "     plan->%s_dims[%d] = dimens[%d];\n", argument->name, i, argument->i_dimens[i]);
+               }
+          }
+          bxprintf(fp, "     return PyCapsule_New(plan, \"%s.%s_plan\", %s_%s_plan_free);\n",
+                   d->prefix, subprogram->name, d->prefix, subprogram->name);
+          bxprintf(fp, "}\n");
+          bxprintf(fp, "\n");
+          bxprintf(fp, "\n");
+
+
+          bxprintf(fp, "static PyObject *%s_%s_execute_py(%s_data_py *self, PyObject *args)\n",
+                   d->prefix, subprogram->name, d->prefix);
+          bxprintf(fp, "{\n");
+          bxprintf(fp, "     ");
+          bindx_write_c_declaration(fp, d, &subprogram->type, NULL);
+          bxprintf(fp, "r;\n");
+          bxprintf(fp, "     %s_data *d = &self->%s;\n", d->prefix, d->prefix);
+          bxprintf(fp, "     PyObject *plan_capsule;\n");
+          bxprintf(fp, "     %s_%s_plan *plan;\n", d->prefix, subprogram->name);
+
+          strcpy(temp, "O");
+          list_for_each(subprogram->args, argument) {
+               if (bindx_plan_argument_is_bound(subprogram, argument))
+                    continue;
+
+               if (argument->type.rank > 0)
+                    bxprintf(fp, "     PyObject *%s_ndarray = NULL;\n", argument->name);
+               bxprintf(fp, "     ");
+               bindx_write_c_argument_declaration(fp, d, argument);
+               bxprintf(fp, "%s;\n", argument->name);
+
+               if (argument->usage == LEX_SUBPROGRAM_ARGUMENT_USAGE_IN)
+                    strcat(temp, type_to_py_format(&argument->type, 0, 0));
+          }
+
+          bxprintf(fp, "     if (! PyArg_ParseTuple(args, \"%s\", &plan_capsule", temp);
+          list_for_each(subprogram->args, argument) {
+               if (! bindx_plan_argument_is_bound(subprogram, argument) &&
+                   argument->usage == LEX_SUBPROGRAM_ARGUMENT_USAGE_IN)
+                    bxprintf(fp, ", &%s", argument->name);
+          }
+          bxprintf(fp, "))\n");
+          bxprintf(fp, "          return NULL;\n");
+          bxprintf(fp, "     plan = (%s_%s_plan *) PyCapsule_GetPointer(plan_capsule, \"%s.%s_plan\");\n",
+                   d->prefix, subprogram->name, d->prefix, subprogram->name);
+          bxprintf(fp, "     if (plan == NULL)\n");
+          bxprintf(fp, "          return NULL;\n");
+          bxprintf(fp, "     if (plan->self != (PyObject *) self) {\n");
+          bxprintf(fp, "          PyErr_SetString(%sError, \"plan passed to %s_execute() was prepared for another instance\");\n",
+                   d->PREFIX, subprogram->name);
+          bxprintf(fp, "          return NULL;\n");
+          bxprintf(fp, "     }\n");
+
+          list_for_each(subprogram->args, argument) {
+               if (argument->type.rank == 0 ||
+                   argument->usage != LEX_SUBPROGRAM_ARGUMENT_USAGE_OUT)
+                    continue;
+               if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_ALIGN)
+                    bxprintf(fp, "     %s_ndarray = ndarray_new_aligned(%d, plan->%s_dims, %s, %ld, %d, %d);\n",
+                             argument->name, argument->type.rank, argument->name, type_to_numpy_typenum(&argument->type),
+                             bindx_c_type_size(&argument->type),
+                             argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_COL_MAJOR ? 1 : 0,
+                             argument->options.align);
+               else
+               if (argument->options.flags & SUBPROGRAM_ARGUMENT_OPTION_MASK_COL_MAJOR)
+                    bxprintf(fp, "     %s_ndarray = PyArray_EMPTY(%d, plan->%s_dims, %s, 1);\n",
+                             argument->name, argument->type.rank, argument->name, type_to_numpy_typenum(&argument->type));
+               else
+                    bxprintf(fp, "     %s_ndarray = PyArray_SimpleNew(%d, plan->%s_dims, %s);\n",
+                             argument->name, argument->type.rank, argument->name, type_to_numpy_typenum(&argument->type));
+               bxprintf(fp, "     if (%s_ndarray == NULL)\n", argument->name);
+               bxprintf(fp, "          return NULL;\n");
+               write_array_from_ndarray(fp, d, argument, 1);
+          }
+
+          flag = subprogram->options.flags & (SUBPROGRAM_ARGUMENT_OPTION_MASK_THREADSAFE |
+                                              SUBPROGRAM_ARGUMENT_OPTION_MASK_PURE);
+          locked = is_instance_locked(d, subprogram);
+          if (flag || locked)
+               bxprintf(fp, "     Py_BEGIN_ALLOW_THREADS\n");
+          if (! flag && locked)
+               write_instance_lock(fp, d, 1);
+
+          bxprintf(fp, "     r = %s_%s(d", d->prefix, subprogram->name);
+          write_call_args(fp, d, subprogram, 1);
+          bxprintf(fp, ");\n");
+
+          if (! flag && locked)
+               write_instance_unlock(fp, d, 1);
+          if (flag || locked)
+               bxprintf(fp, "     Py_END_ALLOW_THREADS\n");
+
+          bxprintf(fp, "     if (r == %s) {\n", bindx_c_error_conditional(d, subprogram->type.type));
+          bxprintf(fp, "          PyErr_SetString(%sError, \"ERROR: %s_%s()\");\n", d->PREFIX, d->prefix, subprogram->name);
+          bxprintf(fp, "          return NULL;\n");
+          bxprintf(fp, "     }\n");
+
+          list_for_each(subprogram->args, argument) {
+               if (! bindx_plan_argument_is_bound(subprogram, argument) &&
+                   argument_is_pointer_array(argument))
+                    bxprintf(fp, "     free_array(%s, %d);\n", argument->name, argument->type.rank);
+          }
 
-          fprintf(fp, "\n");
-          fprintf(fp, "\n");
+          write_return_value(fp, d, subprogram, "return ", 1);
+
+          bxprintf(fp, "}\n");
+          bxprintf(fp, "\n");
+          bxprintf(fp, "\n");
      }
 
      return 0;
@@ -555,182 +2290,441 @@ static int write_subprograms(FILE *fp, const bindx_data *d,
 
 
 
-int bindx_write_py(FILE **fp, const bindx_data *d, const char *name)
+static void write_type_object(bindx_buffer_data *fp, const bindx_data *d)
+{
+     bxprintf(fp, "static PyTypeObject %s_type = {\n", d->prefix);
+     bxprintf(fp, "#if PY_MAJOR_VERSION < 3\n");
+     bxprintf(fp, "     PyObject_HEAD_INIT(NULL)\n");
+     bxprintf(fp, "     0,\n");						/* ob_size */
+     bxprintf(fp, "#else\n");
+     bxprintf(fp, "     PyVarObject_HEAD_INIT(NULL, 0)\n");
+     bxprintf(fp, "#endif\n");
+     bxprintf(fp, "     \"%s.%s\",\n", d->prefix, d->prefix);			/* tp_name */
+     bxprintf(fp, "     sizeof(%s_data_py),\n", d->prefix);			/* tp_basicsize */
+     bxprintf(fp, "     0,\n");						/* tp_itemsize */
+     bxprintf(fp, "     (destructor) %s_dealloc,\n", d->prefix);		/* tp_dealloc */
+     bxprintf(fp, "     0,\n");						/* tp_print */
+     bxprintf(fp, "     0,\n");						/* tp_getattr */
+     bxprintf(fp, "     0,\n");						/* tp_setattr */
+     bxprintf(fp, "     0,\n");						/* tp_compare */
+     bxprintf(fp, "     0,\n");						/* tp_repr */
+     bxprintf(fp, "     0,\n");						/* tp_as_number */
+     bxprintf(fp, "     0,\n");						/* tp_as_sequence */
+     bxprintf(fp, "     0,\n");						/* tp_as_mapping */
+     bxprintf(fp, "     0,\n");						/* tp_hash */
+     bxprintf(fp, "     0,\n");						/* tp_call */
+     bxprintf(fp, "     0,\n");						/* tp_str */
+     bxprintf(fp, "     0,\n");						/* tp_getattro */
+     bxprintf(fp, "     0,\n");						/* tp_setattro */
+     if (bindx_buffer_subprogram(d)) {
+          bxprintf(fp, "#if PY_MAJOR_VERSION >= 3\n");
+          bxprintf(fp, "     &%s_as_buffer,\n", d->prefix);			/* tp_as_buffer */
+          bxprintf(fp, "#else\n");
+          bxprintf(fp, "     0,\n");
+          bxprintf(fp, "#endif\n");
+     }
+     else
+          bxprintf(fp, "     0,\n");						/* tp_as_buffer */
+     bxprintf(fp, "     Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,\n");	/* tp_flags */
+     bxprintf(fp, "     \"%s object\",\n", d->PREFIX);			/* tp_doc */
+     bxprintf(fp, "     0,\n");						/* tp_traverse */
+     bxprintf(fp, "     0,\n");						/* tp_clear */
+     bxprintf(fp, "     0,\n");						/* tp_richcompare */
+     bxprintf(fp, "     0,\n");						/* tp_weaklistoffset */
+     bxprintf(fp, "     0,\n");						/* tp_iter */
+     bxprintf(fp, "     0,\n");						/* tp_iternext */
+     bxprintf(fp, "     %s_methods,\n", d->prefix);				/* tp_methods */
+     bxprintf(fp, "     %s_members,\n", d->prefix);				/* tp_members */
+     bxprintf(fp, "     0,\n");						/* tp_getset */
+     bxprintf(fp, "     0,\n");						/* tp_base */
+     bxprintf(fp, "     0,\n");						/* tp_dict */
+     bxprintf(fp, "     0,\n");						/* tp_descr_get */
+     bxprintf(fp, "     0,\n");						/* tp_descr_set */
+     bxprintf(fp, "     0,\n");						/* tp_dictoffset */
+     bxprintf(fp, "     (initproc) %s_init,\n", d->prefix);			/* tp_init */
+     bxprintf(fp, "     0,\n");						/* tp_alloc */
+     bxprintf(fp, "     (newfunc) %s_new\n", d->prefix);			/* tp_new */
+     bxprintf(fp, "};\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+}
+
+
+
+static void write_type_spec(bindx_buffer_data *fp, const bindx_data *d)
+{
+     bxprintf(fp, "static PyType_Slot %s_type_slots[] = {\n", d->prefix);
+     bxprintf(fp, "     {Py_tp_dealloc, (void *) %s_dealloc},\n", d->prefix);
+     bxprintf(fp, "     {Py_tp_doc,     \"%s object\"},\n", d->PREFIX);
+     bxprintf(fp, "     {Py_tp_methods, %s_methods},\n", d->prefix);
+     bxprintf(fp, "     {Py_tp_members, %s_members},\n", d->prefix);
+     bxprintf(fp, "     {Py_tp_init,    (void *) %s_init},\n", d->prefix);
+     bxprintf(fp, "     {Py_tp_new,     (void *) %s_new},\n", d->prefix);
+     if (bindx_buffer_subprogram(d)) {
+          bxprintf(fp, "     {Py_bf_getbuffer,     (void *) %s_getbuffer},\n", d->prefix);
+          bxprintf(fp, "     {Py_bf_releasebuffer, (void *) %s_releasebuffer},\n", d->prefix);
+     }
+     bxprintf(fp, "     {0, NULL}\n");
+     bxprintf(fp, "};\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+     bxprintf(fp, "static PyType_Spec %s_type_spec = {\n", d->prefix);
+     bxprintf(fp, "     \"%s.%s\",\n", d->prefix, d->prefix);
+     bxprintf(fp, "     sizeof(%s_data_py),\n", d->prefix);
+     bxprintf(fp, "     0,\n");
+     bxprintf(fp, "     Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,\n");
+     bxprintf(fp, "     %s_type_slots\n", d->prefix);
+     bxprintf(fp, "};\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+}
+
+
+
+static void write_module_add_type_spec(bindx_buffer_data *fp, const bindx_data *d, const char *error)
+{
+     bxprintf(fp, "     type = PyType_FromSpec(&%s_type_spec);\n", d->prefix);
+     bxprintf(fp, "     if (type == NULL)\n");
+     bxprintf(fp, "          return %s;\n", error);
+     bxprintf(fp, "     if (PyModule_AddObject(module, \"%s\", type) < 0) {\n", d->prefix);
+     bxprintf(fp, "          Py_DECREF(type);\n");
+     bxprintf(fp, "          return %s;\n", error);
+     bxprintf(fp, "     }\n");
+}
+
+
+
+/*
+ * Multi-phase init for -free_threaded.  The exception object is owned by the
+ * module state while %sError keeps a borrowed copy for the utilities, which are
+ * not passed the module.
+ */
+static void write_module_init_multi_phase(bindx_buffer_data *fp, const bindx_data *d)
+{
+     bxprintf(fp, "static int module_exec(PyObject *module)\n");
+     bxprintf(fp, "{\n");
+     bxprintf(fp, "     %s_module_state *state;\n", d->prefix);
+     if (d->limited_api)
+          bxprintf(fp, "     PyObject *type;\n");
+     bxprintf(fp, "     state = (%s_module_state *) PyModule_GetState(module);\n", d->prefix);
+     if (d->limited_api)
+          write_module_add_type_spec(fp, d, "-1");
+     else {
+          bxprintf(fp, "     if (PyType_Ready(&%s_type) < 0)\n", d->prefix);
+          bxprintf(fp, "          return -1;\n");
+          bxprintf(fp, "     Py_INCREF(&%s_type);\n", d->prefix);
+          bxprintf(fp, "     if (PyModule_AddObject(module, \"%s\", (PyObject *) &%s_type) < 0) {\n", d->prefix, d->prefix);
+          bxprintf(fp, "          Py_DECREF(&%s_type);\n", d->prefix);
+          bxprintf(fp, "          return -1;\n");
+          bxprintf(fp, "     }\n");
+     }
+     bxprintf(fp, "     state->error = PyErr_NewException(\"%s.error\", NULL, NULL);\n", d->prefix);
+     bxprintf(fp, "     if (state->error == NULL)\n");
+     bxprintf(fp, "          return -1;\n");
+     bxprintf(fp, "     %sError = state->error;\n", d->PREFIX);
+     bxprintf(fp, "     Py_INCREF(state->error);\n");
+     bxprintf(fp, "     if (PyModule_AddObject(module, \"error\", state->error) < 0) {\n");
+     bxprintf(fp, "          Py_DECREF(state->error);\n");
+     bxprintf(fp, "          return -1;\n");
+     bxprintf(fp, "     }\n");
+     bxprintf(fp, "     import_array1(-1);\n");
+     if (! list_is_empty(&d->structs)) {
+          bxprintf(fp, "     if (structure_descrs_init(module) < 0)\n");
+          bxprintf(fp, "          return -1;\n");
+     }
+     bxprintf(fp, "     return 0;\n");
+     bxprintf(fp, "}\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+     bxprintf(fp, "static int module_traverse(PyObject *module, visitproc visit, void *arg)\n");
+     bxprintf(fp, "{\n");
+     bxprintf(fp, "     Py_VISIT(((%s_module_state *) PyModule_GetState(module))->error);\n", d->prefix);
+     bxprintf(fp, "     return 0;\n");
+     bxprintf(fp, "}\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+     bxprintf(fp, "static int module_clear(PyObject *module)\n");
+     bxprintf(fp, "{\n");
+     bxprintf(fp, "     Py_CLEAR(((%s_module_state *) PyModule_GetState(module))->error);\n", d->prefix);
+     bxprintf(fp, "     return 0;\n");
+     bxprintf(fp, "}\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+     bxprintf(fp, "static void module_free(void *module)\n");
+     bxprintf(fp, "{\n");
+     bxprintf(fp, "     module_clear((PyObject *) module);\n");
+     bxprintf(fp, "}\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+     bxprintf(fp, "static PyModuleDef_Slot module_slots[] = {\n");
+     bxprintf(fp, "     {Py_mod_exec, (void *) module_exec},\n");
+     bxprintf(fp, "#ifdef Py_mod_multiple_interpreters\n");
+     bxprintf(fp, "     {Py_mod_multiple_interpreters, Py_MOD_MULTIPLE_INTERPRETERS_NOT_SUPPORTED},\n");
+     bxprintf(fp, "#endif\n");
+     bxprintf(fp, "#ifdef Py_mod_gil\n");
+     bxprintf(fp, "     {Py_mod_gil, Py_MOD_GIL_NOT_USED},\n");
+     bxprintf(fp, "#endif\n");
+     bxprintf(fp, "     {0, NULL}\n");
+     bxprintf(fp, "};\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+     bxprintf(fp, "static struct PyModuleDef module_def = {\n");
+     bxprintf(fp, "     PyModuleDef_HEAD_INIT,\n");
+     bxprintf(fp, "     \"%s\",\n", d->prefix);
+     bxprintf(fp, "     \"Module for accessing %s\",\n", d->PREFIX);
+     bxprintf(fp, "     sizeof(%s_module_state),\n", d->prefix);
+     bxprintf(fp, "     module_methods,\n");
+     bxprintf(fp, "     module_slots,\n");
+     bxprintf(fp, "     module_traverse,\n");
+     bxprintf(fp, "     module_clear,\n");
+     bxprintf(fp, "     module_free\n");
+     bxprintf(fp, "};\n");
+     bxprintf(fp, "\n");
+     bxprintf(fp, "\n");
+
+     bxprintf(fp, "PyMODINIT_FUNC PyInit_%s(void)\n", d->prefix);
+     bxprintf(fp, "{\n");
+     bxprintf(fp, "     return PyModuleDef_Init(&module_def);\n");
+     bxprintf(fp, "}\n");
+}
+
+
+
+static void write_module_init(bindx_buffer_data *fp, const bindx_data *d)
+{
+     if (! d->free_threaded) {
+          bxprintf(fp, "#if PY_MAJOR_VERSION >= 3\n");
+          bxprintf(fp, "    static struct PyModuleDef module_def = {\n");
+          bxprintf(fp, "        PyModuleDef_HEAD_INIT,\n");
+          bxprintf(fp, "        \"%s\",\n", d->prefix);
+          bxprintf(fp, "        \"Module for accessing %s\",\n", d->PREFIX);
+          bxprintf(fp, "        -1,\n");
+          bxprintf(fp, "        module_methods,\n");
+          bxprintf(fp, "        NULL,\n");
+          bxprintf(fp, "        NULL,\n");
+          bxprintf(fp, "        NULL,\n");
+          bxprintf(fp, "        NULL\n");
+          bxprintf(fp, "    };\n");
+          bxprintf(fp, "#endif\n");
+          bxprintf(fp, "\n");
+          bxprintf(fp, "\n");
+     }
+
+     bxprintf(fp, "#if PY_MAJOR_VERSION < 3\n");
+     if (d->limited_api)
+          bxprintf(fp, "#error \"Py_LIMITED_API requires Python 3\"\n");
+     else {
+          bxprintf(fp, "PyMODINIT_FUNC init%s(void)\n", d->prefix);
+          bxprintf(fp, "{\n");
+          bxprintf(fp, "     PyObject *module;\n");
+          bxprintf(fp, "     if (PyType_Ready(&%s_type) < 0)\n", d->prefix);
+          bxprintf(fp, "          return;\n");
+          bxprintf(fp, "     module = Py_InitModule3(\"%s\", module_methods, \"Module for accessing %s\");\n", d->prefix, d->PREFIX);
+          bxprintf(fp, "     if (module == NULL)\n");
+          bxprintf(fp, "          return;\n");
+          bxprintf(fp, "     Py_INCREF(&%s_type);\n", d->prefix);
+          bxprintf(fp, "     PyModule_AddObject(module, \"%s\", (PyObject *) &%s_type);\n", d->prefix, d->prefix);
+          bxprintf(fp, "     %sError = PyErr_NewException(\"%s.error\", NULL, NULL);\n", d->PREFIX, d->prefix);
+          bxprintf(fp, "     Py_INCREF(%sError);\n", d->PREFIX);
+          bxprintf(fp, "     PyModule_AddObject(module, \"error\", %sError);\n", d->PREFIX);
+          bxprintf(fp, "     import_array();\n");
+          if (! list_is_empty(&d->structs)) {
+               bxprintf(fp, "     if (structure_descrs_init(module) < 0)\n");
+               bxprintf(fp, "          return;\n");
+          }
+          bxprintf(fp, "}\n");
+     }
+     bxprintf(fp, "#else\n");
+     if (d->free_threaded)
+          write_module_init_multi_phase(fp, d);
+     else {
+          bxprintf(fp, "PyMODINIT_FUNC PyInit_%s(void)\n", d->prefix);
+          bxprintf(fp, "{\n");
+          bxprintf(fp, "     PyObject *module;\n");
+          if (d->limited_api)
+               bxprintf(fp, "     PyObject *type;\n");
+          else {
+               bxprintf(fp, "     if (PyType_Ready(&%s_type) < 0)\n", d->prefix);
+               bxprintf(fp, "          return NULL;\n");
+          }
+          bxprintf(fp, "     module = PyModule_Create(&module_def);\n");
+          bxprintf(fp, "     if (module == NULL)\n");
+          bxprintf(fp, "          return NULL;\n");
+          if (d->limited_api)
+               write_module_add_type_spec(fp, d, "NULL");
+          else {
+               bxprintf(fp, "     Py_INCREF(&%s_type);\n", d->prefix);
+               bxprintf(fp, "     PyModule_AddObject(module, \"%s\", (PyObject *) &%s_type);\n", d->prefix, d->prefix);
+          }
+          bxprintf(fp, "     %sError = PyErr_NewException(\"%s.error\", NULL, NULL);\n", d->PREFIX, d->prefix);
+          bxprintf(fp, "     Py_INCREF(%sError);\n", d->PREFIX);
+          bxprintf(fp, "     PyModule_AddObject(module, \"error\", %sError);\n", d->PREFIX);
+          bxprintf(fp, "     import_array();\n");
+          if (! list_is_empty(&d->structs)) {
+               bxprintf(fp, "     if (structure_descrs_init(module) < 0)\n");
+               bxprintf(fp, "          return NULL;\n");
+          }
+          bxprintf(fp, "     return module;\n");
+          bxprintf(fp, "}\n");
+     }
+     bxprintf(fp, "#endif\n");
+}
+
+
+
+int bindx_write_py(bindx_buffer_data **fp, const bindx_data *d, const char *name)
 {
      bindx_write_c_header_top(fp[0]);
-     fprintf(fp[0], "\n");
+     bxprintf(fp[0], "\n");
 
-     fprintf(fp[0], "#include <Python.h>\n");
-     fprintf(fp[0], "#include <structmember.h>\n");
-     fprintf(fp[0], "#ifndef Py_USING_UNICODE\n");
-     fprintf(fp[0], "#define Py_USING_UNICODE\n");
-     fprintf(fp[0], "#endif\n");
+     if (d->limited_api) {
+          bxprintf(fp[0], "#ifndef Py_LIMITED_API\n");
+          bxprintf(fp[0], "#define Py_LIMITED_API 0x%08X\n", bindx_buffer_subprogram(d) ? 0x030B0000 : 0x030A0000);
+          bxprintf(fp[0], "#endif\n");
+     }
+     bxprintf(fp[0], "#include <Python.h>\n");
+     bxprintf(fp[0], "#include <structmember.h>\n");
+     bxprintf(fp[0], "#ifndef Py_USING_UNICODE\n");
+     bxprintf(fp[0], "#define Py_USING_UNICODE\n");
+     bxprintf(fp[0], "#endif\n");
 /*
-     fprintf(fp[0], "#if NPY_FEATURE_VERSION < 0x00000007\n");
-     fprintf(fp[0], "#define NPY_ARRAY_IN_ARRAY NPY_IN_ARRAY\n");
-     fprintf(fp[0], "#define NPY_ARRAY_OUT_ARRAY NPY_OUT_ARRAY\n");
-     fprintf(fp[0], "#define NPY_ARRAY_INOUT_ARRAY NPY_INOUT_ARRAY\n");
-     fprintf(fp[0], "#else\n");
-     fprintf(fp[0], "#define NPY_NO_DEPRECATED_API NPY_1_7_API_VERSION\n");
-     fprintf(fp[0], "#endif\n");
+     bxprintf(fp[0], "#if NPY_FEATURE_VERSION < 0x00000007\n");
+     bxprintf(fp[0], "#define NPY_ARRAY_IN_ARRAY NPY_IN_ARRAY\n");
+     bxprintf(fp[0], "#define NPY_ARRAY_OUT_ARRAY NPY_OUT_ARRAY\n");
+     bxprintf(fp[0], "#define NPY_ARRAY_INOUT_ARRAY NPY_INOUT_ARRAY\n");
+     bxprintf(fp[0], "#else\n");
+     bxprintf(fp[0], "#define NPY_NO_DEPRECATED_API NPY_1_7_API_VERSION\n");
+     bxprintf(fp[0], "#endif\n");
 */
-     fprintf(fp[0], "#include <numpy/arrayobject.h>\n");
-     fprintf(fp[0], "\n");
-
-     fprintf(fp[0], "#include <gutil.h>\n");
-     fprintf(fp[0], "\n");
-
-     fprintf(fp[0], "#include <%s_interface.h>\n", d->prefix);
-     fprintf(fp[0], "\n");
-     fprintf(fp[0], "\n");
-
-     fprintf(fp[0], "typedef struct {\n");
-     fprintf(fp[0], "     PyObject_HEAD\n");
-     fprintf(fp[0], "     %s_data %s;\n", d->prefix, d->prefix);
-     fprintf(fp[0], "} %s_data_py;\n", d->prefix);
-     fprintf(fp[0], "\n");
-     fprintf(fp[0], "\n");
-
-     fprintf(fp[0], "static PyObject *%sError;\n", d->PREFIX);
-     fprintf(fp[0], "\n");
-     fprintf(fp[0], "\n");
-
-     fprintf(fp[0], "static PyObject *%s_new(PyTypeObject *type, PyObject *args, PyObject *kwds)\n", d->prefix);
-     fprintf(fp[0], "{\n");
-     fprintf(fp[0], "     %s_data_py *self;\n", d->prefix);
-     fprintf(fp[0], "     self = (%s_data_py *) type->tp_alloc(type, 0);\n", d->prefix);
-     fprintf(fp[0], "     if (self != NULL) { }\n");
-     fprintf(fp[0], "     return (PyObject *) self;\n");
-     fprintf(fp[0], "}\n");
-     fprintf(fp[0], "\n");
-     fprintf(fp[0], "\n");
+     bxprintf(fp[0], "#include <numpy/arrayobject.h>\n");
+     bxprintf(fp[0], "\n");
+
+     if (has_async(d)) {
+          bxprintf(fp[0], "#include <pthread.h>\n");
+          bxprintf(fp[0], "\n");
+     }
+
+     bxprintf(fp[0], "#include <gutil.h>\n");
+     bxprintf(fp[0], "\n");
+
+     bxprintf(fp[0], "#include <%s_interface.h>\n", d->prefix);
+     bxprintf(fp[0], "\n");
+     bxprintf(fp[0], "\n");
+
+     bxprintf(fp[0], "typedef struct {\n");
+     bxprintf(fp[0], "     PyObject_HEAD\n");
+     bxprintf(fp[0], "     %s_data %s;\n", d->prefix, d->prefix);
+     if (d->free_threaded && ! d->limited_api) {
+          bxprintf(fp[0], "#if PY_VERSION_HEX >= 0x030D0000\n");
+          bxprintf(fp[0], "     PyMutex mutex;\n");
+          bxprintf(fp[0], "#else\n");
+          bxprintf(fp[0], "     PyThread_type_lock lock;\n");
+          bxprintf(fp[0], "#endif\n");
+     }
+     else
+     if (has_instance_locks(d))
+          bxprintf(fp[0], "     PyThread_type_lock lock;\n");
+     bxprintf(fp[0], "} %s_data_py;\n", d->prefix);
+     bxprintf(fp[0], "\n");
+     bxprintf(fp[0], "\n");
+
+     if (d->free_threaded) {
+          if (! d->limited_api) {
+               bxprintf(fp[0], "#if PY_VERSION_HEX >= 0x030D0000\n");
+               bxprintf(fp[0], "#define INSTANCE_LOCK(self)   PyMutex_Lock(&(self)->mutex)\n");
+               bxprintf(fp[0], "#define INSTANCE_UNLOCK(self) PyMutex_Unlock(&(self)->mutex)\n");
+               bxprintf(fp[0], "#else\n");
+          }
+          bxprintf(fp[0], "#define INSTANCE_LOCK(self)   PyThread_acquire_lock((self)->lock, WAIT_LOCK)\n");
+          bxprintf(fp[0], "#define INSTANCE_UNLOCK(self) PyThread_release_lock((self)->lock)\n");
+          if (! d->limited_api)
+               bxprintf(fp[0], "#endif\n");
+          bxprintf(fp[0], "\n");
+          bxprintf(fp[0], "\n");
+
+          bxprintf(fp[0], "typedef struct {\n");
+          bxprintf(fp[0], "     PyObject *error;\n");
+          bxprintf(fp[0], "} %s_module_state;\n", d->prefix);
+          bxprintf(fp[0], "\n");
+          bxprintf(fp[0], "\n");
+     }
+
+     bxprintf(fp[0], "static PyObject *%sError;\n", d->PREFIX);
+     bxprintf(fp[0], "\n");
+     bxprintf(fp[0], "\n");
+
+     bxprintf(fp[0], "static PyObject *%s_new(PyTypeObject *type, PyObject *args, PyObject *kwds)\n", d->prefix);
+     bxprintf(fp[0], "{\n");
+     bxprintf(fp[0], "     %s_data_py *self;\n", d->prefix);
+     if (d->limited_api)
+          bxprintf(fp[0], "     self = (%s_data_py *) ((allocfunc) PyType_GetSlot(type, Py_tp_alloc))(type, 0);\n", d->prefix);
+     else
+          bxprintf(fp[0], "     self = (%s_data_py *) type->tp_alloc(type, 0);\n", d->prefix);
+     bxprintf(fp[0], "     if (self != NULL) { }\n");
+     bxprintf(fp[0], "     return (PyObject *) self;\n");
+     bxprintf(fp[0], "}\n");
+     bxprintf(fp[0], "\n");
+     bxprintf(fp[0], "\n");
 
      write_utilities(fp[0], d);
+     write_structure_utilities(fp[0], d);
+     if (d->stats)
+          write_stats(fp[0], d);
 
      write_subprograms(fp[0], d, SUBPROGRAM_TYPE_INIT,    &d->subs_init,    name);
      write_subprograms(fp[0], d, SUBPROGRAM_TYPE_FREE,    &d->subs_free,    name);
      write_subprograms(fp[0], d, SUBPROGRAM_TYPE_GENERAL, &d->subs_general, name);
 
+     write_buffer_procs(fp[0], d);
+
+     write_state_procs(fp[0], d);
+
+     write_clone_proc(fp[0], d);
+
+     write_plan_procs(fp[0], d);
+
+     write_async(fp[0], d);
+
      write_methods(fp[0], d, &d->subs_general,  name);
-     fprintf(fp[0], "\n");
-     fprintf(fp[0], "\n");
-
-     fprintf(fp[0], "static PyMemberDef %s_members[] = {\n", d->prefix);
-     fprintf(fp[0], "     {NULL}\n");
-     fprintf(fp[0], "};\n");
-     fprintf(fp[0], "\n");
-     fprintf(fp[0], "\n");
-
-     fprintf(fp[0], "static PyTypeObject %s_type = {\n", d->prefix);
-     fprintf(fp[0], "#if PY_MAJOR_VERSION < 3\n");
-     fprintf(fp[0], "     PyObject_HEAD_INIT(NULL)\n");
-     fprintf(fp[0], "     0,\n");						/* ob_size */
-     fprintf(fp[0], "#else\n");
-     fprintf(fp[0], "     PyVarObject_HEAD_INIT(NULL, 0)\n");
-     fprintf(fp[0], "#endif\n");
-     fprintf(fp[0], "     \"%s.%s\",\n", d->prefix, d->prefix);			/* tp_name */
-     fprintf(fp[0], "     sizeof(%s_data_py),\n", d->prefix);			/* tp_basicsize */
-     fprintf(fp[0], "     0,\n");						/* tp_itemsize */
-     fprintf(fp[0], "     (destructor) %s_dealloc,\n", d->prefix);		/* tp_dealloc */
-     fprintf(fp[0], "     0,\n");						/* tp_print */
-     fprintf(fp[0], "     0,\n");						/* tp_getattr */
-     fprintf(fp[0], "     0,\n");						/* tp_setattr */
-     fprintf(fp[0], "     0,\n");						/* tp_compare */
-     fprintf(fp[0], "     0,\n");						/* tp_repr */
-     fprintf(fp[0], "     0,\n");						/* tp_as_number */
-     fprintf(fp[0], "     0,\n");						/* tp_as_sequence */
-     fprintf(fp[0], "     0,\n");						/* tp_as_mapping */
-     fprintf(fp[0], "     0,\n");						/* tp_hash */
-     fprintf(fp[0], "     0,\n");						/* tp_call */
-     fprintf(fp[0], "     0,\n");						/* tp_str */
-     fprintf(fp[0], "     0,\n");						/* tp_getattro */
-     fprintf(fp[0], "     0,\n");						/* tp_setattro */
-     fprintf(fp[0], "     0,\n");						/* tp_as_buffer */
-     fprintf(fp[0], "     Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,\n");	/* tp_flags */
-     fprintf(fp[0], "     \"%s object\",\n", d->PREFIX);			/* tp_doc */
-     fprintf(fp[0], "     0,\n");						/* tp_traverse */
-     fprintf(fp[0], "     0,\n");						/* tp_clear */
-     fprintf(fp[0], "     0,\n");						/* tp_richcompare */
-     fprintf(fp[0], "     0,\n");						/* tp_weaklistoffset */
-     fprintf(fp[0], "     0,\n");						/* tp_iter */
-     fprintf(fp[0], "     0,\n");						/* tp_iternext */
-     fprintf(fp[0], "     %s_methods,\n", d->prefix);				/* tp_methods */
-     fprintf(fp[0], "     %s_members,\n", d->prefix);				/* tp_members */
-     fprintf(fp[0], "     0,\n");						/* tp_getset */
-     fprintf(fp[0], "     0,\n");						/* tp_base */
-     fprintf(fp[0], "     0,\n");						/* tp_dict */
-     fprintf(fp[0], "     0,\n");						/* tp_descr_get */
-     fprintf(fp[0], "     0,\n");						/* tp_descr_set */
-     fprintf(fp[0], "     0,\n");						/* tp_dictoffset */
-     fprintf(fp[0], "     (initproc) %s_init,\n", d->prefix);			/* tp_init */
-     fprintf(fp[0], "     0,\n");						/* tp_alloc */
-     fprintf(fp[0], "     (newfunc) %s_new\n", d->prefix);			/* tp_new */
-     fprintf(fp[0], "};\n");
-     fprintf(fp[0], "\n");
-     fprintf(fp[0], "\n");
-
-     fprintf(fp[0], "static PyMethodDef module_methods[] = {\n");
-     fprintf(fp[0], "     {NULL}\n");
-     fprintf(fp[0], "};\n");
-     fprintf(fp[0], "\n");
-     fprintf(fp[0], "\n");
-
-     fprintf(fp[0], "#ifndef PyMODINIT_FUNC\n");
-     fprintf(fp[0], "#define PyMODINIT_FUNC void\n");
-     fprintf(fp[0], "#endif\n");
-     fprintf(fp[0], "\n");
-     fprintf(fp[0], "\n");
-
-     fprintf(fp[0], "#if PY_MAJOR_VERSION >= 3\n");
-     fprintf(fp[0], "    static struct PyModuleDef module_def = {\n");
-     fprintf(fp[0], "        PyModuleDef_HEAD_INIT,\n");
-     fprintf(fp[0], "        \"%s\",\n", d->prefix);
-     fprintf(fp[0], "        \"Module for accessing %s\",\n", d->PREFIX);
-     fprintf(fp[0], "        -1,\n");
-     fprintf(fp[0], "        module_methods,\n");
-     fprintf(fp[0], "        NULL,\n");
-     fprintf(fp[0], "        NULL,\n");
-     fprintf(fp[0], "        NULL,\n");
-     fprintf(fp[0], "        NULL\n");
-     fprintf(fp[0], "    };\n");
-     fprintf(fp[0], "#endif\n");
-     fprintf(fp[0], "\n");
-     fprintf(fp[0], "\n");
-
-     fprintf(fp[0], "#if PY_MAJOR_VERSION < 3\n");
-     fprintf(fp[0], "PyMODINIT_FUNC init%s(void)\n", d->prefix);
-     fprintf(fp[0], "{\n");
-     fprintf(fp[0], "     PyObject *module;\n");
-     fprintf(fp[0], "     if (PyType_Ready(&%s_type) < 0)\n", d->prefix);
-     fprintf(fp[0], "          return;\n");
-     fprintf(fp[0], "     module = Py_InitModule3(\"%s\", module_methods, \"Module for accessing %s\");\n", d->prefix, d->PREFIX);
-     fprintf(fp[0], "     if (module == NULL)\n");
-     fprintf(fp[0], "          return;\n");
-     fprintf(fp[0], "     Py_INCREF(&%s_type);\n", d->prefix);
-     fprintf(fp[0], "     PyModule_AddObject(module, \"%s\", (PyObject *) &%s_type);\n", d->prefix, d->prefix);
-     fprintf(fp[0], "     %sError = PyErr_NewException(\"%s.error\", NULL, NULL);\n", d->PREFIX, d->prefix);
-     fprintf(fp[0], "     Py_INCREF(%sError);\n", d->PREFIX);
-     fprintf(fp[0], "     PyModule_AddObject(module, \"error\", %sError);\n", d->PREFIX);
-     fprintf(fp[0], "     import_array();\n");
-     fprintf(fp[0], "}\n");
-     fprintf(fp[0], "#else\n");
-     fprintf(fp[0], "PyMODINIT_FUNC PyInit_%s(void)\n", d->prefix);
-     fprintf(fp[0], "{\n");
-     fprintf(fp[0], "     PyObject *module;\n");
-     fprintf(fp[0], "     if (PyType_Ready(&%s_type) < 0)\n", d->prefix);
-     fprintf(fp[0], "          return NULL;\n");
-     fprintf(fp[0], "     module = PyModule_Create(&module_def);\n");
-     fprintf(fp[0], "     if (module == NULL)\n");
-     fprintf(fp[0], "          return NULL;\n");
-     fprintf(fp[0], "     Py_INCREF(&%s_type);\n", d->prefix);
-     fprintf(fp[0], "     PyModule_AddObject(module, \"%s\", (PyObject *) &%s_type);\n", d->prefix, d->prefix);
-     fprintf(fp[0], "     %sError = PyErr_NewException(\"%s.error\", NULL, NULL);\n", d->PREFIX, d->prefix);
-     fprintf(fp[0], "     Py_INCREF(%sError);\n", d->PREFIX);
-     fprintf(fp[0], "     PyModule_AddObject(module, \"error\", %sError);\n", d->PREFIX);
-     fprintf(fp[0], "     import_array();\n");
-     fprintf(fp[0], "     return module;\n");
-     fprintf(fp[0], "}\n");
-     fprintf(fp[0], "#endif\n");
+     bxprintf(fp[0], "\n");
+     bxprintf(fp[0], "\n");
+
+     bxprintf(fp[0], "static PyMemberDef %s_members[] = {\n", d->prefix);
+     bxprintf(fp[0], "     {NULL}\n");
+     bxprintf(fp[0], "};\n");
+     bxprintf(fp[0], "\n");
+     bxprintf(fp[0], "\n");
+
+     if (d->limited_api)
+          write_type_spec(fp[0], d);
+     else
+          write_type_object(fp[0], d);
+
+     write_structure_descrs_init(fp[0], d);
+
+     bxprintf(fp[0], "static PyMethodDef module_methods[] = {\n");
+     bxprintf(fp[0], "     {\"array_copies\", (PyCFunction) array_copies_py, METH_NOARGS, \"Number of array arguments copied to match a layout\"},\n");
+     bxprintf(fp[0], "     {\"strict_arrays\", (PyCFunction) strict_arrays_py, METH_VARARGS, \"Return, and optionally set, whether array arguments that need a copy raise instead\"},\n");
+     if (d->stats)
+          bxprintf(fp[0], "     {\"stats\", (PyCFunction) stats_py, METH_NOARGS, \"Per-subprogram call counts, phase times (ns) and log2 ns histograms\"},\n");
+     bxprintf(fp[0], "     {NULL}\n");
+     bxprintf(fp[0], "};\n");
+     bxprintf(fp[0], "\n");
+     bxprintf(fp[0], "\n");
+
+     bxprintf(fp[0], "#ifndef PyMODINIT_FUNC\n");
+     bxprintf(fp[0], "#define PyMODINIT_FUNC void\n");
+     bxprintf(fp[0], "#endif\n");
+     bxprintf(fp[0], "\n");
+     bxprintf(fp[0], "\n");
+
+     write_module_init(fp[0], d);
 
      return 0;
 }
@@ -23,6 +23,23 @@ const char *bindx_version()
 
 
 
+/*******************************************************************************
+ *
+ ******************************************************************************/
+void *bindx_realloc(void *p, size_t size)
+{
+     void *p2;
+
+     if ((p2 = realloc(p, size)) == NULL) {
+          fprintf(stderr, "ERROR: realloc(): %s\n", strerror(errno));
+          exit(1);
+     }
+
+     return p2;
+}
+
+
+
 /*******************************************************************************
  *
  ******************************************************************************/
@@ -95,27 +112,224 @@ char *bxis (int n) { return bindx_indent_str5(n); }
 
 
 
+/*******************************************************************************
+ * Back-ends write into a growable memory buffer which is written out once per
+ * file with bindx_buffer_flush().
+ ******************************************************************************/
+void bindx_buffer_init(bindx_buffer_data *b)
+{
+     b->data     = NULL;
+     b->size     = 0;
+     b->capacity = 0;
+
+     b->line          = NULL;
+     b->line_size     = 0;
+     b->line_capacity = 0;
+}
+
+
+
+void bindx_buffer_free(bindx_buffer_data *b)
+{
+     free(b->data);
+     free(b->line);
+}
+
+
+
+static void buffer_reserve(char **data, size_t *capacity, size_t size)
+{
+     if (size <= *capacity)
+          return;
+
+     *capacity = 2 * size > 4096 ? 2 * size : 4096;
+
+     *data = bindx_realloc(*data, *capacity);
+}
+
+
+
+void bindx_buffer_append(bindx_buffer_data *b, const char *s, size_t n)
+{
+     buffer_reserve(&b->data, &b->capacity, b->size + n + 1);
+
+     memcpy(b->data + b->size, s, n);
+
+     b->size += n;
+
+     b->data[b->size] = '\0';
+}
+
+
+
+static size_t buffer_vprintf(char **data, size_t *capacity, size_t size,
+                             const char *fmt, va_list ap)
+{
+     int n;
+
+     va_list ap2;
+
+     va_copy(ap2, ap);
+     n = vsnprintf(*data ? *data + size : NULL, *capacity - size, fmt, ap2);
+     va_end(ap2);
+
+     if (n < 0)
+          INTERNAL_ERROR("Invalid format: %s", fmt);
+
+     if (size + n + 1 > *capacity) {
+          buffer_reserve(data, capacity, size + n + 1);
+          vsnprintf(*data + size, *capacity - size, fmt, ap);
+     }
+
+     return size + n;
+}
+
+
+
+void bxvprintf(bindx_buffer_data *b, const char *fmt, va_list ap)
+{
+     b->size = buffer_vprintf(&b->data, &b->capacity, b->size, fmt, ap);
+}
+
+
+
+void bxprintf(bindx_buffer_data *b, const char *fmt, ...)
+{
+     va_list ap;
+
+     va_start(ap, fmt);
+
+     bxvprintf(b, fmt, ap);
+
+     va_end(ap);
+}
+
+
+
 /*******************************************************************************
  *
  ******************************************************************************/
-void ifprintf(FILE *fp, int n_indent, const char *fmt, ...)
+void ifprintf(bindx_buffer_data *fp, int n_indent, const char *fmt, ...)
 {
      va_list ap;
 
-     fprintf(fp, "%s", bindx_indent_str5(n_indent));
+     bxprintf(fp, "%s", bindx_indent_str5(n_indent));
 
      va_start(ap, fmt);
 
-     vfprintf(fp, fmt, ap);
+     bxvprintf(fp, fmt, ap);
 
      va_end(ap);
 }
 
 
+
+/*******************************************************************************
+ * Outputs are first written to a temporary file next to the final one which
+ * then replaces the final one, only if the contents differ.  Unchanged outputs
+ * keep their time stamps so that dependent builds are not triggered.
+ ******************************************************************************/
+static char *temp_file_name(const char *file_name)
+{
+     char *temp_name;
+
+     temp_name = malloc(strlen(file_name) + strlen(".bindx_tmp") + 1);
+
+     sprintf(temp_name, "%s.bindx_tmp", file_name);
+
+     return temp_name;
+}
+
+
+
+static int file_is_equal(const char *file_name, const char *data, size_t size,
+                         int binary)
+{
+     char buffer[4096];
+
+     int r = 1;
+
+     size_t n;
+
+     FILE *fp;
+
+     if ((fp = fopen(file_name, binary ? "rb" : "r")) == NULL)
+          return 0;
+
+     do {
+          n = fread(buffer, 1, sizeof(buffer), fp);
+
+          if (n > size || memcmp(buffer, data, n) != 0) {
+               r = 0;
+               break;
+          }
+
+          data += n;
+          size -= n;
+     } while (n == sizeof(buffer));
+
+     fclose(fp);
+
+     return r && size == 0;
+}
+
+
+
+int bindx_file_update(const char *file_name, const char *data, size_t size,
+                      int binary)
+{
+     char *temp_name;
+
+     FILE *fp;
+
+     if (file_is_equal(file_name, data, size, binary))
+          return 0;
+
+     temp_name = temp_file_name(file_name);
+
+     if ((fp = fopen(temp_name, binary ? "wb" : "w")) == NULL) {
+          fprintf(stderr, "ERROR: Problem opening file for writing: %s ... %s\n",
+                  temp_name, strerror(errno));
+          free(temp_name);
+          return -1;
+     }
+
+     if (fwrite(data, 1, size, fp) != size || fclose(fp) != 0) {
+          fprintf(stderr, "ERROR: Problem writing file: %s ... %s\n",
+                  temp_name, strerror(errno));
+          remove(temp_name);
+          free(temp_name);
+          return -1;
+     }
+#if PLATFORM == WIN32_MSVC
+     remove(file_name);
+#endif
+     if (rename(temp_name, file_name)) {
+          fprintf(stderr, "ERROR: Problem renaming file: %s to %s ... %s\n",
+                  temp_name, file_name, strerror(errno));
+          remove(temp_name);
+          free(temp_name);
+          return -1;
+     }
+
+     free(temp_name);
+
+     return 0;
+}
+
+
+
+int bindx_buffer_flush(bindx_buffer_data *b, const char *file_name)
+{
+     return bindx_file_update(file_name, b->data, b->size, 0);
+}
+
+
+
 /*******************************************************************************
  *
  ******************************************************************************/
-static char *write_string_trunc(FILE *fp, char *s, int n, char *prefix)
+static char *write_string_trunc(bindx_buffer_data *fp, char *s, int n, char *prefix)
 {
      int i;
 
@@ -125,7 +339,7 @@ static char *write_string_trunc(FILE *fp, char *s, int n, char *prefix)
 
      s[i + 1] = '\0';
 
-     fprintf(fp, "%s%s\n", prefix, s);
+     bxprintf(fp, "%s%s\n", prefix, s);
 
      for (i += 2; s[i] == ' ' || s[i] == '\t'; ++i) ;
 
@@ -134,7 +348,7 @@ static char *write_string_trunc(FILE *fp, char *s, int n, char *prefix)
 
 
 
-static void write_string_wrap(FILE *fp, char *s, int n, int n_wrap, char *prefix)
+static void write_string_wrap(bindx_buffer_data *fp, char *s, int n, int n_wrap, char *prefix)
 {
      char *s2;
 
@@ -152,7 +366,7 @@ static void write_string_wrap(FILE *fp, char *s, int n, int n_wrap, char *prefix
 
      while (1) {
           if (n <= n_wrap) {
-               fprintf(fp, "%s%s\n", prefix2, s2);
+               bxprintf(fp, "%s%s\n", prefix2, s2);
                return;
           }
 
@@ -168,30 +382,31 @@ static void write_string_wrap(FILE *fp, char *s, int n, int n_wrap, char *prefix
 
 
 
-void bindx_fprintf_wrap(FILE *fp, int n_wrap, char *prefix, const char *fmt, va_list ap)
+/*
+ * The partial line is kept in the buffer between calls until a newline is
+ * seen.
+ */
+void bxprintf_wrap(bindx_buffer_data *fp, int n_wrap, char *prefix, const char *fmt, va_list ap)
 {
-     int j;
-     int n;
-
-     static int i = 0;
-
-     static char buffer[1024];
+     char *p;
+     char *end;
+     char *line;
 
-     n = vsprintf(buffer + i, fmt, ap);
+     fp->line_size = buffer_vprintf(&fp->line, &fp->line_capacity, fp->line_size,
+                                    fmt, ap);
 
-     for (j = 0; j < n; ++j) {
-          if (buffer[i + j] == '\n') {
-                buffer[i + j] = '\0';
+     line = fp->line;
+     end  = fp->line + fp->line_size;
 
-                write_string_wrap(fp, buffer, i + j, n_wrap, prefix);
+     while ((p = memchr(line, '\n', end - line)) != NULL) {
+          *p = '\0';
 
-                memmove(buffer, buffer + i + j, n - j);
+          write_string_wrap(fp, line, p - line, n_wrap, prefix);
 
-                i  = 0;
-
-                n -= j + 1;
-          }
+          line = p + 1;
      }
 
-     i += n;
+     fp->line_size = end - line;
+
+     memmove(fp->line, line, fp->line_size);
 }
@@ -17,6 +17,17 @@ extern "C" {
 #endif
 
 
+typedef struct {
+     char *data;
+     size_t size;
+     size_t capacity;
+
+     char *line;
+     size_t line_size;
+     size_t line_capacity;
+} bindx_buffer_data;
+
+
 #define internal_compiler_error(text) do {			\
     fprintf(stderr, "Internal compiler error: %s:%d, %s\n",	\
             __FILE__, __LINE__, text);				\
@@ -0,0 +1,2 @@
+/* bindx_batch.c */
+int bindx_write_batch(bindx_buffer_data **fp, const bindx_data *d, const char *name);
@@ -0,0 +1,2 @@
+/* bindx_bench.c */
+int bindx_write_bench(bindx_buffer_data **fp, const bindx_data *d, const char *name);
@@ -1,14 +1,24 @@
 /* bindx_c.c */
 size_t bindx_c_type_size(const type_data *type);
+const char *bindx_c_type_postfix(const type_data *type);
 const char *bindx_c_error_conditional(const bindx_data *d, int lex_bindx_type);
-int bindx_write_c_header(FILE *fp);
-int bindx_write_c_header_top(FILE *fp);
-int bindx_write_c_util_header(FILE *fp, const bindx_data *d);
-int bindx_write_c_util_trailer(FILE *fp, const bindx_data *d);
-int bindx_write_c_type(FILE *fp, const bindx_data *d, const type_data *type, const char *prefix);
-int bindx_write_c_dimens(FILE *fp, const bindx_data *d, const type_data *type);
-int bindx_write_c_dimens_args(FILE *fp, const bindx_data *d, const type_data *type, enum lex_subprogram_argument_usage usage);
-int bindx_write_c_dimens_return(FILE *fp, const bindx_data *d, const type_data *type);
-int bindx_write_c_declaration(FILE *fp, const bindx_data *d, const type_data *type, const char *prefix);
-int bindx_write_c_enum_mask_init(FILE *fp, struct list_data *list, const char *name, const char *prefix, int indent);
-int bindx_write_c_enum_array_init(FILE *fp, struct list_data *list, const char *name, const char *prefix, int indent);
+int bindx_write_c_header(bindx_buffer_data *fp);
+int bindx_write_c_header_top(bindx_buffer_data *fp);
+int bindx_write_c_util_header(bindx_buffer_data *fp, const bindx_data *d);
+int bindx_write_c_util_trailer(bindx_buffer_data *fp, const bindx_data *d);
+int bindx_write_c_type(bindx_buffer_data *fp, const bindx_data *d, const type_data *type, const char *prefix);
+int bindx_write_c_dimens(bindx_buffer_data *fp, const bindx_data *d, const type_data *type);
+int bindx_write_c_dimens_args(bindx_buffer_data *fp, const bindx_data *d, const type_data *type, enum lex_subprogram_argument_usage usage);
+int bindx_write_c_dimens_return(bindx_buffer_data *fp, const bindx_data *d, const type_data *type);
+int bindx_write_c_declaration(bindx_buffer_data *fp, const bindx_data *d, const type_data *type, const char *prefix);
+int bindx_write_c_argument_dimens(bindx_buffer_data *fp, const bindx_data *d, const argument_data *argument);
+int bindx_write_c_argument_dimens_args(bindx_buffer_data *fp, const bindx_data *d, const argument_data *argument);
+int bindx_write_c_argument_declaration(bindx_buffer_data *fp, const bindx_data *d, const argument_data *argument);
+int bindx_write_c_subprogram_dimens(bindx_buffer_data *fp, const subprogram_data *subprogram, const argument_data *argument, int *n_dimens, const char *indent);
+int bindx_write_c_row_major_strides(bindx_buffer_data *fp, const argument_data *argument, const char *indent);
+int bindx_write_c_enum_mask_init(bindx_buffer_data *fp, struct list_data *list, const char *name, const char *prefix, int indent);
+int bindx_write_c_enum_array_init(bindx_buffer_data *fp, struct list_data *list, const char *name, const char *prefix, int indent);
+int bindx_write_c_stats_header(bindx_buffer_data *fp, const bindx_data *d);
+int bindx_write_c_stats_utilities(bindx_buffer_data *fp, const bindx_data *d);
+int bindx_write_c_stats_declaration(bindx_buffer_data *fp, const bindx_data *d, int indent);
+int bindx_write_c_stats_time(bindx_buffer_data *fp, const bindx_data *d, int i, int i_stats, int indent);
@@ -0,0 +1,7 @@
+/* bindx_cache.c */
+int bindx_cache_hash_file(const char *file, uint64_t *hash);
+int bindx_cache_open(bindx_cache_data *c, const char *name);
+bindx_data *bindx_cache_load_file(bindx_cache_data *c, const char *file, uint64_t hash, locus_data *locus);
+void bindx_cache_add_file(bindx_cache_data *c, const char *file, uint64_t hash, const bindx_data *d);
+int bindx_cache_back_end(bindx_cache_data *c, const bindx_data *d, const char *tag, int sections, const char *name, int n_out_files, char **out_files);
+int bindx_cache_close(bindx_cache_data *c);
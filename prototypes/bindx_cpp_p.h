@@ -1,2 +1,2 @@
 /* bindx_cpp.c */
-int bindx_write_cpp(FILE **fp, const bindx_data *d, const char *name);
+int bindx_write_cpp(bindx_buffer_data **fp, const bindx_data *d, const char *name);
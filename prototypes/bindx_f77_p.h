@@ -1,2 +1,2 @@
 /* bindx_f77.c */
-int bindx_write_f77(FILE **fp, const bindx_data *d, const char *name);
+int bindx_write_f77(bindx_buffer_data **fp, const bindx_data *d, const char *name);
@@ -1,2 +1,2 @@
 /* bindx_idl.c */
-int bindx_write_idl(FILE **fp, const bindx_data *d, const char *name);
+int bindx_write_idl(bindx_buffer_data **fp, const bindx_data *d, const char *name);
@@ -1,2 +1,2 @@
 /* bindx_jl.c */
-int bindx_write_jl(FILE **fp, const bindx_data *d, const char *name);
+int bindx_write_jl(bindx_buffer_data **fp, const bindx_data *d, const char *name);
@@ -1,4 +1,6 @@
 /* bindx.c */
 int main(int argc, char *argv[]);
-int bindx_write_x(const bindx_data *bindx_int, const char *name, int n_out_files, char **out_files, int (*write)(FILE **, const bindx_data *, const char *));
+int bindx_write_x(const bindx_data *bindx_int, const char *name, int n_out_files, char **out_files, int (*write)(bindx_buffer_data **, const bindx_data *, const char *));
+int bindx_write_jobs(const bindx_data *bindx_int, int n_jobs, write_job_data *jobs, int n_threads);
+int bindx_write_deps(const char *file, int n_in_files, char **in_files, int n_out_files, char **out_files);
 void usage(void);
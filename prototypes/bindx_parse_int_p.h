@@ -1,12 +1,25 @@
 /* bindx_parse_int.c */
 int subprogram_n_in_args(subprogram_data *d);
-int subprogram_n_out_args(subprogram_data *d);
+int subprogram_n_out_args(const subprogram_data *d);
 int subprogram_n_scaler_in_args(subprogram_data *d);
 int subprogram_n_scaler_out_args(subprogram_data *d);
 void bindx_init(bindx_data *d);
+void bindx_add_subprogram(bindx_data *d, int sub_type, subprogram_data *subprogram, locus_data *locus);
+const subprogram_data *bindx_buffer_subprogram(const bindx_data *d);
+const subprogram_data *bindx_snapshot_subprogram(const bindx_data *d);
+const subprogram_data *bindx_restore_subprogram(const bindx_data *d);
+const subprogram_data *bindx_clone_subprogram(const bindx_data *d);
+int bindx_plan_argument_is_bound(const subprogram_data *subprogram, const argument_data *argument);
+int bindx_subprogram_type(const bindx_data *d, const subprogram_data *subprogram);
 void bindx_parse(bindx_data *d, locus_data *locus);
+void bindx_merge(bindx_data *d, bindx_data *a, locus_data *locus);
 void bindx_finialize(bindx_data *d);
+void bindx_free_subprogram(subprogram_data *d);
 void bindx_free(bindx_data *d);
-int bindx_write(FILE *fp, const bindx_data *d);
+int bindx_write(bindx_buffer_data *fp, const bindx_data *d);
 int min_argument_rank(argument_data *args);
 int max_argument_rank(argument_data *args);
+int argument_is_flat_array(const argument_data *d);
+int argument_is_pointer_array(const argument_data *d);
+size_t field_n_elems(const field_data *d);
+size_t field_size(const field_data *d);
@@ -1,2 +1,2 @@
 /* bindx_py.c */
-int bindx_write_py(FILE **fp, const bindx_data *d, const char *name);
+int bindx_write_py(bindx_buffer_data **fp, const bindx_data *d, const char *name);
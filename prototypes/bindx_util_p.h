@@ -1,7 +1,15 @@
 /* bindx_util.c */
 const char *bindx_version(void);
+void *bindx_realloc(void *p, size_t size);
 char *bxis4(int n);
 char *bxis5(int n);
 char *bxis(int n);
-void ifprintf(FILE *fp, int n_indent, const char *fmt, ...);
-void bindx_fprintf_wrap(FILE *fp, int n_wrap, char *prefix, const char *fmt, va_list ap);
+void bindx_buffer_init(bindx_buffer_data *b);
+void bindx_buffer_free(bindx_buffer_data *b);
+void bindx_buffer_append(bindx_buffer_data *b, const char *s, size_t n);
+void bxvprintf(bindx_buffer_data *b, const char *fmt, va_list ap);
+void bxprintf(bindx_buffer_data *b, const char *fmt, ...);
+void ifprintf(bindx_buffer_data *fp, int n_indent, const char *fmt, ...);
+int bindx_file_update(const char *file_name, const char *data, size_t size, int binary);
+int bindx_buffer_flush(bindx_buffer_data *b, const char *file_name);
+void bxprintf_wrap(bindx_buffer_data *fp, int n_wrap, char *prefix, const char *fmt, va_list ap);